@@ -39,6 +39,10 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define LOAD_BUFFER_SIZE 65536
 
@@ -327,66 +331,207 @@ eel_cancel_gdk_pixbuf_load (EelPixbufLoadHandle *handle)
     g_cancellable_cancel (handle->cancellable);
 }
 
+/* Adds r * a, g * a, b * a and a for each pixel to sums, starting at
+   pixel start. */
+static void
+sum_pixels_with_alpha_scalar (const guchar *pixels, int start, int n_pixels,
+                              guint64 sums[4])
+{
+    const guchar *p;
+    int i;
+
+    for (i = start; i < n_pixels; i++)
+    {
+        p = pixels + 4 * i;
+        sums[0] += p[0] * p[3];
+        sums[1] += p[1] * p[3];
+        sums[2] += p[2] * p[3];
+        sums[3] += p[3];
+    }
+}
+
+/* Adds r, g and b for each pixel to sums, starting at pixel start. */
+static void
+sum_pixels_without_alpha_scalar (const guchar *pixels, int start, int n_pixels,
+                                 guint64 sums[3])
+{
+    const guchar *p;
+    int i;
+
+    for (i = start; i < n_pixels; i++)
+    {
+        p = pixels + 3 * i;
+        sums[0] += p[0];
+        sums[1] += p[1];
+        sums[2] += p[2];
+    }
+}
+
+#ifdef __SSE2__
+/* The vector sums of pixels with alpha are kept in 32 bits, which is
+   enough for this many pixels at full weight. */
+#define MAX_VECTOR_SUMMED_PIXELS 16384
+
+/* r * a, g * a, b * a and a of the two pixels in the 16 bit lanes of
+   pixels, added up in 32 bit lanes. */
+static inline __m128i
+weigh_two_pixels (__m128i pixels, __m128i color_mask, __m128i alpha_one)
+{
+    __m128i alphas, products, zero;
+
+    alphas = _mm_shufflelo_epi16 (pixels, _MM_SHUFFLE (3, 3, 3, 3));
+    alphas = _mm_shufflehi_epi16 (alphas, _MM_SHUFFLE (3, 3, 3, 3));
+    alphas = _mm_or_si128 (_mm_and_si128 (alphas, color_mask), alpha_one);
+    products = _mm_mullo_epi16 (pixels, alphas);
+
+    zero = _mm_setzero_si128 ();
+    return _mm_add_epi32 (_mm_unpacklo_epi16 (products, zero),
+                          _mm_unpackhi_epi16 (products, zero));
+}
+
+/* Bytes of each of the channels, for the three ways 16 bytes of RGB
+   can start. */
+static const guchar rgb_channel_masks[3][16] =
+{
+    { 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff },
+    { 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0 },
+    { 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0, 0, 0xff, 0 }
+};
+#endif
+
+static void
+sum_pixels_with_alpha (const guchar *pixels, int n_pixels, guint64 sums[4])
+{
+    int i;
+
+    i = 0;
+#ifdef __SSE2__
+    if (n_pixels >= 4)
+    {
+        __m128i zero, color_mask, alpha_one, totals, block;
+        guint32 lanes[4];
+        int end;
+
+        zero = _mm_setzero_si128 ();
+        color_mask = _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1);
+        alpha_one = _mm_set_epi16 (1, 0, 0, 0, 1, 0, 0, 0);
+
+        while (i + 4 <= n_pixels)
+        {
+            end = MIN (n_pixels, i + MAX_VECTOR_SUMMED_PIXELS);
+            totals = zero;
+            for (; i + 4 <= end; i += 4)
+            {
+                block = _mm_loadu_si128 ((const __m128i *) (pixels + 4 * i));
+                totals = _mm_add_epi32 (totals, weigh_two_pixels (_mm_unpacklo_epi8 (block, zero),
+                                        color_mask, alpha_one));
+                totals = _mm_add_epi32 (totals, weigh_two_pixels (_mm_unpackhi_epi8 (block, zero),
+                                        color_mask, alpha_one));
+            }
+
+            _mm_storeu_si128 ((__m128i *) lanes, totals);
+            sums[0] += lanes[0];
+            sums[1] += lanes[1];
+            sums[2] += lanes[2];
+            sums[3] += lanes[3];
+        }
+    }
+#endif
+    sum_pixels_with_alpha_scalar (pixels, i, n_pixels, sums);
+}
+
+static void
+sum_pixels_without_alpha (const guchar *pixels, int n_pixels, guint64 sums[3])
+{
+    int i;
+
+    i = 0;
+#ifdef __SSE2__
+    if (n_pixels >= 16)
+    {
+        __m128i zero, masks[3], totals[3], block;
+        guint64 lanes[2];
+        int block_index, channel;
+
+        zero = _mm_setzero_si128 ();
+        for (channel = 0; channel < 3; channel++)
+        {
+            masks[channel] = _mm_loadu_si128 ((const __m128i *) rgb_channel_masks[channel]);
+            totals[channel] = zero;
+        }
+
+        /* 16 pixels are 3 blocks of 16 bytes, each channel is added up
+           with the mask that picks its bytes from the block. */
+        for (; i + 16 <= n_pixels; i += 16)
+        {
+            for (block_index = 0; block_index < 3; block_index++)
+            {
+                block = _mm_loadu_si128 ((const __m128i *) (pixels + 3 * i + 16 * block_index));
+                for (channel = 0; channel < 3; channel++)
+                {
+                    totals[channel] = _mm_add_epi64 (totals[channel],
+                                                     _mm_sad_epu8 (_mm_and_si128 (block, masks[(channel - block_index + 3) % 3]), zero));
+                }
+            }
+        }
+
+        for (channel = 0; channel < 3; channel++)
+        {
+            _mm_storeu_si128 ((__m128i *) lanes, totals[channel]);
+            sums[channel] += lanes[0] + lanes[1];
+        }
+    }
+#endif
+    sum_pixels_without_alpha_scalar (pixels, i, n_pixels, sums);
+}
+
 /* return the average value of each component */
 guint32
 eel_gdk_pixbuf_average_value (GdkPixbuf *pixbuf)
 {
     guint64 a_total, r_total, g_total, b_total;
-    guint row, column;
+    guint row;
     int row_stride;
     const guchar *pixels, *p;
-    int r, g, b, a;
+    guint64 sums[4];
     guint64 dividend;
     guint width, height;
+    gboolean has_alpha;
 
     width = gdk_pixbuf_get_width (pixbuf);
     height = gdk_pixbuf_get_height (pixbuf);
     row_stride = gdk_pixbuf_get_rowstride (pixbuf);
     pixels = gdk_pixbuf_get_pixels (pixbuf);
+    has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
 
     /* iterate through the pixbuf, counting up each component */
-    a_total = 0;
-    r_total = 0;
-    g_total = 0;
-    b_total = 0;
+    memset (sums, 0, sizeof (sums));
 
-    if (gdk_pixbuf_get_has_alpha (pixbuf))
+    for (row = 0; row < height; row++)
     {
-        for (row = 0; row < height; row++)
+        p = pixels + (row * row_stride);
+        if (has_alpha)
         {
-            p = pixels + (row * row_stride);
-            for (column = 0; column < width; column++)
-            {
-                r = *p++;
-                g = *p++;
-                b = *p++;
-                a = *p++;
-
-                a_total += a;
-                r_total += r * a;
-                g_total += g * a;
-                b_total += b * a;
-            }
+            sum_pixels_with_alpha (p, width, sums);
+        }
+        else
+        {
+            sum_pixels_without_alpha (p, width, sums);
         }
+    }
+
+    r_total = sums[0];
+    g_total = sums[1];
+    b_total = sums[2];
+    a_total = sums[3];
+
+    if (has_alpha)
+    {
         dividend = height * width * 0xFF;
         a_total *= 0xFF;
     }
     else
     {
-        for (row = 0; row < height; row++)
-        {
-            p = pixels + (row * row_stride);
-            for (column = 0; column < width; column++)
-            {
-                r = *p++;
-                g = *p++;
-                b = *p++;
-
-                r_total += r;
-                g_total += g;
-                b_total += b;
-            }
-        }
         dividend = height * width;
         a_total = dividend * 0xFF;
     }
@@ -1052,11 +1197,12 @@ eel_gdk_pixbuf_scale_down (GdkPixbuf *pixbuf,
     int s_xfrac, s_yfrac;
     int dx, dx_frac, dy, dy_frac;
     div_t ddx, ddy;
-    int x, y;
-    int r, g, b, a;
-    int n_pixels;
+    int y;
+    guint64 sums[4];
+    guint64 r, g, b, a;
+    guint64 n_pixels;
     gboolean has_alpha;
-    guchar *dest, *src, *xsrc, *src_pixels;
+    guchar *dest, *src, *src_pixels;
     GdkPixbuf *dest_pixbuf;
     int pixel_stride;
     int source_rowstride, dest_rowstride;
@@ -1116,38 +1262,26 @@ eel_gdk_pixbuf_scale_down (GdkPixbuf *pixbuf,
             }
 
             /* Average block of [x1,x2[ x [y1,y2[ and store in dest */
-            r = g = b = a = 0;
-            n_pixels = 0;
+            memset (sums, 0, sizeof (sums));
+            n_pixels = (s_x2 - s_x1) * (s_y2 - s_y1);
 
             src = src_pixels + s_y1 * source_rowstride + s_x1 * pixel_stride;
             for (y = s_y1; y < s_y2; y++)
             {
-                xsrc = src;
                 if (has_alpha)
                 {
-                    for (x = 0; x < s_x2-s_x1; x++)
-                    {
-                        n_pixels++;
-
-                        r += xsrc[3] * xsrc[0];
-                        g += xsrc[3] * xsrc[1];
-                        b += xsrc[3] * xsrc[2];
-                        a += xsrc[3];
-                        xsrc += 4;
-                    }
+                    sum_pixels_with_alpha (src, s_x2 - s_x1, sums);
                 }
                 else
                 {
-                    for (x = 0; x < s_x2-s_x1; x++)
-                    {
-                        n_pixels++;
-                        r += *xsrc++;
-                        g += *xsrc++;
-                        b += *xsrc++;
-                    }
+                    sum_pixels_without_alpha (src, s_x2 - s_x1, sums);
                 }
                 src += source_rowstride;
             }
+            r = sums[0];
+            g = sums[1];
+            b = sums[2];
+            a = sums[3];
 
             if (has_alpha)
             {
@@ -1182,71 +1316,6 @@ eel_gdk_pixbuf_scale_down (GdkPixbuf *pixbuf,
     return dest_pixbuf;
 }
 
-static guchar
-eel_gdk_pixbuf_lighten_pixbuf_component (guchar cur_value,
-        guint lighten_value)
-{
-    int new_value = cur_value;
-    if (lighten_value > 0)
-    {
-        new_value += lighten_value + (new_value >> 3);
-        if (new_value > 255)
-        {
-            new_value = 255;
-        }
-    }
-    return (guchar) new_value;
-}
-
-static GdkPixbuf *
-eel_gdk_pixbuf_lighten (GdkPixbuf* src,
-                        guint lighten_value)
-{
-    GdkPixbuf *dest;
-    int i, j;
-    int width, height, has_alpha, src_row_stride, dst_row_stride;
-    guchar *target_pixels, *original_pixels;
-    guchar *pixsrc, *pixdest;
-
-    g_assert (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB);
-    g_assert ((!gdk_pixbuf_get_has_alpha (src)
-               && gdk_pixbuf_get_n_channels (src) == 3)
-              || (gdk_pixbuf_get_has_alpha (src)
-                  && gdk_pixbuf_get_n_channels (src) == 4));
-    g_assert (gdk_pixbuf_get_bits_per_sample (src) == 8);
-
-    dest = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (src),
-                           gdk_pixbuf_get_has_alpha (src),
-                           gdk_pixbuf_get_bits_per_sample (src),
-                           gdk_pixbuf_get_width (src),
-                           gdk_pixbuf_get_height (src));
-
-    has_alpha = gdk_pixbuf_get_has_alpha (src);
-    width = gdk_pixbuf_get_width (src);
-    height = gdk_pixbuf_get_height (src);
-    dst_row_stride = gdk_pixbuf_get_rowstride (dest);
-    src_row_stride = gdk_pixbuf_get_rowstride (src);
-    target_pixels = gdk_pixbuf_get_pixels (dest);
-    original_pixels = gdk_pixbuf_get_pixels (src);
-
-    for (i = 0; i < height; i++)
-    {
-        pixdest = target_pixels + i * dst_row_stride;
-        pixsrc = original_pixels + i * src_row_stride;
-        for (j = 0; j < width; j++)
-        {
-            *pixdest++ = eel_gdk_pixbuf_lighten_pixbuf_component (*pixsrc++, lighten_value);
-            *pixdest++ = eel_gdk_pixbuf_lighten_pixbuf_component (*pixsrc++, lighten_value);
-            *pixdest++ = eel_gdk_pixbuf_lighten_pixbuf_component (*pixsrc++, lighten_value);
-            if (has_alpha)
-            {
-                *pixdest++ = *pixsrc++;
-            }
-        }
-    }
-    return dest;
-}
-
 GdkPixbuf *
 eel_gdk_pixbuf_render (GdkPixbuf *pixbuf,
                        guint render_mode,
@@ -1298,7 +1367,7 @@ eel_gdk_pixbuf_render (GdkPixbuf *pixbuf,
     if (lighten_value > 0)
     {
         old_pixbuf = temp_pixbuf;
-        temp_pixbuf = eel_gdk_pixbuf_lighten (temp_pixbuf ? temp_pixbuf : pixbuf, lighten_value);
+        temp_pixbuf = eel_create_lightened_pixbuf (temp_pixbuf ? temp_pixbuf : pixbuf, lighten_value);
         if (old_pixbuf)
         {
             g_object_unref (old_pixbuf);
@@ -1308,6 +1377,36 @@ eel_gdk_pixbuf_render (GdkPixbuf *pixbuf,
     return temp_pixbuf;
 }
 
+static GdkPixbuf *
+render_effect (GdkPixbuf *pixbuf, const guint *params)
+{
+    return eel_gdk_pixbuf_render (pixbuf,
+                                  params[0],
+                                  params[1],
+                                  params[2],
+                                  params[3],
+                                  params[4]);
+}
+
+GdkPixbuf *
+eel_gdk_pixbuf_render_shared (GdkPixbuf *pixbuf,
+                              guint render_mode,
+                              guint saturation,
+                              guint brightness,
+                              guint lighten_value,
+                              guint color)
+{
+    guint params[EEL_GRAPHIC_EFFECT_N_PARAMS];
+
+    params[0] = render_mode;
+    params[1] = saturation;
+    params[2] = brightness;
+    params[3] = lighten_value;
+    params[4] = color;
+
+    return eel_graphic_effect_get_shared (pixbuf, render_effect, params);
+}
+
 
 #if !defined (EEL_OMIT_SELF_CHECK)
 
@@ -1395,6 +1494,88 @@ check_average_value (int width, int height, const char* fill)
                             average >> 24);
 }
 
+/* Scales a pixbuf whose pixels alternate between two colors, given as
+   0xRRGGBBAA, down to a single pixel. */
+static char *
+check_scale_down (int width, int height, gboolean alpha, guint32 even, guint32 odd)
+{
+    GdkPixbuf *pixbuf, *scaled;
+    int x, y, rowstride, n_channels;
+    guchar *pixels, *p;
+    guint32 color;
+    char *result;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, alpha, 8, width, height);
+    pixels = gdk_pixbuf_get_pixels (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            color = ((x + y) & 1) ? odd : even;
+            p = pixels + y * rowstride + x * n_channels;
+            p[0] = color >> 24;
+            p[1] = color >> 16;
+            p[2] = color >> 8;
+            if (alpha)
+            {
+                p[3] = color;
+            }
+        }
+    }
+
+    scaled = eel_gdk_pixbuf_scale_down (pixbuf, 1, 1);
+    p = gdk_pixbuf_get_pixels (scaled);
+    result = g_strdup_printf ("%02X,%02X,%02X,%02X",
+                              p[0], p[1], p[2], alpha ? p[3] : 0xFF);
+
+    g_object_unref (scaled);
+    g_object_unref (pixbuf);
+
+    return result;
+}
+
+/* Checks that the vector sums of pixels come out the same as the
+   scalar ones, for all the ways a run of pixels can end. */
+static gboolean
+check_sums_match_scalar (gboolean alpha)
+{
+    guchar *pixels;
+    guint64 sums[4], expected[4];
+    int i, n_pixels;
+    gboolean matches;
+
+    pixels = g_malloc (4 * 1000);
+    for (i = 0; i < 4 * 1000; i++)
+    {
+        pixels[i] = i * 167 + 13;
+    }
+
+    matches = TRUE;
+    for (n_pixels = 0; n_pixels <= 1000 && matches; n_pixels += n_pixels < 70 ? 1 : 310)
+    {
+        memset (sums, 0, sizeof (sums));
+        memset (expected, 0, sizeof (expected));
+        if (alpha)
+        {
+            sum_pixels_with_alpha (pixels, n_pixels, sums);
+            sum_pixels_with_alpha_scalar (pixels, 0, n_pixels, expected);
+        }
+        else
+        {
+            sum_pixels_without_alpha (pixels, n_pixels, sums);
+            sum_pixels_without_alpha_scalar (pixels, 0, n_pixels, expected);
+        }
+        matches = memcmp (sums, expected, sizeof (sums)) == 0;
+    }
+
+    g_free (pixels);
+
+    return matches;
+}
+
 void
 eel_self_check_gdk_pixbuf_extensions (void)
 {
@@ -1468,6 +1649,15 @@ eel_self_check_gdk_pixbuf_extensions (void)
     EEL_CHECK_STRING_RESULT (check_average_value (1000, 1000, "gray -1"), "7F,7F,7F,FF");
     EEL_CHECK_STRING_RESULT (check_average_value (1000, 1000, "gray 0"), "80,80,80,FF");
     EEL_CHECK_STRING_RESULT (check_average_value (1000, 1000, "gray 1"), "80,80,80,FF");
+    EEL_CHECK_STRING_RESULT (check_average_value (37, 3, "11,22,33,FF"), "11,22,33,FF");
+
+    EEL_CHECK_BOOLEAN_RESULT (check_sums_match_scalar (FALSE), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (check_sums_match_scalar (TRUE), TRUE);
+
+    EEL_CHECK_STRING_RESULT (check_scale_down (2, 1, FALSE, 0x000000FF, 0xFEFEFEFF), "7F,7F,7F,FF");
+    EEL_CHECK_STRING_RESULT (check_scale_down (37, 5, FALSE, 0x102030FF, 0x102030FF), "10,20,30,FF");
+    EEL_CHECK_STRING_RESULT (check_scale_down (2, 1, TRUE, 0xFF0000FF, 0x0000FF00), "FF,00,00,7F");
+    EEL_CHECK_STRING_RESULT (check_scale_down (37, 5, TRUE, 0x204060FF, 0x20406001), "20,40,60,80");
 }
 
 #endif /* !EEL_OMIT_SELF_CHECK */
@@ -148,4 +148,14 @@ GdkPixbuf *          eel_gdk_pixbuf_render                    (GdkPixbuf *pixbuf
         guint lighten_value,
         guint color);
 
+/* Same as eel_gdk_pixbuf_render, but the result is shared by everyone
+ * rendering the same pixbuf the same way, and must not be modified.
+ */
+GdkPixbuf *          eel_gdk_pixbuf_render_shared             (GdkPixbuf *pixbuf,
+        guint render_mode,
+        guint saturation,
+        guint brightness,
+        guint lighten_value,
+        guint color);
+
 #endif /* EEL_GDK_PIXBUF_EXTENSIONS_H */
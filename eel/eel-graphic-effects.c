@@ -27,7 +27,13 @@
 
 #include <config.h>
 #include "eel-graphic-effects.h"
+
+#include "eel-debug.h"
+#include "eel-lib-self-check-functions.h"
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* shared utility to create a new pixbuf from the passed-in one */
 
@@ -50,32 +56,236 @@ create_new_pixbuf (GdkPixbuf *src)
 /* utility routine to bump the level of a color component with pinning */
 
 static guchar
-lighten_component (guchar cur_value)
+lighten_component (guchar cur_value, guint lighten_value)
 {
     int new_value = cur_value;
-    new_value += 24 + (new_value >> 3);
-    if (new_value > 255)
+    if (lighten_value > 0)
     {
-        new_value = 255;
+        new_value += lighten_value + (new_value >> 3);
+        if (new_value > 255)
+        {
+            new_value = 255;
+        }
     }
     return (guchar) new_value;
 }
 
+/* The row kernels below take the row in bytes, and leave the alpha
+   channel alone. The scalar versions do the bytes from start on; the
+   others do what they can with SSE2 first, and leave the rest to the
+   scalar version, which gives the exact same results. */
+
+static void
+lighten_row_scalar (const guchar *src, guchar *dest, int start, int n_bytes,
+                    gboolean has_alpha, guint lighten_value)
+{
+    int i;
+
+    for (i = start; i < n_bytes; i++)
+    {
+        if (has_alpha && i % 4 == 3)
+        {
+            dest[i] = src[i];
+        }
+        else
+        {
+            dest[i] = lighten_component (src[i], lighten_value);
+        }
+    }
+}
+
+static void
+lighten_row (const guchar *src, guchar *dest, int n_bytes,
+             gboolean has_alpha, guint lighten_value)
+{
+    int i;
+
+    i = 0;
+#ifdef __SSE2__
+    if (lighten_value > 0)
+    {
+        __m128i lighten, low_bits, alpha, pixels, eighths, result;
+
+        /* v + lighten + v / 8, pinned, is two saturating adds. */
+        lighten = _mm_set1_epi8 ((char) MIN (lighten_value, 255));
+        low_bits = _mm_set1_epi8 (0x1f);
+        alpha = has_alpha ? _mm_set1_epi32 ((int) 0xff000000) : _mm_setzero_si128 ();
+
+        for (; i + 16 <= n_bytes; i += 16)
+        {
+            pixels = _mm_loadu_si128 ((const __m128i *) (src + i));
+            eighths = _mm_and_si128 (_mm_srli_epi16 (pixels, 3), low_bits);
+            result = _mm_adds_epu8 (_mm_adds_epu8 (pixels, eighths), lighten);
+            result = _mm_or_si128 (_mm_andnot_si128 (alpha, result),
+                                   _mm_and_si128 (alpha, pixels));
+            _mm_storeu_si128 ((__m128i *) (dest + i), result);
+        }
+    }
+#endif
+    lighten_row_scalar (src, dest, i, n_bytes, has_alpha, lighten_value);
+}
+
+static void
+darken_row_scalar (const guchar *src, guchar *dest, int start, int n_bytes,
+                   gboolean has_alpha, guchar negalpha, guchar alpha)
+{
+    int n_channels, i;
+    guchar intensity;
+    guchar r, g, b;
+
+    n_channels = has_alpha ? 4 : 3;
+    for (i = start; i + n_channels <= n_bytes; i += n_channels)
+    {
+        r = src[i];
+        g = src[i + 1];
+        b = src[i + 2];
+        intensity = (r * 77 + g * 150 + b * 28) >> 8;
+        dest[i] = (negalpha * intensity + alpha * r) >> 8;
+        dest[i + 1] = (negalpha * intensity + alpha * g) >> 8;
+        dest[i + 2] = (negalpha * intensity + alpha * b) >> 8;
+        if (has_alpha)
+        {
+            dest[i + 3] = src[i + 3];
+        }
+    }
+}
+
+#ifdef __SSE2__
+/* Darkens the two pixels in the 16 bit lanes of pixels. */
+static inline __m128i
+darken_two_pixels (__m128i pixels, __m128i weights,
+                   __m128i negalpha, __m128i alpha)
+{
+    __m128i sums, intensity;
+
+    /* r * 77 + g * 150 and b * 28 in 32 bit lanes, added up in the
+       low lane of each pixel, then spread over its 16 bit lanes. */
+    sums = _mm_madd_epi16 (pixels, weights);
+    sums = _mm_add_epi32 (sums, _mm_srli_epi64 (sums, 32));
+    intensity = _mm_srli_epi32 (sums, 8);
+    intensity = _mm_shufflelo_epi16 (intensity, _MM_SHUFFLE (0, 0, 0, 0));
+    intensity = _mm_shufflehi_epi16 (intensity, _MM_SHUFFLE (0, 0, 0, 0));
+
+    return _mm_srli_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (intensity, negalpha),
+                                          _mm_mullo_epi16 (pixels, alpha)), 8);
+}
+#endif
+
+static void
+darken_row (const guchar *src, guchar *dest, int n_bytes,
+            gboolean has_alpha, guchar negalpha, guchar alpha)
+{
+    int i;
+
+    i = 0;
+#ifdef __SSE2__
+    /* The sums only fit in 16 bits if the factors add up to at most
+       256, which they do for saturation and darken in range. */
+    if (has_alpha && negalpha + alpha <= 256)
+    {
+        __m128i zero, weights, negalphas, alphas, alpha_mask, pixels, low, high, result;
+
+        zero = _mm_setzero_si128 ();
+        weights = _mm_set_epi16 (0, 28, 150, 77, 0, 28, 150, 77);
+        negalphas = _mm_set1_epi16 (negalpha);
+        alphas = _mm_set1_epi16 (alpha);
+        alpha_mask = _mm_set1_epi32 ((int) 0xff000000);
+
+        for (; i + 16 <= n_bytes; i += 16)
+        {
+            pixels = _mm_loadu_si128 ((const __m128i *) (src + i));
+            low = darken_two_pixels (_mm_unpacklo_epi8 (pixels, zero),
+                                     weights, negalphas, alphas);
+            high = darken_two_pixels (_mm_unpackhi_epi8 (pixels, zero),
+                                      weights, negalphas, alphas);
+            result = _mm_packus_epi16 (low, high);
+            result = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, result),
+                                   _mm_and_si128 (alpha_mask, pixels));
+            _mm_storeu_si128 ((__m128i *) (dest + i), result);
+        }
+    }
+#endif
+    darken_row_scalar (src, dest, i, n_bytes, has_alpha, negalpha, alpha);
+}
+
+static void
+colorize_row_scalar (const guchar *src, guchar *dest, int start, int n_bytes,
+                     gboolean has_alpha, int red_value, int green_value, int blue_value)
+{
+    int n_channels, i;
+
+    n_channels = has_alpha ? 4 : 3;
+    for (i = start; i + n_channels <= n_bytes; i += n_channels)
+    {
+        dest[i] = (src[i] * red_value) >> 8;
+        dest[i + 1] = (src[i + 1] * green_value) >> 8;
+        dest[i + 2] = (src[i + 2] * blue_value) >> 8;
+        if (has_alpha)
+        {
+            dest[i + 3] = src[i + 3];
+        }
+    }
+}
+
+#define COLOR_VALUE_IN_RANGE(value) ((value) >= 0 && (value) <= 255)
+
+static void
+colorize_row (const guchar *src, guchar *dest, int n_bytes,
+              gboolean has_alpha, int red_value, int green_value, int blue_value)
+{
+    int i;
+
+    i = 0;
+#ifdef __SSE2__
+    if (has_alpha &&
+            COLOR_VALUE_IN_RANGE (red_value) &&
+            COLOR_VALUE_IN_RANGE (green_value) &&
+            COLOR_VALUE_IN_RANGE (blue_value))
+    {
+        __m128i zero, factors, alpha_mask, pixels, low, high, result;
+
+        zero = _mm_setzero_si128 ();
+        factors = _mm_set_epi16 (0, blue_value, green_value, red_value,
+                                 0, blue_value, green_value, red_value);
+        alpha_mask = _mm_set1_epi32 ((int) 0xff000000);
+
+        for (; i + 16 <= n_bytes; i += 16)
+        {
+            pixels = _mm_loadu_si128 ((const __m128i *) (src + i));
+            low = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (pixels, zero), factors), 8);
+            high = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (pixels, zero), factors), 8);
+            result = _mm_packus_epi16 (low, high);
+            result = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, result),
+                                   _mm_and_si128 (alpha_mask, pixels));
+            _mm_storeu_si128 ((__m128i *) (dest + i), result);
+        }
+    }
+#endif
+    colorize_row_scalar (src, dest, i, n_bytes, has_alpha, red_value, green_value, blue_value);
+}
+
+/* shared checks on the pixbufs the effects can work on */
+
+#define SOURCE_PIXBUF_IS_VALID(src) \
+    (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB \
+     && ((!gdk_pixbuf_get_has_alpha (src) \
+          && gdk_pixbuf_get_n_channels (src) == 3) \
+         || (gdk_pixbuf_get_has_alpha (src) \
+             && gdk_pixbuf_get_n_channels (src) == 4)) \
+     && gdk_pixbuf_get_bits_per_sample (src) == 8)
+
+/* return a pixbuf with each color component raised by lighten_value and
+   an eighth of itself, pinned at 255 */
+
 GdkPixbuf *
-eel_create_spotlight_pixbuf (GdkPixbuf* src)
+eel_create_lightened_pixbuf (GdkPixbuf *src, guint lighten_value)
 {
     GdkPixbuf *dest;
-    int i, j;
-    int width, height, has_alpha, src_row_stride, dst_row_stride;
+    int i;
+    int width, height, has_alpha, src_row_stride, dst_row_stride, n_bytes;
     guchar *target_pixels, *original_pixels;
-    guchar *pixsrc, *pixdest;
 
-    g_return_val_if_fail (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB, NULL);
-    g_return_val_if_fail ((!gdk_pixbuf_get_has_alpha (src)
-                           && gdk_pixbuf_get_n_channels (src) == 3)
-                          || (gdk_pixbuf_get_has_alpha (src)
-                              && gdk_pixbuf_get_n_channels (src) == 4), NULL);
-    g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8, NULL);
+    g_return_val_if_fail (SOURCE_PIXBUF_IS_VALID (src), NULL);
 
     dest = create_new_pixbuf (src);
 
@@ -86,25 +296,23 @@ eel_create_spotlight_pixbuf (GdkPixbuf* src)
     src_row_stride = gdk_pixbuf_get_rowstride (src);
     target_pixels = gdk_pixbuf_get_pixels (dest);
     original_pixels = gdk_pixbuf_get_pixels (src);
+    n_bytes = width * gdk_pixbuf_get_n_channels (src);
 
     for (i = 0; i < height; i++)
     {
-        pixdest = target_pixels + i * dst_row_stride;
-        pixsrc = original_pixels + i * src_row_stride;
-        for (j = 0; j < width; j++)
-        {
-            *pixdest++ = lighten_component (*pixsrc++);
-            *pixdest++ = lighten_component (*pixsrc++);
-            *pixdest++ = lighten_component (*pixsrc++);
-            if (has_alpha)
-            {
-                *pixdest++ = *pixsrc++;
-            }
-        }
+        lighten_row (original_pixels + i * src_row_stride,
+                     target_pixels + i * dst_row_stride,
+                     n_bytes, has_alpha, lighten_value);
     }
     return dest;
 }
 
+GdkPixbuf *
+eel_create_spotlight_pixbuf (GdkPixbuf* src)
+{
+    return eel_create_lightened_pixbuf (src, 24);
+}
+
 
 /* the following routine was stolen from the panel to darken a pixbuf, by manipulating the saturation */
 
@@ -113,23 +321,15 @@ eel_create_spotlight_pixbuf (GdkPixbuf* src)
 GdkPixbuf *
 eel_create_darkened_pixbuf (GdkPixbuf *src, int saturation, int darken)
 {
-    gint i, j;
-    gint width, height, src_row_stride, dest_row_stride;
+    gint i;
+    gint width, height, src_row_stride, dest_row_stride, n_bytes;
     gboolean has_alpha;
     guchar *target_pixels, *original_pixels;
-    guchar *pixsrc, *pixdest;
-    guchar intensity;
     guchar alpha;
     guchar negalpha;
-    guchar r, g, b;
     GdkPixbuf *dest;
 
-    g_return_val_if_fail (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB, NULL);
-    g_return_val_if_fail ((!gdk_pixbuf_get_has_alpha (src)
-                           && gdk_pixbuf_get_n_channels (src) == 3)
-                          || (gdk_pixbuf_get_has_alpha (src)
-                              && gdk_pixbuf_get_n_channels (src) == 4), NULL);
-    g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8, NULL);
+    g_return_val_if_fail (SOURCE_PIXBUF_IS_VALID (src), NULL);
 
     dest = create_new_pixbuf (src);
 
@@ -140,27 +340,16 @@ eel_create_darkened_pixbuf (GdkPixbuf *src, int saturation, int darken)
     src_row_stride = gdk_pixbuf_get_rowstride (src);
     target_pixels = gdk_pixbuf_get_pixels (dest);
     original_pixels = gdk_pixbuf_get_pixels (src);
+    n_bytes = width * gdk_pixbuf_get_n_channels (src);
+
+    negalpha = ((255 - saturation) * darken) >> 8;
+    alpha = (saturation * darken) >> 8;
 
     for (i = 0; i < height; i++)
     {
-        pixdest = target_pixels + i * dest_row_stride;
-        pixsrc = original_pixels + i * src_row_stride;
-        for (j = 0; j < width; j++)
-        {
-            r = *pixsrc++;
-            g = *pixsrc++;
-            b = *pixsrc++;
-            intensity = (r * 77 + g * 150 + b * 28) >> 8;
-            negalpha = ((255 - saturation) * darken) >> 8;
-            alpha = (saturation * darken) >> 8;
-            *pixdest++ = (negalpha * intensity + alpha * r) >> 8;
-            *pixdest++ = (negalpha * intensity + alpha * g) >> 8;
-            *pixdest++ = (negalpha * intensity + alpha * b) >> 8;
-            if (has_alpha)
-            {
-                *pixdest++ = *pixsrc++;
-            }
-        }
+        darken_row (original_pixels + i * src_row_stride,
+                    target_pixels + i * dest_row_stride,
+                    n_bytes, has_alpha, negalpha, alpha);
     }
     return dest;
 }
@@ -173,20 +362,13 @@ eel_create_colorized_pixbuf (GdkPixbuf *src,
                              int green_value,
                              int blue_value)
 {
-    int i, j;
-    int width, height, has_alpha, src_row_stride, dst_row_stride;
+    int i;
+    int width, height, has_alpha, src_row_stride, dst_row_stride, n_bytes;
     guchar *target_pixels;
     guchar *original_pixels;
-    guchar *pixsrc;
-    guchar *pixdest;
     GdkPixbuf *dest;
 
-    g_return_val_if_fail (gdk_pixbuf_get_colorspace (src) == GDK_COLORSPACE_RGB, NULL);
-    g_return_val_if_fail ((!gdk_pixbuf_get_has_alpha (src)
-                           && gdk_pixbuf_get_n_channels (src) == 3)
-                          || (gdk_pixbuf_get_has_alpha (src)
-                              && gdk_pixbuf_get_n_channels (src) == 4), NULL);
-    g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8, NULL);
+    g_return_val_if_fail (SOURCE_PIXBUF_IS_VALID (src), NULL);
 
     dest = create_new_pixbuf (src);
 
@@ -197,25 +379,175 @@ eel_create_colorized_pixbuf (GdkPixbuf *src,
     dst_row_stride = gdk_pixbuf_get_rowstride (dest);
     target_pixels = gdk_pixbuf_get_pixels (dest);
     original_pixels = gdk_pixbuf_get_pixels (src);
+    n_bytes = width * gdk_pixbuf_get_n_channels (src);
 
     for (i = 0; i < height; i++)
     {
-        pixdest = target_pixels + i*dst_row_stride;
-        pixsrc = original_pixels + i*src_row_stride;
-        for (j = 0; j < width; j++)
-        {
-            *pixdest++ = (*pixsrc++ * red_value) >> 8;
-            *pixdest++ = (*pixsrc++ * green_value) >> 8;
-            *pixdest++ = (*pixsrc++ * blue_value) >> 8;
-            if (has_alpha)
-            {
-                *pixdest++ = *pixsrc++;
-            }
-        }
+        colorize_row (original_pixels + i * src_row_stride,
+                      target_pixels + i * dst_row_stride,
+                      n_bytes, has_alpha, red_value, green_value, blue_value);
     }
     return dest;
 }
 
+/* The same icons get prelit and selected over and over, so the results
+   of the effects are kept for as long as their source pixbuf lives,
+   up to a limit, least recently used going first. */
+
+#define EFFECT_CACHE_MAX_ENTRIES 512
+
+typedef struct
+{
+    /* Not referenced; the entry goes away when it is finalized. */
+    GdkPixbuf *source;
+    EelGraphicEffectFunc effect;
+    guint params[EEL_GRAPHIC_EFFECT_N_PARAMS];
+    GdkPixbuf *result;
+    /* Link in effect_cache_lru, most recently used first. */
+    GList *link;
+} EffectCacheEntry;
+
+static GHashTable *effect_cache = NULL;
+static GQueue effect_cache_lru = G_QUEUE_INIT;
+
+static guint
+effect_cache_entry_hash (gconstpointer key)
+{
+    const EffectCacheEntry *entry;
+    guint hash;
+    int i;
+
+    entry = key;
+    hash = g_direct_hash (entry->source);
+    for (i = 0; i < EEL_GRAPHIC_EFFECT_N_PARAMS; i++)
+    {
+        hash = hash * 31 + entry->params[i];
+    }
+    return hash;
+}
+
+static gboolean
+effect_cache_entry_equal (gconstpointer a, gconstpointer b)
+{
+    const EffectCacheEntry *entry_a, *entry_b;
+
+    entry_a = a;
+    entry_b = b;
+    return entry_a->source == entry_b->source
+           && entry_a->effect == entry_b->effect
+           && memcmp (entry_a->params, entry_b->params, sizeof (entry_a->params)) == 0;
+}
+
+static void
+effect_cache_entry_free (EffectCacheEntry *entry)
+{
+    g_hash_table_remove (effect_cache, entry);
+    g_queue_delete_link (&effect_cache_lru, entry->link);
+    g_object_unref (entry->result);
+    g_free (entry);
+}
+
+static void
+effect_cache_source_finalized (gpointer data, GObject *where_the_object_was)
+{
+    effect_cache_entry_free (data);
+}
+
+static void
+effect_cache_entry_remove (EffectCacheEntry *entry)
+{
+    g_object_weak_unref (G_OBJECT (entry->source),
+                         effect_cache_source_finalized, entry);
+    effect_cache_entry_free (entry);
+}
+
+static void
+effect_cache_destroy (void)
+{
+    while (!g_queue_is_empty (&effect_cache_lru))
+    {
+        effect_cache_entry_remove (g_queue_peek_head (&effect_cache_lru));
+    }
+    g_hash_table_destroy (effect_cache);
+    effect_cache = NULL;
+}
+
+GdkPixbuf *
+eel_graphic_effect_get_shared (GdkPixbuf *source_pixbuf,
+                               EelGraphicEffectFunc effect,
+                               const guint *params)
+{
+    EffectCacheEntry key, *entry;
+    GdkPixbuf *result;
+
+    g_return_val_if_fail (GDK_IS_PIXBUF (source_pixbuf), NULL);
+    g_return_val_if_fail (effect != NULL, NULL);
+
+    if (effect_cache == NULL)
+    {
+        effect_cache = g_hash_table_new (effect_cache_entry_hash,
+                                         effect_cache_entry_equal);
+        eel_debug_call_at_shutdown (effect_cache_destroy);
+    }
+
+    key.source = source_pixbuf;
+    key.effect = effect;
+    memcpy (key.params, params, sizeof (key.params));
+    entry = g_hash_table_lookup (effect_cache, &key);
+    if (entry != NULL)
+    {
+        g_queue_unlink (&effect_cache_lru, entry->link);
+        g_queue_push_head_link (&effect_cache_lru, entry->link);
+        return g_object_ref (entry->result);
+    }
+
+    result = (* effect) (source_pixbuf, params);
+    if (result == NULL)
+    {
+        return NULL;
+    }
+
+    if (g_hash_table_size (effect_cache) >= EFFECT_CACHE_MAX_ENTRIES)
+    {
+        effect_cache_entry_remove (g_queue_peek_tail (&effect_cache_lru));
+    }
+
+    entry = g_new (EffectCacheEntry, 1);
+    *entry = key;
+    entry->result = g_object_ref (result);
+    g_queue_push_head (&effect_cache_lru, entry);
+    entry->link = g_queue_peek_head_link (&effect_cache_lru);
+    g_hash_table_insert (effect_cache, entry, entry);
+    g_object_weak_ref (G_OBJECT (source_pixbuf),
+                       effect_cache_source_finalized, entry);
+
+    return result;
+}
+
+static GdkPixbuf *
+colorize_effect (GdkPixbuf *source_pixbuf, const guint *params)
+{
+    return eel_create_colorized_pixbuf (source_pixbuf,
+                                        (int) params[0],
+                                        (int) params[1],
+                                        (int) params[2]);
+}
+
+GdkPixbuf *
+eel_get_shared_colorized_pixbuf (GdkPixbuf *source_pixbuf,
+                                 int red_value,
+                                 int green_value,
+                                 int blue_value)
+{
+    guint params[EEL_GRAPHIC_EFFECT_N_PARAMS] = { 0 };
+
+    params[0] = red_value;
+    params[1] = green_value;
+    params[2] = blue_value;
+
+    return eel_graphic_effect_get_shared (source_pixbuf, colorize_effect, params);
+}
+
 /* utility to stretch a frame to the desired size */
 
 static void
@@ -335,3 +667,208 @@ eel_embed_image_in_frame (GdkPixbuf *source_image, GdkPixbuf *frame_image, int l
     return result_pixbuf;
 }
 
+
+#if !defined (EEL_OMIT_SELF_CHECK)
+
+typedef enum
+{
+    SELF_CHECK_LIGHTEN,
+    SELF_CHECK_DARKEN,
+    SELF_CHECK_COLORIZE
+} SelfCheckEffect;
+
+/* A pixbuf whose bytes go through all the values, in an order that
+   doesn't line up with the pixels. */
+static GdkPixbuf *
+self_check_create_pixbuf (gboolean has_alpha, int width, int height)
+{
+    GdkPixbuf *pixbuf;
+    guchar *pixels;
+    int x, y, n_bytes, rowstride;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8, width, height);
+    pixels = gdk_pixbuf_get_pixels (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    n_bytes = width * gdk_pixbuf_get_n_channels (pixbuf);
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < n_bytes; x++)
+        {
+            pixels[y * rowstride + x] = (guchar) ((y * n_bytes + x) * 167 + y);
+        }
+    }
+
+    return pixbuf;
+}
+
+static GdkPixbuf *
+self_check_apply (SelfCheckEffect effect, GdkPixbuf *pixbuf, int a, int b, int c)
+{
+    switch (effect)
+    {
+    case SELF_CHECK_LIGHTEN:
+        return eel_create_lightened_pixbuf (pixbuf, a);
+    case SELF_CHECK_DARKEN:
+        return eel_create_darkened_pixbuf (pixbuf, a, b);
+    case SELF_CHECK_COLORIZE:
+        return eel_create_colorized_pixbuf (pixbuf, a, b, c);
+    }
+
+    g_assert_not_reached ();
+    return NULL;
+}
+
+/* Checks that the effect gives exactly what the scalar code does on
+   every row, whatever part of it the vector code did. */
+static gboolean
+self_check_matches_scalar (SelfCheckEffect effect, gboolean has_alpha,
+                           int width, int a, int b, int c)
+{
+    GdkPixbuf *source, *result;
+    guchar *source_row, *result_row, *expected;
+    int y, height, n_bytes;
+    gboolean matches;
+
+    height = 3;
+    source = self_check_create_pixbuf (has_alpha, width, height);
+    result = self_check_apply (effect, source, a, b, c);
+    n_bytes = width * gdk_pixbuf_get_n_channels (source);
+    expected = g_malloc (n_bytes);
+
+    matches = TRUE;
+    for (y = 0; y < height && matches; y++)
+    {
+        source_row = gdk_pixbuf_get_pixels (source) + y * gdk_pixbuf_get_rowstride (source);
+        result_row = gdk_pixbuf_get_pixels (result) + y * gdk_pixbuf_get_rowstride (result);
+        switch (effect)
+        {
+        case SELF_CHECK_LIGHTEN:
+            lighten_row_scalar (source_row, expected, 0, n_bytes, has_alpha, a);
+            break;
+        case SELF_CHECK_DARKEN:
+            darken_row_scalar (source_row, expected, 0, n_bytes, has_alpha,
+                               ((255 - a) * b) >> 8, (a * b) >> 8);
+            break;
+        case SELF_CHECK_COLORIZE:
+            colorize_row_scalar (source_row, expected, 0, n_bytes, has_alpha, a, b, c);
+            break;
+        }
+        matches = memcmp (result_row, expected, n_bytes) == 0;
+    }
+
+    g_free (expected);
+    g_object_unref (result);
+    g_object_unref (source);
+
+    return matches;
+}
+
+static gboolean
+self_check_all_match_scalar (SelfCheckEffect effect, int a, int b, int c)
+{
+    int width;
+
+    for (width = 1; width <= 37; width += 3)
+    {
+        if (!self_check_matches_scalar (effect, FALSE, width, a, b, c)
+                || !self_check_matches_scalar (effect, TRUE, width, a, b, c))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* The first pixel of a pixbuf wide enough for the vector code, filled
+   with one color, after the effect. */
+static char *
+self_check_effect_on_color (SelfCheckEffect effect, guint32 rgba, int a, int b, int c)
+{
+    GdkPixbuf *source, *result;
+    guchar *pixels;
+    char *string;
+    int x;
+
+    source = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 8, 1);
+    pixels = gdk_pixbuf_get_pixels (source);
+    for (x = 0; x < 8; x++)
+    {
+        pixels[4 * x] = rgba >> 24;
+        pixels[4 * x + 1] = rgba >> 16;
+        pixels[4 * x + 2] = rgba >> 8;
+        pixels[4 * x + 3] = rgba;
+    }
+
+    result = self_check_apply (effect, source, a, b, c);
+    pixels = gdk_pixbuf_get_pixels (result);
+    string = g_strdup_printf ("%02X,%02X,%02X,%02X",
+                              pixels[0], pixels[1], pixels[2], pixels[3]);
+
+    g_object_unref (result);
+    g_object_unref (source);
+
+    return string;
+}
+
+static GdkPixbuf *
+self_check_effect (GdkPixbuf *source_pixbuf, const guint *params)
+{
+    return eel_create_lightened_pixbuf (source_pixbuf, params[0]);
+}
+
+static int
+self_check_get_cache_size (void)
+{
+    return effect_cache == NULL ? 0 : g_hash_table_size (effect_cache);
+}
+
+void
+eel_self_check_graphic_effects (void)
+{
+    GdkPixbuf *source, *first, *second;
+    guint params[EEL_GRAPHIC_EFFECT_N_PARAMS] = { 0 };
+    int cache_size;
+
+    EEL_CHECK_STRING_RESULT (self_check_effect_on_color (SELF_CHECK_LIGHTEN, 0x0064C8FF, 24, 0, 0), "18,88,F9,FF");
+    EEL_CHECK_STRING_RESULT (self_check_effect_on_color (SELF_CHECK_LIGHTEN, 0x0064C880, 0, 0, 0), "00,64,C8,80");
+    EEL_CHECK_STRING_RESULT (self_check_effect_on_color (SELF_CHECK_DARKEN, 0xFF000040, 0, 255, 0), "4B,4B,4B,40");
+    EEL_CHECK_STRING_RESULT (self_check_effect_on_color (SELF_CHECK_DARKEN, 0x80808080, 255, 255, 0), "7F,7F,7F,80");
+    EEL_CHECK_STRING_RESULT (self_check_effect_on_color (SELF_CHECK_COLORIZE, 0xFF8040C0, 128, 255, 0), "7F,7F,00,C0");
+
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_LIGHTEN, 24, 0, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_LIGHTEN, 1, 0, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_LIGHTEN, 300, 0, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_DARKEN, 0, 255, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_DARKEN, 255, 255, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_DARKEN, 190, 200, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_DARKEN, 300, 300, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_COLORIZE, 255, 128, 0), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_COLORIZE, 17, 200, 99), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_all_match_scalar (SELF_CHECK_COLORIZE, 256, 512, 0), TRUE);
+
+    /* Results are shared per source and parameters... */
+    source = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 4, 4);
+    gdk_pixbuf_fill (source, 0x102030FF);
+    cache_size = self_check_get_cache_size ();
+
+    params[0] = 10;
+    first = eel_graphic_effect_get_shared (source, self_check_effect, params);
+    second = eel_graphic_effect_get_shared (source, self_check_effect, params);
+    EEL_CHECK_BOOLEAN_RESULT (first == second, TRUE);
+    g_object_unref (second);
+
+    params[0] = 20;
+    second = eel_graphic_effect_get_shared (source, self_check_effect, params);
+    EEL_CHECK_BOOLEAN_RESULT (first == second, FALSE);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_cache_size (), cache_size + 2);
+    g_object_unref (second);
+
+    /* ...and go away with the source, while staying valid for whoever
+       still has them. */
+    g_object_unref (source);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_cache_size (), cache_size);
+    EEL_CHECK_INTEGER_RESULT (gdk_pixbuf_get_width (first), 4);
+    g_object_unref (first);
+}
+
+#endif /* !EEL_OMIT_SELF_CHECK */
@@ -30,6 +30,10 @@
 /* return a lightened pixbuf for pre-lighting */
 GdkPixbuf *eel_create_spotlight_pixbuf (GdkPixbuf *source_pixbuf);
 
+/* return a pixbuf lightened by the given amount, 0 giving a copy */
+GdkPixbuf *eel_create_lightened_pixbuf (GdkPixbuf *source_pixbuf,
+                                        guint      lighten_value);
+
 /* return a darkened pixbuf for selection hiliting */
 GdkPixbuf *eel_create_darkened_pixbuf  (GdkPixbuf *source_pixbuf,
                                         int        saturation,
@@ -41,6 +45,28 @@ GdkPixbuf* eel_create_colorized_pixbuf (GdkPixbuf *source_pixbuf,
                                         int        green_value,
                                         int        blue_value);
 
+/* Effects whose results can be shared take the source pixbuf and up
+ * to EEL_GRAPHIC_EFFECT_N_PARAMS parameters, and return a new pixbuf.
+ */
+#define EEL_GRAPHIC_EFFECT_N_PARAMS 5
+
+typedef GdkPixbuf *(* EelGraphicEffectFunc) (GdkPixbuf   *source_pixbuf,
+        const guint *params);
+
+/* return the result of the effect on the pixbuf, made once and kept for
+ * as long as the source pixbuf lives, so it must not be modified.
+ * Main thread only.
+ */
+GdkPixbuf *eel_graphic_effect_get_shared   (GdkPixbuf           *source_pixbuf,
+        EelGraphicEffectFunc effect,
+        const guint         *params);
+
+/* shared version of eel_create_colorized_pixbuf, see above */
+GdkPixbuf *eel_get_shared_colorized_pixbuf (GdkPixbuf *source_pixbuf,
+        int        red_value,
+        int        green_value,
+        int        blue_value);
+
 /* stretch a image frame */
 GdkPixbuf *eel_stretch_frame_image     (GdkPixbuf *frame_image,
                                         int        left_offset,
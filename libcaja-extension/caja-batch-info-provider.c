@@ -0,0 +1,87 @@
+/*
+ *  caja-batch-info-provider.c - Interface for Caja extensions that
+ *                               provide info about many files at once.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <config.h>
+#include "caja-batch-info-provider.h"
+
+#include <glib-object.h>
+
+static void
+caja_batch_info_provider_base_init (gpointer g_class)
+{
+}
+
+GType
+caja_batch_info_provider_get_type (void)
+{
+    static GType type = 0;
+
+    if (!type)
+    {
+        const GTypeInfo info =
+        {
+            sizeof (CajaBatchInfoProviderIface),
+            caja_batch_info_provider_base_init,
+            NULL,
+            NULL,
+            NULL,
+            NULL,
+            0,
+            0,
+            NULL
+        };
+
+        type = g_type_register_static (G_TYPE_INTERFACE,
+                                       "CajaBatchInfoProvider",
+                                       &info, 0);
+        g_type_interface_add_prerequisite (type, CAJA_TYPE_INFO_PROVIDER);
+    }
+
+    return type;
+}
+
+/**
+ * caja_batch_info_provider_update_file_info_batch:
+ * @provider: a #CajaBatchInfoProvider
+ * @files: (element-type CajaFileInfo): the files to update, all in the same folder
+ * @update_complete: the closure to invoke once, when all of @files are done
+ * @handle: (out): where to store the handle of a batch still in progress
+ *
+ * Returns: %CAJA_OPERATION_IN_PROGRESS if @update_complete will be invoked
+ * later, or %CAJA_OPERATION_COMPLETE or %CAJA_OPERATION_FAILED if the batch
+ * is already done.
+ */
+CajaOperationResult
+caja_batch_info_provider_update_file_info_batch (CajaBatchInfoProvider *provider,
+        GList *files,
+        GClosure *update_complete,
+        CajaOperationHandle **handle)
+{
+    g_return_val_if_fail (CAJA_IS_BATCH_INFO_PROVIDER (provider),
+                          CAJA_OPERATION_FAILED);
+    g_return_val_if_fail (CAJA_BATCH_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch != NULL,
+                          CAJA_OPERATION_FAILED);
+    g_return_val_if_fail (update_complete != NULL,
+                          CAJA_OPERATION_FAILED);
+    g_return_val_if_fail (handle != NULL, CAJA_OPERATION_FAILED);
+
+    return CAJA_BATCH_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch
+           (provider, files, update_complete, handle);
+}
@@ -0,0 +1,72 @@
+/*
+ *  caja-batch-info-provider.h - Interface for Caja extensions that
+ *                               provide info about many files at once.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* This interface can be implemented by info providers that can answer
+ * for several files in one go, such as a version control extension
+ * that runs one status command for a whole folder.  Caja then passes
+ * them a list of CajaFileInfo objects from the same folder instead of
+ * calling update_file_info for each.  The list is only good for the
+ * length of the call, so ref the files to keep them.  The
+ * update_complete closure is invoked once for the whole batch, and a
+ * batch in progress is cancelled with caja_info_provider_cancel_update.
+ * Implementations must implement CajaInfoProvider as well. */
+
+#ifndef CAJA_BATCH_INFO_PROVIDER_H
+#define CAJA_BATCH_INFO_PROVIDER_H
+
+#include <glib-object.h>
+#include "caja-extension-types.h"
+#include "caja-file-info.h"
+#include "caja-info-provider.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAJA_TYPE_BATCH_INFO_PROVIDER           (caja_batch_info_provider_get_type ())
+#define CAJA_BATCH_INFO_PROVIDER(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), CAJA_TYPE_BATCH_INFO_PROVIDER, CajaBatchInfoProvider))
+#define CAJA_IS_BATCH_INFO_PROVIDER(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CAJA_TYPE_BATCH_INFO_PROVIDER))
+#define CAJA_BATCH_INFO_PROVIDER_GET_IFACE(obj) (G_TYPE_INSTANCE_GET_INTERFACE ((obj), CAJA_TYPE_BATCH_INFO_PROVIDER, CajaBatchInfoProviderIface))
+
+    typedef struct _CajaBatchInfoProvider       CajaBatchInfoProvider;
+    typedef struct _CajaBatchInfoProviderIface  CajaBatchInfoProviderIface;
+
+    struct _CajaBatchInfoProviderIface
+    {
+        GTypeInterface g_iface;
+
+        CajaOperationResult (*update_file_info_batch) (CajaBatchInfoProvider *provider,
+                GList                 *files,
+                GClosure              *update_complete,
+                CajaOperationHandle  **handle);
+    };
+
+    /* Interface Functions */
+    GType                   caja_batch_info_provider_get_type               (void);
+    CajaOperationResult caja_batch_info_provider_update_file_info_batch (CajaBatchInfoProvider *provider,
+            GList                 *files,
+            GClosure              *update_complete,
+            CajaOperationHandle  **handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -60,6 +60,12 @@ extern "C" {
 
     GType caja_operation_result_get_type (void);
 
+    /* Every extension exports these. Caja remembers which interfaces
+     * the types from caja_module_list_types implement and, after the
+     * first time, only loads an extension once one of them is needed.
+     * The list of types must therefore only change along with the
+     * module file itself. An extension whose types implement no
+     * interface is loaded at startup every time, as before. */
     void caja_module_initialize (GTypeModule  *module);
     void caja_module_shutdown   (void);
     void caja_module_list_types (const GType **types,
@@ -0,0 +1,417 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-collation.c: Filename collation keys with an ASCII fast path.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-collation.h"
+
+#include "caja-lib-self-check-functions.h"
+
+#include <locale.h>
+#include <string.h>
+
+/* Must match the sentinel used by g_utf8_collate_key_for_filename(). */
+#define COLLATION_SENTINEL "\1\1\1"
+
+/* Segments shorter than this are copied to the stack before strxfrm(). */
+#define SEGMENT_BUFFER_SIZE 256
+
+static gboolean charset_is_utf8;
+static gboolean collation_is_identity;
+
+static void
+collation_init (void)
+{
+    static gsize initialized = 0;
+    const char *locale;
+
+    if (g_once_init_enter (&initialized))
+    {
+        charset_is_utf8 = g_get_charset (NULL);
+
+        /* In the C locale strxfrm() is a plain copy, so skip it. */
+        locale = setlocale (LC_COLLATE, NULL);
+        collation_is_identity = locale == NULL
+                                || strcmp (locale, "C") == 0
+                                || strcmp (locale, "POSIX") == 0;
+
+        g_once_init_leave (&initialized, 1);
+    }
+}
+
+static gboolean
+string_is_ascii (const char *str)
+{
+    const guchar *p;
+
+    for (p = (const guchar *) str; *p != '\0'; p++)
+    {
+        if (*p >= 0x80)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Equivalent of g_utf8_collate_key() for an ASCII segment. ASCII is
+ * already in normal form and converts to the locale charset unchanged,
+ * so only the strxfrm() step and the charset marker remain.
+ */
+static void
+append_segment_key (GString *result,
+                    const char *segment,
+                    gsize length)
+{
+    char buffer[SEGMENT_BUFFER_SIZE];
+    char *copy;
+    gsize old_length;
+    gsize xfrm_length;
+
+    if (!charset_is_utf8)
+    {
+        g_string_append_c (result, 'A');
+    }
+
+    if (collation_is_identity)
+    {
+        g_string_append_len (result, segment, length);
+        return;
+    }
+
+    if (length < sizeof (buffer))
+    {
+        memcpy (buffer, segment, length);
+        buffer[length] = '\0';
+        copy = buffer;
+    }
+    else
+    {
+        copy = g_strndup (segment, length);
+    }
+
+    xfrm_length = strxfrm (NULL, copy, 0);
+    old_length = result->len;
+    g_string_set_size (result, old_length + xfrm_length);
+    strxfrm (result->str + old_length, copy, xfrm_length + 1);
+
+    if (copy != buffer)
+    {
+        g_free (copy);
+    }
+}
+
+/* Mirrors the splitting done by g_utf8_collate_key_for_filename(): dots
+ * and digit runs are special-cased, everything in between is collated
+ * by the locale. The quirks of the original, such as the handling of an
+ * all-zero number at the end of the name, are kept on purpose.
+ */
+static GString *
+ascii_collation_key_for_filename (const char *name)
+{
+    GString *result;
+    GString *append;
+    const char *p, *prev, *end;
+    int digits, leading_zeros;
+    gsize length;
+
+    length = strlen (name);
+    result = g_string_sized_new (length * 2);
+    append = NULL;
+    end = name + length;
+
+    for (prev = p = name; p < end; p++)
+    {
+        if (*p == '.')
+        {
+            if (prev != p)
+            {
+                append_segment_key (result, prev, p - prev);
+            }
+            g_string_append (result, COLLATION_SENTINEL "\1");
+            prev = p + 1;
+        }
+        else if (g_ascii_isdigit (*p))
+        {
+            if (prev != p)
+            {
+                append_segment_key (result, prev, p - prev);
+            }
+            g_string_append (result, COLLATION_SENTINEL "\2");
+            prev = p;
+
+            if (*p == '0')
+            {
+                leading_zeros = 1;
+                digits = 0;
+            }
+            else
+            {
+                leading_zeros = 0;
+                digits = 1;
+            }
+
+            while (++p < end)
+            {
+                if (*p == '0' && !digits)
+                {
+                    ++leading_zeros;
+                }
+                else if (g_ascii_isdigit (*p))
+                {
+                    ++digits;
+                }
+                else
+                {
+                    if (!digits)
+                    {
+                        ++digits;
+                        --leading_zeros;
+                    }
+                    break;
+                }
+            }
+
+            while (digits > 1)
+            {
+                g_string_append_c (result, ':');
+                --digits;
+            }
+
+            if (leading_zeros > 0)
+            {
+                if (append == NULL)
+                {
+                    append = g_string_sized_new (4);
+                }
+                g_string_append_c (append, (char) leading_zeros);
+                prev += leading_zeros;
+            }
+
+            g_string_append_len (result, prev, p - prev);
+            prev = p;
+            --p;
+        }
+    }
+
+    if (prev != p)
+    {
+        append_segment_key (result, prev, p - prev);
+    }
+
+    if (append != NULL)
+    {
+        g_string_append (result, append->str);
+        g_string_free (append, TRUE);
+    }
+
+    return result;
+}
+
+char *
+caja_collation_key_for_filename (const char *name)
+{
+    g_return_val_if_fail (name != NULL, NULL);
+
+    if (!string_is_ascii (name))
+    {
+        return g_utf8_collate_key_for_filename (name, -1);
+    }
+
+    collation_init ();
+    return g_string_free (ascii_collation_key_for_filename (name), FALSE);
+}
+
+static guint64
+get_prefix (const char *key, gsize key_length)
+{
+    guint64 prefix;
+    gsize i;
+
+    prefix = 0;
+    for (i = 0; i < CAJA_COLLATION_PREFIX_LENGTH; i++)
+    {
+        prefix <<= 8;
+        if (i < key_length)
+        {
+            prefix |= (guchar) key[i];
+        }
+    }
+
+    return prefix;
+}
+
+void
+caja_collation_key_split (const char *name,
+                          guint64 *prefix,
+                          char **tail)
+{
+    GString *key;
+    char *slow_key;
+
+    g_return_if_fail (name != NULL);
+    g_return_if_fail (prefix != NULL);
+    g_return_if_fail (tail != NULL);
+
+    if (!string_is_ascii (name))
+    {
+        slow_key = g_utf8_collate_key_for_filename (name, -1);
+        key = g_string_new (slow_key);
+        g_free (slow_key);
+    }
+    else
+    {
+        collation_init ();
+        key = ascii_collation_key_for_filename (name);
+    }
+
+    *prefix = get_prefix (key->str, key->len);
+    if (key->len > CAJA_COLLATION_PREFIX_LENGTH)
+    {
+        *tail = g_strdup (key->str + CAJA_COLLATION_PREFIX_LENGTH);
+    }
+    else
+    {
+        *tail = NULL;
+    }
+
+    g_string_free (key, TRUE);
+}
+
+int
+caja_collation_key_compare (guint64 prefix_1,
+                            const char *tail_1,
+                            guint64 prefix_2,
+                            const char *tail_2)
+{
+    if (prefix_1 != prefix_2)
+    {
+        return prefix_1 < prefix_2 ? -1 : +1;
+    }
+
+    /* A missing tail means the key ended inside the prefix. */
+    return strcmp (tail_1 != NULL ? tail_1 : "",
+                   tail_2 != NULL ? tail_2 : "");
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static const char *self_check_names[] =
+{
+    "",
+    "a",
+    "A",
+    "abc",
+    "abcdefgh",
+    "abcdefghi",
+    "Makefile",
+    "Makefile.am",
+    "README",
+    "readme.txt",
+    "file1.txt",
+    "file2.txt",
+    "file10.txt",
+    "file01.txt",
+    "file001.txt",
+    "file00",
+    "file0",
+    "000",
+    "0",
+    "a.b.c",
+    ".hidden",
+    "..",
+    "IMG_0001.JPG",
+    "IMG_0002.JPG",
+    "IMG_0010.JPG",
+    "some file with spaces",
+    "under_score-and-dash",
+    "1.2.10",
+    "1.2.9",
+    "caf\xc3\xa9",
+    "Caf\xc3\xa9.txt",
+    "\xc3\xa9t\xc3\xa9 2012"
+};
+
+static gboolean
+key_matches_glib (const char *name)
+{
+    char *fast_key, *glib_key;
+    gboolean result;
+
+    fast_key = caja_collation_key_for_filename (name);
+    glib_key = g_utf8_collate_key_for_filename (name, -1);
+    result = strcmp (fast_key, glib_key) == 0;
+    g_free (fast_key);
+    g_free (glib_key);
+
+    return result;
+}
+
+static int
+sign (int value)
+{
+    return value < 0 ? -1 : value > 0 ? +1 : 0;
+}
+
+static gboolean
+split_order_matches_glib (const char *name_1, const char *name_2)
+{
+    char *glib_key_1, *glib_key_2;
+    char *tail_1, *tail_2;
+    guint64 prefix_1, prefix_2;
+    gboolean result;
+
+    glib_key_1 = g_utf8_collate_key_for_filename (name_1, -1);
+    glib_key_2 = g_utf8_collate_key_for_filename (name_2, -1);
+    caja_collation_key_split (name_1, &prefix_1, &tail_1);
+    caja_collation_key_split (name_2, &prefix_2, &tail_2);
+
+    result = sign (strcmp (glib_key_1, glib_key_2))
+             == sign (caja_collation_key_compare (prefix_1, tail_1, prefix_2, tail_2));
+
+    g_free (glib_key_1);
+    g_free (glib_key_2);
+    g_free (tail_1);
+    g_free (tail_2);
+
+    return result;
+}
+
+void
+caja_self_check_collation (void)
+{
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (self_check_names); i++)
+    {
+        EEL_CHECK_BOOLEAN_RESULT (key_matches_glib (self_check_names[i]), TRUE);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (self_check_names); i++)
+    {
+        for (j = 0; j < G_N_ELEMENTS (self_check_names); j++)
+        {
+            EEL_CHECK_BOOLEAN_RESULT (split_order_matches_glib (self_check_names[i],
+                                      self_check_names[j]), TRUE);
+        }
+    }
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
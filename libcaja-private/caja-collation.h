@@ -0,0 +1,51 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-collation.h: Filename collation keys with an ASCII fast path.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_COLLATION_H
+#define CAJA_COLLATION_H
+
+#include <glib.h>
+
+/* Number of leading key bytes packed into a prefix. */
+#define CAJA_COLLATION_PREFIX_LENGTH 8
+
+/* Returns a key that is byte for byte identical to the one returned by
+ * g_utf8_collate_key_for_filename(), but computed without normalization
+ * and charset conversion when the name is plain ASCII.
+ */
+char *   caja_collation_key_for_filename (const char *name);
+
+/* Computes the key for name and splits it into a prefix that can be
+ * compared as an integer and the remaining bytes, if any. *tail is set
+ * to NULL when the whole key fits in the prefix.
+ */
+void     caja_collation_key_split        (const char *name,
+        guint64    *prefix,
+        char      **tail);
+
+/* Compares two keys produced by caja_collation_key_split(). The result
+ * has the same sign as strcmp() on the full keys.
+ */
+int      caja_collation_key_compare      (guint64     prefix_1,
+        const char *tail_1,
+        guint64     prefix_2,
+        const char *tail_2);
+
+#endif /* CAJA_COLLATION_H */
@@ -0,0 +1,371 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-contents-matcher.c: Matching the contents of files against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-contents-matcher.h"
+
+#include "caja-filename-matcher.h"
+#include "caja-lib-self-check-functions.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+/* Files bigger than this are more likely logs, images of disks and
+ * the like than anything someone remembers a phrase from.
+ */
+#define MAX_SEARCHED_SIZE (64 * 1024 * 1024)
+
+/* Files with a NUL byte this near the start are taken to be binary. */
+#define SNIFF_SIZE 8192
+
+/* How much is read and searched between checks for cancellation. */
+#define CHUNK_SIZE (1024 * 1024)
+
+struct CajaContentsMatcher
+{
+    char *text;
+    gsize length;
+    /* Whether text is lower case ASCII, and so can be found ignoring
+     * case; anything else is looked for byte for byte. */
+    gboolean ignore_case;
+};
+
+CajaContentsMatcher *
+caja_contents_matcher_new (const char *text)
+{
+    CajaContentsMatcher *matcher;
+    char *normalized;
+    const char *p;
+
+    g_return_val_if_fail (text != NULL, NULL);
+
+    /* Everything would match, and there is nothing to look for. */
+    if (text[0] == '\0')
+    {
+        return NULL;
+    }
+
+    matcher = g_new0 (CajaContentsMatcher, 1);
+
+    /* Text in files is mostly composed, unlike file names on some
+     * systems, so look for it that way. */
+    normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFC);
+    if (normalized == NULL)
+    {
+        normalized = g_strdup (text);
+    }
+
+    matcher->ignore_case = TRUE;
+    for (p = normalized; *p != '\0'; p++)
+    {
+        if ((guchar) *p >= 0x80)
+        {
+            matcher->ignore_case = FALSE;
+            break;
+        }
+    }
+
+    if (matcher->ignore_case)
+    {
+        matcher->text = g_ascii_strdown (normalized, -1);
+        g_free (normalized);
+    }
+    else
+    {
+        matcher->text = normalized;
+    }
+    matcher->length = strlen (matcher->text);
+
+    return matcher;
+}
+
+void
+caja_contents_matcher_free (CajaContentsMatcher *matcher)
+{
+    if (matcher == NULL)
+    {
+        return;
+    }
+
+    g_free (matcher->text);
+    g_free (matcher);
+}
+
+static gboolean
+find_bytes (const char *haystack,
+            gsize haystack_length,
+            const char *needle,
+            gsize needle_length)
+{
+    const char *p, *end;
+
+    if (needle_length > haystack_length)
+    {
+        return FALSE;
+    }
+
+    end = haystack + haystack_length - needle_length + 1;
+    for (p = haystack; p < end; p++)
+    {
+        p = memchr (p, needle[0], end - p);
+        if (p == NULL)
+        {
+            return FALSE;
+        }
+        if (memcmp (p, needle, needle_length) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+looks_binary (const char *data, gsize size)
+{
+    return memchr (data, '\0', MIN (size, SNIFF_SIZE)) != NULL;
+}
+
+static gboolean
+chunk_matches (CajaContentsMatcher *matcher,
+               const char *data,
+               gsize length)
+{
+    if (length < matcher->length)
+    {
+        return FALSE;
+    }
+
+    if (matcher->ignore_case)
+    {
+        return caja_ascii_strcasestr_len (data, length,
+                                          matcher->text, matcher->length) != NULL;
+    }
+
+    return find_bytes (data, length, matcher->text, matcher->length);
+}
+
+/* Reads until there are size bytes or the file ends, whichever is
+ * first, giving -1 on errors.
+ */
+static gssize
+read_chunk (int fd, char *buffer, gsize size, goffset offset)
+{
+    gssize n;
+    gsize done;
+
+    for (done = 0; done < size; done += n)
+    {
+        n = pread (fd, buffer + done, size - done, offset + done);
+        if (n == -1 && errno == EINTR)
+        {
+            n = 0;
+            continue;
+        }
+        if (n == -1)
+        {
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/* Searches the file a chunk at a time, keeping the last bytes of each,
+ * one less than the text, in front of the next so a match across the
+ * edge between two isn't missed. The file is read rather than mapped
+ * as it may be cut short while we search it, which is an error to a
+ * read but a crash to a mapping.
+ */
+static gboolean
+file_contents_match (CajaContentsMatcher *matcher,
+                     int fd,
+                     GCancellable *cancellable)
+{
+    char *buffer;
+    goffset offset;
+    gsize kept, length;
+    gssize n;
+    gboolean match;
+
+    buffer = g_malloc (CHUNK_SIZE + matcher->length - 1);
+    match = FALSE;
+    kept = 0;
+
+    for (offset = 0; offset < MAX_SEARCHED_SIZE; offset += n)
+    {
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        n = read_chunk (fd, buffer + kept, CHUNK_SIZE, offset);
+        if (n <= 0 ||
+                (offset == 0 && looks_binary (buffer, n)))
+        {
+            break;
+        }
+
+        length = kept + n;
+        if (chunk_matches (matcher, buffer, length))
+        {
+            match = TRUE;
+            break;
+        }
+        if (n < CHUNK_SIZE)
+        {
+            break;
+        }
+
+        kept = MIN (length, matcher->length - 1);
+        memmove (buffer, buffer + length - kept, kept);
+    }
+
+    g_free (buffer);
+
+    return match;
+}
+
+gboolean
+caja_contents_matcher_matches (CajaContentsMatcher *matcher,
+                               const char *path,
+                               GCancellable *cancellable)
+{
+    struct stat statbuf;
+    gboolean match;
+    int fd;
+
+    g_return_val_if_fail (matcher != NULL, FALSE);
+    g_return_val_if_fail (path != NULL, FALSE);
+
+    /* Opening without blocking, in case a pipe took the place of the
+     * file since it was listed. */
+    do
+    {
+        fd = g_open (path, O_RDONLY | O_NOCTTY | O_NONBLOCK, 0);
+    }
+    while (fd == -1 && errno == EINTR);
+    if (fd == -1)
+    {
+        return FALSE;
+    }
+
+    match = fstat (fd, &statbuf) == 0 &&
+            S_ISREG (statbuf.st_mode) &&
+            statbuf.st_size > 0 &&
+            statbuf.st_size <= MAX_SEARCHED_SIZE &&
+            file_contents_match (matcher, fd, cancellable);
+
+    close (fd);
+
+    return match;
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static gboolean
+self_check_file_matches (const char *text, const char *contents, gsize length)
+{
+    CajaContentsMatcher *matcher;
+    char *path;
+    gboolean match;
+    int fd;
+
+    fd = g_file_open_tmp ("caja-contents-XXXXXX", &path, NULL);
+    if (fd == -1)
+    {
+        return FALSE;
+    }
+    if (write (fd, contents, length) != (gssize) length)
+    {
+        length = 0;
+    }
+    close (fd);
+
+    matcher = caja_contents_matcher_new (text);
+    match = length > 0 && caja_contents_matcher_matches (matcher, path, NULL);
+    caja_contents_matcher_free (matcher);
+
+    g_unlink (path);
+    g_free (path);
+
+    return match;
+}
+
+static gboolean
+self_check_contents_match (const char *text, const char *contents)
+{
+    return self_check_file_matches (text, contents, strlen (contents));
+}
+
+/* Puts the text across the edge between the first two chunks, broken
+ * up there or not.
+ */
+static gboolean
+self_check_chunk_edges (gboolean broken)
+{
+    char *data;
+    gsize size;
+    gboolean found;
+
+    size = CHUNK_SIZE * 2;
+    data = g_malloc (size);
+    memset (data, 'a', size);
+    memcpy (data + CHUNK_SIZE - 2, "NEEDLE", 6);
+    if (broken)
+    {
+        data[CHUNK_SIZE] = 'x';
+    }
+
+    found = self_check_file_matches ("needle", data, size);
+    g_free (data);
+
+    return found;
+}
+
+void
+caja_self_check_contents_matcher (void)
+{
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("report", "The annual REPORT is due"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("Annual Report", "the annual report"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("reports", "the annual report"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("café", "au café"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("café", "au cafe"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("cafe\xcc\x81", "au café"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_contents_match ("longer than it", "short"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_chunk_edges (FALSE), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_chunk_edges (TRUE), FALSE);
+
+    EEL_CHECK_BOOLEAN_RESULT (self_check_file_matches ("world", "Hello World\n", 12), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_file_matches ("world", "Hello\0World\n", 12), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_file_matches ("world", "Hello\n", 6), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (caja_contents_matcher_new ("") == NULL, TRUE);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
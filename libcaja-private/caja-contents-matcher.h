@@ -0,0 +1,40 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-contents-matcher.h: Matching the contents of files against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_CONTENTS_MATCHER_H
+#define CAJA_CONTENTS_MATCHER_H
+
+#include <gio/gio.h>
+
+typedef struct CajaContentsMatcher CajaContentsMatcher;
+
+/* A file matches when it is a local regular file that looks like text,
+ * isn't too big to search, and has the text in it. The case of ASCII
+ * letters doesn't matter when the text is all ASCII; other text has to
+ * be there as it is. A matcher never changes once made, so one can be
+ * used from several threads at once. There is none for empty text.
+ */
+CajaContentsMatcher *caja_contents_matcher_new     (const char          *text);
+void                 caja_contents_matcher_free    (CajaContentsMatcher *matcher);
+gboolean             caja_contents_matcher_matches (CajaContentsMatcher *matcher,
+        const char          *path,
+        GCancellable        *cancellable);
+
+#endif /* CAJA_CONTENTS_MATCHER_H */
@@ -51,6 +51,9 @@ static int ring_buffer_max_lines = DEFAULT_RING_BUFFER_NUM_LINES;
 static GSList *milestones_head;
 static GSList *milestones_tail;
 
+static GTimer *startup_timer;
+static gdouble startup_last_phase;
+
 static void
 lock (void)
 {
@@ -670,6 +673,55 @@ out:
     return success;
 }
 
+void
+caja_debug_log_startup_begin (void)
+{
+    if (startup_timer != NULL)
+        return;
+
+    startup_timer = g_timer_new ();
+    startup_last_phase = 0.0;
+}
+
+void
+caja_debug_log_startup_phase (const char *phase)
+{
+    gdouble elapsed;
+
+    if (startup_timer == NULL)
+        return;
+
+    elapsed = g_timer_elapsed (startup_timer, NULL);
+
+    caja_debug_log (TRUE, CAJA_DEBUG_LOG_DOMAIN_USER,
+                    "startup: %s at %.1f ms (+%.1f ms)",
+                    phase,
+                    elapsed * 1000.0,
+                    (elapsed - startup_last_phase) * 1000.0);
+
+    if (g_getenv ("CAJA_DEBUG_STARTUP") != NULL)
+    {
+        g_printerr ("caja startup: %8.1f ms (+%7.1f ms) %s\n",
+                    elapsed * 1000.0,
+                    (elapsed - startup_last_phase) * 1000.0,
+                    phase);
+    }
+
+    startup_last_phase = elapsed;
+}
+
+void
+caja_debug_log_startup_end (void)
+{
+    if (startup_timer == NULL)
+        return;
+
+    caja_debug_log_startup_phase ("startup finished");
+
+    g_timer_destroy (startup_timer);
+    startup_timer = NULL;
+}
+
 void
 caja_debug_log_set_max_lines (int num_lines)
 {
@@ -49,6 +49,15 @@ gboolean caja_debug_log_is_domain_enabled (const char *domain);
 
 gboolean caja_debug_log_dump (const char *filename, GError **error);
 
+/* Startup trace: each phase is logged as a milestone with the time since
+ * caja_debug_log_startup_begin(), and printed to stderr as well when
+ * CAJA_DEBUG_STARTUP is set.  Phases after caja_debug_log_startup_end()
+ * are ignored.  Main thread only.
+ */
+void caja_debug_log_startup_begin (void);
+void caja_debug_log_startup_phase (const char *phase);
+void caja_debug_log_startup_end (void);
+
 void caja_debug_log_set_max_lines (int num_lines);
 int caja_debug_log_get_max_lines (void);
 
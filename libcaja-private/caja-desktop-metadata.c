@@ -32,14 +32,69 @@
 #include "caja-file-private.h"
 #include "caja-file-utilities.h"
 
+#include <eel/eel-debug.h>
 #include <glib/gstdio.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The metadata is kept in memory, a table of keys for each desktop
+ * item, and on disk as a log of the changes to it: setting a key only
+ * appends a line. Once most of the log is overwritten values, it is
+ * written again with just the current ones.
+ *
+ * Each line is a tab separated record, with tabs, newlines and
+ * backslashes in the fields escaped:
+ *
+ *   S <item> <key> <string>
+ *   L <item> <key> <string>...
+ *   U <item> <key>
+ *
+ * for a string, a list of strings and an unset key.
+ */
+#define LOG_HEADER "caja-desktop-metadata 1\n"
+
+/* How many overwritten records the log can hold beyond the values
+ * before it is compacted. */
+#define COMPACTION_SLACK 256
+
+typedef struct {
+    char **values;
+    gboolean is_list;
+} MetadataValue;
+
+/* Item name to a table of key to MetadataValue. */
+static GHashTable *items = NULL;
+static guint n_values = 0;
+/* Records in the log on disk, and ones not yet appended to it. */
+static guint n_records = 0;
+static gboolean log_is_valid = FALSE;
+static GString *unsaved_records = NULL;
 
 static guint save_in_idle_source_id = 0;
 
+static void     save_now        (void);
+static gboolean save_in_idle_cb (gpointer data);
+
+static gchar *
+get_log_path (void)
+{
+    gchar *xdg_dir, *retval;
+
+    xdg_dir = caja_get_user_directory ();
+    retval = g_build_filename (xdg_dir, "desktop-metadata.log", NULL);
+
+    g_free (xdg_dir);
+
+    return retval;
+}
+
+/* Where the metadata was kept before, as a key file rewritten
+ * on each change. */
 static gchar *
 get_keyfile_path (void)
 {
@@ -49,94 +104,363 @@ get_keyfile_path (void)
     retval = g_build_filename (xdg_dir, "desktop-metadata", NULL);
 
     g_free (xdg_dir);
-    
+
     return retval;
 }
 
-static gboolean
-save_in_idle_cb (gpointer data)
+static void
+metadata_value_free (MetadataValue *value)
 {
-    GKeyFile *keyfile = data;
-    gchar *contents, *filename;
-    gsize length;
-    GError *error = NULL;
+    g_strfreev (value->values);
+    g_free (value);
+}
 
-    save_in_idle_source_id = 0;
+/* Sets or, for a NULL value, unsets a key, taking the value. */
+static void
+set_value (const char *name,
+           const char *key,
+           MetadataValue *value)
+{
+    GHashTable *keys;
 
-    contents = g_key_file_to_data (keyfile, &length, NULL);
-    filename = get_keyfile_path ();
+    keys = g_hash_table_lookup (items, name);
+    if (keys == NULL) {
+        if (value == NULL) {
+            return;
+        }
+        keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      g_free, (GDestroyNotify) metadata_value_free);
+        g_hash_table_insert (items, g_strdup (name), keys);
+    }
 
-    if (contents != NULL) {
-        g_file_set_contents (filename,
-                     contents, length,
-                     &error);
-        g_free (contents);
+    if (g_hash_table_remove (keys, key)) {
+        n_values--;
     }
+    if (value != NULL) {
+        g_hash_table_insert (keys, g_strdup (key), value);
+        n_values++;
+    } else if (g_hash_table_size (keys) == 0) {
+        g_hash_table_remove (items, name);
+    }
+}
 
-    if (error != NULL) {
-        g_warning ("Couldn't save the desktop metadata keyfile to disk: %s",
-               error->message);
-        g_error_free (error);
+static MetadataValue *
+metadata_value_new (const char * const *values,
+                    gboolean is_list)
+{
+    MetadataValue *value;
+
+    value = g_new (MetadataValue, 1);
+    value->values = g_strdupv ((gchar **) values);
+    value->is_list = is_list;
+
+    return value;
+}
+
+static void
+append_field (GString *record,
+              const char *field)
+{
+    static char exceptions[129];
+    char *escaped;
+    int i;
+
+    /* Only the ASCII control characters and backslashes need
+     * escaping; the rest of UTF-8 can stay as it is. */
+    if (exceptions[0] == '\0') {
+        for (i = 0; i < 128; i++) {
+            exceptions[i] = (char) (0x80 + i);
+        }
     }
 
-    g_free (filename);
+    escaped = g_strescape (field, exceptions);
+    g_string_append_c (record, '\t');
+    g_string_append (record, escaped);
+    g_free (escaped);
+}
 
-    return FALSE;
+static void
+append_record (GString *records,
+               const char *name,
+               const char *key,
+               MetadataValue *value)
+{
+    int i;
+
+    if (value == NULL) {
+        g_string_append_c (records, 'U');
+    } else {
+        g_string_append_c (records, value->is_list ? 'L' : 'S');
+    }
+    append_field (records, name);
+    append_field (records, key);
+    if (value != NULL) {
+        for (i = 0; value->values[i] != NULL; i++) {
+            append_field (records, value->values[i]);
+        }
+    }
+    g_string_append_c (records, '\n');
 }
 
 static void
-save_in_idle (GKeyFile *keyfile)
+load_record (char *line)
 {
-    if (save_in_idle_source_id != 0) {
-        g_source_remove (save_in_idle_source_id);
+    char **fields;
+    int i, n_fields;
+
+    fields = g_strsplit (line, "\t", -1);
+    n_fields = g_strv_length (fields);
+    for (i = 0; i < n_fields; i++) {
+        char *compressed;
+
+        compressed = g_strcompress (fields[i]);
+        g_free (fields[i]);
+        fields[i] = compressed;
     }
 
-    save_in_idle_source_id = g_idle_add (save_in_idle_cb, keyfile);
+    if (n_fields == 3 && strcmp (fields[0], "U") == 0) {
+        set_value (fields[1], fields[2], NULL);
+    } else if (n_fields == 4 && strcmp (fields[0], "S") == 0) {
+        set_value (fields[1], fields[2],
+                   metadata_value_new ((const char * const *) fields + 3, FALSE));
+    } else if (n_fields >= 3 && strcmp (fields[0], "L") == 0) {
+        set_value (fields[1], fields[2],
+                   metadata_value_new ((const char * const *) fields + 3, TRUE));
+    }
+
+    g_strfreev (fields);
 }
 
-static GKeyFile *
-load_metadata_keyfile (void)
+#define STRV_TERMINATOR "@x-caja-desktop-metadata-term@"
+
+static void
+load_keyfile (void)
 {
-      GKeyFile *retval;
-    GError *error = NULL;
+    GKeyFile *keyfile;
+    gchar **groups, **keys, **values;
     gchar *filename;
+    gsize length;
+    int i, j;
 
-    retval = g_key_file_new ();
+    keyfile = g_key_file_new ();
     filename = get_keyfile_path ();
 
-    g_key_file_load_from_file (retval,
-                   filename,
-                   G_KEY_FILE_NONE,
-                   &error);
-
-    if (error != NULL) {
-        if (!g_error_matches (error,
-                      G_FILE_ERROR,
-                      G_FILE_ERROR_NOENT)) {
-            g_print ("Unable to open the desktop metadata keyfile: %s\n",
-                 error->message);
+    if (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL)) {
+        groups = g_key_file_get_groups (keyfile, NULL);
+        for (i = 0; groups[i] != NULL; i++) {
+            keys = g_key_file_get_keys (keyfile, groups[i], NULL, NULL);
+            for (j = 0; keys != NULL && keys[j] != NULL; j++) {
+                values = g_key_file_get_string_list (keyfile, groups[i], keys[j],
+                                                     &length, NULL);
+                if (values == NULL || length < 1) {
+                    g_strfreev (values);
+                    continue;
+                }
+
+                /* Lists of one were stored with a terminator after
+                 * them, to tell them from strings. */
+                if (length == 2 && strcmp (values[1], STRV_TERMINATOR) == 0) {
+                    g_free (values[1]);
+                    values[1] = NULL;
+                    set_value (groups[i], keys[j],
+                               metadata_value_new ((const char * const *) values, TRUE));
+                } else {
+                    set_value (groups[i], keys[j],
+                               metadata_value_new ((const char * const *) values, length > 1));
+                }
+                g_strfreev (values);
+            }
+            g_strfreev (keys);
         }
+        g_strfreev (groups);
+    }
+
+    g_free (filename);
+    g_key_file_free (keyfile);
+}
+
+/* Loaded when a desktop item first asks for its metadata, which is
+ * when the desktop is shown, not when Caja starts. */
+static void
+ensure_loaded (void)
+{
+    gchar *filename, *contents, *line, *end;
+    GError *error = NULL;
+
+    if (items != NULL) {
+        return;
+    }
 
+    items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                   g_free, (GDestroyNotify) g_hash_table_destroy);
+    unsaved_records = g_string_new (NULL);
+    eel_debug_call_at_shutdown (save_now);
+
+    filename = get_log_path ();
+
+    if (g_file_get_contents (filename, &contents, NULL, &error)) {
+        if (g_str_has_prefix (contents, LOG_HEADER)) {
+            log_is_valid = TRUE;
+
+            /* A last line without its newline was cut short while
+             * being written, and is left out. */
+            line = contents + strlen (LOG_HEADER);
+            while ((end = strchr (line, '\n')) != NULL) {
+                *end = '\0';
+                load_record (line);
+                n_records++;
+                line = end + 1;
+            }
+        } else {
+            g_warning ("Ignoring the desktop metadata log %s, which isn't in a known format",
+                       filename);
+        }
+        g_free (contents);
+    } else {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_print ("Unable to open the desktop metadata log: %s\n",
+                     error->message);
+        }
         g_error_free (error);
+
+        load_keyfile ();
     }
 
     g_free (filename);
 
-    return retval;
+    /* Written out whole if it was too long or not there at all. */
+    if (!log_is_valid || n_records > 2 * n_values + COMPACTION_SLACK) {
+        save_in_idle_source_id = g_idle_add (save_in_idle_cb, NULL);
+    }
+}
+
+static void
+compact_log (const char *filename)
+{
+    GHashTableIter items_iter, keys_iter;
+    gpointer name, keys, key, value;
+    GString *contents;
+    GError *error = NULL;
+
+    contents = g_string_new (LOG_HEADER);
+    g_hash_table_iter_init (&items_iter, items);
+    while (g_hash_table_iter_next (&items_iter, &name, &keys)) {
+        g_hash_table_iter_init (&keys_iter, keys);
+        while (g_hash_table_iter_next (&keys_iter, &key, &value)) {
+            append_record (contents, name, key, value);
+        }
+    }
+
+    if (g_file_set_contents (filename, contents->str, contents->len, &error)) {
+        log_is_valid = TRUE;
+        n_records = n_values;
+        g_string_truncate (unsaved_records, 0);
+    } else {
+        g_warning ("Couldn't save the desktop metadata log to disk: %s",
+                   error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (contents, TRUE);
 }
 
-static GKeyFile *
-get_keyfile (void)
+static void
+append_to_log (const char *filename)
 {
-    static gboolean keyfile_loaded = FALSE;
-    static GKeyFile *keyfile = NULL;
+    gssize written;
+    gsize offset;
+    int fd;
+
+    fd = g_open (filename, O_WRONLY | O_APPEND, 0);
+    if (fd == -1) {
+        /* Gone, so it is written whole next time. */
+        if (errno == ENOENT) {
+            log_is_valid = FALSE;
+        }
+        g_warning ("Couldn't save the desktop metadata log to disk: %s",
+                   g_strerror (errno));
+        return;
+    }
 
-    if (!keyfile_loaded) {
-        keyfile = load_metadata_keyfile ();
-        keyfile_loaded = TRUE;
+    offset = 0;
+    while (offset < unsaved_records->len) {
+        written = write (fd, unsaved_records->str + offset,
+                         unsaved_records->len - offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            g_warning ("Couldn't save the desktop metadata log to disk: %s",
+                       g_strerror (errno));
+            break;
+        }
+        offset += written;
     }
+    close (fd);
 
-    return keyfile;
+    /* Whatever was written counts, even if not all of it was. */
+    g_string_erase (unsaved_records, 0, offset);
+}
+
+static void
+save_now (void)
+{
+    gchar *filename;
+    guint n_unsaved;
+    const char *p;
+
+    if (save_in_idle_source_id != 0) {
+        g_source_remove (save_in_idle_source_id);
+        save_in_idle_source_id = 0;
+    }
+
+    if (items == NULL) {
+        return;
+    }
+
+    n_unsaved = 0;
+    for (p = unsaved_records->str; (p = strchr (p, '\n')) != NULL; p++) {
+        n_unsaved++;
+    }
+
+    filename = get_log_path ();
+    if (!log_is_valid || n_records + n_unsaved > 2 * n_values + COMPACTION_SLACK) {
+        compact_log (filename);
+    } else if (n_unsaved > 0) {
+        append_to_log (filename);
+        n_records += n_unsaved;
+    }
+    g_free (filename);
+}
+
+static gboolean
+save_in_idle_cb (gpointer data)
+{
+    save_in_idle_source_id = 0;
+    save_now ();
+
+    return FALSE;
+}
+
+static void
+save_in_idle (void)
+{
+    if (save_in_idle_source_id == 0) {
+        save_in_idle_source_id = g_idle_add (save_in_idle_cb, NULL);
+    }
+}
+
+static void
+set_metadata (const char *name,
+              const char *key,
+              MetadataValue *value)
+{
+    ensure_loaded ();
+
+    append_record (unsaved_records, name, key, value);
+    set_value (name, key, value);
+
+    save_in_idle ();
 }
 
 void
@@ -145,149 +469,68 @@ caja_desktop_set_metadata_string (CajaFile *file,
                                       const gchar *key,
                                       const gchar *string)
 {
-    GKeyFile *keyfile;
-
-    keyfile = get_keyfile ();
-
-    g_key_file_set_string (keyfile,
-                   name,
-                   key,
-                   string);
+    const char *values[2];
 
-    save_in_idle (keyfile);
+    values[0] = string;
+    values[1] = NULL;
+    set_metadata (name, key,
+                  string != NULL ? metadata_value_new (values, FALSE) : NULL);
 
-    if (caja_desktop_update_metadata_from_keyfile (file, name)) {
+    if (caja_file_update_metadata (file, key, string)) {
         caja_file_changed (file);
-    }    
+    }
 }
 
-#define STRV_TERMINATOR "@x-caja-desktop-metadata-term@"
-
 void
 caja_desktop_set_metadata_stringv (CajaFile *file,
                                        const char *name,
                                        const char *key,
                                        const char * const *stringv)
 {
-    GKeyFile *keyfile;
-    guint length;
-    gchar **actual_stringv = NULL;
-    gboolean free_strv = FALSE;
-
-    keyfile = get_keyfile ();
-
-    /* if we would be setting a single-length strv, append a fake
-     * terminator to the array, to be able to differentiate it later from
-     * the single string case
-     */
-    length = g_strv_length ((gchar **) stringv);
-
-    if (length == 1) {
-        actual_stringv = g_malloc0 (3 * sizeof (gchar *));
-        actual_stringv[0] = (gchar *) stringv[0];
-        actual_stringv[1] = STRV_TERMINATOR;
-        actual_stringv[2] = NULL;
-
-        length = 2;
-        free_strv = TRUE;
-    } else {
-        actual_stringv = (gchar **) stringv;
-    }
-
-    g_key_file_set_string_list (keyfile,
-                    name,
-                    key,
-                    (const gchar **) actual_stringv,
-                    length);
-
-    save_in_idle (keyfile);
+    set_metadata (name, key, metadata_value_new (stringv, TRUE));
 
-    if (caja_desktop_update_metadata_from_keyfile (file, name)) {
+    if (caja_file_update_metadata_list (file, key, (char **) stringv)) {
         caja_file_changed (file);
     }
-
-    if (free_strv) {
-        g_free (actual_stringv);
-    }
 }
 
 gboolean
 caja_desktop_update_metadata_from_keyfile (CajaFile *file,
                            const gchar *name)
 {
-    gchar **keys, **values;
-    const gchar *actual_values[2];
-    const gchar *key, *value;
+    GHashTable *keys;
+    GHashTableIter iter;
+    gpointer key, data;
+    MetadataValue *value;
     gchar *gio_key;
-    gsize length, values_length;
-    GKeyFile *keyfile;
     GFileInfo *info;
-    gint idx;
     gboolean res;
 
-    keyfile = get_keyfile ();
-
-    keys = g_key_file_get_keys (keyfile,
-                    name,
-                    &length,
-                    NULL);
+    ensure_loaded ();
 
+    keys = g_hash_table_lookup (items, name);
     if (keys == NULL) {
         return FALSE;
     }
 
     info = g_file_info_new ();
 
-    for (idx = 0; idx < length; idx++) {
-        key = keys[idx];
-        values = g_key_file_get_string_list (keyfile,
-                             name,
-                             key,
-                             &values_length,
-                             NULL);
-
-        gio_key = g_strconcat ("metadata::", key, NULL);
-
-        if (values_length < 1) {
-            continue;
-        } else if (values_length == 1) {
-            g_file_info_set_attribute_string (info,
-                              gio_key,
-                              values[0]);
-        } else if (values_length == 2) {
-            /* deal with the fact that single-length strv are stored
-             * with an additional terminator in the keyfile string, to differentiate
-             * them from the regular string case.
-             */
-            value = values[1];
-
-            if (g_strcmp0 (value, STRV_TERMINATOR) == 0) {
-                /* if the 2nd value is the terminator, remove it */
-                actual_values[0] = values[0];
-                actual_values[1] = NULL;
-
-                g_file_info_set_attribute_stringv (info,
-                                   gio_key,
-                                   (gchar **) actual_values);
-            } else {
-                /* otherwise, set it as a regular strv */
-                g_file_info_set_attribute_stringv (info,
-                                   gio_key,
-                                   values);
-            }
+    g_hash_table_iter_init (&iter, keys);
+    while (g_hash_table_iter_next (&iter, &key, &data)) {
+        value = data;
+        gio_key = g_strconcat ("metadata::", (char *) key, NULL);
+
+        if (value->is_list) {
+            g_file_info_set_attribute_stringv (info, gio_key, value->values);
         } else {
-            g_file_info_set_attribute_stringv (info,
-                               gio_key,
-                               values);
+            g_file_info_set_attribute_string (info, gio_key, value->values[0]);
         }
 
         g_free (gio_key);
-        g_strfreev (values);
     }
 
     res = caja_file_update_metadata_from_info (file, info);
 
-    g_strfreev (keys);
     g_object_unref (info);
 
     return res;
@@ -24,6 +24,7 @@
 
 #include <config.h>
 
+#include "caja-debug-log.h"
 #include "caja-directory-notify.h"
 #include "caja-directory-private.h"
 #include "caja-file-attributes.h"
@@ -33,8 +34,13 @@
 #include "caja-global-preferences.h"
 #include "caja-link.h"
 #include "caja-marshal.h"
+#include "caja-module.h"
+#include "caja-thumbnail-cache.h"
+#include "caja-thumbnails.h"
+#include <eel/eel-debug.h>
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
+#include <libcaja-extension/caja-batch-info-provider.h>
 #include <libxml/parser.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -61,6 +67,21 @@
 /* Keep async. jobs down to this number for all directories. */
 #define MAX_ASYNC_JOBS 10
 
+/* Batch info providers are asked about up to this many files at once. */
+#define EXTENSION_INFO_BATCH_SIZE 32
+
+/* Keep each info provider down to this many requests for all
+ * directories, so a slow one can't take all the job slots. */
+#define EXTENSION_INFO_MAX_REQUESTS_PER_PROVIDER 2
+
+/* Files a provider hasn't answered for by then are done without it,
+ * and one that times out this many times in a row isn't asked again. */
+#define EXTENSION_INFO_TIMEOUT_SECONDS 10
+#define EXTENSION_INFO_MAX_CONSECUTIVE_TIMEOUTS 3
+
+/* Requests taking longer than this go in the debug log. */
+#define EXTENSION_INFO_SLOW_MSECS 1000
+
 struct TopLeftTextReadState
 {
     CajaDirectory *directory;
@@ -177,13 +198,35 @@ typedef struct
     Request request;
 } Monitor;
 
-typedef struct
+/* One call to an info provider, for one file or, for a batch info
+ * provider, several from the same directory.
+ */
+struct ExtensionInfoRequest
 {
     CajaDirectory *directory;
     CajaInfoProvider *provider;
+    GList *files; /* NULL in place of files no longer in the directory */
+    char *job;
+    GClosure *update_complete;
     CajaOperationHandle *handle;
-    CajaOperationResult result;
-} InfoProviderResponse;
+    CajaOperationHandle *completed_handle;
+    GTimer *timer;
+    guint idle_id;
+    guint timeout_id;
+};
+
+typedef struct
+{
+    char *name;
+    int n_in_progress;
+    guint n_requests;
+    guint n_files;
+    guint n_timeouts;
+    guint consecutive_timeouts;
+    gdouble total_msecs;
+    gdouble max_msecs;
+    gboolean disabled;
+} InfoProviderState;
 
 typedef gboolean (* RequestCheck) (Request);
 typedef gboolean (* FileCheck) (CajaFile *);
@@ -191,6 +234,10 @@ typedef gboolean (* FileCheck) (CajaFile *);
 /* Current number of async. jobs. */
 static int async_job_count;
 static GHashTable *waiting_directories;
+
+/* Keyed by CajaInfoProvider. */
+static GHashTable *info_provider_states;
+static GHashTable *extension_info_waiting_directories;
 #ifdef DEBUG_ASYNC_JOBS
 static GHashTable *async_jobs;
 #endif
@@ -1664,7 +1711,7 @@ caja_directory_get_info_for_new_files (CajaDirectory *directory,
         state->count++;
 
         g_file_query_info_async (location,
-                                 CAJA_FILE_DEFAULT_ATTRIBUTES,
+                                 caja_file_get_default_attributes (),
                                  0,
                                  G_PRIORITY_DEFAULT,
                                  state->cancellable,
@@ -1758,10 +1805,18 @@ caja_async_destroying_file (CajaFile *file)
         directory->details->link_info_read_state->file = NULL;
         changed = TRUE;
     }
-    if (directory->details->extension_info_file == file)
+    for (node = directory->details->extension_info_requests; node != NULL; node = node->next)
     {
-        directory->details->extension_info_file = NULL;
-        changed = TRUE;
+        ExtensionInfoRequest *request;
+        GList *file_node;
+
+        request = node->data;
+        file_node = g_list_find (request->files, file);
+        if (file_node != NULL)
+        {
+            file_node->data = NULL;
+            changed = TRUE;
+        }
     }
 
     if (directory->details->thumbnail_state != NULL &&
@@ -2455,7 +2510,7 @@ start_monitoring_file_list (CajaDirectory *directory)
     directory->details->directory_load_in_progress = state;
 
     g_file_enumerate_children_async (directory->details->location,
-                                     CAJA_FILE_DEFAULT_ATTRIBUTES,
+                                     caja_file_get_default_attributes (),
                                      0, /* flags */
                                      G_PRIORITY_DEFAULT, /* prio */
                                      state->cancellable,
@@ -3877,7 +3932,7 @@ file_info_start (CajaDirectory *directory,
 
     location = caja_file_get_location (file);
     g_file_query_info_async (location,
-                             CAJA_FILE_DEFAULT_ATTRIBUTES,
+                             caja_file_get_default_attributes (),
                              0,
                              G_PRIORITY_DEFAULT,
                              state->cancellable, query_info_callback, state);
@@ -4151,12 +4206,32 @@ link_info_start (CajaDirectory *directory,
     g_object_unref (location);
 }
 
+extern int cached_thumbnail_size;
+
+/* The largest thumbnail we load, cf. caja_file_get_icon() */
+static int
+get_max_thumbnail_size (void)
+{
+    return CAJA_ICON_SIZE_LARGEST * cached_thumbnail_size / CAJA_ICON_SIZE_STANDARD;
+}
+
+/* Thumbnails are cached by the size they were loaded at: originals are
+ * scaled down to the largest size we show, thumbnail files are kept as
+ * the thumbnailer made them.
+ */
+static int
+get_thumbnail_cache_size (gboolean original)
+{
+    return original ? get_max_thumbnail_size () : CAJA_THUMBNAIL_NORMAL_SIZE;
+}
+
 static void
 thumbnail_done (CajaDirectory *directory,
                 CajaFile *file,
                 GdkPixbuf *pixbuf,
                 gboolean tried_original)
 {
+    char *uri;
     const char *thumb_mtime_str;
     time_t thumb_mtime = 0;
 
@@ -4187,6 +4262,15 @@ thumbnail_done (CajaDirectory *directory,
         {
             file->details->thumbnail = g_object_ref (pixbuf);
             file->details->thumbnail_mtime = thumb_mtime;
+
+            if (file->details->mtime != 0)
+            {
+                uri = caja_file_get_uri (file);
+                caja_thumbnail_cache_insert (uri, file->details->mtime,
+                                             get_thumbnail_cache_size (tried_original),
+                                             pixbuf);
+                g_free (uri);
+            }
         }
         else
         {
@@ -4252,8 +4336,6 @@ thumbnail_state_free (ThumbnailState *state)
     g_free (state);
 }
 
-extern int cached_thumbnail_size;
-
 /* scale very large images down to the max. size we need */
 static void
 thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
@@ -4266,8 +4348,7 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 
     aspect_ratio = ((double) width) / height;
 
-    /* cf. caja_file_get_icon() */
-    max_thumbnail_size = CAJA_ICON_SIZE_LARGEST * cached_thumbnail_size / CAJA_ICON_SIZE_STANDARD;
+    max_thumbnail_size = get_max_thumbnail_size ();
     if (MAX (width, height) > max_thumbnail_size)
     {
         if (width > height)
@@ -4396,6 +4477,8 @@ thumbnail_start (CajaDirectory *directory,
 {
     GFile *location;
     ThumbnailState *state;
+    GdkPixbuf *pixbuf;
+    char *uri;
 
     if (directory->details->thumbnail_state != NULL)
     {
@@ -4411,6 +4494,23 @@ thumbnail_start (CajaDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Another window, or an earlier visit to this folder, may have
+       loaded the thumbnail already. */
+    if (file->details->mtime != 0)
+    {
+        uri = caja_file_get_uri (file);
+        pixbuf = caja_thumbnail_cache_lookup (uri, file->details->mtime,
+                                              get_thumbnail_cache_size (file->details->thumbnail_wants_original));
+        g_free (uri);
+
+        if (pixbuf != NULL)
+        {
+            thumbnail_got_pixbuf (directory, file, pixbuf,
+                                  file->details->thumbnail_wants_original);
+            return;
+        }
+    }
+
     if (!async_job_start (directory, "thumbnail"))
     {
         return;
@@ -4798,50 +4898,273 @@ filesystem_info_start (CajaDirectory *directory,
 }
 
 static void
-extension_info_cancel (CajaDirectory *directory)
+info_provider_state_free (InfoProviderState *state)
+{
+    g_free (state->name);
+    g_free (state);
+}
+
+static void
+free_info_provider_states (void)
+{
+    g_hash_table_destroy (info_provider_states);
+    info_provider_states = NULL;
+}
+
+static InfoProviderState *
+get_info_provider_state (CajaInfoProvider *provider)
 {
-    if (directory->details->extension_info_in_progress != NULL)
+    InfoProviderState *state;
+
+    if (info_provider_states == NULL)
     {
-        if (directory->details->extension_info_idle)
-        {
-            g_source_remove (directory->details->extension_info_idle);
-        }
-        else
+        info_provider_states = g_hash_table_new_full (NULL, NULL, NULL,
+                               (GDestroyNotify) info_provider_state_free);
+        eel_debug_call_at_shutdown (free_info_provider_states);
+    }
+
+    state = g_hash_table_lookup (info_provider_states, provider);
+    if (state == NULL)
+    {
+        state = g_new0 (InfoProviderState, 1);
+        state->name = g_strdup (G_OBJECT_TYPE_NAME (provider));
+        g_hash_table_insert (info_provider_states, provider, state);
+    }
+
+    return state;
+}
+
+GList *
+caja_directory_get_info_provider_stats (void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    InfoProviderState *state;
+    CajaInfoProviderStats *stats;
+    GList *stats_list;
+
+    stats_list = NULL;
+
+    if (info_provider_states == NULL)
+    {
+        return NULL;
+    }
+
+    g_hash_table_iter_init (&iter, info_provider_states);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        state = value;
+
+        stats = g_new0 (CajaInfoProviderStats, 1);
+        stats->provider_name = g_strdup (state->name);
+        stats->n_requests = state->n_requests;
+        stats->n_files = state->n_files;
+        stats->n_timeouts = state->n_timeouts;
+        if (state->n_requests > 0)
         {
-            caja_info_provider_cancel_update
-            (directory->details->extension_info_provider,
-             directory->details->extension_info_in_progress);
+            stats->mean_msecs = state->total_msecs / state->n_requests;
         }
+        stats->max_msecs = state->max_msecs;
+        stats->disabled = state->disabled;
+
+        stats_list = g_list_prepend (stats_list, stats);
+    }
+
+    return stats_list;
+}
+
+static void
+info_provider_stats_free (CajaInfoProviderStats *stats)
+{
+    g_free (stats->provider_name);
+    g_free (stats);
+}
+
+void
+caja_info_provider_stats_list_free (GList *stats_list)
+{
+    g_list_free_full (stats_list, (GDestroyNotify) info_provider_stats_free);
+}
+
+/* Directories that have files waiting for a provider that is busy
+ * elsewhere. They are looked at again when a request ends.
+ */
+static void
+wake_up_extension_info_waiters (void)
+{
+    GList *directories, *l;
+
+    if (extension_info_waiting_directories == NULL ||
+            g_hash_table_size (extension_info_waiting_directories) == 0)
+    {
+        return;
+    }
 
-        directory->details->extension_info_in_progress = NULL;
-        directory->details->extension_info_file = NULL;
-        directory->details->extension_info_provider = NULL;
-        directory->details->extension_info_idle = 0;
+    directories = g_hash_table_get_keys (extension_info_waiting_directories);
+    g_hash_table_remove_all (extension_info_waiting_directories);
 
-        async_job_end (directory, "extension info");
+    for (l = directories; l != NULL; l = l->next)
+    {
+        caja_directory_async_state_changed (CAJA_DIRECTORY (l->data));
     }
+    g_list_free (directories);
 }
 
 static void
-extension_info_stop (CajaDirectory *directory)
+wait_for_extension_info (CajaDirectory *directory)
+{
+    if (extension_info_waiting_directories == NULL)
+    {
+        extension_info_waiting_directories = eel_g_hash_table_new_free_at_exit
+                                             (NULL, NULL,
+                                              "caja-directory-async.c: extension_info_waiting_directories");
+    }
+
+    g_hash_table_insert (extension_info_waiting_directories,
+                         directory,
+                         directory);
+}
+
+static void
+extension_info_request_free (ExtensionInfoRequest *request)
+{
+    if (request->idle_id != 0)
+    {
+        g_source_remove (request->idle_id);
+    }
+    if (request->timeout_id != 0)
+    {
+        g_source_remove (request->timeout_id);
+    }
+
+    /* Anything the provider says from now on goes nowhere. */
+    g_closure_invalidate (request->update_complete);
+    g_closure_unref (request->update_complete);
+
+    g_list_free (request->files);
+    g_timer_destroy (request->timer);
+    g_free (request->job);
+    g_free (request);
+}
+
+static void
+extension_info_request_cancel (ExtensionInfoRequest *request)
+{
+    CajaDirectory *directory;
+
+    directory = request->directory;
+    directory->details->extension_info_requests =
+        g_list_remove (directory->details->extension_info_requests, request);
+
+    if (request->idle_id == 0)
+    {
+        caja_info_provider_cancel_update (request->provider,
+                                          request->handle);
+    }
+
+    get_info_provider_state (request->provider)->n_in_progress--;
+
+    async_job_end (directory, request->job);
+    extension_info_request_free (request);
+}
+
+static void
+extension_info_cancel (CajaDirectory *directory)
 {
-    if (directory->details->extension_info_in_progress != NULL)
+    if (extension_info_waiting_directories != NULL)
     {
-        CajaFile *file;
+        g_hash_table_remove (extension_info_waiting_directories, directory);
+    }
 
-        file = directory->details->extension_info_file;
+    while (directory->details->extension_info_requests != NULL)
+    {
+        extension_info_request_cancel (directory->details->extension_info_requests->data);
+    }
+}
+
+static gboolean
+extension_info_request_is_wanted (ExtensionInfoRequest *request)
+{
+    CajaFile *file;
+    GList *node;
+
+    for (node = request->files; node != NULL; node = node->next)
+    {
+        file = node->data;
         if (file != NULL)
         {
             g_assert (CAJA_IS_FILE (file));
-            g_assert (file->details->directory == directory);
+            g_assert (file->details->directory == request->directory);
             if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
             {
-                return;
+                return TRUE;
             }
         }
+    }
 
-        /* The info is not wanted, so stop it. */
-        extension_info_cancel (directory);
+    return FALSE;
+}
+
+static void
+extension_info_stop (CajaDirectory *directory)
+{
+    GList *requests, *node;
+
+    requests = g_list_copy (directory->details->extension_info_requests);
+    for (node = requests; node != NULL; node = node->next)
+    {
+        /* Stop the ones whose info is not wanted. */
+        if (!extension_info_request_is_wanted (node->data))
+        {
+            extension_info_request_cancel (node->data);
+        }
+    }
+    g_list_free (requests);
+}
+
+static void
+count_waiting_info_provider (CajaDirectory *directory,
+                             CajaInfoProvider *provider,
+                             int delta)
+{
+    int count;
+
+    if (directory->details->waiting_info_providers == NULL)
+    {
+        directory->details->waiting_info_providers =
+            g_hash_table_new (NULL, NULL);
+    }
+
+    count = GPOINTER_TO_INT (g_hash_table_lookup (directory->details->waiting_info_providers,
+                             provider)) + delta;
+    if (count > 0)
+    {
+        g_hash_table_insert (directory->details->waiting_info_providers,
+                             provider, GINT_TO_POINTER (count));
+    }
+    else
+    {
+        g_hash_table_remove (directory->details->waiting_info_providers,
+                             provider);
+    }
+}
+
+void
+caja_directory_count_waiting_info_providers (CajaDirectory *directory,
+        CajaFile *file,
+        int delta)
+{
+    GList *node;
+
+    /* Only files on the extension queue are counted. */
+    if (!caja_file_queue_contains (directory->details->extension_queue, file))
+    {
+        return;
+    }
+
+    for (node = file->details->pending_info_providers; node != NULL; node = node->next)
+    {
+        count_waiting_info_provider (directory, node->data, delta);
     }
 }
 
@@ -4850,9 +5173,22 @@ finish_info_provider (CajaDirectory *directory,
                       CajaFile *file,
                       CajaInfoProvider *provider)
 {
+    GList *node;
+
+    /* The file may have been invalidated since it was asked about,
+     * and then it isn't done with this provider yet. */
+    node = g_list_find (file->details->pending_info_providers, provider);
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (caja_file_queue_contains (directory->details->extension_queue, file))
+    {
+        count_waiting_info_provider (directory, provider, -1);
+    }
     file->details->pending_info_providers =
-        g_list_remove  (file->details->pending_info_providers,
-                        provider);
+        g_list_delete_link (file->details->pending_info_providers, node);
     g_object_unref (provider);
 
     caja_directory_async_state_changed (directory);
@@ -4863,34 +5199,107 @@ finish_info_provider (CajaDirectory *directory,
     }
 }
 
-
-static gboolean
-info_provider_idle_callback (gpointer user_data)
+static void
+record_info_provider_request (ExtensionInfoRequest *request,
+                              gboolean timed_out)
 {
-    InfoProviderResponse *response;
-    CajaDirectory *directory;
+    InfoProviderState *state;
+    gdouble msecs;
+    guint n_files;
+
+    state = get_info_provider_state (request->provider);
+    msecs = g_timer_elapsed (request->timer, NULL) * 1000.0;
+    n_files = g_list_length (request->files);
 
-    response = user_data;
-    directory = response->directory;
+    state->n_in_progress--;
+    state->n_requests++;
+    state->n_files += n_files;
+    state->total_msecs += msecs;
+    state->max_msecs = MAX (state->max_msecs, msecs);
 
-    if (response->handle != directory->details->extension_info_in_progress
-            || response->provider != directory->details->extension_info_provider)
+    if (timed_out)
     {
-        g_warning ("Unexpected plugin response.  This probably indicates a bug in a Caja extension: handle=%p", response->handle);
+        state->n_timeouts++;
+        state->consecutive_timeouts++;
     }
     else
     {
-        CajaFile *file;
-        async_job_end (directory, "extension info");
+        state->consecutive_timeouts = 0;
+    }
+
+    if (timed_out || msecs >= EXTENSION_INFO_SLOW_MSECS)
+    {
+        caja_debug_log (FALSE, CAJA_DEBUG_LOG_DOMAIN_ASYNC,
+                        "extension info: %s %s after %.0f ms for %u files",
+                        state->name,
+                        timed_out ? "timed out" : "answered",
+                        msecs, n_files);
+    }
+
+    if (!state->disabled &&
+            state->consecutive_timeouts >= EXTENSION_INFO_MAX_CONSECUTIVE_TIMEOUTS)
+    {
+        state->disabled = TRUE;
+        g_warning ("The %s extension didn't answer in time %u times in a row, "
+                   "so it won't be asked about any more files",
+                   state->name, state->consecutive_timeouts);
+    }
+}
+
+static void
+extension_info_request_done (ExtensionInfoRequest *request,
+                             gboolean timed_out)
+{
+    CajaDirectory *directory;
+    GList *files, *node;
+
+    directory = request->directory;
+    directory->details->extension_info_requests =
+        g_list_remove (directory->details->extension_info_requests, request);
+
+    async_job_end (directory, request->job);
+
+    record_info_provider_request (request, timed_out);
+
+    files = request->files;
+    request->files = NULL;
+
+    caja_directory_ref (directory);
+
+    /* A file that got no answer in time is done with the provider
+     * too, the same as if it had failed. */
+    for (node = files; node != NULL; node = node->next)
+    {
+        if (node->data != NULL)
+        {
+            finish_info_provider (directory, node->data, request->provider);
+        }
+    }
+    g_list_free (files);
 
-        file = directory->details->extension_info_file;
+    extension_info_request_free (request);
 
-        directory->details->extension_info_file = NULL;
-        directory->details->extension_info_provider = NULL;
-        directory->details->extension_info_in_progress = NULL;
-        directory->details->extension_info_idle = 0;
+    caja_directory_async_state_changed (directory);
+    wake_up_extension_info_waiters ();
 
-        finish_info_provider (directory, file, response->provider);
+    caja_directory_unref (directory);
+}
+
+static gboolean
+info_provider_idle_callback (gpointer user_data)
+{
+    ExtensionInfoRequest *request;
+
+    request = user_data;
+    request->idle_id = 0;
+
+    if (request->completed_handle != request->handle)
+    {
+        g_warning ("Unexpected plugin response.  This probably indicates a bug in a Caja extension: handle=%p", request->completed_handle);
+    }
+    else
+    {
+        extension_info_request_done (request, FALSE);
     }
 
     return FALSE;
@@ -4902,82 +5311,286 @@ info_provider_callback (CajaInfoProvider *provider,
                         CajaOperationResult result,
                         gpointer user_data)
 {
-    InfoProviderResponse *response;
+    ExtensionInfoRequest *request;
 
-    response = g_new0 (InfoProviderResponse, 1);
-    response->provider = provider;
-    response->handle = handle;
-    response->result = result;
-    response->directory = CAJA_DIRECTORY (user_data);
+    request = user_data;
+    request->completed_handle = handle;
 
-    response->directory->details->extension_info_idle =
-        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                         info_provider_idle_callback, response,
-                         g_free);
+    if (request->idle_id == 0)
+    {
+        request->idle_id =
+            g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                             info_provider_idle_callback, request,
+                             NULL);
+    }
 }
 
-static void
-extension_info_start (CajaDirectory *directory,
-                      CajaFile *file,
-                      gboolean *doing_io)
+static gboolean
+extension_info_timeout_callback (gpointer user_data)
 {
-    CajaInfoProvider *provider;
-    CajaOperationResult result;
-    CajaOperationHandle *handle;
-    GClosure *update_complete;
+    ExtensionInfoRequest *request;
+
+    request = user_data;
+    request->timeout_id = 0;
 
-    if (directory->details->extension_info_in_progress != NULL)
+    if (request->idle_id == 0)
     {
-        *doing_io = TRUE;
-        return;
+        caja_info_provider_cancel_update (request->provider,
+                                          request->handle);
     }
 
-    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
+    extension_info_request_done (request, TRUE);
+
+    return FALSE;
+}
+
+static gboolean
+extension_info_request_has_file (CajaDirectory *directory,
+                                 CajaFile *file,
+                                 CajaInfoProvider *provider)
+{
+    ExtensionInfoRequest *request;
+    GList *node;
+
+    for (node = directory->details->extension_info_requests; node != NULL; node = node->next)
     {
-        return;
+        request = node->data;
+        if (request->provider == provider &&
+                g_list_find (request->files, file) != NULL)
+        {
+            return TRUE;
+        }
     }
-    *doing_io = TRUE;
 
-    if (!async_job_start (directory, "extension info"))
+    return FALSE;
+}
+
+/* Picks more files from the directory that are waiting for the same
+ * provider, so it can be asked about them all at once.
+ */
+static GList *
+get_extension_info_batch (CajaDirectory *directory,
+                          CajaFile *file,
+                          CajaInfoProvider *provider)
+{
+    CajaFile *other;
+    GList *files, *node;
+    int n_files;
+
+    files = g_list_prepend (NULL, file);
+    n_files = 1;
+
+    for (node = directory->details->file_list;
+            node != NULL && n_files < EXTENSION_INFO_BATCH_SIZE;
+            node = node->next)
     {
-        return;
+        other = node->data;
+
+        if (other != file &&
+                other->details->pending_info_providers != NULL &&
+                !lacks_info (other) &&
+                g_list_find (other->details->pending_info_providers, provider) != NULL &&
+                !extension_info_request_has_file (directory, other, provider) &&
+                is_needy (other, lacks_extension_info, REQUEST_EXTENSION_INFO))
+        {
+            files = g_list_prepend (files, other);
+            n_files++;
+        }
     }
 
-    provider = file->details->pending_info_providers->data;
+    return g_list_reverse (files);
+}
+
+/* Takes files, and returns FALSE if there are already too many jobs
+ * going for another one to start.
+ */
+static gboolean
+extension_info_request_start (CajaDirectory *directory,
+                              CajaInfoProvider *provider,
+                              GList *files)
+{
+    ExtensionInfoRequest *request;
+    CajaOperationResult result;
+    CajaOperationHandle *handle;
+    GList *file_infos;
+    char *job;
 
-    update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
-                                      directory,
-                                      NULL);
-    g_closure_set_marshal (update_complete,
+    /* Several can be going at once, each a job of its own. */
+    job = g_strdup_printf ("extension info %p", files);
+    if (!async_job_start (directory, job))
+    {
+        g_free (job);
+        g_list_free (files);
+        return FALSE;
+    }
+
+    request = g_new0 (ExtensionInfoRequest, 1);
+    request->directory = directory;
+    request->provider = provider;
+    request->files = files;
+    request->job = job;
+    request->timer = g_timer_new ();
+    request->update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
+                               request,
+                               NULL);
+    g_closure_set_marshal (request->update_complete,
                            caja_marshal_VOID__POINTER_ENUM);
 
-    result = caja_info_provider_update_file_info
-             (provider,
-              CAJA_FILE_INFO (file),
-              update_complete,
-              &handle);
+    get_info_provider_state (provider)->n_in_progress++;
+    directory->details->extension_info_requests =
+        g_list_prepend (directory->details->extension_info_requests, request);
 
-    g_closure_unref (update_complete);
+    handle = NULL;
+    if (CAJA_IS_BATCH_INFO_PROVIDER (provider))
+    {
+        /* The files themselves are what extensions see as file infos. */
+        file_infos = g_list_copy (files);
+        result = caja_batch_info_provider_update_file_info_batch
+                 (CAJA_BATCH_INFO_PROVIDER (provider),
+                  file_infos,
+                  request->update_complete,
+                  &handle);
+        g_list_free (file_infos);
+    }
+    else
+    {
+        result = caja_info_provider_update_file_info
+                 (provider,
+                  CAJA_FILE_INFO (files->data),
+                  request->update_complete,
+                  &handle);
+    }
 
     if (result == CAJA_OPERATION_COMPLETE ||
             result == CAJA_OPERATION_FAILED)
     {
-        finish_info_provider (directory, file, provider);
-        async_job_end (directory, "extension info");
+        extension_info_request_done (request, FALSE);
     }
     else
     {
-        directory->details->extension_info_in_progress = handle;
-        directory->details->extension_info_provider = provider;
-        directory->details->extension_info_file = file;
+        request->handle = handle;
+        request->timeout_id =
+            g_timeout_add_seconds (EXTENSION_INFO_TIMEOUT_SECONDS,
+                                   extension_info_timeout_callback,
+                                   request);
+    }
+
+    return TRUE;
+}
+
+/* Whether every provider that files on the queue still wait for has
+ * all the requests going it can, so there is no point looking further
+ * down the queue for files to ask about. Disabled providers aren't
+ * busy, the files waiting for them are simply done with them.
+ */
+static gboolean
+info_providers_are_busy (CajaDirectory *directory,
+                         GList *providers)
+{
+    InfoProviderState *state;
+    GList *node;
+
+    if (directory->details->waiting_info_providers == NULL)
+    {
+        return TRUE;
+    }
+
+    for (node = providers; node != NULL; node = node->next)
+    {
+        if (g_hash_table_lookup (directory->details->waiting_info_providers,
+                                 node->data) == NULL)
+        {
+            continue;
+        }
+
+        state = get_info_provider_state (node->data);
+        if (state->disabled ||
+                state->n_in_progress < EXTENSION_INFO_MAX_REQUESTS_PER_PROVIDER)
+        {
+            return FALSE;
+        }
     }
+
+    return TRUE;
+}
+
+/* Returns FALSE when no more requests can start for now, for this
+ * file or any other.
+ */
+static gboolean
+extension_info_start (CajaDirectory *directory,
+                      CajaFile *file,
+                      gboolean *doing_io)
+{
+    CajaInfoProvider *provider;
+    InfoProviderState *state;
+    GList *providers, *node, *files;
+    gboolean waiting, started;
+
+    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
+    {
+        return TRUE;
+    }
+    *doing_io = TRUE;
+
+    /* Ask every provider the file is waiting for that isn't busy
+     * already, rather than one after the other. */
+    waiting = FALSE;
+    started = TRUE;
+    providers = g_list_copy (file->details->pending_info_providers);
+    for (node = providers; node != NULL; node = node->next)
+    {
+        provider = node->data;
+
+        if (g_list_find (file->details->pending_info_providers, provider) == NULL ||
+                extension_info_request_has_file (directory, file, provider))
+        {
+            continue;
+        }
+
+        state = get_info_provider_state (provider);
+        if (state->disabled)
+        {
+            finish_info_provider (directory, file, provider);
+            continue;
+        }
+        if (state->n_in_progress >= EXTENSION_INFO_MAX_REQUESTS_PER_PROVIDER)
+        {
+            waiting = TRUE;
+            continue;
+        }
+
+        if (CAJA_IS_BATCH_INFO_PROVIDER (provider))
+        {
+            files = get_extension_info_batch (directory, file, provider);
+        }
+        else
+        {
+            files = g_list_prepend (NULL, file);
+        }
+
+        if (!extension_info_request_start (directory, provider, files))
+        {
+            started = FALSE;
+            break;
+        }
+    }
+    g_list_free (providers);
+
+    if (waiting)
+    {
+        wait_for_extension_info (directory);
+    }
+
+    return started;
 }
 
 static void
 start_or_stop_io (CajaDirectory *directory)
 {
-    CajaFile *file;
-    gboolean doing_io;
+    CajaFile *file, *next;
+    GList *providers;
+    gboolean doing_io, more;
 
     /* Start or stop reading files. */
     file_list_start_or_stop (directory);
@@ -5034,20 +5647,39 @@ start_or_stop_io (CajaDirectory *directory)
         move_file_to_extension_queue (directory, file);
     }
 
-    /* Low priority queue must be empty */
-    while (!caja_file_queue_is_empty (directory->details->extension_queue))
+    /* Low priority queue must be empty. Files still waiting for a
+     * provider stay on the queue, but the ones behind them are asked
+     * about too, so a slow provider only holds up its own answers.
+     * The walk ends once every provider still owed answers is busy. */
+    file = caja_file_queue_head (directory->details->extension_queue);
+    if (file == NULL)
+    {
+        return;
+    }
+
+    providers = caja_module_get_extensions_for_type (CAJA_TYPE_INFO_PROVIDER);
+    while (file != NULL)
     {
-        file = caja_file_queue_head (directory->details->extension_queue);
+        caja_file_ref (file);
 
         /* Start getting attributes if possible */
-        extension_info_start (directory, file, &doing_io);
-        if (doing_io)
+        doing_io = FALSE;
+        more = extension_info_start (directory, file, &doing_io);
+
+        next = caja_file_queue_next (directory->details->extension_queue, file);
+        if (!doing_io)
         {
-            return;
+            caja_directory_remove_file_from_work_queue (directory, file);
         }
+        caja_file_unref (file);
 
-        caja_directory_remove_file_from_work_queue (directory, file);
+        if (!more || info_providers_are_busy (directory, providers))
+        {
+            break;
+        }
+        file = next;
     }
+    caja_module_extension_list_free (providers);
 }
 
 /* Call this when the monitor or call when ready list changes,
@@ -5352,6 +5984,7 @@ caja_directory_remove_file_from_work_queue (CajaDirectory *directory,
                             file);
     caja_file_queue_remove (directory->details->low_priority_queue,
                             file);
+    caja_directory_count_waiting_info_providers (directory, file, -1);
     caja_file_queue_remove (directory->details->extension_queue,
                             file);
 }
@@ -5373,8 +6006,12 @@ move_file_to_extension_queue (CajaDirectory *directory,
                               CajaFile *file)
 {
     /* Must add before removing to avoid ref underflow */
-    caja_file_queue_enqueue (directory->details->extension_queue,
-                             file);
+    if (!caja_file_queue_contains (directory->details->extension_queue, file))
+    {
+        caja_file_queue_enqueue (directory->details->extension_queue,
+                                 file);
+        caja_directory_count_waiting_info_providers (directory, file, 1);
+    }
     caja_file_queue_remove (directory->details->low_priority_queue,
                             file);
 }
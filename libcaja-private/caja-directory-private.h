@@ -44,6 +44,7 @@ typedef struct MimeListState MimeListState;
 typedef struct ThumbnailState ThumbnailState;
 typedef struct MountState MountState;
 typedef struct FilesystemInfoState FilesystemInfoState;
+typedef struct ExtensionInfoRequest ExtensionInfoRequest;
 
 typedef enum
 {
@@ -120,10 +121,10 @@ struct CajaDirectoryDetails
     CajaFile *get_info_file;
     GetInfoState *get_info_in_progress;
 
-    CajaFile *extension_info_file;
-    CajaInfoProvider *extension_info_provider;
-    CajaOperationHandle *extension_info_in_progress;
-    guint extension_info_idle;
+    GList *extension_info_requests; /* list of ExtensionInfoRequest * */
+    /* How many files on the extension queue each info provider still
+     * has to answer for. */
+    GHashTable *waiting_info_providers;
 
     ThumbnailState *thumbnail_state;
 
@@ -191,6 +192,29 @@ void               caja_directory_force_reload_internal           (CajaDirectory
 void               caja_directory_cancel_loading_file_attributes  (CajaDirectory         *directory,
         CajaFile              *file,
         CajaFileAttributes     file_attributes);
+/* Call with -1 before and 1 after changing the info providers a file is
+ * waiting for. */
+void               caja_directory_count_waiting_info_providers    (CajaDirectory         *directory,
+        CajaFile              *file,
+        int                    delta);
+
+/* How the info providers have been doing this session, for spotting
+ * the ones that hold up showing folders. Slow providers are disabled
+ * after timing out several times in a row.
+ */
+typedef struct
+{
+    char *provider_name;
+    guint n_requests;
+    guint n_files;
+    guint n_timeouts;
+    guint mean_msecs;
+    guint max_msecs;
+    gboolean disabled;
+} CajaInfoProviderStats;
+
+GList *            caja_directory_get_info_provider_stats         (void);
+void               caja_info_provider_stats_list_free             (GList                     *stats_list);
 
 /* Calls shared between directory, file, and async. code. */
 void               caja_directory_emit_files_added                (CajaDirectory         *directory,
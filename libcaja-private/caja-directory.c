@@ -211,6 +211,10 @@ caja_directory_finalize (GObject *object)
     caja_file_queue_destroy (directory->details->high_priority_queue);
     caja_file_queue_destroy (directory->details->low_priority_queue);
     caja_file_queue_destroy (directory->details->extension_queue);
+    if (directory->details->waiting_info_providers)
+    {
+        g_hash_table_destroy (directory->details->waiting_info_providers);
+    }
     g_assert (directory->details->directory_load_in_progress == NULL);
     g_assert (directory->details->count_in_progress == NULL);
     g_assert (directory->details->dequeue_pending_idle_id == 0);
@@ -0,0 +1,587 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-file-metadata.c: The metadata values of a file.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-file-metadata.h"
+
+#include "caja-lib-self-check-functions.h"
+#include "caja-metadata.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Set in the key of list values, so a key can have both kinds. */
+#define LIST_KEY (1U << 31)
+
+enum
+{
+    VALUE_IS_INTEGER = 1 << 0,
+    VALUE_IS_BOOLEAN = 1 << 1,
+    VALUE_IS_TRUE = 1 << 2
+};
+
+typedef struct
+{
+    guint32 key;
+    /* From the start of the block, of the string, or of the count
+     * and offsets of the strings of a list. */
+    guint32 offset;
+    gint32 integer;
+    guint32 flags;
+} MetadataEntry;
+
+/* Followed by the entries, sorted by key, and then the values. */
+struct CajaFileMetadata
+{
+    guint32 size;
+    guint32 n_entries;
+};
+
+#define METADATA_ENTRIES(metadata) ((MetadataEntry *) ((CajaFileMetadata *) (metadata) + 1))
+#define METADATA_AT(metadata, offset) ((char *) (metadata) + (offset))
+#define ALIGN_OFFSET(offset) (((offset) + 3) & ~(gsize) 3)
+
+/* A value to put in a new block. */
+typedef struct
+{
+    guint32 key;
+    const char *string;
+    const char **list;
+    guint n_values;
+} ValueSource;
+
+static int
+compare_sources (gconstpointer a, gconstpointer b)
+{
+    const ValueSource *source_a, *source_b;
+
+    source_a = a;
+    source_b = b;
+
+    if (source_a->key != source_b->key)
+    {
+        return source_a->key < source_b->key ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Reads value the way it has always been read: as a boolean when it
+ * is "true" or "false" in any case, and as an integer when it is one,
+ * with nothing but spaces around it. */
+static void
+parse_value (MetadataEntry *entry, const char *value)
+{
+    char *end;
+    long number;
+
+    if (g_ascii_strcasecmp (value, "true") == 0)
+    {
+        entry->flags |= VALUE_IS_BOOLEAN | VALUE_IS_TRUE;
+    }
+    else if (g_ascii_strcasecmp (value, "false") == 0)
+    {
+        entry->flags |= VALUE_IS_BOOLEAN;
+    }
+
+    errno = 0;
+    number = strtol (value, &end, 10);
+    if (end == value || errno != 0 ||
+            number < G_MININT32 || number > G_MAXINT32)
+    {
+        return;
+    }
+    while (g_ascii_isspace (*end))
+    {
+        end++;
+    }
+    if (*end == '\0')
+    {
+        entry->flags |= VALUE_IS_INTEGER;
+        entry->integer = number;
+    }
+}
+
+static CajaFileMetadata *
+metadata_new (ValueSource *sources, guint n_sources)
+{
+    CajaFileMetadata *metadata;
+    MetadataEntry *entry;
+    guint32 *offsets;
+    gsize size, offset, length;
+    guint i, j;
+
+    if (n_sources == 0)
+    {
+        return NULL;
+    }
+
+    qsort (sources, n_sources, sizeof (ValueSource), compare_sources);
+
+    size = sizeof (CajaFileMetadata) + n_sources * sizeof (MetadataEntry);
+    for (i = 0; i < n_sources; i++)
+    {
+        if (sources[i].key & LIST_KEY)
+        {
+            size = ALIGN_OFFSET (size) + (sources[i].n_values + 1) * sizeof (guint32);
+            for (j = 0; j < sources[i].n_values; j++)
+            {
+                size += strlen (sources[i].list[j]) + 1;
+            }
+        }
+        else
+        {
+            size += strlen (sources[i].string) + 1;
+        }
+    }
+
+    /* Zeroed, padding and all, so equal blocks are the same bytes. */
+    metadata = g_malloc0 (size);
+    metadata->size = size;
+    metadata->n_entries = n_sources;
+
+    offset = sizeof (CajaFileMetadata) + n_sources * sizeof (MetadataEntry);
+    for (i = 0; i < n_sources; i++)
+    {
+        entry = &METADATA_ENTRIES (metadata)[i];
+        entry->key = sources[i].key;
+
+        if (sources[i].key & LIST_KEY)
+        {
+            offset = ALIGN_OFFSET (offset);
+            entry->offset = offset;
+            offsets = (guint32 *) METADATA_AT (metadata, offset);
+            offsets[0] = sources[i].n_values;
+            offset += (sources[i].n_values + 1) * sizeof (guint32);
+
+            for (j = 0; j < sources[i].n_values; j++)
+            {
+                length = strlen (sources[i].list[j]) + 1;
+                offsets[j + 1] = offset;
+                memcpy (METADATA_AT (metadata, offset), sources[i].list[j], length);
+                offset += length;
+            }
+        }
+        else
+        {
+            length = strlen (sources[i].string) + 1;
+            entry->offset = offset;
+            memcpy (METADATA_AT (metadata, offset), sources[i].string, length);
+            offset += length;
+
+            parse_value (entry, sources[i].string);
+        }
+    }
+
+    g_assert (offset == size);
+
+    return metadata;
+}
+
+CajaFileMetadata *
+caja_file_metadata_new_from_info (GFileInfo *info)
+{
+    CajaFileMetadata *metadata;
+    ValueSource *sources;
+    GFileAttributeType type;
+    gpointer value;
+    char **attrs;
+    guint id, n_sources;
+    int i;
+
+    if (!g_file_info_has_namespace (info, "metadata"))
+    {
+        return NULL;
+    }
+
+    attrs = g_file_info_list_attributes (info, "metadata");
+    sources = g_new0 (ValueSource, g_strv_length (attrs));
+    n_sources = 0;
+
+    for (i = 0; attrs[i] != NULL; i++)
+    {
+        id = caja_metadata_get_id (attrs[i] + strlen ("metadata::"));
+        if (id == 0)
+        {
+            continue;
+        }
+
+        if (!g_file_info_get_attribute_data (info, attrs[i],
+                                             &type, &value, NULL))
+        {
+            continue;
+        }
+
+        if (type == G_FILE_ATTRIBUTE_TYPE_STRING)
+        {
+            sources[n_sources].key = id;
+            sources[n_sources].string = value;
+            n_sources++;
+        }
+        else if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV)
+        {
+            sources[n_sources].key = id | LIST_KEY;
+            sources[n_sources].list = value;
+            sources[n_sources].n_values = g_strv_length (value);
+            n_sources++;
+        }
+    }
+
+    metadata = metadata_new (sources, n_sources);
+
+    g_free (sources);
+    g_strfreev (attrs);
+
+    return metadata;
+}
+
+void
+caja_file_metadata_free (CajaFileMetadata *metadata)
+{
+    g_free (metadata);
+}
+
+gboolean
+caja_file_metadata_equal (const CajaFileMetadata *a,
+                          const CajaFileMetadata *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return a == b;
+    }
+
+    return a->size == b->size && memcmp (a, b, a->size) == 0;
+}
+
+static const MetadataEntry *
+find_entry (const CajaFileMetadata *metadata, guint32 key)
+{
+    const MetadataEntry *entries;
+    guint low, high, middle;
+
+    if (metadata == NULL)
+    {
+        return NULL;
+    }
+
+    entries = METADATA_ENTRIES (metadata);
+    low = 0;
+    high = metadata->n_entries;
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (entries[middle].key == key)
+        {
+            return &entries[middle];
+        }
+        if (entries[middle].key < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return NULL;
+}
+
+static const guint32 *
+get_list_offsets (const CajaFileMetadata *metadata, const MetadataEntry *entry)
+{
+    return (const guint32 *) METADATA_AT (metadata, entry->offset);
+}
+
+/* The values of metadata but the one for key, with value added. */
+static CajaFileMetadata *
+metadata_replace (const CajaFileMetadata *metadata,
+                  ValueSource *value)
+{
+    CajaFileMetadata *new_metadata;
+    const MetadataEntry *entry;
+    const guint32 *offsets;
+    ValueSource *sources;
+    guint i, j, n_entries, n_sources;
+
+    n_entries = metadata != NULL ? metadata->n_entries : 0;
+    sources = g_new0 (ValueSource, n_entries + 1);
+    n_sources = 0;
+
+    for (i = 0; i < n_entries; i++)
+    {
+        entry = &METADATA_ENTRIES (metadata)[i];
+        if (entry->key == value->key)
+        {
+            continue;
+        }
+
+        sources[n_sources].key = entry->key;
+        if (entry->key & LIST_KEY)
+        {
+            offsets = get_list_offsets (metadata, entry);
+            sources[n_sources].n_values = offsets[0];
+            sources[n_sources].list = g_new (const char *, offsets[0]);
+            for (j = 0; j < offsets[0]; j++)
+            {
+                sources[n_sources].list[j] = METADATA_AT (metadata, offsets[j + 1]);
+            }
+        }
+        else
+        {
+            sources[n_sources].string = METADATA_AT (metadata, entry->offset);
+        }
+        n_sources++;
+    }
+
+    if (value->string != NULL || value->list != NULL)
+    {
+        sources[n_sources++] = *value;
+    }
+
+    new_metadata = metadata_new (sources, n_sources);
+
+    for (i = 0; i < n_sources; i++)
+    {
+        if (sources[i].list != value->list)
+        {
+            g_free (sources[i].list);
+        }
+    }
+    g_free (sources);
+
+    return new_metadata;
+}
+
+CajaFileMetadata *
+caja_file_metadata_set_string (const CajaFileMetadata *metadata,
+                               guint id,
+                               const char *value)
+{
+    ValueSource source = { 0 };
+
+    source.key = id;
+    source.string = value;
+
+    return metadata_replace (metadata, &source);
+}
+
+CajaFileMetadata *
+caja_file_metadata_set_list (const CajaFileMetadata *metadata,
+                             guint id,
+                             char **value)
+{
+    ValueSource source = { 0 };
+
+    source.key = id | LIST_KEY;
+    source.list = (const char **) value;
+    source.n_values = value != NULL ? g_strv_length (value) : 0;
+
+    return metadata_replace (metadata, &source);
+}
+
+const char *
+caja_file_metadata_get_string (const CajaFileMetadata *metadata,
+                               guint id)
+{
+    const MetadataEntry *entry;
+
+    entry = find_entry (metadata, id);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    return METADATA_AT (metadata, entry->offset);
+}
+
+gboolean
+caja_file_metadata_get_integer (const CajaFileMetadata *metadata,
+                                guint id,
+                                int *value)
+{
+    const MetadataEntry *entry;
+
+    entry = find_entry (metadata, id);
+    if (entry == NULL || !(entry->flags & VALUE_IS_INTEGER))
+    {
+        return FALSE;
+    }
+
+    *value = entry->integer;
+    return TRUE;
+}
+
+gboolean
+caja_file_metadata_get_boolean (const CajaFileMetadata *metadata,
+                                guint id,
+                                gboolean *value)
+{
+    const MetadataEntry *entry;
+
+    entry = find_entry (metadata, id);
+    if (entry == NULL || !(entry->flags & VALUE_IS_BOOLEAN))
+    {
+        return FALSE;
+    }
+
+    *value = (entry->flags & VALUE_IS_TRUE) != 0;
+    return TRUE;
+}
+
+GList *
+caja_file_metadata_get_list (const CajaFileMetadata *metadata,
+                             guint id)
+{
+    const MetadataEntry *entry;
+    const guint32 *offsets;
+    GList *list;
+    guint i;
+
+    entry = find_entry (metadata, id | LIST_KEY);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    offsets = get_list_offsets (metadata, entry);
+    list = NULL;
+    for (i = offsets[0]; i > 0; i--)
+    {
+        list = g_list_prepend (list, g_strdup (METADATA_AT (metadata, offsets[i])));
+    }
+
+    return list;
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static CajaFileMetadata *
+self_check_new_metadata (void)
+{
+    CajaFileMetadata *metadata;
+    GFileInfo *info;
+    char *emblems[] = { "important", "urgent", NULL };
+
+    info = g_file_info_new ();
+    g_file_info_set_attribute_string (info, "metadata::" CAJA_METADATA_KEY_ICON_SCALE, " 3 ");
+    g_file_info_set_attribute_string (info, "metadata::" CAJA_METADATA_KEY_ICON_VIEW_AUTO_LAYOUT, "TRUE");
+    g_file_info_set_attribute_string (info, "metadata::" CAJA_METADATA_KEY_ANNOTATION, "3 notes");
+    g_file_info_set_attribute_stringv (info, "metadata::" CAJA_METADATA_KEY_EMBLEMS, emblems);
+    g_file_info_set_attribute_string (info, "metadata::not-a-caja-key", "ignored");
+
+    metadata = caja_file_metadata_new_from_info (info);
+    g_object_unref (info);
+
+    return metadata;
+}
+
+static int
+self_check_get_integer (const char *key)
+{
+    CajaFileMetadata *metadata;
+    int value;
+
+    metadata = self_check_new_metadata ();
+    if (!caja_file_metadata_get_integer (metadata, caja_metadata_get_id (key), &value))
+    {
+        value = -1;
+    }
+    caja_file_metadata_free (metadata);
+
+    return value;
+}
+
+static char *
+self_check_get_list (void)
+{
+    CajaFileMetadata *metadata;
+    GList *list, *l;
+    GString *result;
+
+    metadata = self_check_new_metadata ();
+    list = caja_file_metadata_get_list (metadata, caja_metadata_get_id (CAJA_METADATA_KEY_EMBLEMS));
+    caja_file_metadata_free (metadata);
+
+    result = g_string_new (NULL);
+    for (l = list; l != NULL; l = l->next)
+    {
+        g_string_append_printf (result, "[%s]", (char *) l->data);
+    }
+    g_list_free_full (list, g_free);
+
+    return g_string_free (result, FALSE);
+}
+
+/* Setting a value and back gives the same bytes as never setting it. */
+static gboolean
+self_check_set_and_back (void)
+{
+    CajaFileMetadata *metadata, *changed, *back;
+    gboolean value, result;
+    guint id;
+
+    id = caja_metadata_get_id (CAJA_METADATA_KEY_ICON_VIEW_AUTO_LAYOUT);
+
+    metadata = self_check_new_metadata ();
+    changed = caja_file_metadata_set_string (metadata, id, "false");
+    back = caja_file_metadata_set_string (changed, id, "TRUE");
+
+    result = !caja_file_metadata_equal (metadata, changed) &&
+             caja_file_metadata_get_boolean (changed, id, &value) && !value &&
+             caja_file_metadata_equal (metadata, back);
+
+    caja_file_metadata_free (metadata);
+    caja_file_metadata_free (changed);
+    caja_file_metadata_free (back);
+
+    return result;
+}
+
+static gboolean
+self_check_unset_all (void)
+{
+    CajaFileMetadata *metadata;
+
+    metadata = caja_file_metadata_set_string (NULL,
+               caja_metadata_get_id (CAJA_METADATA_KEY_ANNOTATION), "note");
+    if (metadata == NULL)
+    {
+        return FALSE;
+    }
+    metadata = caja_file_metadata_set_string (metadata,
+               caja_metadata_get_id (CAJA_METADATA_KEY_ANNOTATION), NULL);
+
+    return metadata == NULL;
+}
+
+void
+caja_self_check_file_metadata (void)
+{
+    EEL_CHECK_INTEGER_RESULT (self_check_get_integer (CAJA_METADATA_KEY_ICON_SCALE), 3);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_integer (CAJA_METADATA_KEY_ANNOTATION), -1);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_integer (CAJA_METADATA_KEY_ICON_VIEW_AUTO_LAYOUT), -1);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_integer (CAJA_METADATA_KEY_CUSTOM_ICON), -1);
+    EEL_CHECK_STRING_RESULT (self_check_get_list (), "[important][urgent]");
+    EEL_CHECK_BOOLEAN_RESULT (self_check_set_and_back (), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_unset_all (), TRUE);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-file-metadata.h: The metadata values of a file.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_FILE_METADATA_H
+#define CAJA_FILE_METADATA_H
+
+#include <gio/gio.h>
+
+/* The values are keyed by the ids from caja_metadata_get_id, a key
+ * having a string value, a list value or both. They are kept sorted
+ * in one block of memory with no pointers in it, so copies compare
+ * with memcmp, and values that read as integers or booleans are
+ * parsed once, when the block is made. A block never changes; setting
+ * a value makes a new one.
+ */
+typedef struct CajaFileMetadata CajaFileMetadata;
+
+/* NULL when info has no metadata at all. */
+CajaFileMetadata *caja_file_metadata_new_from_info (GFileInfo              *info);
+void              caja_file_metadata_free          (CajaFileMetadata       *metadata);
+gboolean          caja_file_metadata_equal         (const CajaFileMetadata *a,
+        const CajaFileMetadata *b);
+
+/* Copies of metadata, which may be NULL, with the string or list value
+ * for id set, or unset when value is NULL.
+ */
+CajaFileMetadata *caja_file_metadata_set_string    (const CajaFileMetadata *metadata,
+        guint                   id,
+        const char             *value);
+CajaFileMetadata *caja_file_metadata_set_list      (const CajaFileMetadata *metadata,
+        guint                   id,
+        char                  **value);
+
+/* The string value for id, if any, and whether it is there and reads
+ * as an integer or as "true" or "false".
+ */
+const char *      caja_file_metadata_get_string    (const CajaFileMetadata *metadata,
+        guint                   id);
+gboolean          caja_file_metadata_get_integer   (const CajaFileMetadata *metadata,
+        guint                   id,
+        int                    *value);
+gboolean          caja_file_metadata_get_boolean   (const CajaFileMetadata *metadata,
+        guint                   id,
+        gboolean               *value);
+
+/* A copy of the list value for id, or NULL. */
+GList *           caja_file_metadata_get_list      (const CajaFileMetadata *metadata,
+        guint                   id);
+
+#endif /* CAJA_FILE_METADATA_H */
@@ -27,6 +27,7 @@
 
 #include <libcaja-private/caja-directory.h>
 #include <libcaja-private/caja-file.h>
+#include <libcaja-private/caja-file-metadata.h>
 #include <libcaja-private/caja-monitor.h>
 #include <eel/eel-glib-extensions.h>
 #include <eel/eel-string.h>
@@ -43,6 +44,12 @@
 #define CAJA_FILE_DEFAULT_ATTRIBUTES				\
 	"standard::*,access::*,mountable::*,time::*,unix::*,owner::*,selinux::*,thumbnail::*,id::filesystem,trash::orig-path,trash::deletion-date,metadata::*"
 
+/* The thumbnail::* attributes cost a few stat() calls per file, which
+ * the thumbnail index answers without once it is loaded.
+ */
+#define CAJA_FILE_DEFAULT_ATTRIBUTES_WITHOUT_THUMBNAIL		\
+	"standard::*,access::*,mountable::*,time::*,unix::*,owner::*,selinux::*,id::filesystem,trash::orig-path,trash::deletion-date,metadata::*"
+
 /* These are in the typical sort order. Known things come first, then
  * things where we can't know, finally things where we don't yet know.
  */
@@ -68,7 +75,11 @@ struct CajaFileDetails
     GFileType type;
 
     eel_ref_str display_name;
-    char *display_name_collation_key;
+    /* Collation key of display_name, computed on first comparison. The
+     * leading bytes live in the prefix; the tail is NULL when the whole
+     * key fits in the prefix. */
+    guint64 display_name_collation_prefix;
+    char *display_name_collation_tail;
     eel_ref_str edit_name;
 
     goffset size; /* -1 is unknown */
@@ -145,7 +156,11 @@ struct CajaFileDetails
     GHashTable *extension_attributes;
     GHashTable *pending_extension_attributes;
 
-    GHashTable *metadata;
+    CajaFileMetadata *metadata;
+    /* Metadata set but not yet written, and the writes under way;
+     * until both are done, metadata from file info is out of date. */
+    GFileInfo *pending_metadata;
+    guint metadata_writes_in_flight;
 
     /* Mount for mountpoint or the references GMount for a "mountable" */
     GMount *mount;
@@ -189,6 +204,7 @@ struct CajaFileDetails
     eel_boolean_bit link_info_is_up_to_date       : 1;
     eel_boolean_bit got_custom_display_name       : 1;
     eel_boolean_bit got_custom_activation_uri     : 1;
+    eel_boolean_bit display_name_collation_is_up_to_date : 1;
 
     eel_boolean_bit thumbnail_is_up_to_date       : 1;
     eel_boolean_bit thumbnail_wants_original      : 1;
@@ -271,6 +287,14 @@ gboolean      caja_file_update_name                    (CajaFile           *file
         const char             *name);
 gboolean      caja_file_update_metadata_from_info      (CajaFile           *file,
         GFileInfo              *info);
+/* Sets the metadata reads see, ahead of it being written; NULL unsets.
+ * Returns TRUE if it changed. */
+gboolean      caja_file_update_metadata                (CajaFile           *file,
+        const char             *key,
+        const char             *value);
+gboolean      caja_file_update_metadata_list           (CajaFile           *file,
+        const char             *key,
+        char                  **value);
 
 gboolean      caja_file_update_name_and_directory      (CajaFile           *file,
         const char             *name,
@@ -283,6 +307,9 @@ gboolean      caja_file_set_display_name               (CajaFile           *file
 void          caja_file_set_mount                      (CajaFile           *file,
         GMount                 *mount);
 
+/* The attributes to query for a file's info. */
+const char *  caja_file_get_default_attributes         (void);
+
 /* Return true if the top lefts of files in this directory should be
  * fetched, according to the preference settings.
  */
@@ -126,8 +126,31 @@ caja_file_queue_head (CajaFileQueue *queue)
     return CAJA_FILE (queue->head->data);
 }
 
+CajaFile *
+caja_file_queue_next (CajaFileQueue *queue,
+                      CajaFile *file)
+{
+    GList *link;
+
+    link = g_hash_table_lookup (queue->item_to_link_map, file);
+
+    if (link == NULL || link->next == NULL)
+    {
+        return NULL;
+    }
+
+    return CAJA_FILE (link->next->data);
+}
+
 gboolean
 caja_file_queue_is_empty (CajaFileQueue *queue)
 {
     return (queue->head == NULL);
 }
+
+gboolean
+caja_file_queue_contains (CajaFileQueue *queue,
+                          CajaFile *file)
+{
+    return g_hash_table_lookup (queue->item_to_link_map, file) != NULL;
+}
@@ -47,6 +47,13 @@ void               caja_file_queue_remove   (CajaFileQueue *queue,
 /* Get the file at the head of the queue without removing or unrefing it. */
 CajaFile *     caja_file_queue_head     (CajaFileQueue *queue);
 
+/* Get the file after file, or NULL if file is last or not on the queue. */
+CajaFile *     caja_file_queue_next     (CajaFileQueue *queue,
+        CajaFile      *file);
+
 gboolean           caja_file_queue_is_empty (CajaFileQueue *queue);
 
+gboolean           caja_file_queue_contains (CajaFileQueue *queue,
+        CajaFile      *file);
+
 #endif /* CAJA_FILE_CHANGES_QUEUE_H */
@@ -25,6 +25,7 @@
 #include <config.h>
 #include "caja-file.h"
 
+#include "caja-collation.h"
 #include "caja-directory-notify.h"
 #include "caja-directory-private.h"
 #include "caja-signaller.h"
@@ -42,6 +43,8 @@
 #include "caja-module.h"
 #include "caja-search-directory.h"
 #include "caja-search-directory-file.h"
+#include "caja-thumbnail-cache.h"
+#include "caja-thumbnail-index.h"
 #include "caja-thumbnails.h"
 #include "caja-ui-utilities.h"
 #include "caja-users-groups-cache.h"
@@ -98,7 +101,6 @@
 /* Name of Caja trash directories */
 #define TRASH_DIRECTORY_NAME ".Trash"
 
-#define METADATA_ID_IS_LIST_MASK (1<<31)
 
 typedef enum {
 	SHOW_HIDDEN = 1 << 0,
@@ -154,9 +156,7 @@ static char *   caja_file_get_type_as_string             (CajaFile          *fil
 static gboolean update_info_and_name                         (CajaFile          *file,
 							      GFileInfo             *info);
 static const char * caja_file_peek_display_name (CajaFile *file);
-static const char * caja_file_peek_display_name_collation_key (CajaFile *file);
 static void file_mount_unmounted (GMount *mount,  gpointer data);
-static void metadata_hash_free (GHashTable *hash);
 
 G_DEFINE_TYPE_WITH_CODE (CajaFile, caja_file, G_TYPE_OBJECT,
 			 G_IMPLEMENT_INTERFACE (CAJA_TYPE_FILE_INFO,
@@ -237,8 +237,7 @@ caja_file_set_display_name (CajaFile *file,
 			file->details->display_name = eel_ref_str_new (display_name);
 		}
 
-		g_free (file->details->display_name_collation_key);
-		file->details->display_name_collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+		file->details->display_name_collation_is_up_to_date = FALSE;
 	}
 
 	if (eel_strcmp (eel_ref_str_peek (file->details->edit_name), edit_name) != 0) {
@@ -261,153 +260,90 @@ caja_file_clear_display_name (CajaFile *file)
 {
 	eel_ref_str_unref (file->details->display_name);
 	file->details->display_name = NULL;
-	g_free (file->details->display_name_collation_key);
-	file->details->display_name_collation_key = NULL;
+	g_free (file->details->display_name_collation_tail);
+	file->details->display_name_collation_tail = NULL;
+	file->details->display_name_collation_is_up_to_date = FALSE;
 	eel_ref_str_unref (file->details->edit_name);
 	file->details->edit_name = NULL;
 }
 
-static gboolean
-foreach_metadata_free (gpointer  key,
-		       gpointer  value,
-		       gpointer  user_data)
-{
-	guint id;
-
-	id = GPOINTER_TO_UINT (key);
-
-	if (id & METADATA_ID_IS_LIST_MASK) {
-		g_strfreev ((char **)value);
-	} else {
-		g_free ((char *)value);
-	}
-	return TRUE;
-}
-
-
 static void
-metadata_hash_free (GHashTable *hash)
+clear_metadata (CajaFile *file)
 {
-	g_hash_table_foreach_remove (hash,
-				     foreach_metadata_free,
-				     NULL);
-	g_hash_table_destroy (hash);
+	caja_file_metadata_free (file->details->metadata);
+	file->details->metadata = NULL;
 }
 
-static gboolean
-metadata_hash_equal (GHashTable *hash1,
-		     GHashTable *hash2)
+gboolean
+caja_file_update_metadata_from_info (CajaFile *file,
+					 GFileInfo *info)
 {
-	GHashTableIter iter;
-	gpointer key1, value1, value2;
-	guint id;
+	CajaFileMetadata *metadata;
+	gboolean changed = FALSE;
 
-	if (hash1 == NULL && hash2 == NULL) {
-		return TRUE;
+	/* The file already has what is being written, which the info
+	 * may not have yet. */
+	if (file->details->pending_metadata != NULL ||
+	    file->details->metadata_writes_in_flight > 0) {
+		return FALSE;
 	}
 
-	if (hash1 == NULL || hash2 == NULL) {
-		return FALSE;
+	metadata = caja_file_metadata_new_from_info (info);
+	if (!caja_file_metadata_equal (metadata, file->details->metadata)) {
+		changed = TRUE;
+		clear_metadata (file);
+		file->details->metadata = metadata;
+	} else {
+		caja_file_metadata_free (metadata);
 	}
+	return changed;
+}
 
-	if (g_hash_table_size (hash1) !=
-	    g_hash_table_size (hash2)) {
+static gboolean
+set_metadata_in_memory (CajaFile *file,
+			CajaFileMetadata *metadata)
+{
+	if (caja_file_metadata_equal (metadata, file->details->metadata)) {
+		caja_file_metadata_free (metadata);
 		return FALSE;
 	}
 
-	g_hash_table_iter_init (&iter, hash1);
-	while (g_hash_table_iter_next (&iter, &key1, &value1)) {
-		value2 = g_hash_table_lookup (hash2, key1);
-		if (value2 == NULL) {
-			return FALSE;
-		}
-		id = GPOINTER_TO_UINT (key1);
-		if (id & METADATA_ID_IS_LIST_MASK) {
-			if (!eel_g_strv_equal ((char **)value1, (char **)value2)) {
-				return FALSE;
-			}
-		} else {
-			if (strcmp ((char *)value1, (char *)value2) != 0) {
-				return FALSE;
-			}
-		}
-	}
+	clear_metadata (file);
+	file->details->metadata = metadata;
 
 	return TRUE;
 }
 
-static void
-clear_metadata (CajaFile *file)
-{
-	if (file->details->metadata) {
-		metadata_hash_free (file->details->metadata);
-		file->details->metadata = NULL;
-	}
-}
-
-static GHashTable *
-get_metadata_from_info (GFileInfo *info)
+gboolean
+caja_file_update_metadata (CajaFile *file,
+			   const char *key,
+			   const char *value)
 {
-	GHashTable *metadata;
-	char **attrs;
 	guint id;
-	int i;
-	GFileAttributeType type;
-	gpointer value;
-
-	attrs = g_file_info_list_attributes (info, "metadata");
 
-	metadata = g_hash_table_new (NULL, NULL);
-
-	for (i = 0; attrs[i] != NULL; i++) {
-		id = caja_metadata_get_id (attrs[i] + strlen ("metadata::"));
-		if (id == 0) {
-			continue;
-		}
-
-		if (!g_file_info_get_attribute_data (info, attrs[i],
-						     &type, &value, NULL)) {
-			continue;
-		}
-
-		if (type == G_FILE_ATTRIBUTE_TYPE_STRING) {
-			g_hash_table_insert (metadata, GUINT_TO_POINTER (id),
-					     g_strdup ((char *)value));
-		} else if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
-			id |= METADATA_ID_IS_LIST_MASK;
-			g_hash_table_insert (metadata, GUINT_TO_POINTER (id),
-					     g_strdupv ((char **)value));
-		}
+	id = caja_metadata_get_id (key);
+	if (id == 0) {
+		return FALSE;
 	}
 
-	g_strfreev (attrs);
-
-	return metadata;
+	return set_metadata_in_memory
+		(file, caja_file_metadata_set_string (file->details->metadata, id, value));
 }
 
 gboolean
-caja_file_update_metadata_from_info (CajaFile *file,
-					 GFileInfo *info)
+caja_file_update_metadata_list (CajaFile *file,
+				const char *key,
+				char **value)
 {
-	gboolean changed = FALSE;
-
-	if (g_file_info_has_namespace (info, "metadata")) {
-		GHashTable *metadata;
+	guint id;
 
-		metadata = get_metadata_from_info (info);
-		if (!metadata_hash_equal (metadata,
-					  file->details->metadata)) {
-			changed = TRUE;
-			clear_metadata (file);
-			file->details->metadata = metadata;
-		} else {
-			metadata_hash_free (metadata);
-		}
-	} else if (file->details->metadata) {
-		changed = TRUE;
-		clear_metadata (file);
+	id = caja_metadata_get_id (key);
+	if (id == 0) {
+		return FALSE;
 	}
-	return changed;
+
+	return set_metadata_in_memory
+		(file, caja_file_metadata_set_list (file->details->metadata, id, value));
 }
 
 void
@@ -790,7 +726,7 @@ finalize (GObject *object)
 	caja_directory_unref (directory);
 	eel_ref_str_unref (file->details->name);
 	eel_ref_str_unref (file->details->display_name);
-	g_free (file->details->display_name_collation_key);
+	g_free (file->details->display_name_collation_tail);
 	eel_ref_str_unref (file->details->edit_name);
 	if (file->details->icon) {
 		g_object_unref (file->details->icon);
@@ -831,9 +767,7 @@ finalize (GObject *object)
 		g_hash_table_destroy (file->details->extension_attributes);
 	}
 
-	if (file->details->metadata) {
-		metadata_hash_free (file->details->metadata);
-	}
+	caja_file_metadata_free (file->details->metadata);
 
 	G_OBJECT_CLASS (caja_file_parent_class)->finalize (object);
 }
@@ -1770,7 +1704,7 @@ rename_callback (GObject *source_object,
 		caja_undostack_manager_data_set_rename_information(op->undo_redo_data, G_FILE (source_object), new_file);
 		// End UNDO-REDO
 		g_file_query_info_async (new_file,
-					 CAJA_FILE_DEFAULT_ATTRIBUTES,
+					 caja_file_get_default_attributes (),
 					 0,
 					 G_PRIORITY_DEFAULT,
 					 op->cancellable,
@@ -2101,7 +2035,8 @@ update_info_internal (CajaFile *file,
 	time_t trash_time;
 	GTimeVal g_trash_time;
 	const char * time_string;
-	const char *symlink_name, *mime_type, *selinux_context, *name, *thumbnail_path;
+	const char *symlink_name, *mime_type, *selinux_context, *name;
+	char *thumbnail_path, *uri;
 	GFileType file_type;
 	GIcon *icon;
 	char *old_activation_uri;
@@ -2410,14 +2345,23 @@ update_info_internal (CajaFile *file,
 		file->details->icon = g_object_ref (icon);
 	}
 
-	thumbnail_path =  g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH);
+	if (caja_thumbnail_index_is_loaded ()) {
+		uri = caja_file_get_uri (file);
+		thumbnail_path = caja_thumbnail_index_lookup (uri, &thumbnailing_failed);
+		g_free (uri);
+	} else {
+		thumbnail_path = g_strdup (g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH));
+		thumbnailing_failed = g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_THUMBNAILING_FAILED);
+	}
+
 	if (eel_strcmp (file->details->thumbnail_path, thumbnail_path) != 0) {
 		changed = TRUE;
 		g_free (file->details->thumbnail_path);
-		file->details->thumbnail_path = g_strdup (thumbnail_path);
+		file->details->thumbnail_path = thumbnail_path;
+	} else {
+		g_free (thumbnail_path);
 	}
 
-	thumbnailing_failed =  g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_THUMBNAILING_FAILED);
 	if (file->details->thumbnailing_failed != thumbnailing_failed) {
 		changed = TRUE;
 		file->details->thumbnailing_failed = thumbnailing_failed;
@@ -2855,11 +2799,28 @@ compare_by_size (CajaFile *file_1, CajaFile *file_2)
 	}
 }
 
+static void
+caja_file_ensure_display_name_collation_key (CajaFile *file)
+{
+	const char *name;
+
+	if (file->details->display_name_collation_is_up_to_date) {
+		return;
+	}
+
+	name = eel_ref_str_peek (file->details->display_name);
+
+	g_free (file->details->display_name_collation_tail);
+	caja_collation_key_split (name != NULL ? name : "",
+				  &file->details->display_name_collation_prefix,
+				  &file->details->display_name_collation_tail);
+	file->details->display_name_collation_is_up_to_date = TRUE;
+}
+
 static int
 compare_by_display_name (CajaFile *file_1, CajaFile *file_2)
 {
 	const char *name_1, *name_2;
-	const char *key_1, *key_2;
 	gboolean sort_last_1, sort_last_2;
 	int compare;
 
@@ -2874,9 +2835,12 @@ compare_by_display_name (CajaFile *file_1, CajaFile *file_2)
 	} else if (!sort_last_1 && sort_last_2) {
 		compare = -1;
 	} else {
-		key_1 = caja_file_peek_display_name_collation_key (file_1);
-		key_2 = caja_file_peek_display_name_collation_key (file_2);
-		compare = strcmp (key_1, key_2);
+		caja_file_ensure_display_name_collation_key (file_1);
+		caja_file_ensure_display_name_collation_key (file_2);
+		compare = caja_collation_key_compare (file_1->details->display_name_collation_prefix,
+						      file_1->details->display_name_collation_tail,
+						      file_2->details->display_name_collation_prefix,
+						      file_2->details->display_name_collation_tail);
 	}
 
 	return compare;
@@ -3489,8 +3453,7 @@ caja_file_get_metadata (CajaFile *file,
 			    const char *key,
 			    const char *default_metadata)
 {
-	guint id;
-	char *value;
+	const char *value;
 
 	g_return_val_if_fail (key != NULL, g_strdup (default_metadata));
 	g_return_val_if_fail (key[0] != '\0', g_strdup (default_metadata));
@@ -3502,8 +3465,8 @@ caja_file_get_metadata (CajaFile *file,
 
 	g_return_val_if_fail (CAJA_IS_FILE (file), g_strdup (default_metadata));
 
-	id = caja_metadata_get_id (key);
-	value = g_hash_table_lookup (file->details->metadata, GUINT_TO_POINTER (id));
+	value = caja_file_metadata_get_string (file->details->metadata,
+					       caja_metadata_get_id (key));
 
 	if (value) {
 		return g_strdup (value);
@@ -3515,11 +3478,6 @@ GList *
 caja_file_get_metadata_list (CajaFile *file,
 				 const char *key)
 {
-	GList *res;
-	guint id;
-	char **value;
-	int i;
-
 	g_return_val_if_fail (key != NULL, NULL);
 	g_return_val_if_fail (key[0] != '\0', NULL);
 
@@ -3530,20 +3488,8 @@ caja_file_get_metadata_list (CajaFile *file,
 
 	g_return_val_if_fail (CAJA_IS_FILE (file), NULL);
 
-	id = caja_metadata_get_id (key);
-	id |= METADATA_ID_IS_LIST_MASK;
-
-	value = g_hash_table_lookup (file->details->metadata, GUINT_TO_POINTER (id));
-
-	if (value) {
-		res = NULL;
-		for (i = 0; value[i] != NULL; i++) {
-			res = g_list_prepend (res, g_strdup (value[i]));
-		}
-		return g_list_reverse (res);
-	}
-
-	return NULL;
+	return caja_file_metadata_get_list (file->details->metadata,
+					    caja_metadata_get_id (key));
 }
 
 void
@@ -3601,8 +3547,8 @@ caja_file_get_boolean_metadata (CajaFile *file,
 				    const char   *key,
 				    gboolean      default_metadata)
 {
-	char *result_as_string;
 	gboolean result;
+	guint id;
 
 	g_return_val_if_fail (key != NULL, default_metadata);
 	g_return_val_if_fail (key[0] != '\0', default_metadata);
@@ -3613,21 +3559,16 @@ caja_file_get_boolean_metadata (CajaFile *file,
 
 	g_return_val_if_fail (CAJA_IS_FILE (file), default_metadata);
 
-	result_as_string = caja_file_get_metadata
-		(file, key, default_metadata ? "true" : "false");
-	g_assert (result_as_string != NULL);
-
-	if (g_ascii_strcasecmp (result_as_string, "true") == 0) {
-		result = TRUE;
-	} else if (g_ascii_strcasecmp (result_as_string, "false") == 0) {
-		result = FALSE;
-	} else {
+	/* Parsed when the metadata was read, so nothing to copy. */
+	id = caja_metadata_get_id (key);
+	if (caja_file_metadata_get_boolean (file->details->metadata, id, &result)) {
+		return result;
+	}
+	if (caja_file_metadata_get_string (file->details->metadata, id) != NULL) {
 		g_error ("boolean metadata with value other than true or false");
-		result = default_metadata;
 	}
 
-	g_free (result_as_string);
-	return result;
+	return default_metadata;
 }
 
 int
@@ -3635,10 +3576,7 @@ caja_file_get_integer_metadata (CajaFile *file,
 				    const char   *key,
 				    int           default_metadata)
 {
-	char *result_as_string;
-	char default_as_string[32];
 	int result;
-	char c;
 
 	g_return_val_if_fail (key != NULL, default_metadata);
 	g_return_val_if_fail (key[0] != '\0', default_metadata);
@@ -3648,20 +3586,10 @@ caja_file_get_integer_metadata (CajaFile *file,
 	}
 	g_return_val_if_fail (CAJA_IS_FILE (file), default_metadata);
 
-	g_snprintf (default_as_string, sizeof (default_as_string), "%d", default_metadata);
-	result_as_string = caja_file_get_metadata
-		(file, key, default_as_string);
-
-	/* Normally we can't get a a NULL, but we check for it here to
-	 * handle the oddball case of a non-existent directory.
-	 */
-	if (result_as_string == NULL) {
+	if (!caja_file_metadata_get_integer (file->details->metadata,
+					     caja_metadata_get_id (key),
+					     &result)) {
 		result = default_metadata;
-	} else {
-		if (sscanf (result_as_string, " %d %c", &result, &c) != 1) {
-			result = default_metadata;
-		}
-		g_free (result_as_string);
 	}
 
 	return result;
@@ -3759,18 +3687,6 @@ caja_file_set_integer_metadata (CajaFile *file,
 				    default_as_string, value_as_string);
 }
 
-static const char *
-caja_file_peek_display_name_collation_key (CajaFile *file)
-{
-	const char *res;
-
-	res = file->details->display_name_collation_key;
-	if (res == NULL)
-		res = "";
-
-	return res;
-}
-
 static const char *
 caja_file_peek_display_name (CajaFile *file)
 {
@@ -4693,11 +4609,119 @@ caja_file_get_trash_original_file_parent_as_string (CajaFile *file)
  * Returns: Newly allocated string ready to display to the user.
  *
  **/
+/* Unlimited-width date strings keyed by timestamp. Files unpacked from
+ * one archive or checked out together share their timestamps, so most
+ * lookups in a big directory skip the strftime work. The strings depend
+ * on the date format and, for the relative formats, on the current day,
+ * so the cache is flushed when either changes. Once full, the string
+ * used longest ago makes room for the new one.
+ */
+#define DATE_STRING_CACHE_MAX_SIZE 512
+
+typedef struct {
+	gint64 time;
+	char *string;
+	GList *link; /* in date_string_cache_recent_entries */
+} DateStringCacheEntry;
+
+/* Keyed by the time in each entry. The entries are in the queue too,
+ * most recently used first. */
+static GHashTable *date_string_cache;
+static GQueue date_string_cache_recent_entries = G_QUEUE_INIT;
+static int date_string_cache_format;
+static time_t date_string_cache_expiry;
+
+static void
+date_string_cache_entry_free (DateStringCacheEntry *entry)
+{
+	g_free (entry->string);
+	g_free (entry);
+}
+
+static void
+date_string_cache_clear (void)
+{
+	g_queue_clear (&date_string_cache_recent_entries);
+	g_hash_table_remove_all (date_string_cache);
+}
+
+static void
+date_string_cache_free (void)
+{
+	date_string_cache_clear ();
+	g_hash_table_destroy (date_string_cache);
+	date_string_cache = NULL;
+}
+
+static void
+date_string_cache_validate (void)
+{
+	time_t now;
+	struct tm midnight;
+
+	now = time (NULL);
+
+	if (date_string_cache == NULL) {
+		date_string_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+							   NULL, (GDestroyNotify) date_string_cache_entry_free);
+		eel_debug_call_at_shutdown (date_string_cache_free);
+	} else if (now < date_string_cache_expiry &&
+		   date_format_pref == date_string_cache_format) {
+		return;
+	}
+
+	date_string_cache_clear ();
+	date_string_cache_format = date_format_pref;
+
+	localtime_r (&now, &midnight);
+	midnight.tm_sec = 0;
+	midnight.tm_min = 0;
+	midnight.tm_hour = 0;
+	midnight.tm_mday++;
+	midnight.tm_isdst = -1;
+	date_string_cache_expiry = mktime (&midnight);
+}
+
 static char *
 caja_file_get_date_as_string (CajaFile *file, CajaDateType date_type)
 {
-	return caja_file_fit_date_as_string (file, date_type,
+	time_t file_time_raw;
+	gint64 key;
+	DateStringCacheEntry *entry;
+	char *result;
+
+	if (!caja_file_get_date (file, date_type, &file_time_raw)) {
+		return NULL;
+	}
+
+	date_string_cache_validate ();
+
+	key = file_time_raw;
+	entry = g_hash_table_lookup (date_string_cache, &key);
+	if (entry != NULL) {
+		g_queue_unlink (&date_string_cache_recent_entries, entry->link);
+		g_queue_push_head_link (&date_string_cache_recent_entries, entry->link);
+		return g_strdup (entry->string);
+	}
+
+	result = caja_file_fit_date_as_string (file, date_type,
 		0, NULL, NULL, NULL);
+
+	if (result != NULL) {
+		if (g_hash_table_size (date_string_cache) >= DATE_STRING_CACHE_MAX_SIZE) {
+			entry = g_queue_pop_tail (&date_string_cache_recent_entries);
+			g_hash_table_remove (date_string_cache, &entry->time);
+		}
+
+		entry = g_new (DateStringCacheEntry, 1);
+		entry->time = key;
+		entry->string = g_strdup (result);
+		g_hash_table_insert (date_string_cache, &entry->time, entry);
+		g_queue_push_head (&date_string_cache_recent_entries, entry);
+		entry->link = date_string_cache_recent_entries.head;
+	}
+
+	return result;
 }
 
 static CajaSpeedTradeoffValue show_directory_item_count;
@@ -5038,7 +5062,7 @@ set_attributes_callback (GObject *source_object,
 
 	if (res) {
 		g_file_query_info_async (G_FILE (source_object),
-					 CAJA_FILE_DEFAULT_ATTRIBUTES,
+					 caja_file_get_default_attributes (),
 					 0,
 					 G_PRIORITY_DEFAULT,
 					 op->cancellable,
@@ -7554,11 +7578,20 @@ invalidate_mount (CajaFile *file)
 void
 caja_file_invalidate_extension_info_internal (CajaFile *file)
 {
+	CajaDirectory *directory;
+
+	directory = file->details->directory;
+	if (directory != NULL)
+		caja_directory_count_waiting_info_providers (directory, file, -1);
+
 	if (file->details->pending_info_providers)
 		g_list_free_full (file->details->pending_info_providers, g_object_unref);
 
 	file->details->pending_info_providers =
 		caja_module_get_extensions_for_type (CAJA_TYPE_INFO_PROVIDER);
+
+	if (directory != NULL)
+		caja_directory_count_waiting_info_providers (directory, file, 1);
 }
 
 void
@@ -7690,6 +7723,16 @@ caja_file_get_all_attributes (void)
 		CAJA_FILE_ATTRIBUTE_MOUNT;
 }
 
+const char *
+caja_file_get_default_attributes (void)
+{
+	if (caja_thumbnail_index_is_loaded ()) {
+		return CAJA_FILE_DEFAULT_ATTRIBUTES_WITHOUT_THUMBNAIL;
+	}
+
+	return CAJA_FILE_DEFAULT_ATTRIBUTES;
+}
+
 void
 caja_file_invalidate_all_attributes (CajaFile *file)
 {
@@ -8183,6 +8226,17 @@ thumbnail_limit_changed_callback (gpointer user_data)
 	emit_change_signals_for_all_files_in_all_directories ();
 }
 
+static void
+thumbnail_cache_size_changed_callback (gpointer user_data)
+{
+	guint64 cache_size;
+
+	g_settings_get (caja_preferences,
+			CAJA_PREFERENCES_THUMBNAIL_CACHE_SIZE,
+			"t", &cache_size);
+	caja_thumbnail_cache_set_budget (MIN (cache_size, G_MAXSIZE));
+}
+
 static void
 thumbnail_size_changed_callback (gpointer user_data)
 {
@@ -8299,6 +8353,11 @@ caja_file_class_init (CajaFileClass *class)
 							  "changed::" CAJA_PREFERENCES_IMAGE_FILE_THUMBNAIL_LIMIT,
 							  G_CALLBACK (thumbnail_limit_changed_callback),
 							  NULL);
+	thumbnail_cache_size_changed_callback (NULL);
+	g_signal_connect_swapped (caja_preferences,
+				  "changed::" CAJA_PREFERENCES_THUMBNAIL_CACHE_SIZE,
+				  G_CALLBACK (thumbnail_cache_size_changed_callback),
+				  NULL);
 	thumbnail_size_changed_callback (NULL);
 	g_signal_connect_swapped (caja_icon_view_preferences,
 							  "changed::" CAJA_PREFERENCES_ICON_VIEW_THUMBNAIL_SIZE,
@@ -8310,6 +8369,9 @@ caja_file_class_init (CajaFileClass *class)
 							  G_CALLBACK (show_thumbnails_changed_callback),
 							  NULL);
 
+	/* Until this is loaded the thumbnail::* attributes are queried. */
+	caja_thumbnail_index_load ();
+
 	icon_theme = gtk_icon_theme_get_default ();
 	g_signal_connect_object (icon_theme,
 				 "changed",
@@ -0,0 +1,381 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-filename-matcher.c: Matching file names against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-filename-matcher.h"
+
+#include "caja-lib-self-check-functions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef struct
+{
+    char *text;
+    gsize length;
+    gboolean is_ascii;
+} MatcherWord;
+
+struct CajaFilenameMatcher
+{
+    /* Longest first, since those rule out the most names. */
+    MatcherWord *words;
+    int n_words;
+};
+
+static gboolean
+is_ascii (const char *text, gsize length)
+{
+    gsize i;
+
+    i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= length; i += 16)
+    {
+        if (_mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) (text + i))) != 0)
+        {
+            return FALSE;
+        }
+    }
+#endif
+    for (; i < length; i++)
+    {
+        if ((guchar) text[i] >= 0x80)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static int
+compare_words_by_length (gconstpointer a, gconstpointer b)
+{
+    const MatcherWord *word_a, *word_b;
+
+    word_a = a;
+    word_b = b;
+
+    if (word_a->length != word_b->length)
+    {
+        return word_a->length > word_b->length ? -1 : 1;
+    }
+    return 0;
+}
+
+CajaFilenameMatcher *
+caja_filename_matcher_new (const char *text)
+{
+    CajaFilenameMatcher *matcher;
+    char *normalized, *lower, **words;
+    MatcherWord *word;
+    int i;
+
+    g_return_val_if_fail (text != NULL, NULL);
+
+    normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+    lower = g_utf8_strdown (normalized, -1);
+    words = g_strsplit (lower, " ", -1);
+    g_free (lower);
+    g_free (normalized);
+
+    matcher = g_new0 (CajaFilenameMatcher, 1);
+    matcher->words = g_new0 (MatcherWord, g_strv_length (words));
+
+    /* Empty words, from runs of spaces, match everything. */
+    for (i = 0; words[i] != NULL; i++)
+    {
+        if (words[i][0] == '\0')
+        {
+            g_free (words[i]);
+            continue;
+        }
+
+        word = &matcher->words[matcher->n_words++];
+        word->text = words[i];
+        word->length = strlen (words[i]);
+        word->is_ascii = is_ascii (word->text, word->length);
+    }
+    g_free (words);
+
+    qsort (matcher->words, matcher->n_words, sizeof (MatcherWord),
+           compare_words_by_length);
+
+    return matcher;
+}
+
+void
+caja_filename_matcher_free (CajaFilenameMatcher *matcher)
+{
+    int i;
+
+    if (matcher == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        g_free (matcher->words[i].text);
+    }
+    g_free (matcher->words);
+    g_free (matcher);
+}
+
+int
+caja_filename_matcher_get_n_words (CajaFilenameMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, 0);
+
+    return matcher->n_words;
+}
+
+const char *
+caja_filename_matcher_get_word (CajaFilenameMatcher *matcher,
+                                int n,
+                                gsize *length)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+    g_return_val_if_fail (n >= 0 && n < matcher->n_words, NULL);
+
+    if (length != NULL)
+    {
+        *length = matcher->words[n].length;
+    }
+    return matcher->words[n].text;
+}
+
+static gboolean
+ascii_equal_lower (const char *text, const char *lower, gsize length)
+{
+    gsize i;
+
+    for (i = 0; i < length; i++)
+    {
+        if (g_ascii_tolower (text[i]) != lower[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+const char *
+caja_ascii_strcasestr_len (const char *haystack,
+                           gsize haystack_length,
+                           const char *needle,
+                           gsize needle_length)
+{
+    const char *last;
+    gsize i;
+    char first;
+
+    if (needle_length == 0)
+    {
+        return haystack;
+    }
+    if (needle_length > haystack_length)
+    {
+        return NULL;
+    }
+
+    /* Candidates are where the first character is, in either case;
+     * only those get compared in full. */
+    first = needle[0];
+    last = haystack + haystack_length - needle_length;
+    i = 0;
+#ifdef __SSE2__
+    {
+        __m128i lower, upper, block;
+        int mask, bit;
+
+        lower = _mm_set1_epi8 (first);
+        upper = _mm_set1_epi8 (g_ascii_toupper (first));
+
+        for (; i + 16 <= haystack_length - needle_length + 1; i += 16)
+        {
+            block = _mm_loadu_si128 ((const __m128i *) (haystack + i));
+            mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8 (block, lower),
+                                                    _mm_cmpeq_epi8 (block, upper)));
+            while (mask != 0)
+            {
+                bit = g_bit_nth_lsf (mask, -1);
+                if (ascii_equal_lower (haystack + i + bit + 1, needle + 1, needle_length - 1))
+                {
+                    return haystack + i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    for (; haystack + i <= last; i++)
+    {
+        if (g_ascii_tolower (haystack[i]) == first
+                && ascii_equal_lower (haystack + i + 1, needle + 1, needle_length - 1))
+        {
+            return haystack + i;
+        }
+    }
+
+    return NULL;
+}
+
+gboolean
+caja_filename_matcher_matches (CajaFilenameMatcher *matcher,
+                               const char *display_name)
+{
+    char *normalized, *lower_name;
+    gsize length;
+    gboolean hit;
+    int i;
+
+    g_return_val_if_fail (matcher != NULL, FALSE);
+    g_return_val_if_fail (display_name != NULL, FALSE);
+
+    if (matcher->n_words == 0)
+    {
+        return TRUE;
+    }
+
+    /* ASCII is its own normal form, and its lower case is plain
+     * ASCII too, so such names are matched where they are. */
+    length = strlen (display_name);
+    if (is_ascii (display_name, length))
+    {
+        for (i = 0; i < matcher->n_words; i++)
+        {
+            if (!matcher->words[i].is_ascii
+                    || caja_ascii_strcasestr_len (display_name, length,
+                                                  matcher->words[i].text,
+                                                  matcher->words[i].length) == NULL)
+            {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+
+    normalized = g_utf8_normalize (display_name, length, G_NORMALIZE_NFD);
+    if (normalized == NULL)
+    {
+        return FALSE;
+    }
+    lower_name = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    hit = TRUE;
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        if (strstr (lower_name, matcher->words[i].text) == NULL)
+        {
+            hit = FALSE;
+            break;
+        }
+    }
+    g_free (lower_name);
+
+    return hit;
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static gboolean
+self_check_matches (const char *text, const char *display_name)
+{
+    CajaFilenameMatcher *matcher;
+    gboolean matches;
+
+    matcher = caja_filename_matcher_new (text);
+    matches = caja_filename_matcher_matches (matcher, display_name);
+    caja_filename_matcher_free (matcher);
+
+    return matches;
+}
+
+/* The match position, or -1, for checking the vector code against
+ * plain comparisons at every offset. */
+static int
+self_check_find (const char *haystack, const char *needle)
+{
+    const char *found;
+
+    found = caja_ascii_strcasestr_len (haystack, strlen (haystack),
+                                       needle, strlen (needle));
+    return found == NULL ? -1 : found - haystack;
+}
+
+static gboolean
+self_check_find_everywhere (void)
+{
+    char haystack[64];
+    int length, position;
+
+    for (length = 1; length < (int) sizeof (haystack); length++)
+    {
+        for (position = 0; position + 3 <= length; position++)
+        {
+            memset (haystack, 'a', length);
+            haystack[length] = '\0';
+            memcpy (haystack + position, "XyZ", 3);
+            if (self_check_find (haystack, "xyz") != position)
+            {
+                return FALSE;
+            }
+            /* A near miss at the end isn't read past. */
+            haystack[position + 2] = 'q';
+            if (self_check_find (haystack, "xyz") != -1)
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+void
+caja_self_check_filename_matcher (void)
+{
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("Annual Report.odt", "report"), 7);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("Annual Report.odt", "reports"), -1);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("rreport", "report"), 1);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("abc", ""), 0);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("", "a"), -1);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("a[b@c", "[b@"), 1);
+    EEL_CHECK_INTEGER_RESULT (self_check_find ("A{B", "a[b"), -1);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_find_everywhere (), TRUE);
+
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("", "anything"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("report", "Annual REPORT.odt"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("annual  odt", "Annual Report.odt"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("annual pdf", "Annual Report.odt"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("Café", "cafe.txt"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("café", "Le CAFÉ.txt"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("cafe", "Le CAFÉ.txt"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_matches ("café", "Le Cafe\xcc\x81.txt"), TRUE);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
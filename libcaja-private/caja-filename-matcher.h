@@ -0,0 +1,53 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-filename-matcher.h: Matching file names against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_FILENAME_MATCHER_H
+#define CAJA_FILENAME_MATCHER_H
+
+#include <glib.h>
+
+typedef struct CajaFilenameMatcher CajaFilenameMatcher;
+
+/* A name matches when, normalized and in lower case, it contains each
+ * of the space separated words of the text. A matcher never changes
+ * once made, so one can be used from several threads at once.
+ */
+CajaFilenameMatcher *caja_filename_matcher_new     (const char          *text);
+void                 caja_filename_matcher_free    (CajaFilenameMatcher *matcher);
+gboolean             caja_filename_matcher_matches (CajaFilenameMatcher *matcher,
+        const char          *display_name);
+
+/* The words names are matched against, normalized and in lower case,
+ * longest first, for looking them up in an index.
+ */
+int                  caja_filename_matcher_get_n_words (CajaFilenameMatcher *matcher);
+const char *         caja_filename_matcher_get_word    (CajaFilenameMatcher *matcher,
+        int                  n,
+        gsize               *length);
+
+/* Finds needle, which is lower case ASCII, in the first haystack_length
+ * bytes of haystack, ignoring the case of ASCII letters.
+ */
+const char *         caja_ascii_strcasestr_len     (const char          *haystack,
+        gsize                haystack_length,
+        const char          *needle,
+        gsize                needle_length);
+
+#endif /* CAJA_FILENAME_MATCHER_H */
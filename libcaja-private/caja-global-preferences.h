@@ -183,6 +183,8 @@ typedef enum
 #define CAJA_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS "show-directory-item-counts"
 #define CAJA_PREFERENCES_SHOW_IMAGE_FILE_THUMBNAILS	"show-image-thumbnails"
 #define CAJA_PREFERENCES_IMAGE_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
+#define CAJA_PREFERENCES_THUMBNAIL_CACHE_SIZE	"thumbnail-cache-size"
+#define CAJA_PREFERENCES_SEARCH_INDEX_ROOTS	"search-index-roots"
 #define CAJA_PREFERENCES_PREVIEW_SOUND		        "preview-sound"
 
     typedef enum
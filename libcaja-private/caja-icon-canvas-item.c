@@ -1650,6 +1650,12 @@ caja_icon_canvas_item_set_is_visible (CajaIconCanvasItem       *item,
     }
 }
 
+gboolean
+caja_icon_canvas_item_get_is_visible (CajaIconCanvasItem       *item)
+{
+    return item->details->is_visible;
+}
+
 void
 caja_icon_canvas_item_invalidate_label (CajaIconCanvasItem     *item)
 {
@@ -1964,12 +1970,12 @@ real_map_pixbuf (CajaIconCanvasItem *icon_item)
 
         if (render_mode > 0 || saturation < 255 || brightness < 255)
         {
-            temp_pixbuf = eel_gdk_pixbuf_render (temp_pixbuf,
-                                                 render_mode,
-                                                 saturation,
-                                                 brightness,
-                                                 lighten,
-                                                 container->details->prelight_icon_color_rgba);
+            temp_pixbuf = eel_gdk_pixbuf_render_shared (temp_pixbuf,
+                          render_mode,
+                          saturation,
+                          brightness,
+                          lighten,
+                          container->details->prelight_icon_color_rgba);
             g_object_unref (old_pixbuf);
         }
 
@@ -2000,9 +2006,14 @@ real_map_pixbuf (CajaIconCanvasItem *icon_item)
                 audio_pixbuf = NULL;
             }
 
-            /* Composite it onto the icon. */
+            /* Composite it onto a copy of the icon, which is
+             * shared with the other items showing it. */
             if (audio_pixbuf != NULL)
             {
+                old_pixbuf = temp_pixbuf;
+                temp_pixbuf = gdk_pixbuf_copy (old_pixbuf);
+                g_object_unref (old_pixbuf);
+
                 gdk_pixbuf_composite
                 (audio_pixbuf,
                  temp_pixbuf,
@@ -2029,7 +2040,7 @@ real_map_pixbuf (CajaIconCanvasItem *icon_item)
 
         color =  gtk_widget_has_focus (GTK_WIDGET (canvas)) ? CAJA_ICON_CONTAINER (canvas)->details->highlight_color_rgba : CAJA_ICON_CONTAINER (canvas)->details->active_color_rgba;
 
-        temp_pixbuf = eel_create_colorized_pixbuf (temp_pixbuf,
+        temp_pixbuf = eel_get_shared_colorized_pixbuf (temp_pixbuf,
                       EEL_RGBA_COLOR_GET_R (color),
                       EEL_RGBA_COLOR_GET_G (color),
                       EEL_RGBA_COLOR_GET_B (color));
@@ -2053,12 +2064,12 @@ real_map_pixbuf (CajaIconCanvasItem *icon_item)
         if (render_mode > 0 || saturation < 255 || brightness < 255)
         {
             /* if theme requests colorization */
-            temp_pixbuf = eel_gdk_pixbuf_render (temp_pixbuf,
-                                                 render_mode,
-                                                 saturation,
-                                                 brightness,
-                                                 lighten,
-                                                 container->details->normal_icon_color_rgba);
+            temp_pixbuf = eel_gdk_pixbuf_render_shared (temp_pixbuf,
+                          render_mode,
+                          saturation,
+                          brightness,
+                          lighten,
+                          container->details->normal_icon_color_rgba);
             g_object_unref (old_pixbuf);
         }
     }
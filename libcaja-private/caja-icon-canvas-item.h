@@ -116,6 +116,7 @@ extern "C" {
             double i2w_dx, double i2w_dy);
     void        caja_icon_canvas_item_set_is_visible           (CajaIconCanvasItem       *item,
             gboolean                      visible);
+    gboolean    caja_icon_canvas_item_get_is_visible           (CajaIconCanvasItem       *item);
     /* whether the entire label text must be visible at all times */
     void        caja_icon_canvas_item_set_entire_text          (CajaIconCanvasItem       *icon_item,
             gboolean                      entire_text);
@@ -7547,6 +7547,19 @@ caja_icon_container_prioritize_thumbnailing (CajaIconContainer *container,
     klass->prioritize_thumbnailing (container, icon->data);
 }
 
+static void
+caja_icon_container_deprioritize_thumbnailing (CajaIconContainer *container,
+        CajaIcon *icon)
+{
+    CajaIconContainerClass *klass;
+
+    klass = CAJA_ICON_CONTAINER_GET_CLASS (container);
+    if (klass->deprioritize_thumbnailing != NULL)
+    {
+        klass->deprioritize_thumbnailing (container, icon->data);
+    }
+}
+
 static void
 caja_icon_container_update_visible_icons (CajaIconContainer *container)
 {
@@ -7610,9 +7623,11 @@ caja_icon_container_update_visible_icons (CajaIconContainer *container)
                 caja_icon_container_prioritize_thumbnailing (container,
                         icon);
             }
-            else
+            else if (caja_icon_canvas_item_get_is_visible (icon->item))
             {
                 caja_icon_canvas_item_set_is_visible (icon->item, FALSE);
+                caja_icon_container_deprioritize_thumbnailing (container,
+                        icon);
             }
         }
     }
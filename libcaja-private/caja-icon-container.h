@@ -176,6 +176,9 @@ typedef struct
             gconstpointer client);
     void         (* prioritize_thumbnailing)  (CajaIconContainer *container,
             CajaIconData *data);
+    /* Optional, called when a visible icon scrolls out of view. */
+    void         (* deprioritize_thumbnailing) (CajaIconContainer *container,
+            CajaIconData *data);
 
     /* Queries on icons for subclass/client.
      * These must be implemented => These are signals !
@@ -27,6 +27,22 @@
 #include <gio/gio.h>
 #include <eel/eel-gdk-pixbuf-extensions.h>
 
+/* How many differently scaled copies of its pixbuf an icon keeps,
+   enough for the sizes of a view, the sidebar and the path bar. */
+#define MAX_SCALED_PIXBUFS 4
+
+typedef struct
+{
+    gsize size;
+    GdkPixbuf *pixbuf;
+} ScaledPixbuf;
+
+typedef struct
+{
+    char *filename;
+    int size;
+} ThemedIconKey;
+
 struct _CajaIconInfo
 {
     GObject parent;
@@ -35,6 +51,13 @@ struct _CajaIconInfo
     guint64 last_use_time;
     GdkPixbuf *pixbuf;
 
+    /* Most recently used first. */
+    ScaledPixbuf scaled_pixbufs[MAX_SCALED_PIXBUFS];
+    int n_scaled_pixbufs;
+
+    /* Set if this is shared by the themed icons loading the same file. */
+    ThemedIconKey *themed_key;
+
     gboolean got_embedded_rect;
     GdkRectangle embedded_rect;
     gint n_attach_points;
@@ -48,7 +71,7 @@ struct _CajaIconInfoClass
     GObjectClass parent_class;
 };
 
-static void schedule_reap_cache (void);
+static void themed_icon_info_forget (CajaIconInfo *icon);
 
 G_DEFINE_TYPE (CajaIconInfo,
                caja_icon_info,
@@ -81,7 +104,6 @@ pixbuf_toggle_notify (gpointer      info,
                                     pixbuf_toggle_notify,
                                     info);
         icon->last_use_time = g_thread_gettime ();
-        schedule_reap_cache ();
     }
 }
 
@@ -89,9 +111,20 @@ static void
 caja_icon_info_finalize (GObject *object)
 {
     CajaIconInfo *icon;
+    int i;
 
     icon = CAJA_ICON_INFO (object);
 
+    if (icon->themed_key != NULL)
+    {
+        themed_icon_info_forget (icon);
+    }
+
+    for (i = 0; i < icon->n_scaled_pixbufs; i++)
+    {
+        g_object_unref (icon->scaled_pixbufs[i].pixbuf);
+    }
+
     if (!icon->sole_owner && icon->pixbuf)
     {
         g_object_remove_toggle_ref (G_OBJECT (icon->pixbuf),
@@ -176,143 +209,165 @@ caja_icon_info_new_for_icon_info (GtkIconInfo *icon_info)
 }
 
 
+/* Icons are cached by the GIcon and size they were looked up with, so
+ * a lookup that hits doesn't go to the icon theme. Themed icons that
+ * resolve to the same file share their CajaIconInfo.
+ *
+ * The entries are kept in least recently used order and reaped from the
+ * front, a few at a time, once they went unused for a while. Entries
+ * whose pixbuf is still held elsewhere go to the back again.
+ */
 typedef struct
 {
     GIcon *icon;
     int size;
-} LoadableIconKey;
-
-typedef struct
-{
-    char *filename;
-    int size;
-} ThemedIconKey;
+    CajaIconInfo *info;
+    guint64 last_use_time;
+    GList *link;
+} IconCacheEntry;
 
-static GHashTable *loadable_icon_cache = NULL;
+static GHashTable *icon_cache = NULL;
+static GQueue icon_cache_lru = G_QUEUE_INIT;
+/* (ThemedIconKey, CajaIconInfo), not holding references to either; an
+   icon removes itself when finalized. */
 static GHashTable *themed_icon_cache = NULL;
 static guint reap_cache_timeout = 0;
 
 #define NSEC_PER_SEC ((guint64)1000000000L)
 
-static guint time_now;
+/* How long an icon stays cached after it was last used. */
+#define REAP_AFTER_SECS 30
+
+/* The most entries looked at each time the reaper runs. */
+#define REAP_BATCH_SIZE 64
+
+static void schedule_reap_cache (guint64 now);
+
+static void
+icon_cache_entry_free (IconCacheEntry *entry)
+{
+    g_object_unref (entry->icon);
+    g_object_unref (entry->info);
+    g_slice_free (IconCacheEntry, entry);
+}
+
+static void
+icon_cache_remove (IconCacheEntry *entry)
+{
+    g_queue_delete_link (&icon_cache_lru, entry->link);
+    g_hash_table_remove (icon_cache, entry);
+    icon_cache_entry_free (entry);
+}
+
+static void
+icon_cache_touch (IconCacheEntry *entry,
+                  guint64 now)
+{
+    entry->last_use_time = now;
+    g_queue_unlink (&icon_cache_lru, entry->link);
+    g_queue_push_tail_link (&icon_cache_lru, entry->link);
+}
 
 static gboolean
-reap_old_icon (gpointer  key,
-               gpointer  value,
-               gpointer  user_info)
+reap_cache (gpointer data)
 {
-    CajaIconInfo *icon = value;
-    gboolean *reapable_icons_left = user_info;
+    IconCacheEntry *entry;
+    guint64 now;
+    int i;
+
+    reap_cache_timeout = 0;
 
-    if (icon->sole_owner)
+    now = g_thread_gettime ();
+
+    for (i = 0; i < REAP_BATCH_SIZE; i++)
     {
-        if (time_now - icon->last_use_time > 30 * NSEC_PER_SEC)
+        entry = g_queue_peek_head (&icon_cache_lru);
+        if (entry == NULL ||
+                now - entry->last_use_time < REAP_AFTER_SECS * NSEC_PER_SEC)
         {
-            /* This went unused 30 secs ago. reap */
-            return TRUE;
+            break;
+        }
+
+        if (entry->info->sole_owner &&
+                now - entry->info->last_use_time >= REAP_AFTER_SECS * NSEC_PER_SEC)
+        {
+            icon_cache_remove (entry);
         }
         else
         {
-            /* We can reap this soon */
-            *reapable_icons_left = TRUE;
+            /* Still in use, look again later. */
+            icon_cache_touch (entry, now);
         }
     }
 
+    schedule_reap_cache (now);
+
     return FALSE;
 }
 
-static gboolean
-reap_cache (gpointer data)
+/* Wakes up when the least recently used entry is due. */
+static void
+schedule_reap_cache (guint64 now)
 {
-    gboolean reapable_icons_left;
-
-    reapable_icons_left = TRUE;
-
-    time_now = g_thread_gettime ();
-
-    if (loadable_icon_cache)
-    {
-        g_hash_table_foreach_remove (loadable_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
-    }
+    IconCacheEntry *entry;
+    guint64 due;
+    guint seconds;
 
-    if (themed_icon_cache)
+    if (reap_cache_timeout != 0)
     {
-        g_hash_table_foreach_remove (themed_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
+        return;
     }
 
-    if (reapable_icons_left)
-    {
-        return TRUE;
-    }
-    else
+    entry = g_queue_peek_head (&icon_cache_lru);
+    if (entry == NULL)
     {
-        reap_cache_timeout = 0;
-        return FALSE;
+        return;
     }
-}
 
-static void
-schedule_reap_cache (void)
-{
-    if (reap_cache_timeout == 0)
-    {
-        reap_cache_timeout = g_timeout_add_seconds_full (0, 5,
-                             reap_cache,
-                             NULL, NULL);
-    }
+    due = entry->last_use_time + REAP_AFTER_SECS * NSEC_PER_SEC;
+    seconds = due > now ? (due - now + NSEC_PER_SEC - 1) / NSEC_PER_SEC : 0;
+    reap_cache_timeout = g_timeout_add_seconds_full (0, seconds,
+                         reap_cache,
+                         NULL, NULL);
 }
 
 void
 caja_icon_info_clear_caches (void)
 {
-    if (loadable_icon_cache)
+    IconCacheEntry *entry;
+
+    while ((entry = g_queue_pop_head (&icon_cache_lru)) != NULL)
     {
-        g_hash_table_remove_all (loadable_icon_cache);
+        g_hash_table_remove (icon_cache, entry);
+        icon_cache_entry_free (entry);
     }
 
     if (themed_icon_cache)
     {
         g_hash_table_remove_all (themed_icon_cache);
     }
+
+    if (reap_cache_timeout != 0)
+    {
+        g_source_remove (reap_cache_timeout);
+        reap_cache_timeout = 0;
+    }
 }
 
 static guint
-loadable_icon_key_hash (LoadableIconKey *key)
+icon_cache_entry_hash (const IconCacheEntry *entry)
 {
-    return g_icon_hash (key->icon) ^ key->size;
+    return g_icon_hash (entry->icon) ^ entry->size;
 }
 
 static gboolean
-loadable_icon_key_equal (const LoadableIconKey *a,
-                         const LoadableIconKey *b)
+icon_cache_entry_equal (const IconCacheEntry *a,
+                        const IconCacheEntry *b)
 {
     return a->size == b->size &&
            g_icon_equal (a->icon, b->icon);
 }
 
-static LoadableIconKey *
-loadable_icon_key_new (GIcon *icon, int size)
-{
-    LoadableIconKey *key;
-
-    key = g_slice_new (LoadableIconKey);
-    key->icon = g_object_ref (icon);
-    key->size = size;
-
-    return key;
-}
-
-static void
-loadable_icon_key_free (LoadableIconKey *key)
-{
-    g_object_unref (key->icon);
-    g_slice_free (LoadableIconKey, key);
-}
-
 static guint
 themed_icon_key_hash (ThemedIconKey *key)
 {
@@ -346,132 +401,186 @@ themed_icon_key_free (ThemedIconKey *key)
     g_slice_free (ThemedIconKey, key);
 }
 
-CajaIconInfo *
-caja_icon_info_lookup (GIcon *icon,
-                       int size)
+static void
+themed_icon_info_forget (CajaIconInfo *icon)
+{
+    if (themed_icon_cache != NULL &&
+            g_hash_table_lookup (themed_icon_cache, icon->themed_key) == icon)
+    {
+        g_hash_table_remove (themed_icon_cache, icon->themed_key);
+    }
+
+    themed_icon_key_free (icon->themed_key);
+    icon->themed_key = NULL;
+}
+
+static CajaIconInfo *
+load_loadable_icon (GIcon *icon,
+                    int size)
 {
-    CajaIconInfo *icon_info;
     GdkPixbuf *pixbuf;
+    GInputStream *stream;
+    CajaIconInfo *icon_info;
 
-    if (G_IS_LOADABLE_ICON (icon))
+    pixbuf = NULL;
+    stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
+                                   size,
+                                   NULL, NULL, NULL);
+    if (stream)
     {
-        LoadableIconKey lookup_key;
-        LoadableIconKey *key;
-        GInputStream *stream;
+        pixbuf = eel_gdk_pixbuf_load_from_stream_at_size (stream, size);
+        g_object_unref (stream);
+    }
 
-        if (loadable_icon_cache == NULL)
-        {
-            loadable_icon_cache =
-                g_hash_table_new_full ((GHashFunc)loadable_icon_key_hash,
-                                       (GEqualFunc)loadable_icon_key_equal,
-                                       (GDestroyNotify) loadable_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
-        }
+    icon_info = caja_icon_info_new_for_pixbuf (pixbuf);
 
-        lookup_key.icon = icon;
-        lookup_key.size = size;
+    if (pixbuf)
+    {
+        g_object_unref (pixbuf);
+    }
 
-        icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
-        if (icon_info)
-        {
-            return g_object_ref (icon_info);
-        }
+    return icon_info;
+}
 
-        pixbuf = NULL;
-        stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
-                                       size,
-                                       NULL, NULL, NULL);
-        if (stream)
-        {
-            pixbuf = eel_gdk_pixbuf_load_from_stream_at_size (stream, size);
-            g_object_unref (stream);
-        }
+static CajaIconInfo *
+load_themed_icon (GIcon *icon,
+                  int size)
+{
+    const char * const *names;
+    ThemedIconKey lookup_key;
+    GtkIconTheme *icon_theme;
+    GtkIconInfo *gtkicon_info;
+    CajaIconInfo *icon_info;
+    const char *filename;
 
-        icon_info = caja_icon_info_new_for_pixbuf (pixbuf);
+    if (themed_icon_cache == NULL)
+    {
+        themed_icon_cache =
+            g_hash_table_new ((GHashFunc)themed_icon_key_hash,
+                              (GEqualFunc)themed_icon_key_equal);
+    }
 
-        key = loadable_icon_key_new (icon, size);
-        g_hash_table_insert (loadable_icon_cache, key, icon_info);
+    names = g_themed_icon_get_names (G_THEMED_ICON (icon));
 
-        return g_object_ref (icon_info);
-    }
-    else if (G_IS_THEMED_ICON (icon))
-    {
-        const char * const *names;
-        ThemedIconKey lookup_key;
-        ThemedIconKey *key;
-        GtkIconTheme *icon_theme;
-        GtkIconInfo *gtkicon_info;
-        const char *filename;
+    icon_theme = gtk_icon_theme_get_default ();
+    gtkicon_info = gtk_icon_theme_choose_icon (icon_theme, (const char **)names, size, 0);
 
-        if (themed_icon_cache == NULL)
-        {
-            themed_icon_cache =
-                g_hash_table_new_full ((GHashFunc)themed_icon_key_hash,
-                                       (GEqualFunc)themed_icon_key_equal,
-                                       (GDestroyNotify) themed_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
-        }
+    if (gtkicon_info == NULL)
+    {
+        return caja_icon_info_new_for_pixbuf (NULL);
+    }
 
-        names = g_themed_icon_get_names (G_THEMED_ICON (icon));
+    filename = gtk_icon_info_get_filename (gtkicon_info);
 
-        icon_theme = gtk_icon_theme_get_default ();
-        gtkicon_info = gtk_icon_theme_choose_icon (icon_theme, (const char **)names, size, 0);
+    /* 96_no-null-in-g-str-hash.patch from ubuntu natty nautilus
+    https://bugs.launchpad.net/ubuntu/+source/nautilus/+bug/718098 */
+    if (filename == NULL) {
+        gtk_icon_info_free (gtkicon_info);
+        return caja_icon_info_new_for_pixbuf (NULL);
+    }
+    /* patch end */
 
-        if (gtkicon_info == NULL)
-        {
-            return caja_icon_info_new_for_pixbuf (NULL);
-        }
+    lookup_key.filename = (char *)filename;
+    lookup_key.size = size;
 
-        filename = gtk_icon_info_get_filename (gtkicon_info);
+    icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
+    if (icon_info)
+    {
+        gtk_icon_info_free (gtkicon_info);
+        return g_object_ref (icon_info);
+    }
 
-        /* 96_no-null-in-g-str-hash.patch from ubuntu natty nautilus
-        https://bugs.launchpad.net/ubuntu/+source/nautilus/+bug/718098 */
-        if (filename == NULL) {
-            gtk_icon_info_free (gtkicon_info);
-            return caja_icon_info_new_for_pixbuf (NULL);
-        }
-        /* patch end */
+    icon_info = caja_icon_info_new_for_icon_info (gtkicon_info);
 
-        lookup_key.filename = (char *)filename;
-        lookup_key.size = size;
+    icon_info->themed_key = themed_icon_key_new (filename, size);
+    g_hash_table_insert (themed_icon_cache, icon_info->themed_key, icon_info);
 
-        icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
-        if (icon_info)
-        {
-            gtk_icon_info_free (gtkicon_info);
-            return g_object_ref (icon_info);
-        }
+    gtk_icon_info_free (gtkicon_info);
 
-        icon_info = caja_icon_info_new_for_icon_info (gtkicon_info);
+    return icon_info;
+}
 
-        key = themed_icon_key_new (filename, size);
-        g_hash_table_insert (themed_icon_cache, key, icon_info);
+static CajaIconInfo *
+load_icon (GIcon *icon,
+           int size)
+{
+    GdkPixbuf *pixbuf;
+    GtkIconInfo *gtk_icon_info;
+    CajaIconInfo *icon_info;
 
-        gtk_icon_info_free (gtkicon_info);
+    if (G_IS_LOADABLE_ICON (icon))
+    {
+        return load_loadable_icon (icon, size);
+    }
+    else if (G_IS_THEMED_ICON (icon))
+    {
+        return load_themed_icon (icon, size);
+    }
 
-        return g_object_ref (icon_info);
+    gtk_icon_info = gtk_icon_theme_lookup_by_gicon (gtk_icon_theme_get_default (),
+                    icon,
+                    size,
+                    GTK_ICON_LOOKUP_GENERIC_FALLBACK);
+    if (gtk_icon_info != NULL)
+    {
+        pixbuf = gtk_icon_info_load_icon (gtk_icon_info, NULL);
+        gtk_icon_info_free (gtk_icon_info);
     }
     else
     {
-        GdkPixbuf *pixbuf;
-        GtkIconInfo *gtk_icon_info;
+        pixbuf = NULL;
+    }
 
-        gtk_icon_info = gtk_icon_theme_lookup_by_gicon (gtk_icon_theme_get_default (),
-                        icon,
-                        size,
-                        GTK_ICON_LOOKUP_GENERIC_FALLBACK);
-        if (gtk_icon_info != NULL)
-        {
-            pixbuf = gtk_icon_info_load_icon (gtk_icon_info, NULL);
-            gtk_icon_info_free (gtk_icon_info);
-        }
-        else
-        {
-            pixbuf = NULL;
-        }
+    icon_info = caja_icon_info_new_for_pixbuf (pixbuf);
+
+    if (pixbuf)
+    {
+        g_object_unref (pixbuf);
+    }
+
+    return icon_info;
+}
+
+CajaIconInfo *
+caja_icon_info_lookup (GIcon *icon,
+                       int size)
+{
+    IconCacheEntry lookup_entry;
+    IconCacheEntry *entry;
+    guint64 now;
+
+    if (icon_cache == NULL)
+    {
+        icon_cache =
+            g_hash_table_new ((GHashFunc)icon_cache_entry_hash,
+                              (GEqualFunc)icon_cache_entry_equal);
+    }
+
+    now = g_thread_gettime ();
 
-        return caja_icon_info_new_for_pixbuf (pixbuf);
+    lookup_entry.icon = icon;
+    lookup_entry.size = size;
+
+    entry = g_hash_table_lookup (icon_cache, &lookup_entry);
+    if (entry != NULL)
+    {
+        icon_cache_touch (entry, now);
+        return g_object_ref (entry->info);
     }
+
+    entry = g_slice_new (IconCacheEntry);
+    entry->icon = g_object_ref (icon);
+    entry->size = size;
+    entry->info = load_icon (icon, size);
+    entry->last_use_time = now;
+
+    g_queue_push_tail (&icon_cache_lru, entry);
+    entry->link = g_queue_peek_tail_link (&icon_cache_lru);
+    g_hash_table_insert (icon_cache, entry, entry);
+
+    schedule_reap_cache (now);
+
+    return g_object_ref (entry->info);
 }
 
 CajaIconInfo *
@@ -551,33 +660,76 @@ caja_icon_info_get_pixbuf (CajaIconInfo *icon)
     return res;
 }
 
-GdkPixbuf *
-caja_icon_info_get_pixbuf_nodefault_at_size (CajaIconInfo  *icon,
-        gsize              forced_size)
+/* Scaled copies are kept with the icon, so all the views showing it at
+   the same size share one, and don't scale it again. */
+static GdkPixbuf *
+get_scaled_pixbuf (CajaIconInfo *icon,
+                   gsize forced_size)
 {
-    GdkPixbuf *pixbuf, *scaled_pixbuf;
-    int w, h, s;
+    ScaledPixbuf scaled;
+    int w, h, s, i;
     double scale;
 
-    pixbuf = caja_icon_info_get_pixbuf_nodefault (icon);
-
-    if (pixbuf == NULL)
-        return NULL;
-
-    w = gdk_pixbuf_get_width (pixbuf);
-    h = gdk_pixbuf_get_height (pixbuf);
+    w = gdk_pixbuf_get_width (icon->pixbuf);
+    h = gdk_pixbuf_get_height (icon->pixbuf);
     s = MAX (w, h);
     if (s == forced_size)
     {
-        return pixbuf;
+        return caja_icon_info_get_pixbuf_nodefault (icon);
     }
 
-    scale = (double)forced_size / s;
-    scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-                    w * scale, h * scale,
-                    GDK_INTERP_BILINEAR);
-    g_object_unref (pixbuf);
-    return scaled_pixbuf;
+    /* Keeps the reaper away while the copies are used. */
+    icon->last_use_time = g_thread_gettime ();
+
+    for (i = 0; i < icon->n_scaled_pixbufs; i++)
+    {
+        if (icon->scaled_pixbufs[i].size == forced_size)
+        {
+            break;
+        }
+    }
+
+    if (i < icon->n_scaled_pixbufs)
+    {
+        scaled = icon->scaled_pixbufs[i];
+    }
+    else
+    {
+        if (icon->n_scaled_pixbufs == MAX_SCALED_PIXBUFS)
+        {
+            i = MAX_SCALED_PIXBUFS - 1;
+            g_object_unref (icon->scaled_pixbufs[i].pixbuf);
+        }
+        else
+        {
+            i = icon->n_scaled_pixbufs++;
+        }
+
+        scale = (double)forced_size / s;
+        scaled.size = forced_size;
+        scaled.pixbuf = gdk_pixbuf_scale_simple (icon->pixbuf,
+                        w * scale, h * scale,
+                        GDK_INTERP_BILINEAR);
+    }
+
+    /* Move it to the front. */
+    memmove (&icon->scaled_pixbufs[1], &icon->scaled_pixbufs[0],
+             i * sizeof (ScaledPixbuf));
+    icon->scaled_pixbufs[0] = scaled;
+
+    return g_object_ref (scaled.pixbuf);
+}
+
+GdkPixbuf *
+caja_icon_info_get_pixbuf_nodefault_at_size (CajaIconInfo  *icon,
+        gsize              forced_size)
+{
+    if (icon->pixbuf == NULL)
+    {
+        return NULL;
+    }
+
+    return get_scaled_pixbuf (icon, forced_size);
 }
 
 
@@ -589,6 +741,11 @@ caja_icon_info_get_pixbuf_at_size (CajaIconInfo  *icon,
     int w, h, s;
     double scale;
 
+    if (icon->pixbuf != NULL)
+    {
+        return get_scaled_pixbuf (icon, forced_size);
+    }
+
     pixbuf = caja_icon_info_get_pixbuf (icon);
 
     w = gdk_pixbuf_get_width (pixbuf);
@@ -0,0 +1,1039 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-image-preview.c: Fast thumbnails from embedded image previews.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-image-preview.h"
+
+#include "caja-lib-self-check-functions.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+/* Limits that keep a damaged or hostile file from making us loop. */
+#define MAX_IFDS 32
+#define MAX_IFD_DEPTH 2
+#define MAX_IFD_ENTRIES 1024
+#define MAX_SUB_IFDS 8
+
+/* An embedded thumbnail is only used if its aspect ratio is this close to
+ * that of the image. Cameras often letterbox their EXIF thumbnails.
+ */
+#define MAX_ASPECT_DIFFERENCE 0.02
+
+#define TIFF_TAG_JPG_FROM_RAW 0x002e
+#define TIFF_TAG_COMPRESSION 0x0103
+#define TIFF_TAG_STRIP_OFFSETS 0x0111
+#define TIFF_TAG_ORIENTATION 0x0112
+#define TIFF_TAG_STRIP_BYTE_COUNTS 0x0117
+#define TIFF_TAG_SUB_IFDS 0x014a
+#define TIFF_TAG_JPEG_OFFSET 0x0201
+#define TIFF_TAG_JPEG_LENGTH 0x0202
+
+#define TIFF_TYPE_SHORT 3
+#define TIFF_TYPE_LONG 4
+#define TIFF_TYPE_IFD 13
+
+#define TIFF_COMPRESSION_OLD_JPEG 6
+#define TIFF_COMPRESSION_JPEG 7
+
+#define RAF_MAGIC "FUJIFILMCCD-RAW "
+#define RAF_PREVIEW_OFFSET 84
+
+/* How much of the start of a file is read for its headers. The IFDs of
+ * RAW files and the EXIF segment of JPEGs come well within this. */
+#define HEAD_SIZE (256 * 1024)
+
+/* How much of each embedded JPEG is read to find its size. */
+#define CANDIDATE_HEAD_SIZE (64 * 1024)
+
+/* JPEG data is handed to the loader in pieces of this size. */
+#define LOAD_CHUNK_SIZE (64 * 1024)
+
+static const char *jpeg_mime_types[] =
+{
+    "image/jpeg",
+    "image/pjpeg"
+};
+
+/* Camera RAW formats that are TIFF based or, for RAF, carry a pointer
+ * to a JPEG preview in their header.
+ */
+static const char *raw_mime_types[] =
+{
+    "image/x-adobe-dng",
+    "image/x-canon-cr2",
+    "image/x-fuji-raf",
+    "image/x-kodak-dcr",
+    "image/x-nikon-nef",
+    "image/x-olympus-orf",
+    "image/x-panasonic-raw",
+    "image/x-panasonic-rw2",
+    "image/x-pentax-pef",
+    "image/x-samsung-srw",
+    "image/x-sony-arw",
+    "image/x-sony-sr2"
+};
+
+typedef struct
+{
+    const guchar *data;
+    gsize length;
+    gboolean big_endian;
+} TiffReader;
+
+/* A JPEG stream found inside a TIFF structure. */
+typedef struct
+{
+    gsize offset;
+    gsize length;
+} PreviewCandidate;
+
+typedef struct
+{
+    GArray *candidates;
+    int orientation;
+    int n_ifds;
+} TiffScan;
+
+static gboolean
+mime_type_in_list (const char *mime_type,
+                   const char **list,
+                   guint n_items)
+{
+    guint i;
+
+    if (mime_type == NULL)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < n_items; i++)
+    {
+        if (strcmp (mime_type, list[i]) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+is_jpeg_mime_type (const char *mime_type)
+{
+    return mime_type_in_list (mime_type, jpeg_mime_types,
+                              G_N_ELEMENTS (jpeg_mime_types));
+}
+
+static gboolean
+is_raw_mime_type (const char *mime_type)
+{
+    return mime_type_in_list (mime_type, raw_mime_types,
+                              G_N_ELEMENTS (raw_mime_types));
+}
+
+gboolean
+caja_image_preview_is_supported (const char *mime_type)
+{
+    return is_jpeg_mime_type (mime_type) || is_raw_mime_type (mime_type);
+}
+
+static gboolean
+range_is_valid (gsize length, gsize offset, gsize size)
+{
+    return offset <= length && length - offset >= size;
+}
+
+/* Reads length bytes at offset, or as many as there are before the end
+ * of the file, giving the number read or -1 on errors. Files are read
+ * rather than mapped since one cut short under a mapping crashes us.
+ */
+static gssize
+read_range (int fd, goffset offset, guchar *buffer, gsize length)
+{
+    gssize n;
+    gsize done;
+
+    for (done = 0; done < length; done += n)
+    {
+        n = pread (fd, buffer + done, length - done, offset + done);
+        if (n == -1 && errno == EINTR)
+        {
+            n = 0;
+            continue;
+        }
+        if (n == -1)
+        {
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+    }
+
+    return done;
+}
+
+static gboolean
+tiff_read_16 (const TiffReader *reader, gsize offset, guint32 *value)
+{
+    const guchar *p;
+
+    if (!range_is_valid (reader->length, offset, 2))
+    {
+        return FALSE;
+    }
+
+    p = reader->data + offset;
+    if (reader->big_endian)
+    {
+        *value = (p[0] << 8) | p[1];
+    }
+    else
+    {
+        *value = p[0] | (p[1] << 8);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+tiff_read_32 (const TiffReader *reader, gsize offset, guint32 *value)
+{
+    const guchar *p;
+
+    if (!range_is_valid (reader->length, offset, 4))
+    {
+        return FALSE;
+    }
+
+    p = reader->data + offset;
+    if (reader->big_endian)
+    {
+        *value = ((guint32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    else
+    {
+        *value = p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32) p[3] << 24);
+    }
+
+    return TRUE;
+}
+
+/* Reads element index of a SHORT or LONG valued IFD entry. */
+static gboolean
+tiff_read_entry_value (const TiffReader *reader,
+                       gsize entry,
+                       guint32 index,
+                       guint32 *value)
+{
+    guint32 type, count, offset;
+    gsize element_size;
+
+    if (!tiff_read_16 (reader, entry + 2, &type) ||
+            !tiff_read_32 (reader, entry + 4, &count))
+    {
+        return FALSE;
+    }
+
+    switch (type)
+    {
+    case TIFF_TYPE_SHORT:
+        element_size = 2;
+        break;
+    case TIFF_TYPE_LONG:
+    case TIFF_TYPE_IFD:
+        element_size = 4;
+        break;
+    default:
+        return FALSE;
+    }
+
+    if (index >= count)
+    {
+        return FALSE;
+    }
+
+    /* Values that fit in four bytes are stored in the entry itself. */
+    if ((gsize) count * element_size <= 4)
+    {
+        offset = entry + 8;
+    }
+    else if (!tiff_read_32 (reader, entry + 8, &offset))
+    {
+        return FALSE;
+    }
+
+    if (element_size == 2)
+    {
+        return tiff_read_16 (reader, (gsize) offset + index * 2, value);
+    }
+    return tiff_read_32 (reader, (gsize) offset + index * 4, value);
+}
+
+static void
+add_candidate (TiffScan *scan, guint32 offset, guint32 length)
+{
+    PreviewCandidate candidate;
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    candidate.offset = offset;
+    candidate.length = length;
+    g_array_append_val (scan->candidates, candidate);
+}
+
+static void
+scan_ifd (const TiffReader *reader,
+          TiffScan *scan,
+          guint32 offset,
+          int depth)
+{
+    guint32 n_entries, tag, value, count, next;
+    guint32 jpeg_offset, jpeg_length;
+    guint32 strip_offset, strip_length, compression;
+    gboolean is_first_ifd;
+    gsize entry;
+    guint32 i, j;
+
+    /* Each IFD in the chain and each sub IFD count against MAX_IFDS,
+     * which also stops offset loops. */
+    if (depth > MAX_IFD_DEPTH || scan->n_ifds >= MAX_IFDS)
+    {
+        return;
+    }
+    is_first_ifd = scan->n_ifds == 0;
+    scan->n_ifds++;
+
+    if (!tiff_read_16 (reader, offset, &n_entries) ||
+            n_entries > MAX_IFD_ENTRIES)
+    {
+        return;
+    }
+
+    jpeg_offset = jpeg_length = 0;
+    strip_offset = strip_length = 0;
+    compression = 0;
+
+    for (i = 0; i < n_entries; i++)
+    {
+        entry = (gsize) offset + 2 + i * 12;
+        if (!tiff_read_16 (reader, entry, &tag))
+        {
+            return;
+        }
+
+        switch (tag)
+        {
+        case TIFF_TAG_JPG_FROM_RAW:
+            /* Panasonic stores the preview as an undefined blob. */
+            if (tiff_read_32 (reader, entry + 4, &count) &&
+                    tiff_read_32 (reader, entry + 8, &value))
+            {
+                add_candidate (scan, value, count);
+            }
+            break;
+        case TIFF_TAG_COMPRESSION:
+            tiff_read_entry_value (reader, entry, 0, &compression);
+            break;
+        case TIFF_TAG_STRIP_OFFSETS:
+            if (tiff_read_32 (reader, entry + 4, &count) && count == 1)
+            {
+                tiff_read_entry_value (reader, entry, 0, &strip_offset);
+            }
+            break;
+        case TIFF_TAG_STRIP_BYTE_COUNTS:
+            if (tiff_read_32 (reader, entry + 4, &count) && count == 1)
+            {
+                tiff_read_entry_value (reader, entry, 0, &strip_length);
+            }
+            break;
+        case TIFF_TAG_ORIENTATION:
+            if (is_first_ifd &&
+                    tiff_read_entry_value (reader, entry, 0, &value))
+            {
+                scan->orientation = value;
+            }
+            break;
+        case TIFF_TAG_SUB_IFDS:
+            if (tiff_read_32 (reader, entry + 4, &count))
+            {
+                for (j = 0; j < MIN (count, MAX_SUB_IFDS); j++)
+                {
+                    if (tiff_read_entry_value (reader, entry, j, &value))
+                    {
+                        scan_ifd (reader, scan, value, depth + 1);
+                    }
+                }
+            }
+            break;
+        case TIFF_TAG_JPEG_OFFSET:
+            tiff_read_entry_value (reader, entry, 0, &jpeg_offset);
+            break;
+        case TIFF_TAG_JPEG_LENGTH:
+            tiff_read_entry_value (reader, entry, 0, &jpeg_length);
+            break;
+        default:
+            break;
+        }
+    }
+
+    add_candidate (scan, jpeg_offset, jpeg_length);
+    if (compression == TIFF_COMPRESSION_OLD_JPEG ||
+            compression == TIFF_COMPRESSION_JPEG)
+    {
+        add_candidate (scan, strip_offset, strip_length);
+    }
+
+    /* Only the top level IFDs form a chain worth following. */
+    if (depth == 0 &&
+            tiff_read_32 (reader, (gsize) offset + 2 + n_entries * 12, &next) &&
+            next != 0)
+    {
+        scan_ifd (reader, scan, next, 0);
+    }
+}
+
+/* Collects the JPEG streams referenced from a TIFF structure, along
+ * with the orientation of the main image. Offsets are relative to data.
+ */
+static void
+scan_tiff (const guchar *data, gsize length, TiffScan *scan)
+{
+    TiffReader reader;
+    guint32 offset;
+
+    if (length < 8)
+    {
+        return;
+    }
+
+    if (data[0] == 'I' && data[1] == 'I')
+    {
+        reader.big_endian = FALSE;
+    }
+    else if (data[0] == 'M' && data[1] == 'M')
+    {
+        reader.big_endian = TRUE;
+    }
+    else
+    {
+        return;
+    }
+    reader.data = data;
+    reader.length = length;
+
+    /* The magic number after the byte order varies between RAW
+     * formats, so it is not checked. */
+    if (tiff_read_32 (&reader, 4, &offset))
+    {
+        scan_ifd (&reader, scan, offset, 0);
+    }
+}
+
+static void
+tiff_scan_init (TiffScan *scan)
+{
+    scan->candidates = g_array_new (FALSE, FALSE, sizeof (PreviewCandidate));
+    scan->orientation = 1;
+    scan->n_ifds = 0;
+}
+
+static void
+tiff_scan_destroy (TiffScan *scan)
+{
+    g_array_free (scan->candidates, TRUE);
+}
+
+/* Walks the JPEG markers up to the first frame header and returns the
+ * image size, and the location of the EXIF TIFF data if asked for.
+ * Only baseline, extended and progressive frames are accepted, which
+ * rules out the lossless JPEGs some RAW formats use for the main image.
+ */
+static gboolean
+jpeg_parse_headers (const guchar *data,
+                    gsize length,
+                    int *width,
+                    int *height,
+                    gsize *exif_offset,
+                    gsize *exif_length)
+{
+    gsize pos, segment_length;
+    guchar marker;
+
+    if (length < 4 || data[0] != 0xff || data[1] != 0xd8)
+    {
+        return FALSE;
+    }
+
+    if (exif_length != NULL)
+    {
+        *exif_length = 0;
+    }
+
+    pos = 2;
+    while (pos + 4 <= length)
+    {
+        if (data[pos] != 0xff)
+        {
+            return FALSE;
+        }
+        marker = data[pos + 1];
+        if (marker == 0xff)
+        {
+            /* Fill byte */
+            pos++;
+            continue;
+        }
+        if (marker == 0xd9 || marker == 0xda)
+        {
+            /* End of image or start of scan. */
+            return FALSE;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+        {
+            /* Markers without a segment */
+            pos += 2;
+            continue;
+        }
+
+        segment_length = (data[pos + 2] << 8) | data[pos + 3];
+        if (segment_length < 2 || !range_is_valid (length, pos + 2, segment_length))
+        {
+            return FALSE;
+        }
+
+        if (marker == 0xe1 && exif_length != NULL && *exif_length == 0 &&
+                segment_length >= 2 + 6 + 8 &&
+                memcmp (data + pos + 4, "Exif\0\0", 6) == 0)
+        {
+            *exif_offset = pos + 4 + 6;
+            *exif_length = segment_length - 2 - 6;
+        }
+
+        if ((marker == 0xc0 || marker == 0xc1 || marker == 0xc2) &&
+                segment_length >= 2 + 5)
+        {
+            *height = (data[pos + 5] << 8) | data[pos + 6];
+            *width = (data[pos + 7] << 8) | data[pos + 8];
+            return *width > 0 && *height > 0;
+        }
+
+        pos += 2 + segment_length;
+    }
+
+    return FALSE;
+}
+
+/* Picks the smallest candidate that still covers size, so a big preview
+ * is only decoded when nothing smaller will do. When aspect is positive
+ * candidates must also have about that aspect ratio. The candidates are
+ * at offsets from base in the file, and within length bytes of it.
+ */
+static gboolean
+choose_candidate (int fd,
+                  goffset base,
+                  gsize length,
+                  GArray *candidates,
+                  int size,
+                  double aspect,
+                  PreviewCandidate *result)
+{
+    PreviewCandidate *candidate;
+    guchar *head;
+    gssize head_length;
+    int width, height, best_size;
+    gboolean found;
+    guint i;
+
+    head = g_malloc (CANDIDATE_HEAD_SIZE);
+    found = FALSE;
+    best_size = G_MAXINT;
+    for (i = 0; i < candidates->len; i++)
+    {
+        candidate = &g_array_index (candidates, PreviewCandidate, i);
+        if (!range_is_valid (length, candidate->offset, candidate->length))
+        {
+            continue;
+        }
+
+        head_length = read_range (fd, base + candidate->offset, head,
+                                  MIN (candidate->length, CANDIDATE_HEAD_SIZE));
+        if (head_length <= 0 ||
+                !jpeg_parse_headers (head, head_length,
+                                     &width, &height, NULL, NULL))
+        {
+            continue;
+        }
+
+        if (MAX (width, height) < size || MAX (width, height) >= best_size)
+        {
+            continue;
+        }
+
+        if (aspect > 0 &&
+                ABS ((double) width / height - aspect) > aspect * MAX_ASPECT_DIFFERENCE)
+        {
+            continue;
+        }
+
+        *result = *candidate;
+        best_size = MAX (width, height);
+        found = TRUE;
+    }
+    g_free (head);
+
+    return found;
+}
+
+static void
+loader_size_prepared (GdkPixbufLoader *loader,
+                      int              width,
+                      int              height,
+                      gpointer         size_ptr)
+{
+    int size;
+    double scale;
+
+    size = GPOINTER_TO_INT (size_ptr);
+
+    /* Only ever scale down. For JPEG this lets the loader use the
+     * reduced size DCT instead of decoding every pixel. */
+    if (width > size || height > size)
+    {
+        scale = (double) size / MAX (width, height);
+        gdk_pixbuf_loader_set_size (loader,
+                                    MAX (1, (int) (scale * width + 0.5)),
+                                    MAX (1, (int) (scale * height + 0.5)));
+    }
+}
+
+/* Decodes the length bytes of JPEG at offset in the file, a piece at
+ * a time, so only the one embedded image is read.
+ */
+static GdkPixbuf *
+load_jpeg_at_size (int fd,
+                   goffset offset,
+                   gsize length,
+                   int size)
+{
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf;
+    guchar *buffer;
+    gssize n;
+    gsize done;
+    gboolean ok;
+
+    loader = gdk_pixbuf_loader_new_with_type ("jpeg", NULL);
+    if (loader == NULL)
+    {
+        return NULL;
+    }
+
+    g_signal_connect (loader, "size-prepared",
+                      G_CALLBACK (loader_size_prepared),
+                      GINT_TO_POINTER (size));
+
+    buffer = g_malloc (LOAD_CHUNK_SIZE);
+    ok = TRUE;
+    for (done = 0; ok && done < length; done += n)
+    {
+        n = read_range (fd, offset + done, buffer, MIN (length - done, LOAD_CHUNK_SIZE));
+        ok = n > 0 &&
+             gdk_pixbuf_loader_write (loader, buffer, n, NULL);
+    }
+    g_free (buffer);
+    ok = gdk_pixbuf_loader_close (loader, NULL) && ok;
+
+    pixbuf = NULL;
+    if (ok)
+    {
+        pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+        if (pixbuf != NULL)
+        {
+            g_object_ref (pixbuf);
+        }
+    }
+
+    g_object_unref (loader);
+
+    return pixbuf;
+}
+
+/* Same transformations as gdk_pixbuf_apply_embedded_orientation(), for
+ * previews that don't carry the orientation of the image themselves.
+ */
+static GdkPixbuf *
+apply_orientation (GdkPixbuf *pixbuf, int orientation)
+{
+    GdkPixbuf *temp, *result;
+
+    switch (orientation)
+    {
+    case 2:
+        result = gdk_pixbuf_flip (pixbuf, TRUE);
+        break;
+    case 3:
+        result = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_UPSIDEDOWN);
+        break;
+    case 4:
+        result = gdk_pixbuf_flip (pixbuf, FALSE);
+        break;
+    case 5:
+        temp = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+        result = gdk_pixbuf_flip (temp, TRUE);
+        g_object_unref (temp);
+        break;
+    case 6:
+        result = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+        break;
+    case 7:
+        temp = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+        result = gdk_pixbuf_flip (temp, FALSE);
+        g_object_unref (temp);
+        break;
+    case 8:
+        result = gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE);
+        break;
+    default:
+        return pixbuf;
+    }
+
+    g_object_unref (pixbuf);
+    return result;
+}
+
+/* The headers are in head, the first head_length bytes of the file. */
+static GdkPixbuf *
+load_jpeg_preview (int fd,
+                   gsize length,
+                   const guchar *head,
+                   gsize head_length,
+                   int size)
+{
+    GdkPixbuf *pixbuf, *oriented;
+    PreviewCandidate candidate;
+    TiffScan scan;
+    gsize exif_offset, exif_length;
+    int width, height;
+
+    if (!jpeg_parse_headers (head, head_length, &width, &height,
+                             &exif_offset, &exif_length))
+    {
+        return NULL;
+    }
+
+    pixbuf = NULL;
+    if (exif_length > 0)
+    {
+        tiff_scan_init (&scan);
+        scan_tiff (head + exif_offset, exif_length, &scan);
+
+        /* The thumbnail has to look like the image itself, so its
+         * orientation is that of the image. */
+        if (choose_candidate (fd, exif_offset, exif_length,
+                              scan.candidates, size,
+                              (double) width / height, &candidate))
+        {
+            pixbuf = load_jpeg_at_size (fd, exif_offset + candidate.offset,
+                                        candidate.length, size);
+            if (pixbuf != NULL)
+            {
+                pixbuf = apply_orientation (pixbuf, scan.orientation);
+            }
+        }
+
+        tiff_scan_destroy (&scan);
+    }
+
+    if (pixbuf == NULL)
+    {
+        pixbuf = load_jpeg_at_size (fd, 0, length, size);
+        if (pixbuf != NULL)
+        {
+            oriented = gdk_pixbuf_apply_embedded_orientation (pixbuf);
+            g_object_unref (pixbuf);
+            pixbuf = oriented;
+        }
+    }
+
+    return pixbuf;
+}
+
+/* As load_jpeg_preview(). IFDs past the head aren't looked at. */
+static GdkPixbuf *
+load_raw_preview (int fd,
+                  gsize length,
+                  const guchar *head,
+                  gsize head_length,
+                  int size)
+{
+    GdkPixbuf *pixbuf;
+    PreviewCandidate candidate;
+    TiffScan scan;
+    TiffReader reader;
+    guint32 offset, preview_length;
+
+    pixbuf = NULL;
+    tiff_scan_init (&scan);
+
+    if (head_length > RAF_PREVIEW_OFFSET + 8 &&
+            memcmp (head, RAF_MAGIC, strlen (RAF_MAGIC)) == 0)
+    {
+        reader.data = head;
+        reader.length = head_length;
+        reader.big_endian = TRUE;
+        if (tiff_read_32 (&reader, RAF_PREVIEW_OFFSET, &offset) &&
+                tiff_read_32 (&reader, RAF_PREVIEW_OFFSET + 4, &preview_length))
+        {
+            add_candidate (&scan, offset, preview_length);
+        }
+    }
+    else
+    {
+        scan_tiff (head, head_length, &scan);
+    }
+
+    if (choose_candidate (fd, 0, length, scan.candidates, size, 0, &candidate))
+    {
+        pixbuf = load_jpeg_at_size (fd, candidate.offset,
+                                    candidate.length, size);
+        if (pixbuf != NULL)
+        {
+            pixbuf = apply_orientation (pixbuf, scan.orientation);
+        }
+    }
+
+    tiff_scan_destroy (&scan);
+
+    return pixbuf;
+}
+
+GdkPixbuf *
+caja_image_preview_load (const char *path,
+                         const char *mime_type,
+                         int size)
+{
+    struct stat statbuf;
+    guchar *head;
+    gssize head_length;
+    GdkPixbuf *pixbuf;
+    int fd;
+
+    g_return_val_if_fail (path != NULL, NULL);
+    g_return_val_if_fail (size > 0, NULL);
+
+    if (!caja_image_preview_is_supported (mime_type))
+    {
+        return NULL;
+    }
+
+    fd = g_open (path, O_RDONLY | O_NOCTTY, 0);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    if (fstat (fd, &statbuf) != 0 ||
+            !S_ISREG (statbuf.st_mode) ||
+            statbuf.st_size == 0 ||
+            (guint64) statbuf.st_size > G_MAXSIZE)
+    {
+        close (fd);
+        return NULL;
+    }
+
+    /* Only the headers and the chosen preview are read, not the whole
+     * RAW file. */
+    head = g_malloc (MIN ((gsize) statbuf.st_size, HEAD_SIZE));
+    head_length = read_range (fd, 0, head, MIN ((gsize) statbuf.st_size, HEAD_SIZE));
+
+    if (head_length <= 0)
+    {
+        pixbuf = NULL;
+    }
+    else if (is_jpeg_mime_type (mime_type))
+    {
+        pixbuf = load_jpeg_preview (fd, statbuf.st_size, head, head_length, size);
+    }
+    else
+    {
+        pixbuf = load_raw_preview (fd, statbuf.st_size, head, head_length, size);
+    }
+
+    g_free (head);
+    close (fd);
+
+    return pixbuf;
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+/* A little endian TIFF with an IFD0 holding an orientation and a sub
+ * IFD, an IFD1 with a JPEG thumbnail, and a sub IFD with a JPEG strip.
+ */
+static const guchar self_check_tiff[] =
+{
+    'I', 'I', 42, 0, 8, 0, 0, 0,
+    /* IFD0 at 8: 2 entries */
+    2, 0,
+    0x12, 0x01, 3, 0, 1, 0, 0, 0, 6, 0, 0, 0,
+    0x4a, 0x01, 4, 0, 1, 0, 0, 0, 56, 0, 0, 0,
+    /* next IFD at 38 */
+    38, 0, 0, 0,
+    /* IFD1 at 38: 1 entry, no next. Pointing both ways at 200 */
+    1, 0,
+    0x01, 0x02, 4, 0, 1, 0, 0, 0, 200, 0, 0, 0,
+    0, 0, 0, 0,
+    /* sub IFD at 56: 3 entries */
+    3, 0,
+    0x03, 0x01, 3, 0, 1, 0, 0, 0, 7, 0, 0, 0,
+    0x11, 0x01, 4, 0, 1, 0, 0, 0, 0, 1, 0, 0,
+    0x17, 0x01, 4, 0, 1, 0, 0, 0, 0, 2, 0, 0,
+    0, 0, 0, 0
+};
+
+/* The same IFD chain pointing at itself. */
+static const guchar self_check_tiff_loop[] =
+{
+    'M', 'M', 0, 42, 0, 0, 0, 8,
+    0, 1,
+    0x02, 0x01, 0, 4, 0, 0, 0, 1, 0, 0, 0, 100,
+    0, 0, 0, 8
+};
+
+/* SOI, APP1 Exif stub, SOF0 of 640x480 and SOS. */
+static const guchar self_check_jpeg[] =
+{
+    0xff, 0xd8,
+    0xff, 0xe1, 0, 16, 'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0, 8, 0, 0, 0,
+    0xff, 0xc0, 0, 11, 8, 0x01, 0xe0, 0x02, 0x80, 1, 1, 0x11, 0,
+    0xff, 0xda, 0, 2
+};
+
+/* Same image coded as lossless JPEG, which can't be decoded here. */
+static const guchar self_check_lossless_jpeg[] =
+{
+    0xff, 0xd8,
+    0xff, 0xc3, 0, 11, 8, 0x01, 0xe0, 0x02, 0x80, 1, 1, 0x11, 0,
+    0xff, 0xda, 0, 2
+};
+
+static int
+self_check_candidate_field (const guchar *data, gsize length,
+                            guint index, gboolean want_length)
+{
+    TiffScan scan;
+    PreviewCandidate candidate;
+    int result;
+
+    tiff_scan_init (&scan);
+    scan_tiff (data, length, &scan);
+
+    result = -1;
+    if (index < scan.candidates->len)
+    {
+        candidate = g_array_index (scan.candidates, PreviewCandidate, index);
+        result = want_length ? (int) candidate.length : (int) candidate.offset;
+    }
+    else if (index == G_MAXUINT)
+    {
+        result = scan.candidates->len;
+    }
+
+    tiff_scan_destroy (&scan);
+
+    return result;
+}
+
+static int
+self_check_orientation (const guchar *data, gsize length)
+{
+    TiffScan scan;
+    int result;
+
+    tiff_scan_init (&scan);
+    scan_tiff (data, length, &scan);
+    result = scan.orientation;
+    tiff_scan_destroy (&scan);
+
+    return result;
+}
+
+static int
+self_check_jpeg_width (const guchar *data, gsize length)
+{
+    int width, height;
+
+    if (!jpeg_parse_headers (data, length, &width, &height, NULL, NULL))
+    {
+        return -1;
+    }
+
+    return width;
+}
+
+static int
+self_check_jpeg_exif_offset (const guchar *data, gsize length)
+{
+    gsize offset, exif_length;
+    int width, height;
+
+    if (!jpeg_parse_headers (data, length, &width, &height, &offset, &exif_length) ||
+            exif_length == 0)
+    {
+        return -1;
+    }
+
+    return offset;
+}
+
+void
+caja_self_check_image_preview (void)
+{
+    EEL_CHECK_BOOLEAN_RESULT (caja_image_preview_is_supported ("image/jpeg"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (caja_image_preview_is_supported ("image/x-nikon-nef"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (caja_image_preview_is_supported ("image/png"), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (caja_image_preview_is_supported (NULL), FALSE);
+
+    /* Only the sub IFD strip qualifies, the IFD1 thumbnail has no length. */
+    EEL_CHECK_INTEGER_RESULT (self_check_candidate_field (self_check_tiff, sizeof (self_check_tiff), G_MAXUINT, FALSE), 1);
+    EEL_CHECK_INTEGER_RESULT (self_check_candidate_field (self_check_tiff, sizeof (self_check_tiff), 0, FALSE), 256);
+    EEL_CHECK_INTEGER_RESULT (self_check_candidate_field (self_check_tiff, sizeof (self_check_tiff), 0, TRUE), 512);
+    EEL_CHECK_INTEGER_RESULT (self_check_orientation (self_check_tiff, sizeof (self_check_tiff)), 6);
+
+    /* Truncated input must not be read past its end. */
+    EEL_CHECK_INTEGER_RESULT (self_check_candidate_field (self_check_tiff, 40, G_MAXUINT, FALSE), 0);
+    EEL_CHECK_INTEGER_RESULT (self_check_candidate_field (self_check_tiff_loop, sizeof (self_check_tiff_loop), G_MAXUINT, FALSE), 0);
+
+    EEL_CHECK_INTEGER_RESULT (self_check_jpeg_width (self_check_jpeg, sizeof (self_check_jpeg)), 640);
+    EEL_CHECK_INTEGER_RESULT (self_check_jpeg_exif_offset (self_check_jpeg, sizeof (self_check_jpeg)), 12);
+    EEL_CHECK_INTEGER_RESULT (self_check_jpeg_width (self_check_lossless_jpeg, sizeof (self_check_lossless_jpeg)), -1);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
@@ -0,0 +1,39 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-image-preview.h: Fast thumbnails from embedded image previews.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_IMAGE_PREVIEW_H
+#define CAJA_IMAGE_PREVIEW_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Whether caja_image_preview_load() knows how to handle the type. */
+gboolean   caja_image_preview_is_supported (const char *mime_type);
+
+/* Returns a pixbuf no larger than size in either dimension, taken from
+ * the EXIF thumbnail of a JPEG or the largest fitting preview of a
+ * camera RAW file. JPEGs without a usable embedded thumbnail are
+ * decoded at reduced scale. Returns NULL if the file has to be
+ * thumbnailed the slow way. Safe to call from any thread.
+ */
+GdkPixbuf *caja_image_preview_load         (const char *path,
+        const char *mime_type,
+        int         size);
+
+#endif /* CAJA_IMAGE_PREVIEW_H */
@@ -43,7 +43,16 @@ void caja_run_lib_self_checks (void);
 	macro (caja_self_check_file_operations) \
 	macro (caja_self_check_directory) \
 	macro (caja_self_check_file) \
+	macro (caja_self_check_file_metadata) \
+	macro (caja_self_check_filename_matcher) \
 	macro (caja_self_check_icon_container) \
+	macro (caja_self_check_collation) \
+	macro (caja_self_check_contents_matcher) \
+	macro (caja_self_check_image_preview) \
+	macro (caja_self_check_search_index) \
+	macro (caja_self_check_thumbnail_cache) \
+	macro (caja_self_check_thumbnail_costs) \
+	macro (caja_self_check_thumbnail_index) \
 /* Add new self-check functions to the list above this line. */
 
 /* Generate prototypes for all the functions. */
@@ -24,9 +24,27 @@
 #include <config.h>
 #include "caja-module.h"
 
+#include "caja-file-utilities.h"
 #include <eel/eel-gtk-macros.h>
 #include <eel/eel-debug.h>
 #include <gmodule.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+
+#include <src/glibcompat.h> /* for g_list_free_full */
+
+/* Remembers which interfaces the types in each extension implement, so
+ * an extension is only loaded once something asks for one of them.
+ * Entries are for a module file as it was when it was last loaded, and
+ * are thrown away when its time or size changes. Extensions with no
+ * interfaces noted down are loaded right away, as they may do all
+ * their work when initialized.
+ */
+#define MANIFEST_FILE_NAME "extension-manifest"
+#define MANIFEST_KEY_MTIME "mtime"
+#define MANIFEST_KEY_SIZE "size"
+#define MANIFEST_KEY_INTERFACES "interfaces"
 
 #define CAJA_TYPE_MODULE    	(caja_module_get_type ())
 #define CAJA_MODULE(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), CAJA_TYPE_MODULE, CajaModule))
@@ -58,7 +76,24 @@ struct _CajaModuleClass
     GTypeModuleClass parent;
 };
 
+typedef struct
+{
+    char *path;
+    char **interfaces;
+    gboolean loaded;
+    /* Where the module is in the extension directory, from 1. */
+    int order;
+} ModuleEntry;
+
+/* In the order of the modules they come from, whenever those were
+ * loaded, the types of each in the order it lists them. */
 static GList *module_objects = NULL;
+static GList *module_entries = NULL;
+
+/* The order of the module whose types are being added, 0 for those
+ * Caja adds itself, which come first. */
+static int adding_module_order = 0;
+static GQuark module_order_quark = 0;
 
 static GType caja_module_get_type (void);
 
@@ -168,17 +203,65 @@ add_module_objects (CajaModule *module)
     }
 }
 
+/* The names of the interfaces the types in a loaded module implement. */
+static char **
+get_module_interfaces (CajaModule *module)
+{
+    const GType *types;
+    GType *interfaces;
+    GPtrArray *names;
+    const char *name;
+    guint n_interfaces, i, j, k;
+    int num_types;
+
+    names = g_ptr_array_new ();
+
+    module->list_types (&types, &num_types);
+
+    for (i = 0; i < (guint) num_types && types[i] != 0; i++)
+    {
+        interfaces = g_type_interfaces (types[i], &n_interfaces);
+        for (j = 0; j < n_interfaces; j++)
+        {
+            name = g_type_name (interfaces[j]);
+            for (k = 0; k < names->len; k++)
+            {
+                if (strcmp (g_ptr_array_index (names, k), name) == 0)
+                {
+                    break;
+                }
+            }
+            if (k == names->len)
+            {
+                g_ptr_array_add (names, g_strdup (name));
+            }
+        }
+        g_free (interfaces);
+    }
+
+    g_ptr_array_add (names, NULL);
+
+    return (char **) g_ptr_array_free (names, FALSE);
+}
+
 static CajaModule *
-caja_module_load_file (const char *filename)
+caja_module_load_file (ModuleEntry *entry,
+                       char ***interfaces)
 {
     CajaModule *module;
 
     module = g_object_new (CAJA_TYPE_MODULE, NULL);
-    module->path = g_strdup (filename);
+    module->path = g_strdup (entry->path);
 
     if (g_type_module_use (G_TYPE_MODULE (module)))
     {
+        adding_module_order = entry->order;
         add_module_objects (module);
+        adding_module_order = 0;
+        if (interfaces != NULL)
+        {
+            *interfaces = get_module_interfaces (module);
+        }
         g_type_module_unuse (G_TYPE_MODULE (module));
         return module;
     }
@@ -189,10 +272,95 @@ caja_module_load_file (const char *filename)
     }
 }
 
+static char *
+get_manifest_path (void)
+{
+    char *user_directory, *path;
+
+    user_directory = caja_get_user_directory ();
+    path = g_build_filename (user_directory, MANIFEST_FILE_NAME, NULL);
+    g_free (user_directory);
+
+    return path;
+}
+
+static GKeyFile *
+load_manifest (void)
+{
+    GKeyFile *manifest;
+    char *path;
+
+    manifest = g_key_file_new ();
+
+    path = get_manifest_path ();
+    g_key_file_load_from_file (manifest, path, G_KEY_FILE_NONE, NULL);
+    g_free (path);
+
+    return manifest;
+}
+
+static void
+save_manifest (GKeyFile *manifest)
+{
+    char *data, *path;
+    gsize length;
+    GError *error;
+
+    data = g_key_file_to_data (manifest, &length, NULL);
+    if (data == NULL)
+    {
+        return;
+    }
+
+    path = get_manifest_path ();
+    error = NULL;
+    if (!g_file_set_contents (path, data, length, &error))
+    {
+        g_warning ("Couldn't save the extension manifest: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (path);
+    g_free (data);
+}
+
+static gboolean
+manifest_entry_is_current (GKeyFile *manifest,
+                           const char *filename,
+                           const char *mtime,
+                           const char *size)
+{
+    char *value;
+    gboolean current;
+
+    value = g_key_file_get_string (manifest, filename, MANIFEST_KEY_MTIME, NULL);
+    current = g_strcmp0 (value, mtime) == 0;
+    g_free (value);
+
+    if (current)
+    {
+        value = g_key_file_get_string (manifest, filename, MANIFEST_KEY_SIZE, NULL);
+        current = g_strcmp0 (value, size) == 0;
+        g_free (value);
+    }
+
+    return current && g_key_file_has_key (manifest, filename, MANIFEST_KEY_INTERFACES, NULL);
+}
+
+/* Loads the modules the manifest doesn't know about, or knows an older
+ * file for, and only notes down the rest for loading when needed.
+ */
 static void
 load_module_dir (const char *dirname)
 {
     GDir *dir;
+    GKeyFile *manifest, *new_manifest;
+    ModuleEntry *entry;
+    struct stat statbuf;
+    char *mtime, *size;
+    char **groups;
+    gsize n_groups, n_new_groups;
+    gboolean remembered, changed;
+    int order;
 
     dir = g_dir_open (dirname, 0, NULL);
 
@@ -200,6 +368,11 @@ load_module_dir (const char *dirname)
     {
         const char *name;
 
+        manifest = load_manifest ();
+        new_manifest = g_key_file_new ();
+        changed = FALSE;
+        order = 0;
+
         while ((name = g_dir_read_name (dir)))
         {
             if (g_str_has_suffix (name, "." G_MODULE_SUFFIX))
@@ -209,13 +382,132 @@ load_module_dir (const char *dirname)
                 filename = g_build_filename (dirname,
                                              name,
                                              NULL);
-                caja_module_load_file (filename);
-                g_free (filename);
+                if (g_stat (filename, &statbuf) != 0)
+                {
+                    g_free (filename);
+                    continue;
+                }
+
+                entry = g_new0 (ModuleEntry, 1);
+                entry->path = filename;
+                entry->order = ++order;
+
+                mtime = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) statbuf.st_mtime);
+                size = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) statbuf.st_size);
+
+                if (manifest_entry_is_current (manifest, filename, mtime, size))
+                {
+                    entry->interfaces = g_key_file_get_string_list (manifest, filename,
+                                                                    MANIFEST_KEY_INTERFACES,
+                                                                    NULL, NULL);
+                    remembered = TRUE;
+
+                    if (entry->interfaces == NULL || entry->interfaces[0] == NULL)
+                    {
+                        entry->loaded = TRUE;
+                        caja_module_load_file (entry, NULL);
+                    }
+                }
+                else
+                {
+                    /* A module that fails to load isn't remembered, so
+                     * it is tried again next time in case what it was
+                     * missing has turned up. */
+                    entry->loaded = TRUE;
+                    remembered = caja_module_load_file (entry, &entry->interfaces) != NULL;
+                    changed |= remembered;
+                }
+
+                if (entry->interfaces == NULL)
+                {
+                    entry->interfaces = g_new0 (char *, 1);
+                }
+
+                if (remembered)
+                {
+                    g_key_file_set_string (new_manifest, filename, MANIFEST_KEY_MTIME, mtime);
+                    g_key_file_set_string (new_manifest, filename, MANIFEST_KEY_SIZE, size);
+                    g_key_file_set_string_list (new_manifest, filename, MANIFEST_KEY_INTERFACES,
+                                                (const char * const *) entry->interfaces,
+                                                g_strv_length (entry->interfaces));
+                }
+
+                g_free (mtime);
+                g_free (size);
+
+                module_entries = g_list_prepend (module_entries, entry);
             }
         }
 
         g_dir_close (dir);
+        module_entries = g_list_reverse (module_entries);
+
+        /* Modules that were removed drop out of the manifest too. */
+        groups = g_key_file_get_groups (manifest, &n_groups);
+        g_strfreev (groups);
+        groups = g_key_file_get_groups (new_manifest, &n_new_groups);
+        g_strfreev (groups);
+
+        if (changed || n_groups != n_new_groups)
+        {
+            save_manifest (new_manifest);
+        }
+
+        g_key_file_free (new_manifest);
+        g_key_file_free (manifest);
+    }
+}
+
+static gboolean
+module_entry_implements (ModuleEntry *entry,
+                         const char *interface_name)
+{
+    char **p;
+
+    for (p = entry->interfaces; *p != NULL; p++)
+    {
+        if (strcmp (*p, interface_name) == 0)
+        {
+            return TRUE;
+        }
     }
+
+    return FALSE;
+}
+
+/* Loads the modules not yet loaded that have something for type. For
+ * a type that isn't an interface, the manifest can't tell, so all of
+ * them are loaded.
+ */
+static void
+load_modules_for_type (GType type)
+{
+    ModuleEntry *entry;
+    const char *name;
+    GList *l;
+
+    name = g_type_name (type);
+
+    for (l = module_entries; l != NULL; l = l->next)
+    {
+        entry = l->data;
+
+        if (!entry->loaded &&
+            (!G_TYPE_IS_INTERFACE (type) ||
+             module_entry_implements (entry, name)))
+        {
+            entry->loaded = TRUE;
+            caja_module_load_file (entry, NULL);
+        }
+    }
+}
+
+static void
+module_entry_free (ModuleEntry *entry)
+{
+    g_free (entry->path);
+    g_strfreev (entry->interfaces);
+    g_free (entry);
 }
 
 static void
@@ -230,6 +522,9 @@ free_module_objects (void)
     }
 
     g_list_free (module_objects);
+
+    g_list_free_full (module_entries, (GDestroyNotify) module_entry_free);
+    module_entries = NULL;
 }
 
 void
@@ -253,6 +548,11 @@ caja_module_get_extensions_for_type (GType type)
     GList *l;
     GList *ret = NULL;
 
+    /* Modules are loaded the first time something asks for a type
+     * they have, rather than all of them before the first window. */
+    caja_module_setup ();
+    load_modules_for_type (type);
+
     for (l = module_objects; l != NULL; l = l->next)
     {
         if (G_TYPE_CHECK_INSTANCE_TYPE (G_OBJECT (l->data),
@@ -263,7 +563,7 @@ caja_module_get_extensions_for_type (GType type)
         }
     }
 
-    return ret;
+    return g_list_reverse (ret);
 }
 
 void
@@ -283,11 +583,29 @@ void
 caja_module_add_type (GType type)
 {
     GObject *object;
+    GList *l;
+
+    if (module_order_quark == 0)
+    {
+        module_order_quark = g_quark_from_static_string ("caja-module-order");
+    }
 
     object = g_object_new (type, NULL);
     g_object_weak_ref (object,
                        (GWeakNotify)module_object_weak_notify,
                        NULL);
+    g_object_set_qdata (object, module_order_quark,
+                        GINT_TO_POINTER (adding_module_order));
 
-    module_objects = g_list_prepend (module_objects, object);
+    /* After everything from the same module or the ones before it, so
+     * the order doesn't depend on what was asked for first. */
+    for (l = module_objects; l != NULL; l = l->next)
+    {
+        if (GPOINTER_TO_INT (g_object_get_qdata (l->data, module_order_quark)) >
+                adding_module_order)
+        {
+            break;
+        }
+    }
+    module_objects = g_list_insert_before (module_objects, l, object);
 }
@@ -23,8 +23,10 @@
 
 #include <config.h>
 #include <string.h>
+#include <time.h>
 
 #include "caja-query.h"
+#include "caja-filename-matcher.h"
 #include <eel/eel-gtk-macros.h>
 #include <eel/eel-glib-extensions.h>
 #include <glib/gi18n.h>
@@ -35,8 +37,18 @@
 struct CajaQueryDetails
 {
     char *text;
+    char *contents;
     char *location_uri;
     GList *mime_types;
+
+    goffset min_size;
+    goffset max_size;
+    int modified_within_days;
+    int modified_not_within_days;
+    gint64 modified_after;
+    gint64 modified_before;
+    char *owner;
+    GList *extensions;
 };
 
 static void  caja_query_class_init       (CajaQueryClass *class);
@@ -56,6 +68,9 @@ finalize (GObject *object)
     query = CAJA_QUERY (object);
 
     g_free (query->details->text);
+    g_free (query->details->contents);
+    g_free (query->details->owner);
+    g_list_free_full (query->details->extensions, g_free);
     g_free (query->details);
 
     EEL_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
@@ -76,6 +91,12 @@ static void
 caja_query_init (CajaQuery *query)
 {
     query->details = g_new0 (CajaQueryDetails, 1);
+    query->details->min_size = -1;
+    query->details->max_size = -1;
+    query->details->modified_within_days = -1;
+    query->details->modified_not_within_days = -1;
+    query->details->modified_after = -1;
+    query->details->modified_before = -1;
 }
 
 CajaQuery *
@@ -98,6 +119,19 @@ caja_query_set_text (CajaQuery *query, const char *text)
     query->details->text = g_strdup (text);
 }
 
+char *
+caja_query_get_contents (CajaQuery *query)
+{
+    return g_strdup (query->details->contents);
+}
+
+void
+caja_query_set_contents (CajaQuery *query, const char *contents)
+{
+    g_free (query->details->contents);
+    query->details->contents = g_strdup (contents);
+}
+
 char *
 caja_query_get_location (CajaQuery *query)
 {
@@ -131,6 +165,313 @@ caja_query_add_mime_type (CajaQuery *query, const char *mime_type)
                                  g_strdup (mime_type));
 }
 
+void
+caja_query_get_size_range (CajaQuery *query,
+                           goffset   *min_size,
+                           goffset   *max_size)
+{
+    *min_size = query->details->min_size;
+    *max_size = query->details->max_size;
+}
+
+void
+caja_query_set_size_range (CajaQuery *query,
+                           goffset    min_size,
+                           goffset    max_size)
+{
+    query->details->min_size = min_size;
+    query->details->max_size = max_size;
+}
+
+/* Days count whole days back from the start of today, the first one
+ * being today itself, so the times don't change with each edit and
+ * searches can be narrowed. */
+static gint64
+get_start_of_day (int days)
+{
+    struct tm day;
+    time_t now;
+
+    now = time (NULL);
+    localtime_r (&now, &day);
+    day.tm_hour = 0;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+    day.tm_mday -= MAX (days - 1, 0);
+    day.tm_isdst = -1;
+
+    return mktime (&day);
+}
+
+void
+caja_query_get_modified_days (CajaQuery *query,
+                              int       *within_days,
+                              int       *not_within_days)
+{
+    *within_days = query->details->modified_within_days;
+    *not_within_days = query->details->modified_not_within_days;
+}
+
+void
+caja_query_set_modified_days (CajaQuery *query,
+                              int        within_days,
+                              int        not_within_days)
+{
+    query->details->modified_within_days = within_days;
+    query->details->modified_not_within_days = not_within_days;
+
+    /* Resolved once here rather than for every file matched. */
+    query->details->modified_after = within_days >= 0 ? get_start_of_day (within_days) : -1;
+    query->details->modified_before = not_within_days >= 0 ? get_start_of_day (not_within_days) : -1;
+}
+
+void
+caja_query_get_modified_range (CajaQuery *query,
+                               gint64    *after,
+                               gint64    *before)
+{
+    *after = query->details->modified_after;
+    *before = query->details->modified_before;
+}
+
+char *
+caja_query_get_owner (CajaQuery *query)
+{
+    return g_strdup (query->details->owner);
+}
+
+void
+caja_query_set_owner (CajaQuery *query, const char *owner)
+{
+    g_free (query->details->owner);
+    query->details->owner = g_strdup (owner);
+}
+
+GList *
+caja_query_get_extensions (CajaQuery *query)
+{
+    return eel_g_str_list_copy (query->details->extensions);
+}
+
+void
+caja_query_set_extensions (CajaQuery *query, GList *extensions)
+{
+    GList *l;
+
+    g_list_free_full (query->details->extensions, g_free);
+    query->details->extensions = NULL;
+    for (l = extensions; l != NULL; l = l->next)
+    {
+        caja_query_add_extension (query, l->data);
+    }
+}
+
+void
+caja_query_add_extension (CajaQuery *query, const char *extension)
+{
+    /* Kept without the dot and in lower case, the way they are
+     * compared. */
+    while (*extension == '.')
+    {
+        extension++;
+    }
+    if (*extension == '\0')
+    {
+        return;
+    }
+
+    query->details->extensions = g_list_append (query->details->extensions,
+                                 g_ascii_strdown (extension, -1));
+}
+
+char *
+caja_query_get_file_attributes (CajaQuery *query)
+{
+    GString *attributes;
+
+    attributes = g_string_new (NULL);
+    if (query->details->min_size >= 0 || query->details->max_size >= 0)
+    {
+        g_string_append (attributes,
+                         G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                         G_FILE_ATTRIBUTE_STANDARD_SIZE ",");
+    }
+    if (query->details->modified_after >= 0 || query->details->modified_before >= 0)
+    {
+        g_string_append (attributes, G_FILE_ATTRIBUTE_TIME_MODIFIED ",");
+    }
+    if (query->details->owner != NULL)
+    {
+        g_string_append (attributes, G_FILE_ATTRIBUTE_OWNER_USER ",");
+    }
+    if (query->details->extensions != NULL)
+    {
+        g_string_append (attributes, G_FILE_ATTRIBUTE_STANDARD_NAME ",");
+    }
+
+    if (attributes->len == 0)
+    {
+        g_string_free (attributes, TRUE);
+        return NULL;
+    }
+
+    g_string_truncate (attributes, attributes->len - 1);
+    return g_string_free (attributes, FALSE);
+}
+
+static gboolean
+has_extension (const char *name, GList *extensions)
+{
+    gsize name_length, length;
+    GList *l;
+
+    name_length = strlen (name);
+    for (l = extensions; l != NULL; l = l->next)
+    {
+        length = strlen (l->data);
+        if (name_length > length + 1 &&
+                name[name_length - length - 1] == '.' &&
+                g_ascii_strcasecmp (name + name_length - length, l->data) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+gboolean
+caja_query_matches_file_info (CajaQuery *query, GFileInfo *info)
+{
+    CajaQueryDetails *details;
+    const char *owner;
+    goffset size;
+    gint64 mtime;
+
+    details = query->details;
+
+    if (details->min_size >= 0 || details->max_size >= 0)
+    {
+        /* Folders have sizes too, but not ones anyone means. */
+        if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+        {
+            return FALSE;
+        }
+
+        size = g_file_info_get_size (info);
+        if ((details->min_size >= 0 && size < details->min_size) ||
+                (details->max_size >= 0 && size > details->max_size))
+        {
+            return FALSE;
+        }
+    }
+
+    if (details->modified_after >= 0 || details->modified_before >= 0)
+    {
+        if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+        {
+            return FALSE;
+        }
+
+        mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        if ((details->modified_after >= 0 && mtime < details->modified_after) ||
+                (details->modified_before >= 0 && mtime >= details->modified_before))
+        {
+            return FALSE;
+        }
+    }
+
+    if (details->owner != NULL)
+    {
+        owner = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_OWNER_USER);
+        if (owner == NULL || strcmp (owner, details->owner) != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    if (details->extensions != NULL &&
+            !has_extension (g_file_info_get_name (info), details->extensions))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+string_sets_equal (GList *a, GList *b)
+{
+    GList *l;
+
+    if (g_list_length (a) != g_list_length (b))
+    {
+        return FALSE;
+    }
+
+    for (l = a; l != NULL; l = l->next)
+    {
+        if (g_list_find_custom (b, l->data, (GCompareFunc) strcmp) == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Each word of previous is in a word of query, so a name with all of
+ * the words of query has all of those of previous. */
+static gboolean
+text_narrows (const char *text, const char *previous_text)
+{
+    CajaFilenameMatcher *matcher, *previous_matcher;
+    const char *previous_word;
+    gboolean narrows;
+    int i, j;
+
+    matcher = caja_filename_matcher_new (text);
+    previous_matcher = caja_filename_matcher_new (previous_text);
+
+    narrows = TRUE;
+    for (i = 0; narrows && i < caja_filename_matcher_get_n_words (previous_matcher); i++)
+    {
+        previous_word = caja_filename_matcher_get_word (previous_matcher, i, NULL);
+
+        narrows = FALSE;
+        for (j = 0; !narrows && j < caja_filename_matcher_get_n_words (matcher); j++)
+        {
+            narrows = strstr (caja_filename_matcher_get_word (matcher, j, NULL),
+                              previous_word) != NULL;
+        }
+    }
+
+    caja_filename_matcher_free (previous_matcher);
+    caja_filename_matcher_free (matcher);
+
+    return narrows;
+}
+
+gboolean
+caja_query_narrows (CajaQuery *query, CajaQuery *previous)
+{
+    g_return_val_if_fail (CAJA_IS_QUERY (query), FALSE);
+    g_return_val_if_fail (CAJA_IS_QUERY (previous), FALSE);
+
+    return g_strcmp0 (query->details->location_uri, previous->details->location_uri) == 0 &&
+           string_sets_equal (query->details->mime_types, previous->details->mime_types) &&
+           query->details->min_size == previous->details->min_size &&
+           query->details->max_size == previous->details->max_size &&
+           query->details->modified_within_days == previous->details->modified_within_days &&
+           query->details->modified_not_within_days == previous->details->modified_not_within_days &&
+           g_strcmp0 (query->details->owner, previous->details->owner) == 0 &&
+           string_sets_equal (query->details->extensions, previous->details->extensions) &&
+           g_strcmp0 (query->details->contents, previous->details->contents) == 0 &&
+           g_strcmp0 (query->details->text, previous->details->text) != 0 &&
+           text_narrows (query->details->text != NULL ? query->details->text : "",
+                         previous->details->text != NULL ? previous->details->text : "");
+}
+
 char *
 caja_query_to_readable_string (CajaQuery *query)
 {
@@ -195,9 +536,17 @@ typedef struct
 {
     CajaQuery *query;
     gboolean in_text;
+    gboolean in_contents;
     gboolean in_location;
     gboolean in_mimetypes;
     gboolean in_mimetype;
+    gboolean in_min_size;
+    gboolean in_max_size;
+    gboolean in_modified_within_days;
+    gboolean in_modified_not_within_days;
+    gboolean in_owner;
+    gboolean in_extensions;
+    gboolean in_extension;
 } ParserInfo;
 
 static void
@@ -214,12 +563,28 @@ start_element_cb (GMarkupParseContext *ctx,
 
     if (strcmp (element_name, "text") == 0)
         info->in_text = TRUE;
+    else if (strcmp (element_name, "contents") == 0)
+        info->in_contents = TRUE;
     else if (strcmp (element_name, "location") == 0)
         info->in_location = TRUE;
     else if (strcmp (element_name, "mimetypes") == 0)
         info->in_mimetypes = TRUE;
     else if (strcmp (element_name, "mimetype") == 0)
         info->in_mimetype = TRUE;
+    else if (strcmp (element_name, "minsize") == 0)
+        info->in_min_size = TRUE;
+    else if (strcmp (element_name, "maxsize") == 0)
+        info->in_max_size = TRUE;
+    else if (strcmp (element_name, "modifiedwithindays") == 0)
+        info->in_modified_within_days = TRUE;
+    else if (strcmp (element_name, "modifiednotwithindays") == 0)
+        info->in_modified_not_within_days = TRUE;
+    else if (strcmp (element_name, "owner") == 0)
+        info->in_owner = TRUE;
+    else if (strcmp (element_name, "extensions") == 0)
+        info->in_extensions = TRUE;
+    else if (strcmp (element_name, "extension") == 0)
+        info->in_extension = TRUE;
 }
 
 static void
@@ -234,12 +599,28 @@ end_element_cb (GMarkupParseContext *ctx,
 
     if (strcmp (element_name, "text") == 0)
         info->in_text = FALSE;
+    else if (strcmp (element_name, "contents") == 0)
+        info->in_contents = FALSE;
     else if (strcmp (element_name, "location") == 0)
         info->in_location = FALSE;
     else if (strcmp (element_name, "mimetypes") == 0)
         info->in_mimetypes = FALSE;
     else if (strcmp (element_name, "mimetype") == 0)
         info->in_mimetype = FALSE;
+    else if (strcmp (element_name, "minsize") == 0)
+        info->in_min_size = FALSE;
+    else if (strcmp (element_name, "maxsize") == 0)
+        info->in_max_size = FALSE;
+    else if (strcmp (element_name, "modifiedwithindays") == 0)
+        info->in_modified_within_days = FALSE;
+    else if (strcmp (element_name, "modifiednotwithindays") == 0)
+        info->in_modified_not_within_days = FALSE;
+    else if (strcmp (element_name, "owner") == 0)
+        info->in_owner = FALSE;
+    else if (strcmp (element_name, "extensions") == 0)
+        info->in_extensions = FALSE;
+    else if (strcmp (element_name, "extension") == 0)
+        info->in_extension = FALSE;
 }
 
 static void
@@ -260,6 +641,10 @@ text_cb (GMarkupParseContext *ctx,
     {
         caja_query_set_text (info->query, t);
     }
+    else if (info->in_contents)
+    {
+        caja_query_set_contents (info->query, t);
+    }
     else if (info->in_location)
     {
         uri = decode_home_uri (t);
@@ -270,6 +655,34 @@ text_cb (GMarkupParseContext *ctx,
     {
         caja_query_add_mime_type (info->query, t);
     }
+    else if (info->in_min_size)
+    {
+        info->query->details->min_size = g_ascii_strtoll (t, NULL, 10);
+    }
+    else if (info->in_max_size)
+    {
+        info->query->details->max_size = g_ascii_strtoll (t, NULL, 10);
+    }
+    else if (info->in_modified_within_days)
+    {
+        caja_query_set_modified_days (info->query,
+                                      g_ascii_strtoll (t, NULL, 10),
+                                      info->query->details->modified_not_within_days);
+    }
+    else if (info->in_modified_not_within_days)
+    {
+        caja_query_set_modified_days (info->query,
+                                      info->query->details->modified_within_days,
+                                      g_ascii_strtoll (t, NULL, 10));
+    }
+    else if (info->in_owner)
+    {
+        caja_query_set_owner (info->query, t);
+    }
+    else if (info->in_extensions && info->in_extension)
+    {
+        caja_query_add_extension (info->query, t);
+    }
 
     g_free (t);
 
@@ -351,6 +764,13 @@ caja_query_to_xml (CajaQuery *query)
     g_string_append_printf (xml, "   <text>%s</text>\n", text);
     g_free (text);
 
+    if (query->details->contents)
+    {
+        text = g_markup_escape_text (query->details->contents, -1);
+        g_string_append_printf (xml, "   <contents>%s</contents>\n", text);
+        g_free (text);
+    }
+
     if (query->details->location_uri)
     {
         uri = encode_home_uri (query->details->location_uri);
@@ -370,6 +790,46 @@ caja_query_to_xml (CajaQuery *query)
         g_string_append (xml, "   </mimetypes>\n");
     }
 
+    if (query->details->min_size >= 0)
+    {
+        g_string_append_printf (xml, "   <minsize>%" G_GINT64_FORMAT "</minsize>\n",
+                                (gint64) query->details->min_size);
+    }
+    if (query->details->max_size >= 0)
+    {
+        g_string_append_printf (xml, "   <maxsize>%" G_GINT64_FORMAT "</maxsize>\n",
+                                (gint64) query->details->max_size);
+    }
+    if (query->details->modified_within_days >= 0)
+    {
+        g_string_append_printf (xml, "   <modifiedwithindays>%d</modifiedwithindays>\n",
+                                query->details->modified_within_days);
+    }
+    if (query->details->modified_not_within_days >= 0)
+    {
+        g_string_append_printf (xml, "   <modifiednotwithindays>%d</modifiednotwithindays>\n",
+                                query->details->modified_not_within_days);
+    }
+
+    if (query->details->owner)
+    {
+        text = g_markup_escape_text (query->details->owner, -1);
+        g_string_append_printf (xml, "   <owner>%s</owner>\n", text);
+        g_free (text);
+    }
+
+    if (query->details->extensions)
+    {
+        g_string_append (xml, "   <extensions>\n");
+        for (l = query->details->extensions; l != NULL; l = l->next)
+        {
+            text = g_markup_escape_text (l->data, -1);
+            g_string_append_printf (xml, "      <extension>%s</extension>\n", text);
+            g_free (text);
+        }
+        g_string_append (xml, "   </extensions>\n");
+    }
+
     g_string_append (xml, "</query>\n");
 
     return g_string_free (xml, FALSE);
@@ -24,7 +24,7 @@
 #ifndef CAJA_QUERY_H
 #define CAJA_QUERY_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 #define CAJA_TYPE_QUERY		(caja_query_get_type ())
 #define CAJA_QUERY(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), CAJA_TYPE_QUERY, CajaQuery))
@@ -54,6 +54,10 @@ CajaQuery* caja_query_new      (void);
 char *         caja_query_get_text           (CajaQuery *query);
 void           caja_query_set_text           (CajaQuery *query, const char *text);
 
+/* Text the files found have to have in them, or NULL. */
+char *         caja_query_get_contents       (CajaQuery *query);
+void           caja_query_set_contents       (CajaQuery *query, const char *contents);
+
 char *         caja_query_get_location       (CajaQuery *query);
 void           caja_query_set_location       (CajaQuery *query, const char *uri);
 
@@ -61,6 +65,47 @@ GList *        caja_query_get_mime_types     (CajaQuery *query);
 void           caja_query_set_mime_types     (CajaQuery *query, GList *mime_types);
 void           caja_query_add_mime_type      (CajaQuery *query, const char *mime_type);
 
+/* Sizes are in bytes, with -1 where there is no limit. Files found
+ * are at least min_size and at most max_size.
+ */
+void           caja_query_get_size_range     (CajaQuery *query, goffset *min_size, goffset *max_size);
+void           caja_query_set_size_range     (CajaQuery *query, goffset min_size, goffset max_size);
+
+/* Modification times are kept as whole days back from the start of
+ * today, today being the first, with -1 where there is no limit, so
+ * saved searches stay relative to the day they are run. Files found
+ * were modified within the last within_days days and not within the
+ * last not_within_days days. The range gives the same limits in
+ * seconds since the epoch, as of when the days were set.
+ */
+void           caja_query_get_modified_days  (CajaQuery *query, int *within_days, int *not_within_days);
+void           caja_query_set_modified_days  (CajaQuery *query, int within_days, int not_within_days);
+void           caja_query_get_modified_range (CajaQuery *query, gint64 *after, gint64 *before);
+
+/* The user name of the owner of the files found, or NULL. */
+char *         caja_query_get_owner          (CajaQuery *query);
+void           caja_query_set_owner          (CajaQuery *query, const char *owner);
+
+/* File name extensions, like "jpg" or "tar.gz", one of which the files
+ * found have to end in; any case will do.
+ */
+GList *        caja_query_get_extensions     (CajaQuery *query);
+void           caja_query_set_extensions     (CajaQuery *query, GList *extensions);
+void           caja_query_add_extension      (CajaQuery *query, const char *extension);
+
+/* The attributes caja_query_matches_file_info needs, or NULL when it
+ * matches every file. It checks all but the text, location, type and
+ * contents; several threads can call it while the query is left alone.
+ */
+char *         caja_query_get_file_attributes (CajaQuery *query);
+gboolean       caja_query_matches_file_info   (CajaQuery *query, GFileInfo *info);
+
+/* Whether everything query finds, previous finds as well, so its
+ * results can be had by filtering those of previous. Equal queries
+ * don't count.
+ */
+gboolean       caja_query_narrows            (CajaQuery *query, CajaQuery *previous);
+
 char *         caja_query_to_readable_string (CajaQuery *query);
 CajaQuery *caja_query_load               (char *file);
 gboolean       caja_query_save               (CajaQuery *query, char *file);
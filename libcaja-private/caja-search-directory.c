@@ -28,6 +28,7 @@
 #include "caja-file.h"
 #include "caja-file-private.h"
 #include "caja-file-utilities.h"
+#include "caja-filename-matcher.h"
 #include "caja-search-engine.h"
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
@@ -35,6 +36,8 @@
 #include <string.h>
 #include <sys/time.h>
 
+#include <src/glibcompat.h> /* for g_list_free_full */
+
 struct CajaSearchDirectoryDetails
 {
     CajaQuery *query;
@@ -42,6 +45,16 @@ struct CajaSearchDirectoryDetails
     gboolean modified;
 
     CajaSearchEngine *engine;
+    /* For the hits of an engine still going by a query that was
+     * since narrowed. */
+    CajaFilenameMatcher *hit_filter;
+
+    /* The hits of engines that don't check the size, dates, owner
+     * and extension the query asks for are checked here first, and
+     * the search isn't done until they all are. */
+    GCancellable *hit_check_cancellable;
+    int n_hit_checks;
+    gboolean engine_finished;
 
     gboolean search_running;
     gboolean search_finished;
@@ -62,6 +75,16 @@ typedef struct
     gconstpointer client;
 } SearchMonitor;
 
+/* The hits of one hits-added being checked. */
+typedef struct
+{
+    CajaSearchDirectory *search;
+    CajaQuery *query;
+    GCancellable *cancellable;
+    GList *hits;
+    int n_pending;
+} HitCheck;
+
 typedef struct
 {
     CajaSearchDirectory *search_directory;
@@ -81,6 +104,7 @@ G_DEFINE_TYPE (CajaSearchDirectory, caja_search_directory,
 static void search_engine_hits_added (CajaSearchEngine *engine, GList *hits, CajaSearchDirectory *search);
 static void search_engine_hits_subtracted (CajaSearchEngine *engine, GList *hits, CajaSearchDirectory *search);
 static void search_engine_finished (CajaSearchEngine *engine, CajaSearchDirectory *search);
+static void finish_search (CajaSearchDirectory *search);
 static void search_engine_error (CajaSearchEngine *engine, const char *error, CajaSearchDirectory *search);
 static void search_callback_file_ready_callback (CajaFile *file, gpointer data);
 static void file_changed (CajaFile *file, CajaSearchDirectory *search);
@@ -106,6 +130,19 @@ ensure_search_engine (CajaSearchDirectory *search)
     }
 }
 
+static void
+cancel_hit_checks (CajaSearchDirectory *search)
+{
+    if (search->details->hit_check_cancellable != NULL)
+    {
+        g_cancellable_cancel (search->details->hit_check_cancellable);
+        g_object_unref (search->details->hit_check_cancellable);
+        search->details->hit_check_cancellable = NULL;
+    }
+    search->details->n_hit_checks = 0;
+    search->details->engine_finished = FALSE;
+}
+
 static void
 reset_file_list (CajaSearchDirectory *search)
 {
@@ -113,6 +150,9 @@ reset_file_list (CajaSearchDirectory *search)
     CajaFile *file;
     SearchMonitor *monitor;
 
+    /* Whatever was still being checked was for the old list. */
+    cancel_hit_checks (search);
+
     /* Remove file connections */
     for (list = search->details->files; list != NULL; list = list->next)
     {
@@ -134,6 +174,13 @@ reset_file_list (CajaSearchDirectory *search)
     search->details->files = NULL;
 }
 
+static void
+clear_hit_filter (CajaSearchDirectory *search)
+{
+    caja_filename_matcher_free (search->details->hit_filter);
+    search->details->hit_filter = NULL;
+}
+
 static void
 start_or_stop_search_engine (CajaSearchDirectory *search, gboolean adding)
 {
@@ -147,6 +194,7 @@ start_or_stop_search_engine (CajaSearchDirectory *search, gboolean adding)
         search->details->search_finished = FALSE;
         ensure_search_engine (search);
         caja_search_engine_set_query (search->details->engine, search->details->query);
+        clear_hit_filter (search);
 
         reset_file_list (search);
 
@@ -492,9 +540,38 @@ search_cancel_callback (CajaDirectory *directory,
 }
 
 
+/* Same as what the engines match, the display name of the file name. */
+static gboolean
+name_matches (CajaFilenameMatcher *matcher, const char *name)
+{
+    char *display_name;
+    gboolean matches;
+
+    display_name = g_filename_display_name (name);
+    matches = caja_filename_matcher_matches (matcher, display_name);
+    g_free (display_name);
+
+    return matches;
+}
+
+static gboolean
+uri_matches (CajaFilenameMatcher *matcher, const char *uri)
+{
+    GFile *location;
+    char *name;
+    gboolean matches;
+
+    location = g_file_new_for_uri (uri);
+    name = g_file_get_basename (location);
+    matches = name != NULL && name_matches (matcher, name);
+    g_free (name);
+    g_object_unref (location);
+
+    return matches;
+}
+
 static void
-search_engine_hits_added (CajaSearchEngine *engine, GList *hits,
-                          CajaSearchDirectory *search)
+add_hits (CajaSearchDirectory *search, GList *hits)
 {
     GList *hit_list;
     GList *file_list;
@@ -515,6 +592,12 @@ search_engine_hits_added (CajaSearchEngine *engine, GList *hits,
             continue;
         }
 
+        if (search->details->hit_filter != NULL &&
+                !uri_matches (search->details->hit_filter, uri))
+        {
+            continue;
+        }
+
         file = caja_file_get_by_uri (uri);
 
         for (monitor_list = search->details->monitor_list; monitor_list; monitor_list = monitor_list->next)
@@ -539,6 +622,116 @@ search_engine_hits_added (CajaSearchEngine *engine, GList *hits,
     caja_file_unref (file);
 }
 
+static void
+hit_check_free (HitCheck *check)
+{
+    g_object_unref (check->query);
+    g_object_unref (check->cancellable);
+    g_list_free_full (check->hits, g_free);
+    g_free (check);
+}
+
+static void
+hit_checked (GObject *source_object,
+             GAsyncResult *res,
+             gpointer user_data)
+{
+    CajaSearchDirectory *search;
+    HitCheck *check;
+    GFileInfo *info;
+
+    check = user_data;
+
+    info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+    if (info != NULL)
+    {
+        if (caja_query_matches_file_info (check->query, info))
+        {
+            check->hits = g_list_prepend (check->hits,
+                                          g_file_get_uri (G_FILE (source_object)));
+        }
+        g_object_unref (info);
+    }
+
+    if (--check->n_pending > 0)
+    {
+        return;
+    }
+
+    /* Once cancelled, the search may be gone. */
+    if (!g_cancellable_is_cancelled (check->cancellable))
+    {
+        search = check->search;
+        search->details->n_hit_checks--;
+
+        add_hits (search, check->hits);
+
+        if (search->details->n_hit_checks == 0 &&
+                search->details->engine_finished)
+        {
+            search->details->engine_finished = FALSE;
+            finish_search (search);
+        }
+    }
+
+    hit_check_free (check);
+}
+
+static void
+check_hits (CajaSearchDirectory *search, GList *hits, const char *attributes)
+{
+    HitCheck *check;
+    GFile *location;
+    GList *l;
+
+    if (search->details->hit_check_cancellable == NULL)
+    {
+        search->details->hit_check_cancellable = g_cancellable_new ();
+    }
+
+    check = g_new0 (HitCheck, 1);
+    check->search = search;
+    check->query = g_object_ref (search->details->query);
+    check->cancellable = g_object_ref (search->details->hit_check_cancellable);
+    check->n_pending = g_list_length (hits);
+    search->details->n_hit_checks++;
+
+    for (l = hits; l != NULL; l = l->next)
+    {
+        location = g_file_new_for_uri (l->data);
+        g_file_query_info_async (location, attributes, 0,
+                                 G_PRIORITY_DEFAULT,
+                                 check->cancellable,
+                                 hit_checked, check);
+        g_object_unref (location);
+    }
+}
+
+static void
+search_engine_hits_added (CajaSearchEngine *engine, GList *hits,
+                          CajaSearchDirectory *search)
+{
+    char *attributes;
+
+    attributes = NULL;
+    if (search->details->query != NULL &&
+            !caja_search_engine_checks_file_info (engine))
+    {
+        attributes = caja_query_get_file_attributes (search->details->query);
+    }
+
+    if (attributes != NULL && hits != NULL)
+    {
+        check_hits (search, hits, attributes);
+    }
+    else
+    {
+        add_hits (search, hits);
+    }
+
+    g_free (attributes);
+}
+
 static void
 search_engine_hits_subtracted (CajaSearchEngine *engine, GList *hits,
                                CajaSearchDirectory *search)
@@ -604,6 +797,18 @@ search_engine_error (CajaSearchEngine *engine, const char *error_message, CajaSe
 
 static void
 search_engine_finished (CajaSearchEngine *engine, CajaSearchDirectory *search)
+{
+    if (search->details->n_hit_checks > 0)
+    {
+        search->details->engine_finished = TRUE;
+        return;
+    }
+
+    finish_search (search);
+}
+
+static void
+finish_search (CajaSearchDirectory *search)
 {
     search->details->search_finished = TRUE;
 
@@ -645,6 +850,7 @@ search_force_reload (CajaDirectory *directory)
     {
         caja_search_engine_stop (search->details->engine);
         caja_search_engine_set_query (search->details->engine, search->details->query);
+        clear_hit_filter (search);
         caja_search_engine_start (search->details->engine);
     }
 }
@@ -745,6 +951,8 @@ search_dispose (GObject *object)
         search->details->engine = NULL;
     }
 
+    clear_hit_filter (search);
+
     G_OBJECT_CLASS (caja_search_directory_parent_class)->dispose (object);
 }
 
@@ -835,6 +1043,76 @@ caja_search_directory_set_query (CajaSearchDirectory *search,
     }
 }
 
+gboolean
+caja_search_directory_refine_query (CajaSearchDirectory *search,
+                                    CajaQuery *query)
+{
+    CajaFilenameMatcher *matcher;
+    CajaFile *file;
+    GList *list, *next, *removed, *monitor_list;
+    char *text, *name;
+    gboolean matches;
+
+    /* The hits so far have to be there, or be on their way. */
+    if (query == NULL || search->details->query == NULL ||
+            !search->details->search_running ||
+            !caja_query_narrows (query, search->details->query))
+    {
+        caja_search_directory_set_query (search, query);
+        return FALSE;
+    }
+
+    caja_search_directory_set_query (search, query);
+
+    text = caja_query_get_text (query);
+    matcher = caja_filename_matcher_new (text != NULL ? text : "");
+    g_free (text);
+
+    removed = NULL;
+    for (list = search->details->files; list != NULL; list = next)
+    {
+        next = list->next;
+        file = list->data;
+
+        name = caja_file_get_name (file);
+        matches = name_matches (matcher, name);
+        g_free (name);
+        if (matches)
+        {
+            continue;
+        }
+
+        for (monitor_list = search->details->monitor_list; monitor_list;
+                monitor_list = monitor_list->next)
+        {
+            caja_file_monitor_remove (file, monitor_list->data);
+        }
+        g_signal_handlers_disconnect_by_func (file, file_changed, search);
+
+        search->details->files = g_list_delete_link (search->details->files, list);
+        removed = g_list_prepend (removed, file);
+    }
+
+    /* Takes over from the one before, which it narrows. */
+    clear_hit_filter (search);
+    search->details->hit_filter = matcher;
+
+    if (removed != NULL)
+    {
+        caja_directory_emit_files_changed (CAJA_DIRECTORY (search), removed);
+        caja_file_list_free (removed);
+    }
+
+    /* The search file's name follows the query, so it changed even
+     * when every hit so far still matches.
+     */
+    file = caja_directory_get_corresponding_file (CAJA_DIRECTORY (search));
+    caja_file_changed (file);
+    caja_file_unref (file);
+
+    return TRUE;
+}
+
 CajaQuery *
 caja_search_directory_get_query (CajaSearchDirectory *search)
 {
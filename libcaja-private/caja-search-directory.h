@@ -70,4 +70,10 @@ CajaQuery *caja_search_directory_get_query       (CajaSearchDirectory *search);
 void           caja_search_directory_set_query       (CajaSearchDirectory *search,
         CajaQuery           *query);
 
+/* Sets query. If it only narrows the one before, the hits so far are
+ * filtered and TRUE is returned, as there is nothing to reload.
+ */
+gboolean       caja_search_directory_refine_query    (CajaSearchDirectory *search,
+        CajaQuery           *query);
+
 #endif /* CAJA_SEARCH_DIRECTORY_H */
@@ -291,7 +291,7 @@ caja_search_engine_beagle_start (CajaSearchEngine *engine)
     CajaSearchEngineBeagle *beagle;
     GError *error;
     GList *mimetypes, *l;
-    char *text, *mimetype;
+    char *text, *contents, *mimetype;
 
     error = NULL;
     beagle = CAJA_SEARCH_ENGINE_BEAGLE (engine);
@@ -322,6 +322,14 @@ caja_search_engine_beagle_start (CajaSearchEngine *engine)
     beagle_query_add_text (beagle->details->current_query,
                            text);
 
+    /* Beagle looks for the words in the text of files too. */
+    contents = caja_query_get_contents (beagle->details->query);
+    if (contents != NULL)
+    {
+        beagle_query_add_text (beagle->details->current_query, " ");
+        beagle_query_add_text (beagle->details->current_query, contents);
+    }
+
     mimetypes = caja_query_get_mime_types (beagle->details->query);
     for (l = mimetypes; l != NULL; l = l->next)
     {
@@ -343,6 +351,7 @@ caja_search_engine_beagle_start (CajaSearchEngine *engine)
 
     /* These must live during the lifetime of the query */
     g_free (text);
+    g_free (contents);
     g_list_free_full (mimetypes, g_free);
 }
 
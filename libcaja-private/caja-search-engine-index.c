@@ -0,0 +1,579 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Caja is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Caja is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <config.h>
+#include "caja-search-engine-index.h"
+#include "caja-contents-matcher.h"
+#include "caja-search-index.h"
+
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include <eel/eel-gtk-macros.h>
+#include <gio/gio.h>
+
+#include <src/glibcompat.h> /* for g_list_free_full */
+
+/* Hits are sent to the main loop this often, in seconds. */
+#define BATCH_INTERVAL 0.2
+
+typedef struct
+{
+    CajaSearchEngineIndex *engine;
+    CajaSearchIndex *index;
+    GCancellable *cancellable;
+
+    CajaFilenameMatcher *matcher;
+    CajaContentsMatcher *contents;
+    GList *mime_types;
+    char *path;
+
+    /* The query, when it has more to check than names, types and
+     * contents, and what to ask for to check it and the type. */
+    CajaQuery *query;
+    char *attributes;
+
+    GList *uri_hits;
+    GTimer *batch_timer;
+
+    GMutex *hits_mutex;
+    GList *pending_hits;
+    guint hits_idle_id;
+} IndexSearchData;
+
+struct CajaSearchEngineIndexDetails
+{
+    CajaQuery *query;
+
+    IndexSearchData *active_search;
+
+    /* The engine there would be without the index, for what the index
+     * can't answer. */
+    CajaSearchEngine *fallback;
+    gboolean fallback_active;
+};
+
+static void  caja_search_engine_index_class_init       (CajaSearchEngineIndexClass *class);
+static void  caja_search_engine_index_init             (CajaSearchEngineIndex      *engine);
+
+G_DEFINE_TYPE (CajaSearchEngineIndex,
+               caja_search_engine_index,
+               CAJA_TYPE_SEARCH_ENGINE);
+
+static CajaSearchEngineClass *parent_class = NULL;
+
+static void
+finalize (GObject *object)
+{
+    CajaSearchEngineIndex *index;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (object);
+
+    if (index->details->query)
+    {
+        g_object_unref (index->details->query);
+        index->details->query = NULL;
+    }
+
+    if (index->details->fallback)
+    {
+        g_signal_handlers_disconnect_matched (index->details->fallback,
+                                              G_SIGNAL_MATCH_DATA,
+                                              0, 0, NULL, NULL, index);
+        g_object_unref (index->details->fallback);
+        index->details->fallback = NULL;
+    }
+
+    g_free (index->details);
+
+    EEL_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
+}
+
+static IndexSearchData *
+index_search_data_new (CajaSearchEngineIndex *engine,
+                       CajaSearchIndex *index,
+                       const char *path)
+{
+    IndexSearchData *data;
+    GString *attributes;
+    char *text;
+
+    data = g_new0 (IndexSearchData, 1);
+
+    data->engine = engine;
+    data->index = index;
+    data->path = g_strdup (path);
+
+    text = caja_query_get_text (engine->details->query);
+    data->matcher = caja_filename_matcher_new (text);
+    g_free (text);
+
+    text = caja_query_get_contents (engine->details->query);
+    if (text != NULL && text[0] != '\0')
+    {
+        data->contents = caja_contents_matcher_new (text);
+    }
+    g_free (text);
+
+    data->mime_types = caja_query_get_mime_types (engine->details->query);
+
+    attributes = g_string_new (NULL);
+    if (data->mime_types != NULL)
+    {
+        g_string_append (attributes, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+    }
+    text = caja_query_get_file_attributes (engine->details->query);
+    if (text != NULL)
+    {
+        data->query = g_object_ref (engine->details->query);
+        if (attributes->len > 0)
+        {
+            g_string_append_c (attributes, ',');
+        }
+        g_string_append (attributes, text);
+        g_free (text);
+    }
+    data->attributes = g_string_free (attributes, attributes->len == 0);
+
+    data->cancellable = g_cancellable_new ();
+    data->batch_timer = g_timer_new ();
+    data->hits_mutex = g_mutex_new ();
+
+    return data;
+}
+
+static void
+index_search_data_free (IndexSearchData *data)
+{
+    caja_search_index_unref (data->index);
+    g_object_unref (data->cancellable);
+    caja_filename_matcher_free (data->matcher);
+    caja_contents_matcher_free (data->contents);
+    g_list_free_full (data->mime_types, g_free);
+    g_free (data->path);
+    if (data->query != NULL)
+    {
+        g_object_unref (data->query);
+    }
+    g_free (data->attributes);
+    g_list_free_full (data->uri_hits, g_free);
+    g_timer_destroy (data->batch_timer);
+    g_mutex_free (data->hits_mutex);
+    g_list_free_full (data->pending_hits, g_free);
+    g_free (data);
+}
+
+static void
+flush_hits (IndexSearchData *data)
+{
+    GList *uris;
+
+    g_mutex_lock (data->hits_mutex);
+    uris = data->pending_hits;
+    data->pending_hits = NULL;
+    data->hits_idle_id = 0;
+    g_mutex_unlock (data->hits_mutex);
+
+    if (uris != NULL && !g_cancellable_is_cancelled (data->cancellable))
+    {
+        caja_search_engine_hits_added (CAJA_SEARCH_ENGINE (data->engine),
+                                       uris);
+    }
+
+    g_list_free_full (uris, g_free);
+}
+
+static gboolean
+search_thread_add_hits_idle (gpointer user_data)
+{
+    flush_hits (user_data);
+
+    return FALSE;
+}
+
+static gboolean
+search_thread_done_idle (gpointer user_data)
+{
+    IndexSearchData *data;
+
+    data = user_data;
+
+    if (data->hits_idle_id != 0)
+    {
+        g_source_remove (data->hits_idle_id);
+    }
+    flush_hits (data);
+
+    if (!g_cancellable_is_cancelled (data->cancellable))
+    {
+        caja_search_engine_finished (CAJA_SEARCH_ENGINE (data->engine));
+        data->engine->details->active_search = NULL;
+    }
+
+    index_search_data_free (data);
+
+    return FALSE;
+}
+
+static void
+send_batch (IndexSearchData *data)
+{
+    g_timer_start (data->batch_timer);
+
+    if (data->uri_hits == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (data->hits_mutex);
+    data->pending_hits = g_list_concat (data->uri_hits, data->pending_hits);
+    if (data->hits_idle_id == 0)
+    {
+        data->hits_idle_id = g_idle_add (search_thread_add_hits_idle, data);
+    }
+    g_mutex_unlock (data->hits_mutex);
+
+    data->uri_hits = NULL;
+}
+
+/* The index is as of the last rescan, so the file may be gone since;
+ * anything more than that is only looked at when the query asks. */
+static gboolean
+file_is_hit (IndexSearchData *data, const char *path)
+{
+    GFile *file;
+    GFileInfo *info;
+    const char *mime_type;
+    struct stat statbuf;
+    gboolean hit;
+    GList *l;
+
+    if (data->attributes == NULL)
+    {
+        hit = g_lstat (path, &statbuf) == 0;
+    }
+    else
+    {
+        file = g_file_new_for_path (path);
+        info = g_file_query_info (file, data->attributes,
+                                  0, data->cancellable, NULL);
+        g_object_unref (file);
+        if (info == NULL)
+        {
+            return FALSE;
+        }
+
+        hit = data->query == NULL ||
+              caja_query_matches_file_info (data->query, info);
+
+        if (hit && data->mime_types != NULL)
+        {
+            hit = FALSE;
+            mime_type = g_file_info_get_content_type (info);
+            for (l = data->mime_types; mime_type != NULL && l != NULL; l = l->next)
+            {
+                if (g_content_type_equals (mime_type, l->data))
+                {
+                    hit = TRUE;
+                    break;
+                }
+            }
+        }
+        g_object_unref (info);
+    }
+
+    if (hit && data->contents != NULL)
+    {
+        hit = caja_contents_matcher_matches (data->contents, path, data->cancellable);
+    }
+
+    return hit;
+}
+
+static gboolean
+add_hit (const char *path, gpointer user_data)
+{
+    IndexSearchData *data;
+    char *uri;
+
+    data = user_data;
+
+    if (g_cancellable_is_cancelled (data->cancellable))
+    {
+        return FALSE;
+    }
+
+    if (file_is_hit (data, path))
+    {
+        uri = g_filename_to_uri (path, NULL, NULL);
+        if (uri != NULL)
+        {
+            data->uri_hits = g_list_prepend (data->uri_hits, uri);
+        }
+        if (g_timer_elapsed (data->batch_timer, NULL) >= BATCH_INTERVAL)
+        {
+            send_batch (data);
+        }
+    }
+
+    return TRUE;
+}
+
+static gpointer
+search_thread_func (gpointer user_data)
+{
+    IndexSearchData *data;
+
+    data = user_data;
+
+    caja_search_index_find (data->index, data->path, data->matcher,
+                            data->cancellable, add_hit, data);
+    send_batch (data);
+
+    g_idle_add (search_thread_done_idle, data);
+
+    return NULL;
+}
+
+static void
+fallback_hits_added (CajaSearchEngine *fallback, GList *hits, gpointer user_data)
+{
+    caja_search_engine_hits_added (CAJA_SEARCH_ENGINE (user_data), hits);
+}
+
+static void
+fallback_hits_subtracted (CajaSearchEngine *fallback, GList *hits, gpointer user_data)
+{
+    caja_search_engine_hits_subtracted (CAJA_SEARCH_ENGINE (user_data), hits);
+}
+
+static void
+fallback_finished (CajaSearchEngine *fallback, gpointer user_data)
+{
+    CAJA_SEARCH_ENGINE_INDEX (user_data)->details->fallback_active = FALSE;
+    caja_search_engine_finished (CAJA_SEARCH_ENGINE (user_data));
+}
+
+static void
+fallback_error (CajaSearchEngine *fallback, const char *error_message, gpointer user_data)
+{
+    caja_search_engine_error (CAJA_SEARCH_ENGINE (user_data), error_message);
+}
+
+static void
+start_fallback (CajaSearchEngineIndex *index)
+{
+    caja_search_engine_set_query (index->details->fallback, index->details->query);
+    caja_search_engine_start (index->details->fallback);
+    index->details->fallback_active = TRUE;
+}
+
+static void
+caja_search_engine_index_start (CajaSearchEngine *engine)
+{
+    CajaSearchEngineIndex *index;
+    CajaSearchIndex *search_index;
+    IndexSearchData *data;
+    char *uri, *path;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (engine);
+
+    if (index->details->active_search != NULL || index->details->fallback_active)
+    {
+        return;
+    }
+
+    if (index->details->query == NULL)
+    {
+        return;
+    }
+
+    /* The index only has some folders, so a search of everywhere is
+     * the fallback's to do as well. */
+    search_index = NULL;
+    path = NULL;
+    uri = caja_query_get_location (index->details->query);
+    if (uri != NULL)
+    {
+        path = g_filename_from_uri (uri, NULL, NULL);
+        g_free (uri);
+    }
+    if (path != NULL)
+    {
+        search_index = caja_search_index_ref_for_location (path);
+    }
+
+    if (search_index == NULL)
+    {
+        g_free (path);
+        start_fallback (index);
+        return;
+    }
+
+    data = index_search_data_new (index, search_index, path);
+    g_free (path);
+
+    if (!g_thread_create (search_thread_func, data, FALSE, NULL))
+    {
+        index_search_data_free (data);
+        start_fallback (index);
+        return;
+    }
+
+    index->details->active_search = data;
+}
+
+static void
+caja_search_engine_index_stop (CajaSearchEngine *engine)
+{
+    CajaSearchEngineIndex *index;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (engine);
+
+    if (index->details->active_search != NULL)
+    {
+        g_cancellable_cancel (index->details->active_search->cancellable);
+        index->details->active_search = NULL;
+    }
+
+    if (index->details->fallback_active)
+    {
+        caja_search_engine_stop (index->details->fallback);
+        index->details->fallback_active = FALSE;
+    }
+}
+
+/* Only when the index has all of where the query looks, as the
+ * search is then quick enough to redo as the query changes; anything
+ * else is as indexed as the fallback is. */
+static gboolean
+caja_search_engine_index_is_indexed (CajaSearchEngine *engine)
+{
+    CajaSearchEngineIndex *index;
+    CajaSearchIndex *search_index;
+    char *uri, *path;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (engine);
+
+    search_index = NULL;
+    if (index->details->query != NULL)
+    {
+        uri = caja_query_get_location (index->details->query);
+        path = uri != NULL ? g_filename_from_uri (uri, NULL, NULL) : NULL;
+        if (path != NULL)
+        {
+            search_index = caja_search_index_ref_for_location (path);
+        }
+        g_free (path);
+        g_free (uri);
+    }
+
+    if (search_index != NULL)
+    {
+        caja_search_index_unref (search_index);
+        return TRUE;
+    }
+
+    return caja_search_engine_is_indexed (index->details->fallback);
+}
+
+/* The fallback's hits are only as checked as it makes them. */
+static gboolean
+caja_search_engine_index_checks_file_info (CajaSearchEngine *engine)
+{
+    CajaSearchEngineIndex *index;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (engine);
+
+    return !index->details->fallback_active ||
+           caja_search_engine_checks_file_info (index->details->fallback);
+}
+
+static void
+caja_search_engine_index_set_query (CajaSearchEngine *engine, CajaQuery *query)
+{
+    CajaSearchEngineIndex *index;
+
+    index = CAJA_SEARCH_ENGINE_INDEX (engine);
+
+    if (query)
+    {
+        g_object_ref (query);
+    }
+
+    if (index->details->query)
+    {
+        g_object_unref (index->details->query);
+    }
+
+    index->details->query = query;
+}
+
+static void
+caja_search_engine_index_class_init (CajaSearchEngineIndexClass *class)
+{
+    GObjectClass *gobject_class;
+    CajaSearchEngineClass *engine_class;
+
+    parent_class = g_type_class_peek_parent (class);
+
+    gobject_class = G_OBJECT_CLASS (class);
+    gobject_class->finalize = finalize;
+
+    engine_class = CAJA_SEARCH_ENGINE_CLASS (class);
+    engine_class->set_query = caja_search_engine_index_set_query;
+    engine_class->start = caja_search_engine_index_start;
+    engine_class->stop = caja_search_engine_index_stop;
+    engine_class->is_indexed = caja_search_engine_index_is_indexed;
+    engine_class->checks_file_info = caja_search_engine_index_checks_file_info;
+}
+
+static void
+caja_search_engine_index_init (CajaSearchEngineIndex *engine)
+{
+    engine->details = g_new0 (CajaSearchEngineIndexDetails, 1);
+}
+
+
+CajaSearchEngine *
+caja_search_engine_index_new (CajaSearchEngine *fallback)
+{
+    CajaSearchEngineIndex *index;
+
+    g_return_val_if_fail (CAJA_IS_SEARCH_ENGINE (fallback), NULL);
+
+    if (!caja_search_index_is_enabled ())
+    {
+        return NULL;
+    }
+
+    index = g_object_new (CAJA_TYPE_SEARCH_ENGINE_INDEX, NULL);
+
+    index->details->fallback = fallback;
+    g_signal_connect (fallback, "hits-added",
+                      G_CALLBACK (fallback_hits_added), index);
+    g_signal_connect (fallback, "hits-subtracted",
+                      G_CALLBACK (fallback_hits_subtracted), index);
+    g_signal_connect (fallback, "finished",
+                      G_CALLBACK (fallback_finished), index);
+    g_signal_connect (fallback, "error",
+                      G_CALLBACK (fallback_error), index);
+
+    return CAJA_SEARCH_ENGINE (index);
+}
@@ -23,8 +23,11 @@
 
 #include <config.h>
 #include "caja-search-engine-simple.h"
+#include "caja-contents-matcher.h"
+#include "caja-filename-matcher.h"
 
 #include <string.h>
+#include <unistd.h>
 #include <glib.h>
 
 #include <eel/eel-gtk-macros.h>
@@ -32,24 +35,73 @@
 
 #include <src/glibcompat.h> /* for g_list_free_full */
 
-#define BATCH_SIZE 500
+/* Directories are searched by this many threads at most, as many as
+ * there are processors otherwise. */
+#define MAX_SEARCH_WORKERS 8
+
+/* Hits are sent to the main loop this often, in seconds. */
+#define BATCH_INTERVAL 0.2
+
+/* Seen directories are kept in this many separately locked tables. */
+#define N_VISITED_SHARDS 16
+
+typedef struct SearchThreadData SearchThreadData;
 
 typedef struct
+{
+    SearchThreadData *data;
+    int index;
+
+    /* Directories waiting to be visited, GFiles. The worker takes
+     * its own from the tail and the others steal from the head. */
+    GMutex *mutex;
+    GQueue directories;
+
+    GList *uri_hits;
+    GTimer *batch_timer;
+} SearchWorker;
+
+typedef struct
+{
+    GMutex *mutex;
+    GHashTable *ids;
+} VisitedShard;
+
+struct SearchThreadData
 {
     CajaSearchEngineSimple *engine;
     GCancellable *cancellable;
 
+    /* Only there when it has more to check than the name, type and
+     * contents. */
+    CajaQuery *query;
+    char *attributes;
+
     GList *mime_types;
-    char **words;
-    GList *found_list;
+    CajaFilenameMatcher *matcher;
+    CajaContentsMatcher *contents;
 
-    GQueue *directories; /* GFiles */
+    GFile *location;
 
-    GHashTable *visited;
+    SearchWorker *workers;
+    int n_workers;
+    volatile gint n_running_workers;
 
-    gint n_processed_files;
-    GList *uri_hits;
-} SearchThreadData;
+    /* Directories queued or being visited, with the generation
+     * bumped whenever one is queued, so idle workers know when to
+     * look again. */
+    GMutex *work_mutex;
+    GCond *work_cond;
+    int n_pending;
+    guint generation;
+    int n_waiting;
+
+    VisitedShard visited[N_VISITED_SHARDS];
+
+    GMutex *hits_mutex;
+    GList *pending_hits;
+    guint hits_idle_id;
+};
 
 
 struct CajaSearchEngineSimpleDetails
@@ -89,61 +141,176 @@ finalize (GObject *object)
     EEL_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
 }
 
+static int
+get_n_search_workers (void)
+{
+    static int n_workers = 0;
+    long n_processors;
+
+    if (n_workers == 0)
+    {
+        n_processors = sysconf (_SC_NPROCESSORS_ONLN);
+        n_workers = CLAMP (n_processors, 1, MAX_SEARCH_WORKERS);
+    }
+
+    return n_workers;
+}
+
+#define STD_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+	G_FILE_ATTRIBUTE_ID_FILE
+
 static SearchThreadData *
 search_thread_data_new (CajaSearchEngineSimple *engine,
                         CajaQuery *query)
 {
     SearchThreadData *data;
-    char *text, *lower, *normalized, *uri;
-    GFile *location;
+    SearchWorker *worker;
+    GString *attributes;
+    char *text, *uri;
+    int i;
 
     data = g_new0 (SearchThreadData, 1);
 
     data->engine = engine;
-    data->directories = g_queue_new ();
-    data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
     uri = caja_query_get_location (query);
-    location = NULL;
     if (uri != NULL)
     {
-        location = g_file_new_for_uri (uri);
+        data->location = g_file_new_for_uri (uri);
         g_free (uri);
     }
-    if (location == NULL)
+    if (data->location == NULL)
     {
-        location = g_file_new_for_path ("/");
+        data->location = g_file_new_for_path ("/");
     }
-    g_queue_push_tail (data->directories, location);
 
     text = caja_query_get_text (query);
-    normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
-    lower = g_utf8_strdown (normalized, -1);
-    data->words = g_strsplit (lower, " ", -1);
+    data->matcher = caja_filename_matcher_new (text);
+    g_free (text);
+
+    text = caja_query_get_contents (query);
+    if (text != NULL && text[0] != '\0')
+    {
+        data->contents = caja_contents_matcher_new (text);
+    }
     g_free (text);
-    g_free (lower);
-    g_free (normalized);
 
     data->mime_types = caja_query_get_mime_types (query);
 
+    /* Asking for no more than the query needs saves a stat, a user
+     * name lookup or a content sniff for every file. */
+    attributes = g_string_new (STD_ATTRIBUTES);
+    if (data->mime_types != NULL)
+    {
+        g_string_append (attributes, "," G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+    }
+    text = caja_query_get_file_attributes (query);
+    if (text != NULL)
+    {
+        data->query = g_object_ref (query);
+        g_string_append_c (attributes, ',');
+        g_string_append (attributes, text);
+        g_free (text);
+    }
+    data->attributes = g_string_free (attributes, FALSE);
+
     data->cancellable = g_cancellable_new ();
 
+    data->n_workers = get_n_search_workers ();
+    data->workers = g_new0 (SearchWorker, data->n_workers);
+    for (i = 0; i < data->n_workers; i++)
+    {
+        worker = &data->workers[i];
+        worker->data = data;
+        worker->index = i;
+        worker->mutex = g_mutex_new ();
+        g_queue_init (&worker->directories);
+        worker->batch_timer = g_timer_new ();
+    }
+
+    data->work_mutex = g_mutex_new ();
+    data->work_cond = g_cond_new ();
+    /* The location, queued by the first worker once it is in visited. */
+    data->n_pending = 1;
+
+    for (i = 0; i < N_VISITED_SHARDS; i++)
+    {
+        data->visited[i].mutex = g_mutex_new ();
+        data->visited[i].ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    data->hits_mutex = g_mutex_new ();
+
     return data;
 }
 
 static void
 search_thread_data_free (SearchThreadData *data)
 {
-    g_queue_foreach (data->directories,
-                     (GFunc)g_object_unref, NULL);
-    g_queue_free (data->directories);
-    g_hash_table_destroy (data->visited);
+    SearchWorker *worker;
+    int i;
+
+    for (i = 0; i < data->n_workers; i++)
+    {
+        worker = &data->workers[i];
+        g_queue_foreach (&worker->directories,
+                         (GFunc)g_object_unref, NULL);
+        g_queue_clear (&worker->directories);
+        g_mutex_free (worker->mutex);
+        g_list_free_full (worker->uri_hits, g_free);
+        g_timer_destroy (worker->batch_timer);
+    }
+    g_free (data->workers);
+
+    g_mutex_free (data->work_mutex);
+    g_cond_free (data->work_cond);
+
+    for (i = 0; i < N_VISITED_SHARDS; i++)
+    {
+        g_mutex_free (data->visited[i].mutex);
+        g_hash_table_destroy (data->visited[i].ids);
+    }
+
+    g_mutex_free (data->hits_mutex);
+    g_list_free_full (data->pending_hits, g_free);
+
+    g_object_unref (data->location);
     g_object_unref (data->cancellable);
-    g_strfreev (data->words);
+    caja_filename_matcher_free (data->matcher);
+    caja_contents_matcher_free (data->contents);
+    if (data->query != NULL)
+    {
+        g_object_unref (data->query);
+    }
+    g_free (data->attributes);
     g_list_free_full (data->mime_types, g_free);
-    g_list_free_full (data->uri_hits, g_free);
     g_free (data);
 }
 
+/* Hands the hits the workers have sent so far to the engine. */
+static void
+flush_hits (SearchThreadData *data)
+{
+    GList *uris;
+
+    g_mutex_lock (data->hits_mutex);
+    uris = data->pending_hits;
+    data->pending_hits = NULL;
+    data->hits_idle_id = 0;
+    g_mutex_unlock (data->hits_mutex);
+
+    if (uris != NULL && !g_cancellable_is_cancelled (data->cancellable))
+    {
+        caja_search_engine_hits_added (CAJA_SEARCH_ENGINE (data->engine),
+                                       uris);
+    }
+
+    g_list_free_full (uris, g_free);
+}
+
 static gboolean
 search_thread_done_idle (gpointer user_data)
 {
@@ -151,6 +318,14 @@ search_thread_done_idle (gpointer user_data)
 
     data = user_data;
 
+    /* All the workers are gone, so nobody adds hits any more; the
+     * ones still waiting go out before we are done. */
+    if (data->hits_idle_id != 0)
+    {
+        g_source_remove (data->hits_idle_id);
+    }
+    flush_hits (data);
+
     if (!g_cancellable_is_cancelled (data->cancellable))
     {
         caja_search_engine_finished (CAJA_SEARCH_ENGINE (data->engine));
@@ -162,77 +337,215 @@ search_thread_done_idle (gpointer user_data)
     return FALSE;
 }
 
-typedef struct
+static gboolean
+search_thread_add_hits_idle (gpointer user_data)
 {
-    GList *uris;
-    SearchThreadData *thread_data;
-} SearchHits;
+    flush_hits (user_data);
+
+    return FALSE;
+}
+
+static void
+send_batch (SearchWorker *worker)
+{
+    SearchThreadData *data;
+
+    data = worker->data;
+
+    g_timer_start (worker->batch_timer);
 
+    if (worker->uri_hits == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (data->hits_mutex);
+    data->pending_hits = g_list_concat (worker->uri_hits, data->pending_hits);
+    if (data->hits_idle_id == 0)
+    {
+        data->hits_idle_id = g_idle_add (search_thread_add_hits_idle, data);
+    }
+    g_mutex_unlock (data->hits_mutex);
+
+    worker->uri_hits = NULL;
+}
+
+/* Checked after every file rather than every hit, so a hit that is
+ * followed by a long stretch of files that aren't still shows up in
+ * time.
+ */
+static void
+send_batch_if_due (SearchWorker *worker)
+{
+    if (g_timer_elapsed (worker->batch_timer, NULL) >= BATCH_INTERVAL)
+    {
+        send_batch (worker);
+    }
+}
 
+/* Returns TRUE if the directory with this id wasn't seen before. */
 static gboolean
-search_thread_add_hits_idle (gpointer user_data)
+mark_visited (SearchThreadData *data, const char *id)
 {
-    SearchHits *hits;
+    VisitedShard *shard;
+    gboolean is_new;
 
-    hits = user_data;
+    shard = &data->visited[g_str_hash (id) % N_VISITED_SHARDS];
 
-    if (!g_cancellable_is_cancelled (hits->thread_data->cancellable))
+    g_mutex_lock (shard->mutex);
+    is_new = !g_hash_table_lookup_extended (shard->ids, id, NULL, NULL);
+    if (is_new)
     {
-        caja_search_engine_hits_added (CAJA_SEARCH_ENGINE (hits->thread_data->engine),
-                                       hits->uris);
+        g_hash_table_insert (shard->ids, g_strdup (id), NULL);
     }
+    g_mutex_unlock (shard->mutex);
 
-    g_list_free_full (hits->uris, g_free);
-    g_free (hits);
+    return is_new;
+}
 
-    return FALSE;
+/* Takes over the reference to dir. */
+static void
+queue_directory (SearchWorker *worker, GFile *dir)
+{
+    SearchThreadData *data;
+
+    data = worker->data;
+
+    g_mutex_lock (worker->mutex);
+    g_queue_push_tail (&worker->directories, dir);
+    g_mutex_unlock (worker->mutex);
+
+    g_mutex_lock (data->work_mutex);
+    data->n_pending++;
+    data->generation++;
+    if (data->n_waiting > 0)
+    {
+        g_cond_signal (data->work_cond);
+    }
+    g_mutex_unlock (data->work_mutex);
 }
 
 static void
-send_batch (SearchThreadData *data)
+directory_done (SearchThreadData *data)
 {
-    SearchHits *hits;
+    g_mutex_lock (data->work_mutex);
+    data->n_pending--;
+    if (data->n_pending == 0)
+    {
+        g_cond_broadcast (data->work_cond);
+    }
+    g_mutex_unlock (data->work_mutex);
+}
 
-    data->n_processed_files = 0;
+/* Own directories first, depth first, then the oldest ones of the
+ * other workers, which tend to be the biggest subtrees. */
+static GFile *
+find_directory (SearchWorker *worker)
+{
+    SearchThreadData *data;
+    SearchWorker *victim;
+    GFile *dir;
+    int i;
+
+    data = worker->data;
+
+    g_mutex_lock (worker->mutex);
+    dir = g_queue_pop_tail (&worker->directories);
+    g_mutex_unlock (worker->mutex);
 
-    if (data->uri_hits)
+    for (i = 1; dir == NULL && i < data->n_workers; i++)
     {
-        hits = g_new (SearchHits, 1);
-        hits->uris = data->uri_hits;
-        hits->thread_data = data;
-        g_idle_add (search_thread_add_hits_idle, hits);
+        victim = &data->workers[(worker->index + i) % data->n_workers];
+        g_mutex_lock (victim->mutex);
+        dir = g_queue_pop_head (&victim->directories);
+        g_mutex_unlock (victim->mutex);
     }
-    data->uri_hits = NULL;
+
+    return dir;
 }
 
-#define STD_ATTRIBUTES \
-	G_FILE_ATTRIBUTE_STANDARD_NAME "," \
-	G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
-	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
-	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
-	G_FILE_ATTRIBUTE_ID_FILE
+/* Returns NULL once every directory has been visited, or the search
+ * is cancelled. */
+static GFile *
+get_next_directory (SearchWorker *worker)
+{
+    SearchThreadData *data;
+    GFile *dir;
+    guint generation;
+    GTimeVal timeout;
+
+    data = worker->data;
+
+    g_mutex_lock (data->work_mutex);
+    while (data->n_pending > 0 &&
+            !g_cancellable_is_cancelled (data->cancellable))
+    {
+        generation = data->generation;
+        g_mutex_unlock (data->work_mutex);
+
+        dir = find_directory (worker);
+        if (dir != NULL)
+        {
+            return dir;
+        }
+
+        /* Nothing to do until someone queues more; the timeout is
+         * for noticing cancellation. */
+        g_mutex_lock (data->work_mutex);
+        if (data->generation == generation && data->n_pending > 0)
+        {
+            send_batch (worker);
+            g_get_current_time (&timeout);
+            g_time_val_add (&timeout, G_USEC_PER_SEC / 10);
+            data->n_waiting++;
+            g_cond_timed_wait (data->work_cond, data->work_mutex, &timeout);
+            data->n_waiting--;
+        }
+    }
+    g_mutex_unlock (data->work_mutex);
+
+    return NULL;
+}
+
+/* Only local files are searched for contents, since they are read
+ * with plain system calls rather than through GIO. The workers share
+ * out the directories, so the files of different ones are searched in
+ * parallel.
+ */
+static gboolean
+contents_match (SearchThreadData *data, GFile *file, GFileInfo *info)
+{
+    char *path;
+    gboolean match;
+
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+    {
+        return FALSE;
+    }
+
+    path = g_file_get_path (file);
+    match = path != NULL &&
+            caja_contents_matcher_matches (data->contents, path, data->cancellable);
+    g_free (path);
+
+    return match;
+}
 
 static void
-visit_directory (GFile *dir, SearchThreadData *data)
+visit_directory (GFile *dir, SearchWorker *worker)
 {
+    SearchThreadData *data;
     GFileEnumerator *enumerator;
     GFileInfo *info;
     GFile *child;
     const char *mime_type, *display_name;
-    char *lower_name, *normalized;
-    gboolean hit;
-    int i;
+    gboolean hit, is_directory;
     GList *l;
     const char *id;
-    gboolean visited;
-
-    enumerator = g_file_enumerate_children (dir,
-                                            data->mime_types != NULL ?
-                                            STD_ATTRIBUTES ","
-                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
-                                            :
-                                            STD_ATTRIBUTES
-                                            ,
+
+    data = worker->data;
+
+    enumerator = g_file_enumerate_children (dir, data->attributes,
                                             0, data->cancellable, NULL);
 
     if (enumerator == NULL)
@@ -253,20 +566,12 @@ visit_directory (GFile *dir, SearchThreadData *data)
             goto next;
         }
 
-        normalized = g_utf8_normalize (display_name, -1, G_NORMALIZE_NFD);
-        lower_name = g_utf8_strdown (normalized, -1);
-        g_free (normalized);
+        hit = caja_filename_matcher_matches (data->matcher, display_name);
 
-        hit = TRUE;
-        for (i = 0; data->words[i] != NULL; i++)
+        if (hit && data->query != NULL)
         {
-            if (strstr (lower_name, data->words[i]) == NULL)
-            {
-                hit = FALSE;
-                break;
-            }
+            hit = caja_query_matches_file_info (data->query, info);
         }
-        g_free (lower_name);
 
         if (hit && data->mime_types)
         {
@@ -283,83 +588,97 @@ visit_directory (GFile *dir, SearchThreadData *data)
             }
         }
 
+        /* Most entries are neither, and need no GFile at all. */
+        is_directory = g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY;
+        if (!hit && !is_directory)
+        {
+            goto next;
+        }
+
         child = g_file_get_child (dir, g_file_info_get_name (info));
 
-        if (hit)
+        /* The slowest test by far, so it comes last. */
+        if (hit && data->contents != NULL)
         {
-            data->uri_hits = g_list_prepend (data->uri_hits, g_file_get_uri (child));
+            hit = contents_match (data, child, info);
         }
 
-        data->n_processed_files++;
-        if (data->n_processed_files > BATCH_SIZE)
+        if (hit)
         {
-            send_batch (data);
+            worker->uri_hits = g_list_prepend (worker->uri_hits, g_file_get_uri (child));
         }
 
-        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        if (is_directory)
         {
             id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-            visited = FALSE;
-            if (id)
+            if (id == NULL || mark_visited (data, id))
             {
-                if (g_hash_table_lookup_extended (data->visited,
-                                                  id, NULL, NULL))
-                {
-                    visited = TRUE;
-                }
-                else
-                {
-                    g_hash_table_insert (data->visited, g_strdup (id), NULL);
-                }
-            }
-
-            if (!visited)
-            {
-                g_queue_push_tail (data->directories, g_object_ref (child));
+                queue_directory (worker, g_object_ref (child));
             }
         }
 
         g_object_unref (child);
 next:
         g_object_unref (info);
+        send_batch_if_due (worker);
     }
 
     g_object_unref (enumerator);
 }
 
-
-static gpointer
-search_thread_func (gpointer user_data)
+static void
+queue_location (SearchWorker *worker)
 {
     SearchThreadData *data;
-    GFile *dir;
     GFileInfo *info;
     const char *id;
 
-    data = user_data;
+    data = worker->data;
 
     /* Insert id for toplevel directory into visited */
-    dir = g_queue_peek_head (data->directories);
-    info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
+    info = g_file_query_info (data->location, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
     if (info)
     {
         id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
         if (id)
         {
-            g_hash_table_insert (data->visited, g_strdup (id), NULL);
+            mark_visited (data, id);
         }
         g_object_unref (info);
     }
 
-    while (!g_cancellable_is_cancelled (data->cancellable) &&
-            (dir = g_queue_pop_head (data->directories)) != NULL)
+    queue_directory (worker, g_object_ref (data->location));
+    directory_done (data);
+}
+
+static gpointer
+search_thread_func (gpointer user_data)
+{
+    SearchWorker *worker;
+    SearchThreadData *data;
+    GFile *dir;
+
+    worker = user_data;
+    data = worker->data;
+
+    if (worker->index == 0)
     {
-        visit_directory (dir, data);
+        queue_location (worker);
+    }
+
+    while ((dir = get_next_directory (worker)) != NULL)
+    {
+        visit_directory (dir, worker);
         g_object_unref (dir);
+        directory_done (data);
+        send_batch_if_due (worker);
     }
-    send_batch (data);
+    send_batch (worker);
 
-    g_idle_add (search_thread_done_idle, data);
+    if (g_atomic_int_dec_and_test (&data->n_running_workers))
+    {
+        g_idle_add (search_thread_done_idle, data);
+    }
 
     return NULL;
 }
@@ -369,6 +688,7 @@ caja_search_engine_simple_start (CajaSearchEngine *engine)
 {
     CajaSearchEngineSimple *simple;
     SearchThreadData *data;
+    int i;
 
     simple = CAJA_SEARCH_ENGINE_SIMPLE (engine);
 
@@ -384,7 +704,11 @@ caja_search_engine_simple_start (CajaSearchEngine *engine)
 
     data = search_thread_data_new (simple, simple->details->query);
 
-    g_thread_create (search_thread_func, data, FALSE, NULL);
+    data->n_running_workers = data->n_workers;
+    for (i = 0; i < data->n_workers; i++)
+    {
+        g_thread_create (search_thread_func, &data->workers[i], FALSE, NULL);
+    }
 
     simple->details->active_search = data;
 }
@@ -409,6 +733,12 @@ caja_search_engine_simple_is_indexed (CajaSearchEngine *engine)
     return FALSE;
 }
 
+static gboolean
+caja_search_engine_simple_checks_file_info (CajaSearchEngine *engine)
+{
+    return TRUE;
+}
+
 static void
 caja_search_engine_simple_set_query (CajaSearchEngine *engine, CajaQuery *query)
 {
@@ -445,6 +775,7 @@ caja_search_engine_simple_class_init (CajaSearchEngineSimpleClass *class)
     engine_class->start = caja_search_engine_simple_start;
     engine_class->stop = caja_search_engine_simple_stop;
     engine_class->is_indexed = caja_search_engine_simple_is_indexed;
+    engine_class->checks_file_info = caja_search_engine_simple_checks_file_info;
 }
 
 static void
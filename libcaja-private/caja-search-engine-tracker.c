@@ -316,7 +316,7 @@ caja_search_engine_tracker_start (CajaSearchEngine *engine)
 {
     CajaSearchEngineTracker *tracker;
     GList 	*mimetypes, *l;
-    char 	*search_text, *location, *location_uri;
+    char 	*search_text, *text, *contents, *location, *location_uri;
     char 	**mimes;
     int 	i, mime_count;
     GString *sparql;
@@ -336,6 +336,17 @@ caja_search_engine_tracker_start (CajaSearchEngine *engine)
 
     search_text = caja_query_get_text (tracker->details->query);
 
+    /* Tracker matches the words against the text of files as well as
+     * their names, so contents are just more words for it. */
+    contents = caja_query_get_contents (tracker->details->query);
+    if (contents != NULL)
+    {
+        text = search_text;
+        search_text = g_strconcat (text, " ", contents, NULL);
+        g_free (text);
+        g_free (contents);
+    }
+
     mimetypes = caja_query_get_mime_types (tracker->details->query);
 
     location_uri = caja_query_get_location (tracker->details->query);
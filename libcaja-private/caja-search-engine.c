@@ -24,6 +24,7 @@
 #include <config.h>
 #include "caja-search-engine.h"
 #include "caja-search-engine-beagle.h"
+#include "caja-search-engine-index.h"
 #include "caja-search-engine-simple.h"
 #include "caja-search-engine-tracker.h"
 
@@ -126,21 +127,25 @@ caja_search_engine_init (CajaSearchEngine *engine)
 CajaSearchEngine *
 caja_search_engine_new (void)
 {
-    CajaSearchEngine *engine;
+    CajaSearchEngine *engine, *index;
 
     engine = caja_search_engine_tracker_new ();
-    if (engine)
+    if (engine == NULL)
+    {
+        engine = caja_search_engine_beagle_new ();
+    }
+    if (engine == NULL)
     {
-        return engine;
+        engine = caja_search_engine_simple_new ();
     }
 
-    engine = caja_search_engine_beagle_new ();
-    if (engine)
+    /* Only there when asked for, and then in front of the others. */
+    index = caja_search_engine_index_new (engine);
+    if (index)
     {
-        return engine;
+        return index;
     }
 
-    engine = caja_search_engine_simple_new ();
     return engine;
 }
 
@@ -181,6 +186,19 @@ caja_search_engine_is_indexed (CajaSearchEngine *engine)
     return CAJA_SEARCH_ENGINE_GET_CLASS (engine)->is_indexed (engine);
 }
 
+gboolean
+caja_search_engine_checks_file_info (CajaSearchEngine *engine)
+{
+    g_return_val_if_fail (CAJA_IS_SEARCH_ENGINE (engine), FALSE);
+
+    if (CAJA_SEARCH_ENGINE_GET_CLASS (engine)->checks_file_info == NULL)
+    {
+        return FALSE;
+    }
+
+    return CAJA_SEARCH_ENGINE_GET_CLASS (engine)->checks_file_info (engine);
+}
+
 void
 caja_search_engine_hits_added (CajaSearchEngine *engine, GList *hits)
 {
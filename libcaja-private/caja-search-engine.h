@@ -51,6 +51,9 @@ typedef struct
     void (*start) (CajaSearchEngine *engine);
     void (*stop) (CajaSearchEngine *engine);
     gboolean (*is_indexed) (CajaSearchEngine *engine);
+    /* Whether hits already have the size, dates, owner and extension
+     * the query asks for; unset means they don't. */
+    gboolean (*checks_file_info) (CajaSearchEngine *engine);
 
     /* Signals */
     void (*hits_added) (CajaSearchEngine *engine, GList *hits);
@@ -68,6 +71,7 @@ void           caja_search_engine_set_query (CajaSearchEngine *engine, CajaQuery
 void	       caja_search_engine_start (CajaSearchEngine *engine);
 void	       caja_search_engine_stop (CajaSearchEngine *engine);
 gboolean       caja_search_engine_is_indexed (CajaSearchEngine *engine);
+gboolean       caja_search_engine_checks_file_info (CajaSearchEngine *engine);
 
 void	       caja_search_engine_hits_added (CajaSearchEngine *engine, GList *hits);
 void	       caja_search_engine_hits_subtracted (CajaSearchEngine *engine, GList *hits);
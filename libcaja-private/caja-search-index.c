@@ -0,0 +1,1733 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-search-index.c: Index of the file names in the indexed folders.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-search-index.h"
+
+#include "caja-file-utilities.h"
+#include "caja-global-preferences.h"
+#include "caja-lib-self-check-functions.h"
+
+#include <eel/eel-debug.h>
+#include <glib/gstdio.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INDEX_FILE_NAME "search-index"
+#define INDEX_MAGIC "CAJASIX1"
+
+#define NO_ENTRY G_MAXUINT32
+
+/* The mtime of directories that were changed in the second they were
+ * read in, which doesn't tell whether they changed since. */
+#define MTIME_UNKNOWN 1
+
+/* Every directory is looked at again this often, in seconds, and the
+ * ones whose mtime changed are read again. */
+#define RESCAN_INTERVAL (15 * 60)
+
+/* How long to wait after a monitored directory changes, in seconds,
+ * for more changes to come along. */
+#define CHANGE_RESCAN_DELAY 10
+
+/* The indexed folders and the directories right in them are
+ * monitored, up to this many of them; changes further down wait for
+ * the next rescan. */
+#define MAX_MONITORED_DIRECTORIES 256
+
+/* The file is the header, the entries, their names, the trigram
+ * table and the postings, all in host byte order. */
+typedef struct
+{
+    char magic[8];
+    guint32 n_entries;
+    guint32 n_trigrams;
+    guint32 entries_offset;
+    guint32 names_offset;
+    guint32 names_size;
+    guint32 trigrams_offset;
+    guint32 postings_offset;
+    guint32 postings_size;
+} IndexHeader;
+
+/* Entries come after their parents, and the entries of a directory
+ * come right after each other. The indexed folders themselves have
+ * no parent, and their full path as the name. */
+typedef struct
+{
+    guint32 parent;
+    guint32 name;
+    /* 0 for anything but directories. */
+    guint32 mtime;
+} IndexEntry;
+
+/* Sorted by trigram, which is three bytes of a name, folded the way
+ * CajaFilenameMatcher folds them, in the low 24 bits. The postings
+ * are the entries with the trigram, in ascending order, as varint
+ * encoded differences. */
+typedef struct
+{
+    guint32 trigram;
+    guint32 postings;
+    guint32 n_postings;
+} IndexTrigram;
+
+struct CajaSearchIndex
+{
+    volatile gint ref_count;
+    GMappedFile *file;
+    char **roots;
+    const IndexEntry *entries;
+    guint32 n_entries;
+    const char *names;
+    guint32 names_size;
+    const IndexTrigram *trigrams;
+    guint32 n_trigrams;
+    const guchar *postings;
+    guint32 postings_size;
+};
+
+typedef struct
+{
+    GArray *entries;
+    GString *names;
+} IndexBuilder;
+
+typedef struct
+{
+    GByteArray *bytes;
+    guint32 last;
+    guint32 n_postings;
+} TrigramPostings;
+
+typedef struct
+{
+    char **roots;
+    char *path;
+    volatile gint cancelled;
+
+    /* The index before, whose unchanged directories are copied. */
+    CajaSearchIndex *old;
+    guint32 *first_child;
+    guint32 *next_sibling;
+
+    IndexBuilder builder;
+    dev_t device;
+
+    CajaSearchIndex *result;
+} IndexUpdate;
+
+typedef struct
+{
+    char **roots;
+    char *path;
+    CajaSearchIndex *current;
+    IndexUpdate *update;
+    gboolean update_again;
+    guint rescan_timeout_id;
+    guint change_timeout_id;
+    GList *monitors;
+} SearchIndexState;
+
+static SearchIndexState *search_index = NULL;
+
+static CajaSearchIndex *
+search_index_ref (CajaSearchIndex *index)
+{
+    g_atomic_int_inc (&index->ref_count);
+    return index;
+}
+
+void
+caja_search_index_unref (CajaSearchIndex *index)
+{
+    if (index == NULL || !g_atomic_int_dec_and_test (&index->ref_count))
+    {
+        return;
+    }
+
+    g_strfreev (index->roots);
+    g_mapped_file_unref (index->file);
+    g_free (index);
+}
+
+/* Whether path is directory or in it, or only in it. */
+static gboolean
+path_is_in (const char *path, const char *directory, gboolean or_at)
+{
+    gsize length;
+
+    length = strlen (directory);
+    while (length > 0 && directory[length - 1] == G_DIR_SEPARATOR)
+    {
+        length--;
+    }
+
+    return strncmp (path, directory, length) == 0 &&
+           (path[length] == G_DIR_SEPARATOR ||
+            (or_at && path[length] == '\0'));
+}
+
+static const char *
+get_display_name (const char *name, char **display_name)
+{
+    if (g_utf8_validate (name, -1, NULL))
+    {
+        *display_name = NULL;
+        return name;
+    }
+
+    *display_name = g_filename_display_name (name);
+    return *display_name;
+}
+
+/* Folds name the way CajaFilenameMatcher does before looking for the
+ * words in it, so that each trigram of a word is in the names it is
+ * in. */
+static char *
+fold_name (const char *name)
+{
+    const char *display_name, *p;
+    char *converted, *normalized, *folded;
+
+    display_name = get_display_name (name, &converted);
+
+    for (p = display_name; *p != '\0' && (guchar) *p < 0x80; p++)
+    {
+    }
+    if (*p == '\0')
+    {
+        folded = g_ascii_strdown (display_name, -1);
+    }
+    else
+    {
+        normalized = g_utf8_normalize (display_name, -1, G_NORMALIZE_NFD);
+        folded = normalized == NULL ? g_strdup ("") : g_utf8_strdown (normalized, -1);
+        g_free (normalized);
+    }
+    g_free (converted);
+
+    return folded;
+}
+
+static guint32
+get_trigram (const char *text)
+{
+    return ((guint32) (guchar) text[0] << 16) |
+           ((guint32) (guchar) text[1] << 8) |
+           (guint32) (guchar) text[2];
+}
+
+static void
+append_varint (GByteArray *bytes, guint32 value)
+{
+    guint8 byte;
+
+    while (value >= 0x80)
+    {
+        byte = (value & 0x7f) | 0x80;
+        g_byte_array_append (bytes, &byte, 1);
+        value >>= 7;
+    }
+    byte = value;
+    g_byte_array_append (bytes, &byte, 1);
+}
+
+static gboolean
+read_varint (const guchar **p, const guchar *end, guint32 *value)
+{
+    guint32 result;
+    int shift;
+
+    result = 0;
+    for (shift = 0; shift < 35 && *p < end; shift += 7)
+    {
+        result |= (guint32) (**p & 0x7f) << shift;
+        if ((*(*p)++ & 0x80) == 0)
+        {
+            *value = result;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+builder_init (IndexBuilder *builder)
+{
+    builder->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+    builder->names = g_string_new (NULL);
+}
+
+static void
+builder_clear (IndexBuilder *builder)
+{
+    g_array_free (builder->entries, TRUE);
+    g_string_free (builder->names, TRUE);
+}
+
+static guint32
+builder_add (IndexBuilder *builder,
+             guint32 parent,
+             const char *name,
+             guint32 mtime)
+{
+    IndexEntry entry;
+
+    entry.parent = parent;
+    entry.name = builder->names->len;
+    entry.mtime = mtime;
+    g_string_append_len (builder->names, name, strlen (name) + 1);
+    g_array_append_val (builder->entries, entry);
+
+    return builder->entries->len - 1;
+}
+
+static int
+compare_trigrams (gconstpointer a, gconstpointer b)
+{
+    guint32 trigram_a, trigram_b;
+
+    trigram_a = *(const guint32 *) a;
+    trigram_b = *(const guint32 *) b;
+
+    return trigram_a < trigram_b ? -1 : trigram_a > trigram_b;
+}
+
+static void
+trigram_postings_free (gpointer data)
+{
+    TrigramPostings *postings;
+
+    postings = data;
+    g_byte_array_free (postings->bytes, TRUE);
+    g_free (postings);
+}
+
+/* Adds entry to the postings of each trigram of its name, once. */
+static void
+builder_add_postings (IndexBuilder *builder,
+                      GHashTable *postings,
+                      GArray *trigrams,
+                      guint32 id)
+{
+    const IndexEntry *entry;
+    TrigramPostings *trigram_postings;
+    char *folded;
+    gsize length, i;
+    guint32 trigram, previous;
+
+    entry = &g_array_index (builder->entries, IndexEntry, id);
+    folded = fold_name (builder->names->str + entry->name);
+    length = strlen (folded);
+
+    g_array_set_size (trigrams, 0);
+    for (i = 0; i + 3 <= length; i++)
+    {
+        trigram = get_trigram (folded + i);
+        g_array_append_val (trigrams, trigram);
+    }
+    g_free (folded);
+
+    g_array_sort (trigrams, compare_trigrams);
+
+    previous = 0;
+    for (i = 0; i < trigrams->len; i++)
+    {
+        trigram = g_array_index (trigrams, guint32, i);
+        if (trigram == previous)
+        {
+            continue;
+        }
+        previous = trigram;
+
+        trigram_postings = g_hash_table_lookup (postings, GUINT_TO_POINTER (trigram));
+        if (trigram_postings == NULL)
+        {
+            trigram_postings = g_new0 (TrigramPostings, 1);
+            trigram_postings->bytes = g_byte_array_new ();
+            g_hash_table_insert (postings, GUINT_TO_POINTER (trigram), trigram_postings);
+        }
+        append_varint (trigram_postings->bytes, id - trigram_postings->last);
+        trigram_postings->last = id;
+        trigram_postings->n_postings++;
+    }
+}
+
+/* Whether index has the same entries as builder, which means it would
+ * be written out just the same. */
+static gboolean
+builder_equals_index (IndexBuilder *builder, CajaSearchIndex *index)
+{
+    return index != NULL &&
+           index->n_entries == builder->entries->len &&
+           index->names_size == builder->names->len &&
+           memcmp (index->entries, builder->entries->data,
+                   builder->entries->len * sizeof (IndexEntry)) == 0 &&
+           memcmp (index->names, builder->names->str, builder->names->len) == 0;
+}
+
+static gboolean
+write_padding (FILE *file, guint32 offset, guint32 aligned_offset)
+{
+    static const char zeroes[4] = { 0 };
+
+    return fwrite (zeroes, 1, aligned_offset - offset, file) == aligned_offset - offset;
+}
+
+#define ALIGN_4(offset) (((offset) + 3) & ~(guint64) 3)
+
+/* Writes the index next to path and moves it there when done, so
+ * that whoever has the old one mapped keeps it as it was. */
+static gboolean
+builder_write (IndexBuilder *builder, const char *path)
+{
+    GHashTable *postings;
+    TrigramPostings *trigram_postings;
+    GArray *trigrams, *keys;
+    GHashTableIter iter;
+    gpointer key;
+    IndexHeader header;
+    IndexTrigram trigram;
+    guint64 size, postings_size;
+    char *temporary_path;
+    FILE *file;
+    gboolean written;
+    guint32 id, i;
+    int fd;
+
+    postings = g_hash_table_new_full (NULL, NULL, NULL, trigram_postings_free);
+    trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+    for (id = 0; id < builder->entries->len; id++)
+    {
+        /* The indexed folders are never found, only what is in them. */
+        if (g_array_index (builder->entries, IndexEntry, id).parent != NO_ENTRY)
+        {
+            builder_add_postings (builder, postings, trigrams, id);
+        }
+    }
+    g_array_free (trigrams, TRUE);
+
+    keys = g_array_sized_new (FALSE, FALSE, sizeof (guint32), g_hash_table_size (postings));
+    postings_size = 0;
+    g_hash_table_iter_init (&iter, postings);
+    while (g_hash_table_iter_next (&iter, &key, (gpointer *) &trigram_postings))
+    {
+        trigram.trigram = GPOINTER_TO_UINT (key);
+        g_array_append_val (keys, trigram.trigram);
+        postings_size += trigram_postings->bytes->len;
+    }
+    g_array_sort (keys, compare_trigrams);
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+    header.n_entries = builder->entries->len;
+    header.n_trigrams = keys->len;
+    header.entries_offset = sizeof (IndexHeader);
+    size = header.entries_offset + (guint64) builder->entries->len * sizeof (IndexEntry);
+    header.names_offset = size;
+    header.names_size = builder->names->len;
+    size = ALIGN_4 (size + builder->names->len);
+    header.trigrams_offset = size;
+    size += (guint64) keys->len * sizeof (IndexTrigram);
+    header.postings_offset = size;
+    header.postings_size = postings_size;
+    size += postings_size;
+
+    written = FALSE;
+    file = NULL;
+    temporary_path = g_strconcat (path, ".XXXXXX", NULL);
+    if (size <= G_MAXUINT32 && builder->names->len > 0)
+    {
+        /* Each its own, as a cancelled update may still be writing. */
+        fd = g_mkstemp (temporary_path);
+        if (fd >= 0)
+        {
+            file = fdopen (fd, "wb");
+            if (file == NULL)
+            {
+                close (fd);
+                g_unlink (temporary_path);
+            }
+        }
+    }
+
+    if (file != NULL)
+    {
+        written = fwrite (&header, sizeof (header), 1, file) == 1 &&
+                  fwrite (builder->entries->data, sizeof (IndexEntry),
+                          builder->entries->len, file) == builder->entries->len &&
+                  fwrite (builder->names->str, 1, builder->names->len, file) == builder->names->len &&
+                  write_padding (file, header.names_offset + header.names_size,
+                                 header.trigrams_offset);
+
+        trigram.postings = 0;
+        for (i = 0; written && i < keys->len; i++)
+        {
+            trigram.trigram = g_array_index (keys, guint32, i);
+            trigram_postings = g_hash_table_lookup (postings, GUINT_TO_POINTER (trigram.trigram));
+            trigram.n_postings = trigram_postings->n_postings;
+            written = fwrite (&trigram, sizeof (trigram), 1, file) == 1;
+            trigram.postings += trigram_postings->bytes->len;
+        }
+        for (i = 0; written && i < keys->len; i++)
+        {
+            trigram_postings = g_hash_table_lookup (postings,
+                                                    GUINT_TO_POINTER (g_array_index (keys, guint32, i)));
+            written = fwrite (trigram_postings->bytes->data, 1,
+                              trigram_postings->bytes->len, file) == trigram_postings->bytes->len;
+        }
+
+        written = fclose (file) == 0 && written &&
+                  g_rename (temporary_path, path) == 0;
+        if (!written)
+        {
+            g_unlink (temporary_path);
+        }
+    }
+
+    g_free (temporary_path);
+    g_array_free (keys, TRUE);
+    g_hash_table_destroy (postings);
+
+    return written;
+}
+
+/* Whether all postings of trigram can be read and are ids of entries,
+ * as the searches use them without looking. */
+static gboolean
+postings_are_valid (CajaSearchIndex *index, const IndexTrigram *trigram)
+{
+    const guchar *p, *end;
+    guint64 id;
+    guint32 delta, n;
+
+    p = index->postings + trigram->postings;
+    end = index->postings + index->postings_size;
+    id = 0;
+
+    for (n = 0; n < trigram->n_postings; n++)
+    {
+        if (!read_varint (&p, end, &delta))
+        {
+            return FALSE;
+        }
+        id += delta;
+        if (id >= index->n_entries)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Maps the index at path, checking it enough that a damaged file
+ * can't make us read outside of it. */
+static CajaSearchIndex *
+search_index_load (const char *path)
+{
+    CajaSearchIndex *index;
+    GMappedFile *file;
+    const char *contents;
+    const IndexHeader *header;
+    GPtrArray *roots;
+    guint64 length;
+    gboolean valid;
+    guint32 i;
+
+    file = g_mapped_file_new (path, FALSE, NULL);
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    contents = g_mapped_file_get_contents (file);
+    length = g_mapped_file_get_length (file);
+    header = (const IndexHeader *) contents;
+
+    if (length < sizeof (IndexHeader) ||
+            memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+            header->entries_offset != sizeof (IndexHeader) ||
+            header->entries_offset + (guint64) header->n_entries * sizeof (IndexEntry) > length ||
+            header->names_size == 0 ||
+            header->names_offset + (guint64) header->names_size > length ||
+            contents[header->names_offset + header->names_size - 1] != '\0' ||
+            header->trigrams_offset % 4 != 0 ||
+            header->trigrams_offset + (guint64) header->n_trigrams * sizeof (IndexTrigram) > length ||
+            header->postings_offset + (guint64) header->postings_size > length)
+    {
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    index = g_new0 (CajaSearchIndex, 1);
+    index->ref_count = 1;
+    index->file = file;
+    index->entries = (const IndexEntry *) (contents + header->entries_offset);
+    index->n_entries = header->n_entries;
+    index->names = contents + header->names_offset;
+    index->names_size = header->names_size;
+    index->trigrams = (const IndexTrigram *) (contents + header->trigrams_offset);
+    index->n_trigrams = header->n_trigrams;
+    index->postings = (const guchar *) contents + header->postings_offset;
+    index->postings_size = header->postings_size;
+
+    roots = g_ptr_array_new ();
+    for (i = 0; i < index->n_entries; i++)
+    {
+        if (index->entries[i].name >= header->names_size ||
+                (index->entries[i].parent != NO_ENTRY && index->entries[i].parent >= i))
+        {
+            break;
+        }
+        if (index->entries[i].parent == NO_ENTRY)
+        {
+            g_ptr_array_add (roots, g_strdup (index->names + index->entries[i].name));
+        }
+    }
+    valid = i == index->n_entries;
+    for (i = 0; valid && i < index->n_trigrams; i++)
+    {
+        valid = index->trigrams[i].postings <= index->postings_size &&
+                postings_are_valid (index, &index->trigrams[i]);
+    }
+    g_ptr_array_add (roots, NULL);
+    index->roots = (char **) g_ptr_array_free (roots, FALSE);
+
+    if (!valid)
+    {
+        caja_search_index_unref (index);
+        return NULL;
+    }
+
+    return index;
+}
+
+static const IndexTrigram *
+lookup_trigram (CajaSearchIndex *index, guint32 trigram)
+{
+    guint32 low, high, middle;
+
+    low = 0;
+    high = index->n_trigrams;
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (index->trigrams[middle].trigram < trigram)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < index->n_trigrams && index->trigrams[low].trigram == trigram)
+    {
+        return &index->trigrams[low];
+    }
+    return NULL;
+}
+
+/* Keeps the ids in ids that are in the postings of trigram as well,
+ * or puts all of those in when ids is empty and all is set. */
+static void
+intersect_postings (CajaSearchIndex *index,
+                    const IndexTrigram *trigram,
+                    GArray *ids,
+                    gboolean all)
+{
+    const guchar *p, *end;
+    guint32 id, delta, i, j, n;
+
+    p = index->postings + trigram->postings;
+    end = index->postings + index->postings_size;
+    id = 0;
+    i = j = 0;
+
+    for (n = 0; n < trigram->n_postings && read_varint (&p, end, &delta); n++)
+    {
+        id += delta;
+        if (all)
+        {
+            g_array_append_val (ids, id);
+            continue;
+        }
+
+        while (i < ids->len && g_array_index (ids, guint32, i) < id)
+        {
+            i++;
+        }
+        if (i == ids->len)
+        {
+            break;
+        }
+        if (g_array_index (ids, guint32, i) == id)
+        {
+            g_array_index (ids, guint32, j++) = id;
+            i++;
+        }
+    }
+
+    if (!all)
+    {
+        g_array_set_size (ids, j);
+    }
+}
+
+static int
+compare_trigrams_by_postings (gconstpointer a, gconstpointer b)
+{
+    const IndexTrigram *trigram_a, *trigram_b;
+
+    trigram_a = *(const IndexTrigram * const *) a;
+    trigram_b = *(const IndexTrigram * const *) b;
+
+    return trigram_a->n_postings < trigram_b->n_postings ? -1 :
+           trigram_a->n_postings > trigram_b->n_postings;
+}
+
+/* The entries whose names have every trigram of the words, which is
+ * every entry that can match, or NULL when the words are too short to
+ * have any. */
+static GArray *
+find_candidates (CajaSearchIndex *index, CajaFilenameMatcher *matcher)
+{
+    GArray *candidates;
+    GPtrArray *trigrams;
+    const IndexTrigram *trigram;
+    const char *word;
+    gsize length, i;
+    int n;
+
+    trigrams = g_ptr_array_new ();
+    for (n = 0; n < caja_filename_matcher_get_n_words (matcher); n++)
+    {
+        word = caja_filename_matcher_get_word (matcher, n, &length);
+        for (i = 0; i + 3 <= length; i++)
+        {
+            trigram = lookup_trigram (index, get_trigram (word + i));
+            if (trigram == NULL)
+            {
+                g_ptr_array_free (trigrams, TRUE);
+                return g_array_new (FALSE, FALSE, sizeof (guint32));
+            }
+            g_ptr_array_add (trigrams, (gpointer) trigram);
+        }
+    }
+
+    if (trigrams->len == 0)
+    {
+        g_ptr_array_free (trigrams, TRUE);
+        return NULL;
+    }
+
+    /* Rarest first, so the list to go through is short from the start. */
+    g_ptr_array_sort (trigrams, compare_trigrams_by_postings);
+
+    candidates = g_array_new (FALSE, FALSE, sizeof (guint32));
+    intersect_postings (index, g_ptr_array_index (trigrams, 0), candidates, TRUE);
+    for (i = 1; i < trigrams->len && candidates->len > 0; i++)
+    {
+        if (g_ptr_array_index (trigrams, i) != g_ptr_array_index (trigrams, i - 1))
+        {
+            intersect_postings (index, g_ptr_array_index (trigrams, i), candidates, FALSE);
+        }
+    }
+    g_ptr_array_free (trigrams, TRUE);
+
+    return candidates;
+}
+
+static void
+get_entry_path (CajaSearchIndex *index, guint32 id, GArray *ancestors, GString *path)
+{
+    const char *name;
+    int i;
+
+    g_array_set_size (ancestors, 0);
+    for (; id != NO_ENTRY; id = index->entries[id].parent)
+    {
+        g_array_append_val (ancestors, id);
+    }
+
+    g_string_truncate (path, 0);
+    for (i = ancestors->len - 1; i >= 0; i--)
+    {
+        name = index->names + index->entries[g_array_index (ancestors, guint32, i)].name;
+        if (path->len > 0 && path->str[path->len - 1] != G_DIR_SEPARATOR)
+        {
+            g_string_append_c (path, G_DIR_SEPARATOR);
+        }
+        g_string_append (path, name);
+    }
+}
+
+void
+caja_search_index_find (CajaSearchIndex *index,
+                        const char *path,
+                        CajaFilenameMatcher *matcher,
+                        GCancellable *cancellable,
+                        CajaSearchIndexHitFunc callback,
+                        gpointer callback_data)
+{
+    GArray *candidates, *ancestors;
+    GString *hit_path;
+    const IndexEntry *entry;
+    const char *display_name;
+    char *converted;
+    gboolean hit;
+    guint32 n, i, id;
+
+    g_return_if_fail (index != NULL);
+    g_return_if_fail (matcher != NULL);
+    g_return_if_fail (callback != NULL);
+
+    candidates = find_candidates (index, matcher);
+    n = candidates != NULL ? candidates->len : index->n_entries;
+
+    ancestors = g_array_new (FALSE, FALSE, sizeof (guint32));
+    hit_path = g_string_new (NULL);
+
+    for (i = 0; i < n; i++)
+    {
+        if (i % 4096 == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        id = candidates != NULL ? g_array_index (candidates, guint32, i) : i;
+        entry = &index->entries[id];
+        if (entry->parent == NO_ENTRY)
+        {
+            continue;
+        }
+
+        display_name = get_display_name (index->names + entry->name, &converted);
+        hit = caja_filename_matcher_matches (matcher, display_name);
+        g_free (converted);
+        if (!hit)
+        {
+            continue;
+        }
+
+        get_entry_path (index, id, ancestors, hit_path);
+        if (path != NULL && !path_is_in (hit_path->str, path, FALSE))
+        {
+            continue;
+        }
+
+        if (!(* callback) (hit_path->str, callback_data))
+        {
+            break;
+        }
+    }
+
+    g_string_free (hit_path, TRUE);
+    g_array_free (ancestors, TRUE);
+    if (candidates != NULL)
+    {
+        g_array_free (candidates, TRUE);
+    }
+}
+
+static guint32
+get_directory_mtime (const struct stat *statbuf)
+{
+    /* A change later in the same second wouldn't show. */
+    if (statbuf->st_mtime >= time (NULL) - 1)
+    {
+        return MTIME_UNKNOWN;
+    }
+    return CLAMP (statbuf->st_mtime, MTIME_UNKNOWN + 1, G_MAXUINT32);
+}
+
+/* Same as G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN, which is what the
+ * simple search engine goes by. */
+static gboolean
+is_hidden (const char *name, GHashTable *hidden_names)
+{
+    gsize length;
+
+    length = strlen (name);
+    return name[0] == '.' ||
+           (length > 0 && name[length - 1] == '~') ||
+           (hidden_names != NULL && g_hash_table_lookup_extended (hidden_names, name, NULL, NULL));
+}
+
+static GHashTable *
+read_hidden_names (const char *directory)
+{
+    GHashTable *hidden_names;
+    char *path, *contents, **lines;
+    int i;
+
+    path = g_build_filename (directory, ".hidden", NULL);
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+        g_free (path);
+        return NULL;
+    }
+    g_free (path);
+
+    hidden_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    lines = g_strsplit (contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        g_hash_table_insert (hidden_names, lines[i], NULL);
+    }
+    g_free (lines);
+    g_free (contents);
+
+    return hidden_names;
+}
+
+typedef struct
+{
+    guint32 id;
+    guint32 old_id;
+} CrawlDirectory;
+
+/* Adds a directory found in path, which is only gone into when it is
+ * on the same file system as the indexed folder. */
+static void
+add_directory (IndexUpdate *update,
+               GString *path,
+               guint32 parent,
+               const char *name,
+               guint32 old_id,
+               GArray *directories)
+{
+    CrawlDirectory directory;
+    struct stat statbuf;
+    gsize length;
+
+    length = path->len;
+    if (length == 0 || path->str[length - 1] != G_DIR_SEPARATOR)
+    {
+        g_string_append_c (path, G_DIR_SEPARATOR);
+    }
+    g_string_append (path, name);
+
+    if (g_lstat (path->str, &statbuf) == 0 && S_ISDIR (statbuf.st_mode) &&
+            statbuf.st_dev == update->device)
+    {
+        directory.id = builder_add (&update->builder, parent, name,
+                                    get_directory_mtime (&statbuf));
+        directory.old_id = old_id;
+        g_array_append_val (directories, directory);
+    }
+    else
+    {
+        builder_add (&update->builder, parent, name, 0);
+    }
+
+    g_string_truncate (path, length);
+}
+
+static void
+add_changed_children (IndexUpdate *update,
+                      GString *path,
+                      guint32 id,
+                      GArray *directories)
+{
+    GHashTable *hidden_names;
+    struct dirent *dirent;
+    DIR *dir;
+    gboolean is_directory;
+
+    dir = opendir (path->str);
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    hidden_names = read_hidden_names (path->str);
+
+    while ((dirent = readdir (dir)) != NULL)
+    {
+        if (is_hidden (dirent->d_name, hidden_names))
+        {
+            continue;
+        }
+
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (dirent->d_type != DT_UNKNOWN)
+        {
+            is_directory = dirent->d_type == DT_DIR;
+        }
+        else
+#endif
+        {
+            /* add_directory finds out. */
+            is_directory = TRUE;
+        }
+
+        if (is_directory)
+        {
+            add_directory (update, path, id, dirent->d_name, NO_ENTRY, directories);
+        }
+        else
+        {
+            builder_add (&update->builder, id, dirent->d_name, 0);
+        }
+    }
+
+    closedir (dir);
+    if (hidden_names != NULL)
+    {
+        g_hash_table_destroy (hidden_names);
+    }
+}
+
+/* Copies the children of a directory whose mtime is the same as in
+ * the old index, so none were added, removed or renamed. */
+static void
+add_unchanged_children (IndexUpdate *update,
+                        GString *path,
+                        guint32 id,
+                        guint32 old_id,
+                        GArray *directories)
+{
+    const IndexEntry *old_entry;
+    const char *name;
+    guint32 child;
+
+    for (child = update->first_child[old_id]; child != NO_ENTRY;
+            child = update->next_sibling[child])
+    {
+        old_entry = &update->old->entries[child];
+        name = update->old->names + old_entry->name;
+        if (old_entry->mtime != 0)
+        {
+            add_directory (update, path, id, name, child, directories);
+        }
+        else
+        {
+            builder_add (&update->builder, id, name, 0);
+        }
+    }
+}
+
+static void
+crawl_directory (IndexUpdate *update, GString *path, guint32 id, guint32 old_id)
+{
+    GArray *directories;
+    CrawlDirectory *directory;
+    guint32 mtime;
+    gsize length;
+    guint i;
+
+    directories = g_array_new (FALSE, FALSE, sizeof (CrawlDirectory));
+
+    mtime = g_array_index (update->builder.entries, IndexEntry, id).mtime;
+    if (old_id != NO_ENTRY && mtime != MTIME_UNKNOWN &&
+            update->old->entries[old_id].mtime == mtime)
+    {
+        add_unchanged_children (update, path, id, old_id, directories);
+    }
+    else
+    {
+        add_changed_children (update, path, id, directories);
+    }
+
+    /* Children first, so that those of each directory stay together. */
+    for (i = 0; i < directories->len && !g_atomic_int_get (&update->cancelled); i++)
+    {
+        directory = &g_array_index (directories, CrawlDirectory, i);
+
+        length = path->len;
+        if (length == 0 || path->str[length - 1] != G_DIR_SEPARATOR)
+        {
+            g_string_append_c (path, G_DIR_SEPARATOR);
+        }
+        g_string_append (path, update->builder.names->str +
+                         g_array_index (update->builder.entries, IndexEntry, directory->id).name);
+
+        crawl_directory (update, path, directory->id, directory->old_id);
+
+        g_string_truncate (path, length);
+    }
+
+    g_array_free (directories, TRUE);
+}
+
+static void
+link_old_children (IndexUpdate *update)
+{
+    guint32 i, n_entries;
+
+    n_entries = update->old->n_entries;
+    update->first_child = g_new (guint32, n_entries);
+    update->next_sibling = g_new (guint32, n_entries);
+    memset (update->first_child, 0xff, n_entries * sizeof (guint32));
+
+    for (i = n_entries; i-- > 0;)
+    {
+        update->next_sibling[i] = NO_ENTRY;
+        if (update->old->entries[i].parent != NO_ENTRY)
+        {
+            update->next_sibling[i] = update->first_child[update->old->entries[i].parent];
+            update->first_child[update->old->entries[i].parent] = i;
+        }
+    }
+}
+
+static guint32
+find_old_root (IndexUpdate *update, const char *root)
+{
+    guint32 i;
+
+    for (i = 0; update->old != NULL && i < update->old->n_entries; i++)
+    {
+        if (update->old->entries[i].parent == NO_ENTRY &&
+                strcmp (update->old->names + update->old->entries[i].name, root) == 0)
+        {
+            return i;
+        }
+    }
+
+    return NO_ENTRY;
+}
+
+static void
+index_update_free (IndexUpdate *update)
+{
+    g_strfreev (update->roots);
+    g_free (update->path);
+    caja_search_index_unref (update->old);
+    caja_search_index_unref (update->result);
+    g_free (update->first_child);
+    g_free (update->next_sibling);
+    g_free (update);
+}
+
+static void
+stop_monitoring (SearchIndexState *state)
+{
+    GList *l;
+
+    for (l = state->monitors; l != NULL; l = l->next)
+    {
+        g_file_monitor_cancel (l->data);
+        g_object_unref (l->data);
+    }
+    g_list_free (state->monitors);
+    state->monitors = NULL;
+}
+
+static void start_update (void);
+
+static gboolean
+change_timeout_callback (gpointer data)
+{
+    search_index->change_timeout_id = 0;
+    start_update ();
+
+    return FALSE;
+}
+
+static void
+directory_changed (GFileMonitor *monitor,
+                   GFile *child,
+                   GFile *other_file,
+                   GFileMonitorEvent event_type,
+                   gpointer callback_data)
+{
+    char *name, *other_name;
+    gboolean hidden;
+
+    /* Only those change names. */
+    if (search_index == NULL ||
+            (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+             event_type != G_FILE_MONITOR_EVENT_DELETED &&
+             event_type != G_FILE_MONITOR_EVENT_MOVED))
+    {
+        return;
+    }
+
+    /* Hidden files aren't indexed, and some come and go all the time. */
+    name = g_file_get_basename (child);
+    other_name = other_file != NULL ? g_file_get_basename (other_file) : NULL;
+    hidden = is_hidden (name, NULL) &&
+             (other_name == NULL || is_hidden (other_name, NULL));
+    g_free (name);
+    g_free (other_name);
+    if (hidden)
+    {
+        return;
+    }
+
+    if (search_index->change_timeout_id == 0)
+    {
+        search_index->change_timeout_id =
+            g_timeout_add_seconds (CHANGE_RESCAN_DELAY, change_timeout_callback, NULL);
+    }
+}
+
+static void
+monitor_directory (SearchIndexState *state, const char *path)
+{
+    GFileMonitor *monitor;
+    GFile *location;
+
+    location = g_file_new_for_path (path);
+    monitor = g_file_monitor_directory (location, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref (location);
+
+    if (monitor != NULL)
+    {
+        g_signal_connect (monitor, "changed",
+                          G_CALLBACK (directory_changed), NULL);
+        state->monitors = g_list_prepend (state->monitors, monitor);
+    }
+}
+
+static void
+start_monitoring (SearchIndexState *state)
+{
+    CajaSearchIndex *index;
+    char *path;
+    guint32 root, i;
+    int n_monitors;
+
+    index = state->current;
+    n_monitors = 0;
+
+    for (root = 0; root < index->n_entries && n_monitors < MAX_MONITORED_DIRECTORIES; root++)
+    {
+        if (index->entries[root].parent != NO_ENTRY)
+        {
+            continue;
+        }
+
+        monitor_directory (state, index->names + index->entries[root].name);
+        n_monitors++;
+
+        /* The entries of a directory are right after each other, and
+         * those of an indexed folder right after it. */
+        for (i = root + 1; i < index->n_entries &&
+                index->entries[i].parent == root &&
+                n_monitors < MAX_MONITORED_DIRECTORIES; i++)
+        {
+            if (index->entries[i].mtime != 0)
+            {
+                path = g_build_filename (index->names + index->entries[root].name,
+                                         index->names + index->entries[i].name, NULL);
+                monitor_directory (state, path);
+                g_free (path);
+                n_monitors++;
+            }
+        }
+    }
+}
+
+static void
+set_current_index (SearchIndexState *state, CajaSearchIndex *index)
+{
+    stop_monitoring (state);
+    caja_search_index_unref (state->current);
+    state->current = index;
+
+    if (index != NULL)
+    {
+        start_monitoring (state);
+    }
+}
+
+static gboolean
+index_loaded_idle (gpointer data)
+{
+    CajaSearchIndex *index;
+
+    index = data;
+
+    /* Unless the rescan is done already, or was stopped. */
+    if (search_index != NULL && search_index->current == NULL &&
+            search_index->update != NULL && search_index->update->old == index)
+    {
+        set_current_index (search_index, index);
+    }
+    else
+    {
+        caja_search_index_unref (index);
+    }
+
+    return FALSE;
+}
+
+static gboolean
+index_update_done_idle (gpointer data)
+{
+    IndexUpdate *update;
+
+    update = data;
+
+    if (search_index != NULL && search_index->update == update)
+    {
+        search_index->update = NULL;
+
+        if (update->result != NULL)
+        {
+            set_current_index (search_index, update->result);
+            update->result = NULL;
+        }
+
+        if (search_index->update_again)
+        {
+            search_index->update_again = FALSE;
+            start_update ();
+        }
+    }
+
+    index_update_free (update);
+
+    return FALSE;
+}
+
+static gpointer
+index_update_thread_func (gpointer data)
+{
+    IndexUpdate *update;
+    struct stat statbuf;
+    GString *path;
+    guint32 id;
+    int i;
+
+    update = data;
+
+    /* The one from the last session is good enough until it is
+     * brought up to date. */
+    if (update->old == NULL)
+    {
+        update->old = search_index_load (update->path);
+        if (update->old != NULL)
+        {
+            g_idle_add (index_loaded_idle, search_index_ref (update->old));
+        }
+    }
+
+    if (update->old != NULL)
+    {
+        link_old_children (update);
+    }
+
+    builder_init (&update->builder);
+    path = g_string_new (NULL);
+
+    for (i = 0; update->roots[i] != NULL && !g_atomic_int_get (&update->cancelled); i++)
+    {
+        if (g_stat (update->roots[i], &statbuf) != 0 || !S_ISDIR (statbuf.st_mode))
+        {
+            continue;
+        }
+
+        update->device = statbuf.st_dev;
+        id = builder_add (&update->builder, NO_ENTRY, update->roots[i],
+                          get_directory_mtime (&statbuf));
+        g_string_assign (path, update->roots[i]);
+        crawl_directory (update, path, id, find_old_root (update, update->roots[i]));
+    }
+
+    g_string_free (path, TRUE);
+
+    /* Nothing changed most of the time, and then the index is left
+     * as it is. */
+    if (!g_atomic_int_get (&update->cancelled) &&
+            !builder_equals_index (&update->builder, update->old) &&
+            builder_write (&update->builder, update->path))
+    {
+        update->result = search_index_load (update->path);
+    }
+    builder_clear (&update->builder);
+
+    g_idle_add (index_update_done_idle, update);
+
+    return NULL;
+}
+
+static void
+start_update (void)
+{
+    IndexUpdate *update;
+
+    if (search_index->update != NULL)
+    {
+        search_index->update_again = TRUE;
+        return;
+    }
+
+    if (search_index->roots[0] == NULL)
+    {
+        return;
+    }
+
+    update = g_new0 (IndexUpdate, 1);
+    update->roots = g_strdupv (search_index->roots);
+    update->path = g_strdup (search_index->path);
+    if (search_index->current != NULL)
+    {
+        update->old = search_index_ref (search_index->current);
+    }
+
+    search_index->update = update;
+    if (!g_thread_create (index_update_thread_func, update, FALSE, NULL))
+    {
+        search_index->update = NULL;
+        index_update_free (update);
+    }
+}
+
+static gboolean
+rescan_timeout_callback (gpointer data)
+{
+    start_update ();
+
+    return TRUE;
+}
+
+static void
+stop_update (SearchIndexState *state)
+{
+    /* The thread sees this, and the idle frees it. */
+    if (state->update != NULL)
+    {
+        g_atomic_int_set (&state->update->cancelled, TRUE);
+        state->update = NULL;
+    }
+    state->update_again = FALSE;
+}
+
+/* The folders in the settings, as absolute paths without a trailing
+ * slash, with ~ standing for the home directory. */
+static char **
+get_roots (void)
+{
+    GPtrArray *roots;
+    char **folders, *root;
+    gsize length;
+    int i;
+
+    folders = g_settings_get_strv (caja_preferences, CAJA_PREFERENCES_SEARCH_INDEX_ROOTS);
+
+    roots = g_ptr_array_new ();
+    for (i = 0; folders[i] != NULL; i++)
+    {
+        if (folders[i][0] == '~' &&
+                (folders[i][1] == '\0' || folders[i][1] == G_DIR_SEPARATOR))
+        {
+            root = g_build_filename (g_get_home_dir (), folders[i] + 1, NULL);
+        }
+        else if (g_path_is_absolute (folders[i]))
+        {
+            root = g_strdup (folders[i]);
+        }
+        else
+        {
+            continue;
+        }
+
+        length = strlen (root);
+        while (length > 1 && root[length - 1] == G_DIR_SEPARATOR)
+        {
+            root[--length] = '\0';
+        }
+        g_ptr_array_add (roots, root);
+    }
+    g_ptr_array_add (roots, NULL);
+    g_strfreev (folders);
+
+    return (char **) g_ptr_array_free (roots, FALSE);
+}
+
+static void
+roots_changed_callback (GSettings *settings,
+                        const char *key,
+                        gpointer callback_data)
+{
+    g_strfreev (search_index->roots);
+    search_index->roots = get_roots ();
+
+    stop_update (search_index);
+    if (search_index->roots[0] == NULL)
+    {
+        set_current_index (search_index, NULL);
+    }
+    else if (search_index->rescan_timeout_id != 0)
+    {
+        /* Already in use, so bring it up to date now. */
+        start_update ();
+    }
+}
+
+static void
+destroy_search_index (void)
+{
+    g_signal_handlers_disconnect_by_func (caja_preferences,
+                                          roots_changed_callback, NULL);
+    stop_update (search_index);
+    set_current_index (search_index, NULL);
+    if (search_index->rescan_timeout_id != 0)
+    {
+        g_source_remove (search_index->rescan_timeout_id);
+    }
+    if (search_index->change_timeout_id != 0)
+    {
+        g_source_remove (search_index->change_timeout_id);
+    }
+    g_strfreev (search_index->roots);
+    g_free (search_index->path);
+    g_free (search_index);
+    search_index = NULL;
+}
+
+static SearchIndexState *
+get_search_index (void)
+{
+    char *user_directory;
+
+    if (search_index == NULL)
+    {
+        search_index = g_new0 (SearchIndexState, 1);
+        search_index->roots = get_roots ();
+        user_directory = caja_get_user_directory ();
+        search_index->path = g_build_filename (user_directory, INDEX_FILE_NAME, NULL);
+        g_free (user_directory);
+
+        g_signal_connect (caja_preferences,
+                          "changed::" CAJA_PREFERENCES_SEARCH_INDEX_ROOTS,
+                          G_CALLBACK (roots_changed_callback), NULL);
+        eel_debug_call_at_shutdown (destroy_search_index);
+    }
+
+    return search_index;
+}
+
+gboolean
+caja_search_index_is_enabled (void)
+{
+    return get_search_index ()->roots[0] != NULL && g_thread_supported ();
+}
+
+/* Whether path is in one of the indexed folders, and on the same file
+ * system, as the index doesn't go into others. */
+static gboolean
+index_has_location (CajaSearchIndex *index, const char *path)
+{
+    struct stat path_statbuf, root_statbuf;
+    int i;
+
+    for (i = 0; index->roots[i] != NULL; i++)
+    {
+        if (path_is_in (path, index->roots[i], TRUE))
+        {
+            return g_stat (path, &path_statbuf) == 0 &&
+                   g_stat (index->roots[i], &root_statbuf) == 0 &&
+                   path_statbuf.st_dev == root_statbuf.st_dev;
+        }
+    }
+
+    return FALSE;
+}
+
+CajaSearchIndex *
+caja_search_index_ref_for_location (const char *path)
+{
+    SearchIndexState *state;
+
+    if (!caja_search_index_is_enabled ())
+    {
+        return NULL;
+    }
+
+    state = get_search_index ();
+    if (state->rescan_timeout_id == 0)
+    {
+        state->rescan_timeout_id = g_timeout_add_seconds (RESCAN_INTERVAL,
+                                   rescan_timeout_callback, NULL);
+        start_update ();
+    }
+
+    if (state->current == NULL ||
+            (path != NULL && !index_has_location (state->current, path)))
+    {
+        return NULL;
+    }
+
+    return search_index_ref (state->current);
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static gboolean
+self_check_collect_hit (const char *path, gpointer callback_data)
+{
+    GString *hits;
+
+    hits = callback_data;
+    if (hits->len > 0)
+    {
+        g_string_append_c (hits, ',');
+    }
+    g_string_append (hits, path);
+
+    return TRUE;
+}
+
+static char *
+self_check_find (CajaSearchIndex *index, const char *location, const char *text)
+{
+    CajaFilenameMatcher *matcher;
+    GString *hits;
+
+    hits = g_string_new (NULL);
+    matcher = caja_filename_matcher_new (text);
+    caja_search_index_find (index, location, matcher, NULL,
+                            self_check_collect_hit, hits);
+    caja_filename_matcher_free (matcher);
+
+    return g_string_free (hits, FALSE);
+}
+
+static void
+self_check_fill_builder (IndexBuilder *builder)
+{
+    guint32 home, documents, music, root;
+
+    builder_init (builder);
+    home = builder_add (builder, NO_ENTRY, "/home/user", 2);
+    documents = builder_add (builder, home, "Documents", 2);
+    music = builder_add (builder, home, "Music", 2);
+    builder_add (builder, home, "report.txt", 0);
+    builder_add (builder, documents, "Annual Report.odt", 0);
+    builder_add (builder, documents, "Le CAFÉ.txt", 0);
+    builder_add (builder, documents, "rep", 0);
+    builder_add (builder, music, "Reportage.ogg", 0);
+    root = builder_add (builder, NO_ENTRY, "/", 2);
+    builder_add (builder, root, "reports", 0);
+}
+
+static gboolean
+self_check_equals_index (CajaSearchIndex *index, const char *extra_name)
+{
+    IndexBuilder builder;
+    gboolean equal;
+
+    self_check_fill_builder (&builder);
+    if (extra_name != NULL)
+    {
+        builder_add (&builder, 0, extra_name, 0);
+    }
+    equal = builder_equals_index (&builder, index);
+    builder_clear (&builder);
+
+    return equal;
+}
+
+static CajaSearchIndex *
+self_check_make_index (void)
+{
+    CajaSearchIndex *index;
+    IndexBuilder builder;
+    char *path;
+    int fd;
+
+    fd = g_file_open_tmp ("caja-search-index-XXXXXX", &path, NULL);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    close (fd);
+
+    self_check_fill_builder (&builder);
+
+    index = NULL;
+    if (builder_write (&builder, path))
+    {
+        /* Still there as long as it is mapped. */
+        index = search_index_load (path);
+    }
+    g_unlink (path);
+    g_free (path);
+    builder_clear (&builder);
+
+    return index;
+}
+
+void
+caja_self_check_search_index (void)
+{
+    CajaSearchIndex *index;
+    guint32 value;
+    const guchar *p;
+    GByteArray *bytes;
+
+    bytes = g_byte_array_new ();
+    append_varint (bytes, 300);
+    append_varint (bytes, G_MAXUINT32);
+    p = bytes->data;
+    EEL_CHECK_BOOLEAN_RESULT (read_varint (&p, bytes->data + bytes->len, &value) && value == 300, TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (read_varint (&p, bytes->data + bytes->len, &value) && value == G_MAXUINT32, TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (read_varint (&p, bytes->data + bytes->len, &value), FALSE);
+    g_byte_array_free (bytes, TRUE);
+
+    EEL_CHECK_BOOLEAN_RESULT (path_is_in ("/home/user/a", "/home/user", FALSE), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (path_is_in ("/home/user", "/home/user/", FALSE), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (path_is_in ("/home/user", "/home/user/", TRUE), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (path_is_in ("/home/username", "/home/user", TRUE), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (path_is_in ("/home", "/", FALSE), TRUE);
+
+    index = self_check_make_index ();
+    EEL_CHECK_BOOLEAN_RESULT (index != NULL, TRUE);
+    if (index == NULL)
+    {
+        return;
+    }
+
+    EEL_CHECK_STRING_RESULT (self_check_find (index, NULL, "report"),
+                             "/home/user/report.txt,/home/user/Documents/Annual Report.odt,"
+                             "/home/user/Music/Reportage.ogg,/reports");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, "/home/user/Documents", "report"),
+                             "/home/user/Documents/Annual Report.odt");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, "/home/user", "rep ogg"),
+                             "/home/user/Music/Reportage.ogg");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, "/home/user/Documents", "re"),
+                             "/home/user/Documents/Annual Report.odt,/home/user/Documents/rep");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, NULL, "cafe"),
+                             "/home/user/Documents/Le CAFÉ.txt");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, NULL, "reportx"), "");
+    EEL_CHECK_STRING_RESULT (self_check_find (index, NULL, "user"), "");
+
+    EEL_CHECK_BOOLEAN_RESULT (self_check_equals_index (index, NULL), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_equals_index (index, "new.txt"), FALSE);
+
+    caja_search_index_unref (index);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
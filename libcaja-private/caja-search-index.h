@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-search-index.h: Index of the file names in the indexed folders.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_SEARCH_INDEX_H
+#define CAJA_SEARCH_INDEX_H
+
+#include <gio/gio.h>
+#include <libcaja-private/caja-filename-matcher.h>
+
+typedef struct CajaSearchIndex CajaSearchIndex;
+
+/* Called with the path of each file that matches, until it returns
+ * FALSE.
+ */
+typedef gboolean (* CajaSearchIndexHitFunc) (const char *path,
+        gpointer    callback_data);
+
+/* Whether any folders are set to be indexed, in which case their
+ * names are kept in a file in the user directory. The index is read
+ * or made in a thread the first time it is asked for, and made again
+ * in the background as the folders change. Main thread only.
+ */
+gboolean         caja_search_index_is_enabled       (void);
+
+/* The index as of now, if it is ready and has all of the folder at
+ * path, or the whole index when path is NULL. Main thread only; the
+ * index itself can be searched and unreffed from any thread.
+ */
+CajaSearchIndex *caja_search_index_ref_for_location (const char             *path);
+void             caja_search_index_unref            (CajaSearchIndex        *index);
+
+/* Finds the files under path, or anywhere for NULL, whose names match
+ * matcher. The files were there at the last rescan, which doesn't mean
+ * they still are.
+ */
+void             caja_search_index_find             (CajaSearchIndex        *index,
+        const char             *path,
+        CajaFilenameMatcher    *matcher,
+        GCancellable           *cancellable,
+        CajaSearchIndexHitFunc  callback,
+        gpointer                callback_data);
+
+#endif /* CAJA_SEARCH_INDEX_H */
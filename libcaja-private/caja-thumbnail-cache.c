@@ -0,0 +1,319 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-cache.c: Process wide cache of loaded thumbnails.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-thumbnail-cache.h"
+
+#include "caja-lib-self-check-functions.h"
+
+#include <eel/eel-debug.h>
+#include <string.h>
+
+typedef struct
+{
+    char *uri;
+    time_t mtime;
+    int size;
+    GdkPixbuf *pixbuf;
+    gsize bytes;
+    /* Link in the LRU queue, most recently used first. */
+    GList *link;
+} CacheEntry;
+
+typedef struct
+{
+    GHashTable *entries;
+    GQueue lru;
+    gsize bytes;
+    gsize budget;
+    CajaThumbnailCacheStatistics statistics;
+} ThumbnailCache;
+
+static ThumbnailCache *thumbnail_cache = NULL;
+
+static guint
+cache_entry_hash (gconstpointer key)
+{
+    const CacheEntry *entry;
+
+    entry = key;
+    return g_str_hash (entry->uri) ^ ((guint) entry->mtime * 31) ^ (guint) entry->size;
+}
+
+static gboolean
+cache_entry_equal (gconstpointer a, gconstpointer b)
+{
+    const CacheEntry *entry_a, *entry_b;
+
+    entry_a = a;
+    entry_b = b;
+    return entry_a->mtime == entry_b->mtime &&
+           entry_a->size == entry_b->size &&
+           strcmp (entry_a->uri, entry_b->uri) == 0;
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+    g_free (entry->uri);
+    g_object_unref (entry->pixbuf);
+    g_free (entry);
+}
+
+static void
+destroy_thumbnail_cache (void)
+{
+    CacheEntry *entry;
+
+    while ((entry = g_queue_pop_head (&thumbnail_cache->lru)) != NULL)
+    {
+        cache_entry_free (entry);
+    }
+    g_hash_table_destroy (thumbnail_cache->entries);
+    g_free (thumbnail_cache);
+    thumbnail_cache = NULL;
+}
+
+static ThumbnailCache *
+get_cache (void)
+{
+    if (thumbnail_cache == NULL)
+    {
+        thumbnail_cache = g_new0 (ThumbnailCache, 1);
+        thumbnail_cache->entries = g_hash_table_new (cache_entry_hash, cache_entry_equal);
+        thumbnail_cache->budget = CAJA_THUMBNAIL_CACHE_DEFAULT_BUDGET;
+        eel_debug_call_at_shutdown (destroy_thumbnail_cache);
+    }
+
+    return thumbnail_cache;
+}
+
+static void
+remove_entry (ThumbnailCache *cache, CacheEntry *entry)
+{
+    g_hash_table_remove (cache->entries, entry);
+    g_queue_delete_link (&cache->lru, entry->link);
+    cache->bytes -= entry->bytes;
+    cache_entry_free (entry);
+}
+
+static void
+evict_to_budget (ThumbnailCache *cache)
+{
+    CacheEntry *entry;
+
+    while (cache->bytes > cache->budget)
+    {
+        entry = g_queue_peek_tail (&cache->lru);
+        remove_entry (cache, entry);
+        cache->statistics.evictions++;
+    }
+}
+
+static gsize
+get_pixbuf_bytes (GdkPixbuf *pixbuf)
+{
+    return (gsize) gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+}
+
+GdkPixbuf *
+caja_thumbnail_cache_lookup (const char *uri,
+                             time_t mtime,
+                             int size)
+{
+    ThumbnailCache *cache;
+    CacheEntry key, *entry;
+
+    g_return_val_if_fail (uri != NULL, NULL);
+
+    cache = get_cache ();
+
+    key.uri = (char *) uri;
+    key.mtime = mtime;
+    key.size = size;
+    entry = g_hash_table_lookup (cache->entries, &key);
+    if (entry == NULL)
+    {
+        cache->statistics.misses++;
+        return NULL;
+    }
+
+    cache->statistics.hits++;
+    g_queue_unlink (&cache->lru, entry->link);
+    g_queue_push_head_link (&cache->lru, entry->link);
+
+    return g_object_ref (entry->pixbuf);
+}
+
+void
+caja_thumbnail_cache_insert (const char *uri,
+                             time_t mtime,
+                             int size,
+                             GdkPixbuf *pixbuf)
+{
+    ThumbnailCache *cache;
+    CacheEntry key, *entry;
+    gsize bytes;
+
+    g_return_if_fail (uri != NULL);
+    g_return_if_fail (GDK_IS_PIXBUF (pixbuf));
+
+    cache = get_cache ();
+
+    key.uri = (char *) uri;
+    key.mtime = mtime;
+    key.size = size;
+    entry = g_hash_table_lookup (cache->entries, &key);
+    if (entry != NULL)
+    {
+        remove_entry (cache, entry);
+    }
+
+    /* A thumbnail that would push everything else out isn't kept. */
+    bytes = get_pixbuf_bytes (pixbuf);
+    if (bytes > cache->budget)
+    {
+        return;
+    }
+
+    entry = g_new0 (CacheEntry, 1);
+    entry->uri = g_strdup (uri);
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->pixbuf = g_object_ref (pixbuf);
+    entry->bytes = bytes;
+
+    g_queue_push_head (&cache->lru, entry);
+    entry->link = g_queue_peek_head_link (&cache->lru);
+    g_hash_table_insert (cache->entries, entry, entry);
+    cache->bytes += bytes;
+
+    evict_to_budget (cache);
+}
+
+void
+caja_thumbnail_cache_set_budget (gsize bytes)
+{
+    ThumbnailCache *cache;
+
+    cache = get_cache ();
+    cache->budget = bytes;
+    evict_to_budget (cache);
+}
+
+void
+caja_thumbnail_cache_get_statistics (CajaThumbnailCacheStatistics *statistics)
+{
+    ThumbnailCache *cache;
+
+    g_return_if_fail (statistics != NULL);
+
+    cache = get_cache ();
+    *statistics = cache->statistics;
+    statistics->n_entries = g_hash_table_size (cache->entries);
+    statistics->bytes = cache->bytes;
+    statistics->budget = cache->budget;
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static gboolean
+self_check_lookup (const char *uri, time_t mtime, int size)
+{
+    GdkPixbuf *pixbuf;
+
+    pixbuf = caja_thumbnail_cache_lookup (uri, mtime, size);
+    if (pixbuf == NULL)
+    {
+        return FALSE;
+    }
+
+    g_object_unref (pixbuf);
+    return TRUE;
+}
+
+static int
+self_check_get_hits (void)
+{
+    CajaThumbnailCacheStatistics statistics;
+
+    caja_thumbnail_cache_get_statistics (&statistics);
+    return statistics.hits;
+}
+
+static int
+self_check_get_entries (void)
+{
+    CajaThumbnailCacheStatistics statistics;
+
+    caja_thumbnail_cache_get_statistics (&statistics);
+    return statistics.n_entries;
+}
+
+void
+caja_self_check_thumbnail_cache (void)
+{
+    CajaThumbnailCacheStatistics saved;
+    GdkPixbuf *pixbuf;
+    gsize bytes;
+    int hits;
+
+    caja_thumbnail_cache_get_statistics (&saved);
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 10, 10);
+    bytes = get_pixbuf_bytes (pixbuf);
+
+    /* Room for two thumbnails, dropping whatever was there. */
+    caja_thumbnail_cache_set_budget (0);
+    caja_thumbnail_cache_set_budget (2 * bytes);
+
+    caja_thumbnail_cache_insert ("file:///a", 1, 128, pixbuf);
+    caja_thumbnail_cache_insert ("file:///b", 1, 128, pixbuf);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_entries (), 2);
+
+    /* Same file with another mtime or size is a different thumbnail. */
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///a", 2, 128), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///a", 1, 256), FALSE);
+
+    hits = self_check_get_hits ();
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///a", 1, 128), TRUE);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_hits (), hits + 1);
+
+    /* b is now the least recently used, so it goes first. */
+    caja_thumbnail_cache_insert ("file:///c", 1, 128, pixbuf);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_entries (), 2);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///b", 1, 128), FALSE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///a", 1, 128), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_lookup ("file:///c", 1, 128), TRUE);
+
+    /* Replacing an entry doesn't count it twice. */
+    caja_thumbnail_cache_insert ("file:///c", 1, 128, pixbuf);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_entries (), 2);
+
+    caja_thumbnail_cache_set_budget (bytes - 1);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_entries (), 0);
+    caja_thumbnail_cache_insert ("file:///d", 1, 128, pixbuf);
+    EEL_CHECK_INTEGER_RESULT (self_check_get_entries (), 0);
+
+    caja_thumbnail_cache_set_budget (saved.budget);
+    g_object_unref (pixbuf);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
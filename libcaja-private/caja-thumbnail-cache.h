@@ -0,0 +1,57 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-cache.h: Process wide cache of loaded thumbnails.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_THUMBNAIL_CACHE_H
+#define CAJA_THUMBNAIL_CACHE_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <time.h>
+
+/* Used when no budget has been set. */
+#define CAJA_THUMBNAIL_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct
+{
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+    guint n_entries;
+    gsize bytes;
+    gsize budget;
+} CajaThumbnailCacheStatistics;
+
+/* Thumbnails are keyed by the uri and mtime of the file they show, and
+ * by the size they were loaded at, so a changed file never hits a stale
+ * entry. The least recently used entries are dropped once the pixels
+ * of all entries take more than the budget. Main thread only.
+ */
+
+/* Returns a new reference, or NULL. */
+GdkPixbuf *caja_thumbnail_cache_lookup         (const char *uri,
+        time_t      mtime,
+        int         size);
+void       caja_thumbnail_cache_insert         (const char *uri,
+        time_t      mtime,
+        int         size,
+        GdkPixbuf  *pixbuf);
+void       caja_thumbnail_cache_set_budget     (gsize       bytes);
+void       caja_thumbnail_cache_get_statistics (CajaThumbnailCacheStatistics *statistics);
+
+#endif /* CAJA_THUMBNAIL_CACHE_H */
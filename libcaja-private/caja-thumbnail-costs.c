@@ -0,0 +1,359 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-costs.c: What making thumbnails of each type costs.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-thumbnail-costs.h"
+
+#include "caja-file-utilities.h"
+#include "caja-lib-self-check-functions.h"
+
+#include <eel/eel-debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Types whose thumbnails take longer than this on average are made
+   after all others. */
+#define EXPENSIVE_THUMBNAIL_MSECS 1500
+
+/* A type no thumbnail was ever made for is given up on after this
+   many failures in a row... */
+#define HOPELESS_FAILURES 10
+
+/* ...and tried again once this much time has passed, in case a
+   thumbnailer for it was installed in the meantime. */
+#define HOPELESS_RETRY_SECS (3 * 24 * 60 * 60)
+
+/* The mean follows the last few samples rather than all of them. */
+#define MEAN_SAMPLES 8
+
+/* Changes are written out this long after the first one. */
+#define SAVE_DELAY_SECS 30
+
+#define COSTS_FILE_NAME "thumbnail-costs"
+
+typedef struct
+{
+    guint attempts;
+    guint successes;
+    guint consecutive_failures;
+    gulong mean_msecs;
+    time_t last_attempt;
+} MimeCost;
+
+/* Mime type -> MimeCost, lock costs when accessing it. */
+static GHashTable *costs = NULL;
+static guint save_timeout_id = 0;
+
+G_LOCK_DEFINE_STATIC (costs);
+
+static void
+mime_cost_add_sample (MimeCost *cost,
+                      gboolean succeeded,
+                      gulong msecs,
+                      time_t now)
+{
+    guint n;
+
+    cost->attempts++;
+    cost->last_attempt = now;
+
+    if (succeeded)
+    {
+        cost->successes++;
+        cost->consecutive_failures = 0;
+    }
+    else
+    {
+        cost->consecutive_failures++;
+    }
+
+    n = MIN (cost->attempts, MEAN_SAMPLES);
+    cost->mean_msecs = (cost->mean_msecs * (n - 1) + msecs) / n;
+}
+
+/* Files of a type that has worked before can fail for reasons of their
+   own, which the failed thumbnail kept for each of them takes care of,
+   so only types that never worked are given up on as a whole. */
+static CajaThumbnailCost
+mime_cost_classify (const MimeCost *cost,
+                    time_t now)
+{
+    if (cost->successes == 0 &&
+            cost->consecutive_failures >= HOPELESS_FAILURES &&
+            now - cost->last_attempt < HOPELESS_RETRY_SECS)
+    {
+        return CAJA_THUMBNAIL_COST_HOPELESS;
+    }
+
+    if (cost->mean_msecs > EXPENSIVE_THUMBNAIL_MSECS)
+    {
+        return CAJA_THUMBNAIL_COST_EXPENSIVE;
+    }
+
+    return CAJA_THUMBNAIL_COST_CHEAP;
+}
+
+static char *
+get_costs_path (void)
+{
+    char *user_directory, *path;
+
+    user_directory = caja_get_user_directory ();
+    path = g_build_filename (user_directory, COSTS_FILE_NAME, NULL);
+    g_free (user_directory);
+
+    return path;
+}
+
+static char *
+costs_to_data (gsize *length)
+{
+    GKeyFile *key_file;
+    GHashTableIter iter;
+    gpointer key, value;
+    MimeCost *cost;
+    char *last_attempt, *data;
+
+    key_file = g_key_file_new ();
+
+    g_hash_table_iter_init (&iter, costs);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        cost = value;
+        g_key_file_set_integer (key_file, key, "attempts", cost->attempts);
+        g_key_file_set_integer (key_file, key, "successes", cost->successes);
+        g_key_file_set_integer (key_file, key, "consecutive-failures", cost->consecutive_failures);
+        g_key_file_set_integer (key_file, key, "mean-msecs", cost->mean_msecs);
+        last_attempt = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) cost->last_attempt);
+        g_key_file_set_string (key_file, key, "last-attempt", last_attempt);
+        g_free (last_attempt);
+    }
+
+    data = g_key_file_to_data (key_file, length, NULL);
+    g_key_file_free (key_file);
+
+    return data;
+}
+
+static void
+save_costs (void)
+{
+    char *data, *path;
+    gsize length;
+    GError *error;
+
+    G_LOCK (costs);
+    data = costs_to_data (&length);
+    G_UNLOCK (costs);
+
+    if (data == NULL)
+    {
+        return;
+    }
+
+    path = get_costs_path ();
+    error = NULL;
+    if (!g_file_set_contents (path, data, length, &error))
+    {
+        g_warning ("Couldn't save the thumbnail costs: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (path);
+    g_free (data);
+}
+
+static gboolean
+save_costs_timeout (gpointer data)
+{
+    G_LOCK (costs);
+    save_timeout_id = 0;
+    G_UNLOCK (costs);
+
+    save_costs ();
+
+    return FALSE;
+}
+
+static void
+free_costs (void)
+{
+    if (save_timeout_id != 0)
+    {
+        g_source_remove (save_timeout_id);
+        save_timeout_id = 0;
+        save_costs ();
+    }
+
+    g_hash_table_destroy (costs);
+    costs = NULL;
+}
+
+/* Call with costs locked. */
+static void
+load_costs (void)
+{
+    GKeyFile *key_file;
+    char **groups, *path, *last_attempt;
+    MimeCost *cost;
+    int i;
+
+    costs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    eel_debug_call_at_shutdown (free_costs);
+
+    key_file = g_key_file_new ();
+    path = get_costs_path ();
+    if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        groups = g_key_file_get_groups (key_file, NULL);
+        for (i = 0; groups[i] != NULL; i++)
+        {
+            cost = g_new0 (MimeCost, 1);
+            cost->attempts = MAX (0, g_key_file_get_integer (key_file, groups[i], "attempts", NULL));
+            cost->consecutive_failures = MAX (0, g_key_file_get_integer (key_file, groups[i], "consecutive-failures", NULL));
+            cost->mean_msecs = MAX (0, g_key_file_get_integer (key_file, groups[i], "mean-msecs", NULL));
+            if (g_key_file_has_key (key_file, groups[i], "successes", NULL))
+            {
+                cost->successes = MAX (0, g_key_file_get_integer (key_file, groups[i], "successes", NULL));
+            }
+            else
+            {
+                /* Written before successes were counted; this is at
+                   least how many the last ones show. */
+                cost->successes = cost->attempts > cost->consecutive_failures;
+            }
+            last_attempt = g_key_file_get_string (key_file, groups[i], "last-attempt", NULL);
+            if (last_attempt != NULL)
+            {
+                cost->last_attempt = g_ascii_strtoll (last_attempt, NULL, 10);
+                g_free (last_attempt);
+            }
+            g_hash_table_insert (costs, g_strdup (groups[i]), cost);
+        }
+        g_strfreev (groups);
+    }
+    g_free (path);
+    g_key_file_free (key_file);
+}
+
+CajaThumbnailCost
+caja_thumbnail_costs_get (const char *mime_type)
+{
+    CajaThumbnailCost result;
+    MimeCost *cost;
+
+    if (mime_type == NULL)
+    {
+        return CAJA_THUMBNAIL_COST_CHEAP;
+    }
+
+    G_LOCK (costs);
+
+    if (costs == NULL)
+    {
+        load_costs ();
+    }
+
+    cost = g_hash_table_lookup (costs, mime_type);
+    result = cost == NULL ? CAJA_THUMBNAIL_COST_CHEAP : mime_cost_classify (cost, time (NULL));
+
+    G_UNLOCK (costs);
+
+    return result;
+}
+
+void
+caja_thumbnail_costs_record (const char *mime_type,
+                             gboolean succeeded,
+                             gulong msecs)
+{
+    MimeCost *cost;
+
+    if (mime_type == NULL)
+    {
+        return;
+    }
+
+    G_LOCK (costs);
+
+    if (costs == NULL)
+    {
+        load_costs ();
+    }
+
+    cost = g_hash_table_lookup (costs, mime_type);
+    if (cost == NULL)
+    {
+        cost = g_new0 (MimeCost, 1);
+        g_hash_table_insert (costs, g_strdup (mime_type), cost);
+    }
+    mime_cost_add_sample (cost, succeeded, msecs, time (NULL));
+
+    if (save_timeout_id == 0)
+    {
+        save_timeout_id = g_timeout_add_seconds (SAVE_DELAY_SECS, save_costs_timeout, NULL);
+    }
+
+    G_UNLOCK (costs);
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+void
+caja_self_check_thumbnail_costs (void)
+{
+    MimeCost cost = { 0 };
+    int i;
+
+    EEL_CHECK_INTEGER_RESULT (mime_cost_classify (&cost, 0), CAJA_THUMBNAIL_COST_CHEAP);
+
+    /* The mean starts out as the plain average... */
+    mime_cost_add_sample (&cost, TRUE, 100, 0);
+    mime_cost_add_sample (&cost, TRUE, 300, 0);
+    EEL_CHECK_INTEGER_RESULT (cost.mean_msecs, 200);
+
+    /* ...and then follows the recent samples. */
+    for (i = 0; i < 4 * MEAN_SAMPLES; i++)
+    {
+        mime_cost_add_sample (&cost, TRUE, 4000, 0);
+    }
+    EEL_CHECK_BOOLEAN_RESULT (cost.mean_msecs > EXPENSIVE_THUMBNAIL_MSECS, TRUE);
+    EEL_CHECK_INTEGER_RESULT (mime_cost_classify (&cost, 0), CAJA_THUMBNAIL_COST_EXPENSIVE);
+
+    /* A type that worked before is never hopeless... */
+    for (i = 0; i < 2 * HOPELESS_FAILURES; i++)
+    {
+        mime_cost_add_sample (&cost, FALSE, 10, 0);
+    }
+    EEL_CHECK_BOOLEAN_RESULT (mime_cost_classify (&cost, 0) == CAJA_THUMBNAIL_COST_HOPELESS, FALSE);
+
+    /* ...and one that never did only after failures in a row. */
+    memset (&cost, 0, sizeof (cost));
+    for (i = 0; i < HOPELESS_FAILURES - 1; i++)
+    {
+        mime_cost_add_sample (&cost, FALSE, 10, 1000);
+    }
+    EEL_CHECK_BOOLEAN_RESULT (mime_cost_classify (&cost, 1000) == CAJA_THUMBNAIL_COST_HOPELESS, FALSE);
+    mime_cost_add_sample (&cost, FALSE, 10, 1000);
+    EEL_CHECK_INTEGER_RESULT (mime_cost_classify (&cost, 1000), CAJA_THUMBNAIL_COST_HOPELESS);
+    EEL_CHECK_BOOLEAN_RESULT (mime_cost_classify (&cost, 1000 + HOPELESS_RETRY_SECS) == CAJA_THUMBNAIL_COST_HOPELESS, FALSE);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
@@ -0,0 +1,46 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-costs.h: What making thumbnails of each type costs.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_THUMBNAIL_COSTS_H
+#define CAJA_THUMBNAIL_COSTS_H
+
+#include <glib.h>
+
+typedef enum
+{
+    /* Make these in the order they are asked for. */
+    CAJA_THUMBNAIL_COST_CHEAP,
+    /* Takes long enough that everything else should go first. */
+    CAJA_THUMBNAIL_COST_EXPENSIVE,
+    /* Never worked and failed every time lately, don't try again for
+       a while. */
+    CAJA_THUMBNAIL_COST_HOPELESS
+} CajaThumbnailCost;
+
+/* The time taken and the outcome of thumbnailing are kept per mime
+ * type, in a file in the user directory, so what was learned survives
+ * restarts. Both functions may be called from any thread.
+ */
+CajaThumbnailCost caja_thumbnail_costs_get    (const char *mime_type);
+void              caja_thumbnail_costs_record (const char *mime_type,
+        gboolean    succeeded,
+        gulong      msecs);
+
+#endif /* CAJA_THUMBNAIL_COSTS_H */
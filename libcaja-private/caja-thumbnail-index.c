@@ -0,0 +1,504 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-index.c: In memory index of the thumbnail directories.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <config.h>
+#include "caja-thumbnail-index.h"
+
+#define MATE_DESKTOP_USE_UNSTABLE_API
+
+#include "caja-lib-self-check-functions.h"
+
+#include <eel/eel-debug.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <libmateui/mate-desktop-thumbnail.h>
+
+/* Thumbnail files are named after the MD5 of the uri, in hex. */
+#define MD5_LENGTH 32
+#define THUMBNAIL_SUFFIX ".png"
+
+typedef enum
+{
+    THUMBNAIL_NORMAL = 1 << 0,
+    THUMBNAIL_LARGE = 1 << 1,
+    THUMBNAIL_FAILED = 1 << 2
+} ThumbnailFlags;
+
+typedef struct
+{
+    const char *subdirectory;
+    ThumbnailFlags flag;
+} IndexedDirectory;
+
+/* In the order the thumbnail::* attributes look at them. */
+static const IndexedDirectory indexed_directories[] =
+{
+    { "normal", THUMBNAIL_NORMAL },
+    { "large", THUMBNAIL_LARGE },
+    { "fail" G_DIR_SEPARATOR_S "mate-thumbnail-factory", THUMBNAIL_FAILED },
+    { "fail" G_DIR_SEPARATOR_S "gnome-thumbnail-factory", THUMBNAIL_FAILED }
+};
+
+#define N_INDEXED_DIRECTORIES G_N_ELEMENTS (indexed_directories)
+
+typedef struct
+{
+    char *base_directory;
+    /* MD5 -> ThumbnailFlags of the thumbnail files there are for it. */
+    GHashTable *thumbnails;
+    gboolean loaded;
+    /* MD5s the monitors saw change while loading, checked again once
+       the thread is done as its listing may be older. */
+    GHashTable *changed_while_loading;
+    GFileMonitor *monitors[N_INDEXED_DIRECTORIES];
+} ThumbnailIndex;
+
+typedef struct
+{
+    char *base_directory;
+    GHashTable *thumbnails;
+} IndexLoad;
+
+static ThumbnailIndex *thumbnail_index = NULL;
+
+static GHashTable *
+thumbnails_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static void
+thumbnails_add_flags (GHashTable *thumbnails,
+                      const char *md5,
+                      guint flags)
+{
+    guint old_flags;
+
+    old_flags = GPOINTER_TO_UINT (g_hash_table_lookup (thumbnails, md5));
+    if ((old_flags & flags) != flags)
+    {
+        g_hash_table_insert (thumbnails, g_strdup (md5),
+                             GUINT_TO_POINTER (old_flags | flags));
+    }
+}
+
+/* Fills md5 in from a thumbnail file name, returns FALSE for anything
+   that isn't one, like the temporary files the thumbnails are written
+   to. */
+static gboolean
+get_md5_from_name (const char *name,
+                   char md5[MD5_LENGTH + 1])
+{
+    int i;
+
+    if (strlen (name) != MD5_LENGTH + strlen (THUMBNAIL_SUFFIX) ||
+            strcmp (name + MD5_LENGTH, THUMBNAIL_SUFFIX) != 0)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < MD5_LENGTH; i++)
+    {
+        if (!g_ascii_isxdigit (name[i]))
+        {
+            return FALSE;
+        }
+        md5[i] = g_ascii_tolower (name[i]);
+    }
+    md5[MD5_LENGTH] = '\0';
+
+    return TRUE;
+}
+
+static char *
+get_md5_for_uri (const char *uri)
+{
+    return g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+}
+
+static char *
+get_thumbnail_path (const char *base_directory,
+                    const IndexedDirectory *directory,
+                    const char *md5)
+{
+    char *name, *path;
+
+    name = g_strconcat (md5, THUMBNAIL_SUFFIX, NULL);
+    path = g_build_filename (base_directory, directory->subdirectory, name, NULL);
+    g_free (name);
+
+    return path;
+}
+
+/* Looks at the thumbnail files for one MD5 on disk. */
+static void
+index_refresh_md5 (ThumbnailIndex *index,
+                   const char *md5)
+{
+    guint flags;
+    char *path;
+    guint i;
+
+    flags = 0;
+    for (i = 0; i < N_INDEXED_DIRECTORIES; i++)
+    {
+        path = get_thumbnail_path (index->base_directory,
+                                   &indexed_directories[i], md5);
+        if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        {
+            flags |= indexed_directories[i].flag;
+        }
+        g_free (path);
+    }
+
+    if (flags == 0)
+    {
+        g_hash_table_remove (index->thumbnails, md5);
+    }
+    else
+    {
+        g_hash_table_insert (index->thumbnails, g_strdup (md5),
+                             GUINT_TO_POINTER (flags));
+    }
+}
+
+static void
+index_directory_changed (GFileMonitor *monitor,
+                         GFile *child,
+                         GFile *other_file,
+                         GFileMonitorEvent event_type,
+                         gpointer callback_data)
+{
+    char md5[MD5_LENGTH + 1];
+    char *name;
+
+    if (thumbnail_index == NULL ||
+            (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+             event_type != G_FILE_MONITOR_EVENT_DELETED))
+    {
+        return;
+    }
+
+    name = g_file_get_basename (child);
+    if (get_md5_from_name (name, md5))
+    {
+        if (!thumbnail_index->loaded)
+        {
+            g_hash_table_insert (thumbnail_index->changed_while_loading,
+                                 g_strdup (md5), NULL);
+        }
+        else if (event_type == G_FILE_MONITOR_EVENT_CREATED)
+        {
+            thumbnails_add_flags (thumbnail_index->thumbnails, md5,
+                                  GPOINTER_TO_UINT (callback_data));
+        }
+        else
+        {
+            /* Both failed thumbnail directories map to the same
+               flag, so look at what is left. */
+            index_refresh_md5 (thumbnail_index, md5);
+        }
+    }
+    g_free (name);
+}
+
+static void
+index_load_free (IndexLoad *load)
+{
+    g_free (load->base_directory);
+    if (load->thumbnails != NULL)
+    {
+        g_hash_table_destroy (load->thumbnails);
+    }
+    g_free (load);
+}
+
+static gboolean
+index_load_done_idle (gpointer data)
+{
+    IndexLoad *load;
+    GHashTableIter iter;
+    gpointer md5;
+
+    load = data;
+
+    if (thumbnail_index != NULL)
+    {
+        g_hash_table_destroy (thumbnail_index->thumbnails);
+        thumbnail_index->thumbnails = load->thumbnails;
+        load->thumbnails = NULL;
+
+        g_hash_table_iter_init (&iter, thumbnail_index->changed_while_loading);
+        while (g_hash_table_iter_next (&iter, &md5, NULL))
+        {
+            index_refresh_md5 (thumbnail_index, md5);
+        }
+        g_hash_table_remove_all (thumbnail_index->changed_while_loading);
+
+        thumbnail_index->loaded = TRUE;
+    }
+
+    index_load_free (load);
+
+    return FALSE;
+}
+
+static gpointer
+index_load_thread_func (gpointer data)
+{
+    IndexLoad *load;
+    const char *name;
+    char md5[MD5_LENGTH + 1];
+    char *path;
+    GDir *dir;
+    guint i;
+
+    load = data;
+
+    for (i = 0; i < N_INDEXED_DIRECTORIES; i++)
+    {
+        path = g_build_filename (load->base_directory,
+                                 indexed_directories[i].subdirectory, NULL);
+        dir = g_dir_open (path, 0, NULL);
+        g_free (path);
+
+        if (dir == NULL)
+        {
+            continue;
+        }
+
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            if (get_md5_from_name (name, md5))
+            {
+                thumbnails_add_flags (load->thumbnails, md5,
+                                      indexed_directories[i].flag);
+            }
+        }
+        g_dir_close (dir);
+    }
+
+    g_idle_add (index_load_done_idle, load);
+
+    return NULL;
+}
+
+/* The directory the thumbnail factory saves to, which depends on the
+   version of the thumbnail spec it follows. */
+static char *
+get_base_directory (void)
+{
+    char *path, *directory, *base_directory;
+
+    path = mate_desktop_thumbnail_path_for_uri ("file:///", MATE_DESKTOP_THUMBNAIL_SIZE_NORMAL);
+    directory = g_path_get_dirname (path);
+    base_directory = g_path_get_dirname (directory);
+    g_free (directory);
+    g_free (path);
+
+    return base_directory;
+}
+
+static void
+destroy_thumbnail_index (void)
+{
+    guint i;
+
+    for (i = 0; i < N_INDEXED_DIRECTORIES; i++)
+    {
+        if (thumbnail_index->monitors[i] != NULL)
+        {
+            g_file_monitor_cancel (thumbnail_index->monitors[i]);
+            g_object_unref (thumbnail_index->monitors[i]);
+        }
+    }
+    g_hash_table_destroy (thumbnail_index->changed_while_loading);
+    g_hash_table_destroy (thumbnail_index->thumbnails);
+    g_free (thumbnail_index->base_directory);
+    g_free (thumbnail_index);
+    thumbnail_index = NULL;
+}
+
+void
+caja_thumbnail_index_load (void)
+{
+    IndexLoad *load;
+    GFile *location;
+    char *path;
+    guint i;
+
+    /* Programs that don't use threads keep asking for the
+       thumbnail::* attributes. */
+    if (thumbnail_index != NULL || !g_thread_supported ())
+    {
+        return;
+    }
+
+    thumbnail_index = g_new0 (ThumbnailIndex, 1);
+    thumbnail_index->base_directory = get_base_directory ();
+    thumbnail_index->thumbnails = thumbnails_new ();
+    thumbnail_index->changed_while_loading = thumbnails_new ();
+    eel_debug_call_at_shutdown (destroy_thumbnail_index);
+
+    /* Monitor before listing, so nothing falls in between. */
+    for (i = 0; i < N_INDEXED_DIRECTORIES; i++)
+    {
+        path = g_build_filename (thumbnail_index->base_directory,
+                                 indexed_directories[i].subdirectory, NULL);
+        location = g_file_new_for_path (path);
+        thumbnail_index->monitors[i] = g_file_monitor_directory (location,
+                                       G_FILE_MONITOR_NONE,
+                                       NULL, NULL);
+        if (thumbnail_index->monitors[i] != NULL)
+        {
+            g_signal_connect (thumbnail_index->monitors[i], "changed",
+                              G_CALLBACK (index_directory_changed),
+                              GUINT_TO_POINTER (indexed_directories[i].flag));
+        }
+        g_object_unref (location);
+        g_free (path);
+    }
+
+    load = g_new0 (IndexLoad, 1);
+    load->base_directory = g_strdup (thumbnail_index->base_directory);
+    load->thumbnails = thumbnails_new ();
+
+    if (!g_thread_create (index_load_thread_func, load, FALSE, NULL))
+    {
+        /* Keep asking for the thumbnail::* attributes. */
+        index_load_free (load);
+    }
+}
+
+gboolean
+caja_thumbnail_index_is_loaded (void)
+{
+    return thumbnail_index != NULL && thumbnail_index->loaded;
+}
+
+char *
+caja_thumbnail_index_lookup (const char *uri,
+                             gboolean *thumbnailing_failed)
+{
+    char *md5, *path;
+    guint flags;
+    guint i;
+
+    g_return_val_if_fail (uri != NULL, NULL);
+    g_return_val_if_fail (thumbnailing_failed != NULL, NULL);
+    g_return_val_if_fail (caja_thumbnail_index_is_loaded (), NULL);
+
+    *thumbnailing_failed = FALSE;
+
+    md5 = get_md5_for_uri (uri);
+    flags = GPOINTER_TO_UINT (g_hash_table_lookup (thumbnail_index->thumbnails, md5));
+
+    path = NULL;
+    for (i = 0; flags != 0 && i < N_INDEXED_DIRECTORIES; i++)
+    {
+        if ((flags & indexed_directories[i].flag) == 0)
+        {
+            continue;
+        }
+
+        if (indexed_directories[i].flag == THUMBNAIL_FAILED)
+        {
+            *thumbnailing_failed = TRUE;
+        }
+        else
+        {
+            path = get_thumbnail_path (thumbnail_index->base_directory,
+                                       &indexed_directories[i], md5);
+        }
+        break;
+    }
+    g_free (md5);
+
+    return path;
+}
+
+void
+caja_thumbnail_index_refresh (const char *uri)
+{
+    char *md5;
+
+    g_return_if_fail (uri != NULL);
+
+    if (thumbnail_index == NULL)
+    {
+        return;
+    }
+
+    md5 = get_md5_for_uri (uri);
+    if (thumbnail_index->loaded)
+    {
+        index_refresh_md5 (thumbnail_index, md5);
+    }
+    else
+    {
+        g_hash_table_insert (thumbnail_index->changed_while_loading,
+                             g_strdup (md5), NULL);
+    }
+    g_free (md5);
+}
+
+#if !defined (CAJA_OMIT_SELF_CHECK)
+
+static gboolean
+self_check_md5_from_name (const char *name, const char *expected_md5)
+{
+    char md5[MD5_LENGTH + 1];
+
+    if (!get_md5_from_name (name, md5))
+    {
+        return expected_md5 == NULL;
+    }
+
+    return expected_md5 != NULL && strcmp (md5, expected_md5) == 0;
+}
+
+void
+caja_self_check_thumbnail_index (void)
+{
+    GHashTable *thumbnails;
+
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("0123456789abcdef0123456789abcdef.png",
+                              "0123456789abcdef0123456789abcdef"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("0123456789ABCDEF0123456789ABCDEF.png",
+                              "0123456789abcdef0123456789abcdef"), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("0123456789abcdef0123456789abcdef.png.X1Y2Z3", NULL), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("0123456789abcdef0123456789abcdeg.png", NULL), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("0123456789abcdef.png", NULL), TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (self_check_md5_from_name ("", NULL), TRUE);
+
+    /* The names of the thumbnail files. */
+    EEL_CHECK_STRING_RESULT (get_md5_for_uri ("file:///home/jens/photos/me.png"),
+                             "c6ee772d9e49320e97ec29a7eb5b1697");
+
+    thumbnails = thumbnails_new ();
+    thumbnails_add_flags (thumbnails, "c6ee772d9e49320e97ec29a7eb5b1697", THUMBNAIL_NORMAL);
+    thumbnails_add_flags (thumbnails, "c6ee772d9e49320e97ec29a7eb5b1697", THUMBNAIL_FAILED);
+    EEL_CHECK_INTEGER_RESULT (GPOINTER_TO_UINT (g_hash_table_lookup (thumbnails, "c6ee772d9e49320e97ec29a7eb5b1697")),
+                              THUMBNAIL_NORMAL | THUMBNAIL_FAILED);
+    EEL_CHECK_INTEGER_RESULT (g_hash_table_size (thumbnails), 1);
+    g_hash_table_destroy (thumbnails);
+}
+
+#endif /* !CAJA_OMIT_SELF_CHECK */
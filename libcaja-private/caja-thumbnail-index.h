@@ -0,0 +1,45 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   caja-thumbnail-index.h: In memory index of the thumbnail directories.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef CAJA_THUMBNAIL_INDEX_H
+#define CAJA_THUMBNAIL_INDEX_H
+
+#include <glib.h>
+
+/* The thumbnail directories are read once in a thread, and kept
+ * current with file monitors afterwards. Until then the thumbnail::*
+ * file attributes have to be asked for instead. Main thread only.
+ */
+void     caja_thumbnail_index_load      (void);
+gboolean caja_thumbnail_index_is_loaded (void);
+
+/* Returns the path of the thumbnail for uri, or NULL if there is none,
+ * in which case thumbnailing_failed tells whether a failed thumbnail
+ * was recorded. Same as the thumbnail::* attributes, without any I/O.
+ */
+char *   caja_thumbnail_index_lookup    (const char *uri,
+        gboolean   *thumbnailing_failed);
+
+/* Checks the thumbnail files of uri again, for when we know they just
+ * changed and can't wait for the file monitor.
+ */
+void     caja_thumbnail_index_refresh   (const char *uri);
+
+#endif /* CAJA_THUMBNAIL_INDEX_H */
@@ -31,6 +31,9 @@
 #include "caja-directory-notify.h"
 #include "caja-global-preferences.h"
 #include "caja-file-utilities.h"
+#include "caja-image-preview.h"
+#include "caja-thumbnail-costs.h"
+#include "caja-thumbnail-index.h"
 #include <math.h>
 #include <eel/eel-gdk-pixbuf-extensions.h>
 #include <eel/eel-graphic-effects.h>
@@ -60,8 +63,35 @@
 /* Cool-off period between last file modification time and thumbnail creation */
 #define THUMBNAIL_CREATION_DELAY_SECS 3
 
+/* Upper bound on the number of thumbnail worker threads. Beyond this the
+   disk, not the CPU, is the bottleneck. */
+#define MAX_THUMBNAIL_WORKERS 16
+
 static gpointer thumbnail_thread_start (gpointer data);
 
+/* Requests for files currently shown in a view are made before any
+   others. Types that are known to be expensive to thumbnail wait until
+   everything else is done, unless they are visible. */
+typedef enum
+{
+    THUMBNAIL_PRIORITY_VISIBLE,
+    THUMBNAIL_PRIORITY_NORMAL,
+    THUMBNAIL_PRIORITY_DEFERRED,
+    THUMBNAIL_N_PRIORITIES
+} ThumbnailPriority;
+
+/* How a thumbnail gets made, used to limit how many of a kind run at
+   once. Images are decoded in process, everything else spawns an
+   external thumbnailer, and video thumbnailers are the heaviest of
+   those. */
+typedef enum
+{
+    THUMBNAIL_KIND_IMAGE,
+    THUMBNAIL_KIND_EXTERNAL,
+    THUMBNAIL_KIND_VIDEO,
+    THUMBNAIL_N_KINDS
+} ThumbnailKind;
+
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
 
 typedef struct
@@ -69,35 +99,47 @@ typedef struct
     char *image_uri;
     char *mime_type;
     time_t original_file_mtime;
+    ThumbnailPriority priority;
+    ThumbnailKind kind;
+    /* Deferred rather than queued normally. */
+    gboolean expensive;
+    /* Link in thumbnails_to_make[priority], NULL while a worker is
+       making the thumbnail. */
+    GList *link;
+    gboolean in_progress;
+    /* Set when the file goes away while in progress. */
+    gboolean cancelled;
 } CajaThumbnailInfo;
 
 /*
  * Thumbnail thread state.
  */
 
-/* The id of the idle handler used to start the thumbnail thread, or 0 if no
+/* The id of the idle handler used to start thumbnail threads, or 0 if no
    idle handler is currently registered. */
 static guint thumbnail_thread_starter_id = 0;
 
 /* Our mutex used when accessing data shared between the main thread and the
-   thumbnail thread, i.e. the thumbnail_thread_is_running flag and the
-   thumbnails_to_make list. */
+   thumbnail threads, i.e. the running counts, the thumbnails_to_make queues
+   and the thumbnails_to_make_hash. */
 static pthread_mutex_t thumbnails_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* A flag to indicate whether a thumbnail thread is running, so we don't
-   start more than one. Lock thumbnails_mutex when accessing this. */
-static volatile gboolean thumbnail_thread_is_running = FALSE;
+/* The number of thumbnail threads running, so we don't start more than
+   get_max_thumbnail_workers(). Lock thumbnails_mutex when accessing this. */
+static int thumbnail_threads_running = 0;
 
-/* The list of CajaThumbnailInfo structs containing information about the
-   thumbnails we are making. Lock thumbnails_mutex when accessing this. */
-static volatile GQueue thumbnails_to_make = G_QUEUE_INIT;
+/* The number of thumbnails of each kind being made right now. Lock
+   thumbnails_mutex when accessing this. */
+static int thumbnails_running_per_kind[THUMBNAIL_N_KINDS];
 
-/* Quickly check if uri is in thumbnails_to_make list */
-static GHashTable *thumbnails_to_make_hash = NULL;
+/* The CajaThumbnailInfo structs waiting for a worker, one queue per
+   priority. Lock thumbnails_mutex when accessing this. */
+static GQueue thumbnails_to_make[THUMBNAIL_N_PRIORITIES] = { G_QUEUE_INIT, G_QUEUE_INIT, G_QUEUE_INIT };
 
-/* The currently thumbnailed icon. it also exists in the thumbnails_to_make list
- * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
-static CajaThumbnailInfo *currently_thumbnailing = NULL;
+/* Maps uris to CajaThumbnailInfo structs, both the queued ones and the
+   ones in progress, so the main thread doesn't add a file twice. Lock
+   thumbnails_mutex when accessing this. */
+static GHashTable *thumbnails_to_make_hash = NULL;
 
 static MateDesktopThumbnailFactory *thumbnail_factory = NULL;
 
@@ -150,8 +192,99 @@ get_thumbnail_factory (void)
 }
 
 
+static int
+get_max_thumbnail_workers (void)
+{
+    static int max_workers = 0;
+    long n_processors;
+
+    if (max_workers == 0)
+    {
+        n_processors = sysconf (_SC_NPROCESSORS_ONLN);
+        max_workers = CLAMP (n_processors, 1, MAX_THUMBNAIL_WORKERS);
+    }
+
+    return max_workers;
+}
+
+static int
+get_max_running_for_kind (ThumbnailKind kind)
+{
+    switch (kind)
+    {
+    case THUMBNAIL_KIND_VIDEO:
+        return 1;
+    case THUMBNAIL_KIND_EXTERNAL:
+        return MAX (1, get_max_thumbnail_workers () / 2);
+    case THUMBNAIL_KIND_IMAGE:
+    default:
+        return get_max_thumbnail_workers ();
+    }
+}
+
+/* Call with thumbnails_mutex locked. */
+static void
+queue_thumbnail_info (CajaThumbnailInfo *info,
+                      ThumbnailPriority priority,
+                      gboolean at_head)
+{
+    GQueue *queue;
+
+    g_assert (info->link == NULL);
+
+    info->priority = priority;
+    queue = &thumbnails_to_make[priority];
+    if (at_head)
+    {
+        g_queue_push_head (queue, info);
+        info->link = g_queue_peek_head_link (queue);
+    }
+    else
+    {
+        g_queue_push_tail (queue, info);
+        info->link = g_queue_peek_tail_link (queue);
+    }
+}
+
+/* Call with thumbnails_mutex locked. */
+static void
+unqueue_thumbnail_info (CajaThumbnailInfo *info)
+{
+    g_assert (info->link != NULL);
+
+    g_queue_delete_link (&thumbnails_to_make[info->priority], info->link);
+    info->link = NULL;
+}
+
+/* Takes the first queued request, visible ones first, whose kind is not
+   at its concurrency limit. Call with thumbnails_mutex locked. */
+static CajaThumbnailInfo *
+take_next_thumbnail_info (void)
+{
+    CajaThumbnailInfo *info;
+    GList *l;
+    int priority;
+
+    for (priority = 0; priority < THUMBNAIL_N_PRIORITIES; priority++)
+    {
+        for (l = thumbnails_to_make[priority].head; l != NULL; l = l->next)
+        {
+            info = l->data;
+            if (thumbnails_running_per_kind[info->kind] < get_max_running_for_kind (info->kind))
+            {
+                unqueue_thumbnail_info (info);
+                info->in_progress = TRUE;
+                thumbnails_running_per_kind[info->kind]++;
+                return info;
+            }
+        }
+    }
+
+    return NULL;
+}
+
 /* This function is added as a very low priority idle function to start the
-   thread to create any needed thumbnails. It is added with a very low priority
+   threads to create any needed thumbnails. It is added with a very low priority
    so that it doesn't delay showing the directory in the icon/list views.
    We want to show the files in the directory as quickly as possible. */
 static gboolean
@@ -159,6 +292,7 @@ thumbnail_thread_starter_cb (gpointer data)
 {
     pthread_attr_t thread_attributes;
     pthread_t thumbnail_thread;
+    int n_queued, n_threads, priority, i;
 
     /* Don't do this in thread, since g_object_ref is not threadsafe */
     if (thumbnail_factory == NULL)
@@ -166,25 +300,43 @@ thumbnail_thread_starter_cb (gpointer data)
         thumbnail_factory = get_thumbnail_factory ();
     }
 
-    /* We create the thread in the detached state, as we don't need/want
-       to join with it at any point. */
+    /* Start one thread per queued thumbnail, up to the pool size. We
+       count the threads as running before creating them, so a thread
+       that finds no work right away can't make us start too many. */
+    pthread_mutex_lock (&thumbnails_mutex);
+    n_queued = 0;
+    for (priority = 0; priority < THUMBNAIL_N_PRIORITIES; priority++)
+    {
+        n_queued += thumbnails_to_make[priority].length;
+    }
+    n_threads = MIN (n_queued, get_max_thumbnail_workers () - thumbnail_threads_running);
+    n_threads = MAX (n_threads, 0);
+    thumbnail_threads_running += n_threads;
+    pthread_mutex_unlock (&thumbnails_mutex);
+
+    /* We create the threads in the detached state, as we don't need/want
+       to join with them at any point. */
     pthread_attr_init (&thread_attributes);
     pthread_attr_setdetachstate (&thread_attributes,
                                  PTHREAD_CREATE_DETACHED);
 #ifdef _POSIX_THREAD_ATTR_STACKSIZE
     pthread_attr_setstacksize (&thread_attributes, 128*1024);
 #endif
+    for (i = 0; i < n_threads; i++)
+    {
 #ifdef DEBUG_THUMBNAILS
-    g_message ("(Main Thread) Creating thumbnails thread\n");
+        g_message ("(Main Thread) Creating thumbnails thread\n");
 #endif
-    /* We set a flag to indicate the thread is running, so we don't create
-       a new one. We don't need to lock a mutex here, as the thumbnail
-       thread isn't running yet. And we know we won't create the thread
-       twice, as we also check thumbnail_thread_starter_id before
-       scheduling this idle function. */
-    thumbnail_thread_is_running = TRUE;
-    pthread_create (&thumbnail_thread, &thread_attributes,
-                    thumbnail_thread_start, NULL);
+        if (pthread_create (&thumbnail_thread, &thread_attributes,
+                            thumbnail_thread_start, NULL) != 0)
+        {
+            pthread_mutex_lock (&thumbnails_mutex);
+            thumbnail_threads_running -= n_threads - i;
+            pthread_mutex_unlock (&thumbnails_mutex);
+            break;
+        }
+    }
+    pthread_attr_destroy (&thread_attributes);
 
     thumbnail_thread_starter_id = 0;
 
@@ -194,7 +346,7 @@ thumbnail_thread_starter_cb (gpointer data)
 void
 caja_thumbnail_remove_from_queue (const char *file_uri)
 {
-    GList *node;
+    CajaThumbnailInfo *info;
 
 #ifdef DEBUG_THUMBNAILS
     g_message ("(Remove from queue) Locking mutex\n");
@@ -207,13 +359,18 @@ caja_thumbnail_remove_from_queue (const char *file_uri)
 
     if (thumbnails_to_make_hash)
     {
-        node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+        info = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-        if (node && node->data != currently_thumbnailing)
+        if (info && info->in_progress)
+        {
+            /* The worker drops it when it is done. */
+            info->cancelled = TRUE;
+        }
+        else if (info)
         {
             g_hash_table_remove (thumbnails_to_make_hash, file_uri);
-            free_thumbnail_info (node->data);
-            g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
+            unqueue_thumbnail_info (info);
+            free_thumbnail_info (info);
         }
     }
 
@@ -227,14 +384,12 @@ caja_thumbnail_remove_from_queue (const char *file_uri)
     pthread_mutex_unlock (&thumbnails_mutex);
 }
 
-void
-caja_thumbnail_prioritize (const char *file_uri)
+static void
+thumbnail_set_priority (const char *file_uri,
+                        ThumbnailPriority priority)
 {
-    GList *node;
+    CajaThumbnailInfo *info;
 
-#ifdef DEBUG_THUMBNAILS
-    g_message ("(Prioritize) Locking mutex\n");
-#endif
     pthread_mutex_lock (&thumbnails_mutex);
 
     /*********************************
@@ -243,12 +398,21 @@ caja_thumbnail_prioritize (const char *file_uri)
 
     if (thumbnails_to_make_hash)
     {
-        node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+        info = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 
-        if (node && node->data != currently_thumbnailing)
+        if (info && info->expensive && priority == THUMBNAIL_PRIORITY_NORMAL)
         {
-            g_queue_unlink ((GQueue *)&thumbnails_to_make, node);
-            g_queue_push_head_link ((GQueue *)&thumbnails_to_make, node);
+            priority = THUMBNAIL_PRIORITY_DEFERRED;
+        }
+
+        /* Either way the file goes to the head of its queue: the
+           visible ones in the order the view reports them, the ones
+           that scrolled away ahead of files that were never seen. */
+        if (info && !info->in_progress &&
+            (priority == THUMBNAIL_PRIORITY_VISIBLE || info->priority != priority))
+        {
+            unqueue_thumbnail_info (info);
+            queue_thumbnail_info (info, priority, TRUE);
         }
     }
 
@@ -256,10 +420,25 @@ caja_thumbnail_prioritize (const char *file_uri)
      * MUTEX UNLOCKED
      *********************************/
 
+    pthread_mutex_unlock (&thumbnails_mutex);
+}
+
+void
+caja_thumbnail_prioritize (const char *file_uri)
+{
 #ifdef DEBUG_THUMBNAILS
-    g_message ("(Prioritize) Unlocking mutex\n");
+    g_message ("(Prioritize) %s\n", file_uri);
 #endif
-    pthread_mutex_unlock (&thumbnails_mutex);
+    thumbnail_set_priority (file_uri, THUMBNAIL_PRIORITY_VISIBLE);
+}
+
+void
+caja_thumbnail_deprioritize (const char *file_uri)
+{
+#ifdef DEBUG_THUMBNAILS
+    g_message ("(Deprioritize) %s\n", file_uri);
+#endif
+    thumbnail_set_priority (file_uri, THUMBNAIL_PRIORITY_NORMAL);
 }
 
 
@@ -279,6 +458,10 @@ thumbnail_thread_notify_file_changed (gpointer image_uri)
 
     gdk_threads_enter ();
 
+    /* The thumbnail was just written, the index may not have heard
+       from its file monitor yet. */
+    caja_thumbnail_index_refresh ((char *) image_uri);
+
     file = caja_file_get_by_uri ((char *) image_uri);
 #ifdef DEBUG_THUMBNAILS
     g_message ("(Thumbnail Thread) Notifying file changed file:%p uri: %s\n", file, (char*) image_uri);
@@ -379,30 +562,73 @@ caja_can_thumbnail (CajaFile *file)
     mime_type = caja_file_get_mime_type (file);
     mtime = caja_file_get_mtime (file);
 
+    /* Types that never worked get their generic icon right away,
+       unless we decode them ourselves, where a failure is down to the
+       file and is kept for it alone. */
+    if (!pixbuf_can_load_type (mime_type) &&
+            !caja_image_preview_is_supported (mime_type) &&
+            caja_thumbnail_costs_get (mime_type) == CAJA_THUMBNAIL_COST_HOPELESS)
+    {
+        g_free (mime_type);
+        g_free (uri);
+        return FALSE;
+    }
+
     factory = get_thumbnail_factory ();
     res = mate_desktop_thumbnail_factory_can_thumbnail (factory,
             uri,
             mime_type,
             mtime);
+
+    /* We can do camera RAW files ourselves, even without a thumbnailer
+       for them, as long as we didn't fail before. */
+    if (!res &&
+            caja_file_is_local (file) &&
+            caja_image_preview_is_supported (mime_type))
+    {
+        res = !mate_desktop_thumbnail_factory_has_valid_failed_thumbnail (factory,
+                uri,
+                mtime);
+    }
     g_free (mime_type);
     g_free (uri);
 
     return res;
 }
 
+static ThumbnailKind
+get_thumbnail_kind (const char *mime_type)
+{
+    if (mime_type == NULL)
+    {
+        return THUMBNAIL_KIND_EXTERNAL;
+    }
+    if (g_str_has_prefix (mime_type, "video/"))
+    {
+        return THUMBNAIL_KIND_VIDEO;
+    }
+    if (pixbuf_can_load_type (mime_type))
+    {
+        return THUMBNAIL_KIND_IMAGE;
+    }
+    return THUMBNAIL_KIND_EXTERNAL;
+}
+
 void
 caja_create_thumbnail (CajaFile *file)
 {
     time_t file_mtime = 0;
     CajaThumbnailInfo *info;
     CajaThumbnailInfo *existing_info;
-    GList *existing, *node;
 
     caja_file_set_is_thumbnailing (file, TRUE);
 
     info = g_new0 (CajaThumbnailInfo, 1);
     info->image_uri = caja_file_get_uri (file);
     info->mime_type = caja_file_get_mime_type (file);
+    /* Work this out here, the types table is not thread safe. */
+    info->kind = get_thumbnail_kind (info->mime_type);
+    info->expensive = caja_thumbnail_costs_get (info->mime_type) == CAJA_THUMBNAIL_COST_EXPENSIVE;
 
     /* Hopefully the CajaFile will already have the image file mtime,
        so we can just use that. Otherwise we have to get it ourselves. */
@@ -436,24 +662,25 @@ caja_create_thumbnail (CajaFile *file)
     }
 
     /* Check if it is already in the list of thumbnails to make. */
-    existing = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-    if (existing == NULL)
+    existing_info = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
+    if (existing_info == NULL)
     {
         /* Add the thumbnail to the list. */
 #ifdef DEBUG_THUMBNAILS
         g_message ("(Main Thread) Adding thumbnail: %s\n",
                    info->image_uri);
 #endif
-        g_queue_push_tail ((GQueue *)&thumbnails_to_make, info);
-        node = g_queue_peek_tail_link ((GQueue *)&thumbnails_to_make);
+        queue_thumbnail_info (info,
+                              info->expensive ? THUMBNAIL_PRIORITY_DEFERRED : THUMBNAIL_PRIORITY_NORMAL,
+                              FALSE);
         g_hash_table_insert (thumbnails_to_make_hash,
                              info->image_uri,
-                             node);
-        /* If the thumbnail thread isn't running, and we haven't
-           scheduled an idle function to start it up, do that now.
-           We don't want to start it until all the other work is done,
+                             info);
+        /* If the thumbnail pool isn't full, and we haven't scheduled
+           an idle function to add threads to it, do that now.
+           We don't want to start them until all the other work is done,
            so the GUI will be updated as quickly as possible.*/
-        if (thumbnail_thread_is_running == FALSE &&
+        if (thumbnail_threads_running < get_max_thumbnail_workers () &&
                 thumbnail_thread_starter_id == 0)
         {
             thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
@@ -466,8 +693,8 @@ caja_create_thumbnail (CajaFile *file)
                    info->image_uri);
 #endif
         /* The file in the queue might need a new original mtime */
-        existing_info = existing->data;
         existing_info->original_file_mtime = info->original_file_mtime;
+        existing_info->cancelled = FALSE;
         free_thumbnail_info (info);
     }
 
@@ -481,7 +708,9 @@ caja_create_thumbnail (CajaFile *file)
     pthread_mutex_unlock (&thumbnails_mutex);
 }
 
-/* thumbnail_thread is invoked as a separate thread to to make thumbnails. */
+/* thumbnail_thread is invoked as a separate thread to to make thumbnails.
+   Several of them run at once, each taking the next request it may run
+   from the queues. */
 static gpointer
 thumbnail_thread_start (gpointer data)
 {
@@ -489,10 +718,12 @@ thumbnail_thread_start (gpointer data)
     GdkPixbuf *pixbuf;
     time_t current_orig_mtime = 0;
     time_t current_time;
-    GList *node;
+    gboolean skipped = FALSE;
+    GTimer *timer;
+    char *path;
 
-    /* We loop until there are no more thumbails to make, at which point
-       we exit the thread. */
+    /* We loop until there are no more thumbails we can make, at which
+       point we exit the thread. */
     for (;;)
     {
 #ifdef DEBUG_THUMBNAILS
@@ -504,43 +735,62 @@ thumbnail_thread_start (gpointer data)
          * MUTEX LOCKED
          *********************************/
 
-        /* Pop the last thumbnail we just made off the head of the
-           list and free it. I did this here so we only have to lock
-           the mutex once per thumbnail, rather than once before
-           creating it and once after.
-           Don't pop the thumbnail off the queue if the original file
-           mtime of the request changed. Then we need to redo the thumbnail.
+        /* Finish the thumbnail we just made and free it. I did this
+           here so we only have to lock the mutex once per thumbnail,
+           rather than once before creating it and once after.
+           Don't drop the request if the original file mtime changed.
+           Then we need to redo the thumbnail.
         */
-        if (currently_thumbnailing &&
-                currently_thumbnailing->original_file_mtime == current_orig_mtime)
+        if (info != NULL)
         {
-            g_assert (info == currently_thumbnailing);
-            node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-            g_assert (node != NULL);
-            g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
-            free_thumbnail_info (info);
-            g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
+            info->in_progress = FALSE;
+            thumbnails_running_per_kind[info->kind]--;
+
+            if (info->cancelled ||
+                    info->original_file_mtime == current_orig_mtime)
+            {
+                /* We need to call caja_file_changed(), but I don't think that is
+                   thread safe. So add an idle handler and do it from the main loop.
+                   Nobody is interested any more if the request was cancelled. */
+                if (!info->cancelled && skipped)
+                {
+                    /* Reschedule thumbnailing via a change notification */
+                    g_timeout_add_seconds (1, thumbnail_thread_notify_file_changed,
+                                           g_strdup (info->image_uri));
+                }
+                else if (!info->cancelled)
+                {
+                    g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                     thumbnail_thread_notify_file_changed,
+                                     g_strdup (info->image_uri), NULL);
+                }
+
+                g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
+                free_thumbnail_info (info);
+            }
+            else
+            {
+                queue_thumbnail_info (info, info->priority, TRUE);
+            }
         }
-        currently_thumbnailing = NULL;
 
-        /* If there are no more thumbnails to make, reset the
-           thumbnail_thread_is_running flag, unlock the mutex, and
-           exit the thread. */
-        if (g_queue_is_empty ((GQueue *)&thumbnails_to_make))
+        /* Get the next one to make. It stays in the hash table until
+           it is created so the main thread doesn't add it again while
+           we are creating it. If there is nothing we may make right now,
+           unlock the mutex and exit the thread; requests held back by
+           the per kind limits are taken by the threads making the
+           thumbnails of that kind. */
+        info = take_next_thumbnail_info ();
+        if (info == NULL)
         {
 #ifdef DEBUG_THUMBNAILS
             g_message ("(Thumbnail Thread) Exiting\n");
 #endif
-            thumbnail_thread_is_running = FALSE;
+            thumbnail_threads_running--;
             pthread_mutex_unlock (&thumbnails_mutex);
             pthread_exit (NULL);
         }
 
-        /* Get the next one to make. We leave it on the list until it
-           is created so the main thread doesn't add it again while we
-           are creating it. */
-        info = g_queue_peek_head ((GQueue *)&thumbnails_to_make);
-        currently_thumbnailing = info;
         current_orig_mtime = info->original_file_mtime;
         /*********************************
          * MUTEX UNLOCKED
@@ -555,16 +805,14 @@ thumbnail_thread_start (gpointer data)
 
         /* Don't try to create a thumbnail if the file was modified recently.
            This prevents constant re-thumbnailing of changing files. */
-        if (current_time < current_orig_mtime + THUMBNAIL_CREATION_DELAY_SECS &&
-                current_time >= current_orig_mtime)
+        skipped = current_time < current_orig_mtime + THUMBNAIL_CREATION_DELAY_SECS &&
+                  current_time >= current_orig_mtime;
+        if (skipped)
         {
 #ifdef DEBUG_THUMBNAILS
             g_message ("(Thumbnail Thread) Skipping: %s\n",
                        info->image_uri);
 #endif
-            /* Reschedule thumbnailing via a change notification */
-            g_timeout_add_seconds (1, thumbnail_thread_notify_file_changed,
-                                   g_strdup (info->image_uri));
             continue;
         }
 
@@ -574,9 +822,32 @@ thumbnail_thread_start (gpointer data)
                    info->image_uri);
 #endif
 
-        pixbuf = mate_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
-                 info->image_uri,
-                 info->mime_type);
+        /* Embedded previews and reduced size JPEG decoding are much
+           faster than a full decode, so try those first. */
+        timer = g_timer_new ();
+        pixbuf = NULL;
+        if (caja_image_preview_is_supported (info->mime_type))
+        {
+            path = g_filename_from_uri (info->image_uri, NULL, NULL);
+            if (path != NULL)
+            {
+                pixbuf = caja_image_preview_load (path, info->mime_type,
+                                                  CAJA_THUMBNAIL_NORMAL_SIZE);
+                g_free (path);
+            }
+        }
+
+        if (pixbuf == NULL)
+        {
+            pixbuf = mate_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
+                     info->image_uri,
+                     info->mime_type);
+        }
+
+        /* Learn which types are worth the wait. */
+        caja_thumbnail_costs_record (info->mime_type, pixbuf != NULL,
+                                     g_timer_elapsed (timer, NULL) * 1000);
+        g_timer_destroy (timer);
 
         if (pixbuf)
         {
@@ -600,10 +871,5 @@ thumbnail_thread_start (gpointer data)
                     info->image_uri,
                     current_orig_mtime);
         }
-        /* We need to call caja_file_changed(), but I don't think that is
-           thread safe. So add an idle handler and do it from the main loop. */
-        g_idle_add_full (G_PRIORITY_HIGH_IDLE,
-                         thumbnail_thread_notify_file_changed,
-                         g_strdup (info->image_uri), NULL);
     }
 }
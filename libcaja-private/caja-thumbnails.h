@@ -28,6 +28,9 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <libcaja-private/caja-file.h>
 
+/* Size of the thumbnails we make, MATE_DESKTOP_THUMBNAIL_SIZE_NORMAL */
+#define CAJA_THUMBNAIL_NORMAL_SIZE 128
+
 /* Returns NULL if there's no thumbnail yet. */
 void       caja_create_thumbnail                (CajaFile *file);
 gboolean   caja_can_thumbnail                   (CajaFile *file);
@@ -38,6 +41,7 @@ gboolean   caja_thumbnail_is_mimetype_limited_by_size
 /* Queue handling: */
 void       caja_thumbnail_remove_from_queue     (const char   *file_uri);
 void       caja_thumbnail_prioritize            (const char   *file_uri);
+void       caja_thumbnail_deprioritize          (const char   *file_uri);
 
 
 #endif /* CAJA_THUMBNAILS_H */
@@ -30,6 +30,7 @@
 #include "caja-directory-private.h"
 #include "caja-file-private.h"
 #include "caja-autorun.h"
+#include <eel/eel-debug.h>
 #include <eel/eel-gtk-macros.h>
 #include <glib/gi18n.h>
 
@@ -118,6 +119,17 @@ set_metadata_get_info_callback (GObject *source_object,
     }
 }
 
+/* Metadata is written a while after it is set, all of a file's keys at
+ * once and a folder at a time, so dragging or resetting thousands of
+ * icons doesn't mean a write per key. Until then the new values are
+ * only in the files, where reads see them right away.
+ */
+#define METADATA_WRITE_DELAY 500 /* milliseconds */
+
+/* The files with metadata to write, by folder. */
+static GHashTable *pending_metadata_directories;
+static guint metadata_write_timeout_id;
+
 static void
 set_metadata_callback (GObject *source_object,
                        GAsyncResult *result,
@@ -128,6 +140,7 @@ set_metadata_callback (GObject *source_object,
     gboolean res;
 
     file = callback_data;
+    file->details->metadata_writes_in_flight--;
 
     error = NULL;
     res = g_file_set_attributes_finish (G_FILE (source_object),
@@ -137,55 +150,157 @@ set_metadata_callback (GObject *source_object,
 
     if (res)
     {
+        caja_file_unref (file);
+    }
+    else
+    {
+        /* What the file has isn't what was written, so find out
+         * what was. */
         g_file_query_info_async (G_FILE (source_object),
-                                 CAJA_FILE_DEFAULT_ATTRIBUTES,
+                                 caja_file_get_default_attributes (),
                                  0,
                                  G_PRIORITY_DEFAULT,
                                  NULL,
                                  set_metadata_get_info_callback, file);
-    }
-    else
-    {
-        caja_file_unref (file);
         g_error_free (error);
     }
 }
 
 static void
-vfs_file_set_metadata (CajaFile           *file,
-                       const char             *key,
-                       const char             *value)
+write_file_metadata (CajaFile *file, gboolean synchronously)
 {
     GFileInfo *info;
     GFile *location;
+
+    info = file->details->pending_metadata;
+    file->details->pending_metadata = NULL;
+
+    location = caja_file_get_location (file);
+    if (synchronously)
+    {
+        g_file_set_attributes_from_info (location, info, 0, NULL, NULL);
+        caja_file_unref (file);
+    }
+    else
+    {
+        file->details->metadata_writes_in_flight++;
+        g_file_set_attributes_async (location,
+                                     info,
+                                     0,
+                                     G_PRIORITY_DEFAULT,
+                                     NULL,
+                                     set_metadata_callback,
+                                     file);
+    }
+    g_object_unref (location);
+    g_object_unref (info);
+}
+
+static void
+write_pending_metadata (gboolean synchronously)
+{
+    GHashTableIter iter;
+    gpointer files;
+    GList *l;
+
+    if (metadata_write_timeout_id != 0)
+    {
+        g_source_remove (metadata_write_timeout_id);
+        metadata_write_timeout_id = 0;
+    }
+
+    if (pending_metadata_directories == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_iter_init (&iter, pending_metadata_directories);
+    while (g_hash_table_iter_next (&iter, NULL, &files))
+    {
+        /* The list's references go with the writes. */
+        for (l = files; l != NULL; l = l->next)
+        {
+            write_file_metadata (l->data, synchronously);
+        }
+        g_list_free (files);
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static gboolean
+write_metadata_timeout (gpointer user_data)
+{
+    metadata_write_timeout_id = 0;
+    write_pending_metadata (FALSE);
+
+    return FALSE;
+}
+
+static void
+write_metadata_at_shutdown (void)
+{
+    write_pending_metadata (TRUE);
+    g_hash_table_destroy (pending_metadata_directories);
+    pending_metadata_directories = NULL;
+}
+
+static void
+queue_metadata (CajaFile *file,
+                const char *key,
+                GFileAttributeType type,
+                gpointer value)
+{
+    GList *files;
     char *gio_key;
 
-    info = g_file_info_new ();
+    if (file->details->pending_metadata == NULL)
+    {
+        if (pending_metadata_directories == NULL)
+        {
+            pending_metadata_directories = g_hash_table_new (NULL, NULL);
+            eel_debug_call_at_shutdown (write_metadata_at_shutdown);
+        }
+
+        file->details->pending_metadata = g_file_info_new ();
+        files = g_hash_table_lookup (pending_metadata_directories,
+                                     file->details->directory);
+        g_hash_table_insert (pending_metadata_directories,
+                             file->details->directory,
+                             g_list_prepend (files, caja_file_ref (file)));
+    }
 
+    /* A later value for a key replaces the one waiting. */
     gio_key = g_strconcat ("metadata::", key, NULL);
+    g_file_info_set_attribute (file->details->pending_metadata,
+                               gio_key, type, value);
+    g_free (gio_key);
+
+    if (metadata_write_timeout_id == 0)
+    {
+        metadata_write_timeout_id =
+            g_timeout_add (METADATA_WRITE_DELAY, write_metadata_timeout, NULL);
+    }
+}
+
+static void
+vfs_file_set_metadata (CajaFile           *file,
+                       const char             *key,
+                       const char             *value)
+{
     if (value != NULL)
     {
-        g_file_info_set_attribute_string (info, gio_key, value);
+        queue_metadata (file, key, G_FILE_ATTRIBUTE_TYPE_STRING, (gpointer) value);
     }
     else
     {
         /* Unset the key */
-        g_file_info_set_attribute (info, gio_key,
-                                   G_FILE_ATTRIBUTE_TYPE_INVALID,
-                                   NULL);
+        queue_metadata (file, key, G_FILE_ATTRIBUTE_TYPE_INVALID, NULL);
     }
-    g_free (gio_key);
 
-    location = caja_file_get_location (file);
-    g_file_set_attributes_async (location,
-                                 info,
-                                 0,
-                                 G_PRIORITY_DEFAULT,
-                                 NULL,
-                                 set_metadata_callback,
-                                 caja_file_ref (file));
-    g_object_unref (location);
-    g_object_unref (info);
+    if (caja_file_update_metadata (file, key, value))
+    {
+        caja_file_changed (file);
+    }
 }
 
 static void
@@ -193,26 +308,12 @@ vfs_file_set_metadata_as_list (CajaFile           *file,
                                const char             *key,
                                char                  **value)
 {
-    GFile *location;
-    GFileInfo *info;
-    char *gio_key;
-
-    info = g_file_info_new ();
+    queue_metadata (file, key, G_FILE_ATTRIBUTE_TYPE_STRINGV, value);
 
-    gio_key = g_strconcat ("metadata::", key, NULL);
-    g_file_info_set_attribute_stringv (info, gio_key, value);
-    g_free (gio_key);
-
-    location = caja_file_get_location (file);
-    g_file_set_attributes_async (location,
-                                 info,
-                                 0,
-                                 G_PRIORITY_DEFAULT,
-                                 NULL,
-                                 set_metadata_callback,
-                                 caja_file_ref (file));
-    g_object_unref (info);
-    g_object_unref (location);
+    if (caja_file_update_metadata_list (file, key, value))
+    {
+        caja_file_changed (file);
+    }
 }
 
 static gboolean
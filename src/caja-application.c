@@ -364,6 +364,12 @@ caja_application_finalize (GObject *object)
         application->automount_idle_id = 0;
     }
 
+    if (application->deferred_startup_id != 0)
+    {
+        g_source_remove (application->deferred_startup_id);
+        application->deferred_startup_id = 0;
+    }
+
     if (application->proxy != NULL)
     {
         g_object_unref (application->proxy);
@@ -725,16 +731,21 @@ do_upgrades_once (CajaApplication *application,
     g_free (metafile_dir);
 }
 
+/* Everything here can wait until the first window is up: none of it
+ * changes what that window shows, and some of it, like asking the
+ * volume monitor for the drives or loading the menu extensions, can
+ * take a while on a cold start.
+ */
 static void
-finish_startup (CajaApplication *application,
-                gboolean no_desktop)
+finish_deferred_startup (CajaApplication *application)
 {
     GList *drives;
 
-    do_upgrades_once (application, no_desktop);
-
-    /* initialize caja modules */
-    caja_module_setup ();
+    if (application->deferred_startup_done)
+    {
+        return;
+    }
+    application->deferred_startup_done = TRUE;
 
     /* attach menu-provider module callback */
     menu_provider_init_callback ();
@@ -772,6 +783,108 @@ finish_startup (CajaApplication *application,
         g_idle_add_full (G_PRIORITY_LOW,
                          automount_all_volumes_idle_cb,
                          application, NULL);
+
+    caja_debug_log_startup_end ();
+}
+
+static gboolean
+deferred_startup_idle_cb (gpointer data)
+{
+    CajaApplication *application = CAJA_APPLICATION (data);
+
+    application->deferred_startup_id = 0;
+
+    finish_deferred_startup (application);
+
+    return FALSE;
+}
+
+static void
+queue_deferred_startup (CajaApplication *application)
+{
+    if (application->deferred_startup_done ||
+        application->deferred_startup_id != 0)
+    {
+        return;
+    }
+
+    application->deferred_startup_id =
+        g_idle_add_full (G_PRIORITY_LOW,
+                         deferred_startup_idle_cb,
+                         application, NULL);
+}
+
+static void startup_window_destroy_cb (GtkWidget       *widget,
+                                       CajaApplication *application);
+
+static gboolean
+startup_window_map_event_cb (GtkWidget       *widget,
+                             GdkEvent        *event,
+                             CajaApplication *application)
+{
+    g_signal_handlers_disconnect_by_func (widget, startup_window_map_event_cb, application);
+    g_signal_handlers_disconnect_by_func (widget, startup_window_destroy_cb, application);
+
+    caja_debug_log_startup_phase ("first window mapped");
+
+    queue_deferred_startup (application);
+
+    return FALSE;
+}
+
+static void
+startup_window_destroy_cb (GtkWidget       *widget,
+                           CajaApplication *application)
+{
+    g_signal_handlers_disconnect_by_func (widget, startup_window_map_event_cb, application);
+    g_signal_handlers_disconnect_by_func (widget, startup_window_destroy_cb, application);
+
+    queue_deferred_startup (application);
+}
+
+/* Runs the rest of the startup once the first window has been mapped,
+ * or right away in the idle if there is no window to wait for.
+ */
+static void
+defer_startup_until_mapped (CajaApplication *application)
+{
+    GtkWidget *window;
+
+    window = NULL;
+    if (caja_application_window_list != NULL)
+    {
+        window = GTK_WIDGET (caja_application_window_list->data);
+    }
+    else if (caja_application_desktop_windows != NULL)
+    {
+        window = GTK_WIDGET (caja_application_desktop_windows->data);
+    }
+
+    if (window == NULL || gtk_widget_get_mapped (window))
+    {
+        queue_deferred_startup (application);
+        return;
+    }
+
+    g_signal_connect_after (window, "map-event",
+                            G_CALLBACK (startup_window_map_event_cb), application);
+    g_signal_connect (window, "destroy",
+                      G_CALLBACK (startup_window_destroy_cb), application);
+}
+
+static void
+finish_startup (CajaApplication *application,
+                gboolean no_desktop)
+{
+    do_upgrades_once (application, no_desktop);
+
+    if (!no_desktop)
+    {
+        /* The desktop shows the links as soon as it is up */
+        caja_desktop_link_monitor_get ();
+    }
+
+    caja_debug_log_startup_phase ("upgrades done");
 }
 
 static void
@@ -976,6 +1089,7 @@ caja_application_startup (CajaApplication *application,
             else
             {
                 caja_application_open_desktop (application);
+                caja_debug_log_startup_phase ("desktop opened");
             }
         }
 
@@ -1022,6 +1136,7 @@ caja_application_startup (CajaApplication *application,
                               gdk_screen_get_default (),
                               geometry,
                               browser_window);
+                caja_debug_log_startup_phase ("windows opened");
             }
         }
 
@@ -1036,6 +1151,11 @@ caja_application_startup (CajaApplication *application,
             g_free (accel_map_filename);
         }
         g_signal_connect (gtk_accel_map_get (), "changed", G_CALLBACK (queue_accel_map_save_callback), NULL);
+
+        if (!unique_app_is_running (application->unique_app))
+        {
+            defer_startup_until_mapped (application);
+        }
     }
 }
 
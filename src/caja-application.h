@@ -66,6 +66,8 @@ typedef struct
     EggSMClient* smclient;
     GVolumeMonitor* volume_monitor;
     unsigned int automount_idle_id;
+    unsigned int deferred_startup_id;
+    gboolean deferred_startup_done;
     GDBusProxy* proxy;
     gboolean session_is_active;
 } CajaApplication;
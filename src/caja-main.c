@@ -44,6 +44,7 @@
 #include <glib/gi18n.h>
 #include <gio/gdesktopappinfo.h>
 #include <libcaja-private/caja-debug-log.h>
+#include <libcaja-private/caja-directory-private.h>
 #include <libcaja-private/caja-global-preferences.h>
 #include <libcaja-private/caja-lib-self-check-functions.h>
 #include <libcaja-private/caja-icon-names.h>
@@ -156,10 +157,32 @@ void caja_main_event_loop_quit (gboolean explicit)
     }
 }
 
+static void log_info_provider_stats (void)
+{
+    CajaInfoProviderStats *stats;
+    GList *stats_list, *l;
+
+    stats_list = caja_directory_get_info_provider_stats ();
+    for (l = stats_list; l != NULL; l = l->next)
+    {
+        stats = l->data;
+        caja_debug_log (FALSE, CAJA_DEBUG_LOG_DOMAIN_USER,
+                        "info provider %s: %u requests for %u files, %u timeouts, "
+                        "mean %u ms, max %u ms%s",
+                        stats->provider_name,
+                        stats->n_requests, stats->n_files, stats->n_timeouts,
+                        stats->mean_msecs, stats->max_msecs,
+                        stats->disabled ? ", disabled" : "");
+    }
+    caja_info_provider_stats_list_free (stats_list);
+}
+
 static void dump_debug_log (void)
 {
     char *filename;
 
+    log_info_provider_stats ();
+
     filename = g_build_filename (g_get_home_dir (), "caja-debug-log.txt", NULL);
     caja_debug_log_dump (filename, NULL); /* NULL GError */
     g_free (filename);
@@ -389,6 +412,8 @@ main (int argc, char *argv[])
 
     g_thread_init (NULL);
 
+    caja_debug_log_startup_begin ();
+
     /* This will be done by gtk+ later, but for now, force it to MATE */
     g_desktop_app_info_set_desktop_env ("MATE");
 
@@ -454,6 +479,7 @@ main (int argc, char *argv[])
 #endif
 
     setup_debug_log ();
+    caja_debug_log_startup_phase ("options parsed");
 
     /* If in autostart mode (aka started by mate-session), we need to ensure
          * caja starts with the correct options.
@@ -496,6 +522,7 @@ main (int argc, char *argv[])
      * happens.
      */
     caja_global_preferences_init ();
+    caja_debug_log_startup_phase ("preferences initialized");
 
     /* exit_with_last_window being FALSE, caja can run without window. */
     exit_with_last_window = g_settings_get_boolean (caja_preferences, CAJA_PREFERENCES_EXIT_WITH_LAST_WINDOW);
@@ -545,6 +572,7 @@ main (int argc, char *argv[])
 
         /* Run the caja application. */
         application = caja_application_new ();
+        caja_debug_log_startup_phase ("application created");
 
         if (egg_sm_client_is_resumed (application->smclient))
         {
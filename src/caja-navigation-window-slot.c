@@ -116,9 +116,9 @@ query_editor_changed_callback (CajaSearchBar *bar,
     directory = caja_directory_get_for_file (slot->viewed_file);
     g_assert (CAJA_IS_SEARCH_DIRECTORY (directory));
 
-    caja_search_directory_set_query (CAJA_SEARCH_DIRECTORY (directory),
-                                     query);
-    if (reload)
+    /* A narrower query filters the hits there are, without reloading. */
+    if (!caja_search_directory_refine_query (CAJA_SEARCH_DIRECTORY (directory),
+            query) && reload)
     {
         caja_window_slot_reload (slot);
     }
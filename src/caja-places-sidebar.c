@@ -102,6 +102,8 @@ typedef struct
     CajaWindowOpenFlags go_to_after_mount_flags;
 
 	GtkTreePath *eject_highlight_path;
+
+    guint update_places_idle_id;
 } CajaPlacesSidebar;
 
 typedef struct
@@ -3319,6 +3321,12 @@ caja_places_sidebar_dispose (GObject *object)
 
     sidebar = CAJA_PLACES_SIDEBAR (object);
 
+    if (sidebar->update_places_idle_id != 0)
+    {
+        g_source_remove (sidebar->update_places_idle_id);
+        sidebar->update_places_idle_id = 0;
+    }
+
     sidebar->window = NULL;
     sidebar->tree_view = NULL;
 
@@ -3395,6 +3403,33 @@ caja_places_sidebar_iface_init (CajaSidebarIface *iface)
     iface->is_visible_changed = caja_places_sidebar_is_visible_changed;
 }
 
+static gboolean
+update_places_idle_callback (gpointer data)
+{
+    CajaPlacesSidebar *sidebar;
+
+    sidebar = CAJA_PLACES_SIDEBAR (data);
+    sidebar->update_places_idle_id = 0;
+
+    update_places (sidebar);
+
+    return FALSE;
+}
+
+/* Asking the volume monitor for the drives, volumes and mounts can be
+ * slow, so the list is filled in once the window is up rather than
+ * while it is being made.
+ */
+static void
+schedule_update_places (CajaPlacesSidebar *sidebar)
+{
+    if (sidebar->update_places_idle_id == 0)
+    {
+        sidebar->update_places_idle_id =
+            g_idle_add (update_places_idle_callback, sidebar);
+    }
+}
+
 static void
 caja_places_sidebar_set_parent_window (CajaPlacesSidebar *sidebar,
                                        CajaWindowInfo *window)
@@ -3435,7 +3470,7 @@ caja_places_sidebar_set_parent_window (CajaPlacesSidebar *sidebar,
     g_signal_connect_object (sidebar->volume_monitor, "drive_changed",
                              G_CALLBACK (drive_changed_callback), sidebar, 0);
 
-    update_places (sidebar);
+    schedule_update_places (sidebar);
 }
 
 static void
@@ -3446,7 +3481,7 @@ caja_places_sidebar_style_set (GtkWidget *widget,
 
     sidebar = CAJA_PLACES_SIDEBAR (widget);
 
-    update_places (sidebar);
+    schedule_update_places (sidebar);
 }
 
 static CajaSidebar *
@@ -40,6 +40,11 @@ typedef enum
 {
     CAJA_QUERY_EDITOR_ROW_LOCATION,
     CAJA_QUERY_EDITOR_ROW_TYPE,
+    CAJA_QUERY_EDITOR_ROW_CONTENTS,
+    CAJA_QUERY_EDITOR_ROW_SIZE,
+    CAJA_QUERY_EDITOR_ROW_MODIFIED,
+    CAJA_QUERY_EDITOR_ROW_OWNER,
+    CAJA_QUERY_EDITOR_ROW_EXTENSION,
 
     CAJA_QUERY_EDITOR_ROW_LAST
 } CajaQueryEditorRowType;
@@ -117,6 +122,35 @@ static void       type_row_add_to_query        (CajaQueryEditorRow *row,
 static void       type_row_free_data           (CajaQueryEditorRow *row);
 static void       type_add_rows_from_query     (CajaQueryEditor    *editor,
         CajaQuery          *query);
+static GtkWidget *contents_row_create_widgets  (CajaQueryEditorRow *row);
+static void       contents_row_add_to_query    (CajaQueryEditorRow *row,
+        CajaQuery          *query);
+static void       contents_row_free_data       (CajaQueryEditorRow *row);
+static void       contents_add_rows_from_query (CajaQueryEditor    *editor,
+        CajaQuery          *query);
+static GtkWidget *size_row_create_widgets      (CajaQueryEditorRow *row);
+static void       size_row_add_to_query        (CajaQueryEditorRow *row,
+        CajaQuery          *query);
+static void       size_add_rows_from_query     (CajaQueryEditor    *editor,
+        CajaQuery          *query);
+static GtkWidget *modified_row_create_widgets  (CajaQueryEditorRow *row);
+static void       modified_row_add_to_query    (CajaQueryEditorRow *row,
+        CajaQuery          *query);
+static void       modified_add_rows_from_query (CajaQueryEditor    *editor,
+        CajaQuery          *query);
+static void       range_row_free_data          (CajaQueryEditorRow *row);
+static GtkWidget *owner_row_create_widgets     (CajaQueryEditorRow *row);
+static void       owner_row_add_to_query       (CajaQueryEditorRow *row,
+        CajaQuery          *query);
+static void       owner_row_free_data          (CajaQueryEditorRow *row);
+static void       owner_add_rows_from_query    (CajaQueryEditor    *editor,
+        CajaQuery          *query);
+static GtkWidget *extension_row_create_widgets (CajaQueryEditorRow *row);
+static void       extension_row_add_to_query   (CajaQueryEditorRow *row,
+        CajaQuery          *query);
+static void       extension_row_free_data      (CajaQueryEditorRow *row);
+static void       extension_add_rows_from_query (CajaQueryEditor    *editor,
+        CajaQuery          *query);
 
 
 
@@ -136,6 +170,41 @@ static CajaQueryEditorRowOps row_type[] =
         type_row_free_data,
         type_add_rows_from_query
     },
+    {
+        N_("Contains"),
+        contents_row_create_widgets,
+        contents_row_add_to_query,
+        contents_row_free_data,
+        contents_add_rows_from_query
+    },
+    {
+        N_("Size"),
+        size_row_create_widgets,
+        size_row_add_to_query,
+        range_row_free_data,
+        size_add_rows_from_query
+    },
+    {
+        N_("Modified"),
+        modified_row_create_widgets,
+        modified_row_add_to_query,
+        range_row_free_data,
+        modified_add_rows_from_query
+    },
+    {
+        N_("Owner"),
+        owner_row_create_widgets,
+        owner_row_add_to_query,
+        owner_row_free_data,
+        owner_add_rows_from_query
+    },
+    {
+        N_("Extension"),
+        extension_row_create_widgets,
+        extension_row_add_to_query,
+        extension_row_free_data,
+        extension_add_rows_from_query
+    },
 };
 
 EEL_CLASS_BOILERPLATE (CajaQueryEditor,
@@ -866,6 +935,401 @@ type_add_rows_from_query (CajaQueryEditor    *editor,
     g_list_free_full (mime_types, g_free);
 }
 
+/* Contents */
+
+static GtkWidget *
+contents_row_create_widgets (CajaQueryEditorRow *row)
+{
+    GtkWidget *entry;
+
+    entry = gtk_entry_new ();
+    gtk_widget_set_tooltip_text (entry,
+                                 _("Text the files have to contain"));
+    gtk_widget_show (entry);
+
+    g_signal_connect (entry, "activate",
+                      G_CALLBACK (entry_activate_cb), row->editor);
+    g_signal_connect (entry, "changed",
+                      G_CALLBACK (entry_changed_cb), row->editor);
+
+    gtk_box_pack_start (GTK_BOX (row->hbox), entry, TRUE, TRUE, 0);
+
+    return entry;
+}
+
+static void
+contents_row_add_to_query (CajaQueryEditorRow *row,
+                           CajaQuery          *query)
+{
+    const char *text;
+
+    text = gtk_entry_get_text (GTK_ENTRY (row->type_widget));
+    if (text != NULL && text[0] != '\0')
+    {
+        caja_query_set_contents (query, text);
+    }
+}
+
+static void
+contents_row_free_data (CajaQueryEditorRow *row)
+{
+}
+
+static void
+contents_add_rows_from_query (CajaQueryEditor    *editor,
+                              CajaQuery          *query)
+{
+    CajaQueryEditorRow *row;
+    char *contents;
+
+    contents = caja_query_get_contents (query);
+    if (contents == NULL)
+    {
+        return;
+    }
+
+    row = caja_query_editor_add_row (editor,
+                                     CAJA_QUERY_EDITOR_ROW_CONTENTS);
+    gtk_entry_set_text (GTK_ENTRY (row->type_widget), contents);
+
+    g_free (contents);
+}
+
+/* Size and modification time */
+
+/* Both are a lower or an upper limit, picked in a combo box, and an
+ * amount; which is which depends on the row type. */
+enum
+{
+    RANGE_LOWER_LIMIT,
+    RANGE_UPPER_LIMIT
+};
+
+typedef struct
+{
+    GtkWidget *limit;
+    GtkWidget *amount;
+} RangeRowData;
+
+#define MEGABYTE (1024 * 1024)
+
+static GtkWidget *
+range_row_create_widgets (CajaQueryEditorRow *row,
+                          const char *lower_limit_label,
+                          const char *upper_limit_label,
+                          double min_amount,
+                          double max_amount,
+                          double default_amount,
+                          const char *unit_label)
+{
+    RangeRowData *data;
+    GtkWidget *hbox, *label;
+
+    data = g_new0 (RangeRowData, 1);
+    row->data = data;
+
+    hbox = gtk_hbox_new (FALSE, 6);
+    gtk_widget_show (hbox);
+
+    data->limit = gtk_combo_box_text_new ();
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (data->limit), lower_limit_label);
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (data->limit), upper_limit_label);
+    gtk_combo_box_set_active (GTK_COMBO_BOX (data->limit), RANGE_LOWER_LIMIT);
+    gtk_widget_show (data->limit);
+    gtk_box_pack_start (GTK_BOX (hbox), data->limit, FALSE, FALSE, 0);
+
+    data->amount = gtk_spin_button_new_with_range (min_amount, max_amount, 1);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (data->amount), default_amount);
+    gtk_widget_show (data->amount);
+    gtk_box_pack_start (GTK_BOX (hbox), data->amount, FALSE, FALSE, 0);
+
+    label = gtk_label_new (unit_label);
+    gtk_widget_show (label);
+    gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+
+    g_signal_connect_swapped (data->limit, "changed",
+                              G_CALLBACK (caja_query_editor_changed),
+                              row->editor);
+    g_signal_connect_swapped (data->amount, "value-changed",
+                              G_CALLBACK (caja_query_editor_changed),
+                              row->editor);
+
+    gtk_box_pack_start (GTK_BOX (row->hbox), hbox, FALSE, FALSE, 0);
+
+    return hbox;
+}
+
+static void
+range_row_get (CajaQueryEditorRow *row, int *limit, gint64 *amount)
+{
+    RangeRowData *data;
+
+    data = row->data;
+    *limit = gtk_combo_box_get_active (GTK_COMBO_BOX (data->limit));
+    *amount = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (data->amount));
+}
+
+static void
+range_row_set (CajaQueryEditorRow *row, int limit, gint64 amount)
+{
+    RangeRowData *data;
+
+    data = row->data;
+    gtk_combo_box_set_active (GTK_COMBO_BOX (data->limit), limit);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (data->amount), amount);
+}
+
+static void
+range_row_free_data (CajaQueryEditorRow *row)
+{
+    g_free (row->data);
+}
+
+static GtkWidget *
+size_row_create_widgets (CajaQueryEditorRow *row)
+{
+    return range_row_create_widgets (row,
+                                     _("larger than"),
+                                     _("smaller than"),
+                                     0, 10 * 1024 * 1024, 100,
+                                     _("MB"));
+}
+
+static void
+size_row_add_to_query (CajaQueryEditorRow *row,
+                       CajaQuery          *query)
+{
+    goffset min_size, max_size;
+    gint64 amount;
+    int limit;
+
+    range_row_get (row, &limit, &amount);
+
+    caja_query_get_size_range (query, &min_size, &max_size);
+    if (limit == RANGE_LOWER_LIMIT)
+    {
+        min_size = amount * MEGABYTE;
+    }
+    else
+    {
+        max_size = amount * MEGABYTE;
+    }
+    caja_query_set_size_range (query, min_size, max_size);
+}
+
+static void
+size_add_rows_from_query (CajaQueryEditor    *editor,
+                          CajaQuery          *query)
+{
+    CajaQueryEditorRow *row;
+    goffset min_size, max_size;
+
+    caja_query_get_size_range (query, &min_size, &max_size);
+
+    if (min_size >= 0)
+    {
+        row = caja_query_editor_add_row (editor,
+                                         CAJA_QUERY_EDITOR_ROW_SIZE);
+        range_row_set (row, RANGE_LOWER_LIMIT, min_size / MEGABYTE);
+    }
+    if (max_size >= 0)
+    {
+        row = caja_query_editor_add_row (editor,
+                                         CAJA_QUERY_EDITOR_ROW_SIZE);
+        range_row_set (row, RANGE_UPPER_LIMIT, max_size / MEGABYTE);
+    }
+}
+
+static GtkWidget *
+modified_row_create_widgets (CajaQueryEditorRow *row)
+{
+    return range_row_create_widgets (row,
+                                     _("in the last"),
+                                     _("before the last"),
+                                     1, 100 * 366, 7,
+                                     _("days"));
+}
+
+static void
+modified_row_add_to_query (CajaQueryEditorRow *row,
+                           CajaQuery          *query)
+{
+    gint64 amount;
+    int limit, within, not_within;
+
+    range_row_get (row, &limit, &amount);
+
+    caja_query_get_modified_days (query, &within, &not_within);
+    if (limit == RANGE_LOWER_LIMIT)
+    {
+        within = amount;
+    }
+    else
+    {
+        not_within = amount;
+    }
+    caja_query_set_modified_days (query, within, not_within);
+}
+
+static void
+modified_add_rows_from_query (CajaQueryEditor    *editor,
+                              CajaQuery          *query)
+{
+    CajaQueryEditorRow *row;
+    int within, not_within;
+
+    caja_query_get_modified_days (query, &within, &not_within);
+
+    if (within >= 0)
+    {
+        row = caja_query_editor_add_row (editor,
+                                         CAJA_QUERY_EDITOR_ROW_MODIFIED);
+        range_row_set (row, RANGE_LOWER_LIMIT, within);
+    }
+    if (not_within >= 0)
+    {
+        row = caja_query_editor_add_row (editor,
+                                         CAJA_QUERY_EDITOR_ROW_MODIFIED);
+        range_row_set (row, RANGE_UPPER_LIMIT, not_within);
+    }
+}
+
+/* Owner */
+
+static GtkWidget *
+owner_row_create_widgets (CajaQueryEditorRow *row)
+{
+    GtkWidget *entry;
+
+    entry = gtk_entry_new ();
+    gtk_entry_set_text (GTK_ENTRY (entry), g_get_user_name ());
+    gtk_widget_set_tooltip_text (entry,
+                                 _("User name of the owner of the files"));
+    gtk_widget_show (entry);
+
+    g_signal_connect (entry, "activate",
+                      G_CALLBACK (entry_activate_cb), row->editor);
+    g_signal_connect (entry, "changed",
+                      G_CALLBACK (entry_changed_cb), row->editor);
+
+    gtk_box_pack_start (GTK_BOX (row->hbox), entry, FALSE, FALSE, 0);
+
+    return entry;
+}
+
+static void
+owner_row_add_to_query (CajaQueryEditorRow *row,
+                        CajaQuery          *query)
+{
+    const char *owner;
+
+    owner = gtk_entry_get_text (GTK_ENTRY (row->type_widget));
+    if (owner != NULL && owner[0] != '\0')
+    {
+        caja_query_set_owner (query, owner);
+    }
+}
+
+static void
+owner_row_free_data (CajaQueryEditorRow *row)
+{
+}
+
+static void
+owner_add_rows_from_query (CajaQueryEditor    *editor,
+                           CajaQuery          *query)
+{
+    CajaQueryEditorRow *row;
+    char *owner;
+
+    owner = caja_query_get_owner (query);
+    if (owner == NULL)
+    {
+        return;
+    }
+
+    row = caja_query_editor_add_row (editor,
+                                     CAJA_QUERY_EDITOR_ROW_OWNER);
+    gtk_entry_set_text (GTK_ENTRY (row->type_widget), owner);
+
+    g_free (owner);
+}
+
+/* Extension */
+
+static GtkWidget *
+extension_row_create_widgets (CajaQueryEditorRow *row)
+{
+    GtkWidget *entry;
+
+    entry = gtk_entry_new ();
+    gtk_widget_set_tooltip_text (entry,
+                                 _("Extensions the file names can end in, like \"jpg png\""));
+    gtk_widget_show (entry);
+
+    g_signal_connect (entry, "activate",
+                      G_CALLBACK (entry_activate_cb), row->editor);
+    g_signal_connect (entry, "changed",
+                      G_CALLBACK (entry_changed_cb), row->editor);
+
+    gtk_box_pack_start (GTK_BOX (row->hbox), entry, FALSE, FALSE, 0);
+
+    return entry;
+}
+
+static void
+extension_row_add_to_query (CajaQueryEditorRow *row,
+                            CajaQuery          *query)
+{
+    char **extensions;
+    int i;
+
+    extensions = g_strsplit_set (gtk_entry_get_text (GTK_ENTRY (row->type_widget)),
+                                 " ,;", -1);
+    for (i = 0; extensions[i] != NULL; i++)
+    {
+        caja_query_add_extension (query, extensions[i]);
+    }
+    g_strfreev (extensions);
+}
+
+static void
+extension_row_free_data (CajaQueryEditorRow *row)
+{
+}
+
+static void
+extension_add_rows_from_query (CajaQueryEditor    *editor,
+                               CajaQuery          *query)
+{
+    CajaQueryEditorRow *row;
+    GList *extensions, *l;
+    GString *text;
+
+    extensions = caja_query_get_extensions (query);
+    if (extensions == NULL)
+    {
+        return;
+    }
+
+    text = g_string_new (NULL);
+    for (l = extensions; l != NULL; l = l->next)
+    {
+        if (l != extensions)
+        {
+            g_string_append_c (text, ' ');
+        }
+        g_string_append (text, l->data);
+    }
+
+    row = caja_query_editor_add_row (editor,
+                                     CAJA_QUERY_EDITOR_ROW_EXTENSION);
+    gtk_entry_set_text (GTK_ENTRY (row->type_widget), text->str);
+
+    g_string_free (text, TRUE);
+    g_list_free_full (extensions, g_free);
+}
+
 /* End of row types */
 
 static CajaQueryEditorRowType
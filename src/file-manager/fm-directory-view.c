@@ -179,6 +179,7 @@ struct FMDirectoryViewDetails
 	guint extensions_menu_merge_id;
 
 	guint display_selection_idle_id;
+	guint add_menu_directories_idle_id;
 	guint update_menus_timeout_id;
 	guint update_status_idle_id;
 	guint reveal_selection_idle_id;
@@ -1966,13 +1967,36 @@ fm_directory_view_init_view_iface (CajaViewIface *iface)
 	iface->drop_proxy_received_netscape_url = (gpointer)fm_directory_view_drop_proxy_received_netscape_url;
 }
 
-static void
-fm_directory_view_init (FMDirectoryView *view)
+/* Watching the scripts and templates folders means reading them, which
+ * would only compete with the folder being opened, so it waits until
+ * the view has settled down. The menus stay empty until then.
+ */
+static gboolean
+add_menu_directories_idle_callback (gpointer data)
 {
+	FMDirectoryView *view;
 	CajaDirectory *scripts_directory;
-	CajaDirectory *templates_directory;
-	char *templates_uri;
 
+	view = FM_DIRECTORY_VIEW (data);
+	view->details->add_menu_directories_idle_id = 0;
+
+	set_up_scripts_directory_global ();
+	scripts_directory = caja_directory_get_by_uri (scripts_directory_uri);
+	add_directory_to_scripts_directory_list (view, scripts_directory);
+	caja_directory_unref (scripts_directory);
+
+	update_templates_directory (view);
+
+	view->details->scripts_invalid = TRUE;
+	view->details->templates_invalid = TRUE;
+	schedule_update_menus (view);
+
+	return FALSE;
+}
+
+static void
+fm_directory_view_init (FMDirectoryView *view)
+{
 	view->details = g_new0 (FMDirectoryViewDetails, 1);
 
 	/* Default to true; desktop-icon-view sets to false */
@@ -1991,19 +2015,10 @@ fm_directory_view_init (FMDirectoryView *view)
 	gtk_scrolled_window_set_vadjustment (GTK_SCROLLED_WINDOW (view), NULL);
 	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (view), GTK_SHADOW_ETCHED_IN);
 
-	set_up_scripts_directory_global ();
-	scripts_directory = caja_directory_get_by_uri (scripts_directory_uri);
-	add_directory_to_scripts_directory_list (view, scripts_directory);
-	caja_directory_unref (scripts_directory);
-
-	if (caja_should_use_templates_directory ()) {
-		templates_uri = caja_get_templates_directory_uri ();
-		templates_directory = caja_directory_get_by_uri (templates_uri);
-		g_free (templates_uri);
-		add_directory_to_templates_directory_list (view, templates_directory);
-		caja_directory_unref (templates_directory);
-	}
-	update_templates_directory (view);
+	view->details->add_menu_directories_idle_id =
+		g_idle_add_full (G_PRIORITY_LOW,
+				 add_menu_directories_idle_callback,
+				 view, NULL);
 	g_signal_connect_object (caja_signaller_get_current (),
 				 "user_dirs_changed",
 				 G_CALLBACK (user_dirs_changed),
@@ -2115,6 +2130,11 @@ fm_directory_view_destroy (GtkObject *object)
 	fm_directory_view_stop (view);
 	fm_directory_view_clear (view);
 
+	if (view->details->add_menu_directories_idle_id != 0) {
+		g_source_remove (view->details->add_menu_directories_idle_id);
+		view->details->add_menu_directories_idle_id = 0;
+	}
+
 	for (node = view->details->scripts_directory_list; node != NULL; node = next) {
 		next = node->next;
 		remove_directory_from_scripts_directory_list (view, node->data);
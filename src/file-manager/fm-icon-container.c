@@ -198,6 +198,25 @@ fm_icon_container_prioritize_thumbnailing (CajaIconContainer *container,
     }
 }
 
+static void
+fm_icon_container_deprioritize_thumbnailing (CajaIconContainer *container,
+        CajaIconData      *data)
+{
+    CajaFile *file;
+    char *uri;
+
+    file = (CajaFile *) data;
+
+    g_assert (CAJA_IS_FILE (file));
+
+    if (caja_file_is_thumbnailing (file))
+    {
+        uri = caja_file_get_uri (file);
+        caja_thumbnail_deprioritize (uri);
+        g_free (uri);
+    }
+}
+
 /*
  * Get the preference for which caption text should appear
  * beneath icons.
@@ -583,6 +602,7 @@ fm_icon_container_class_init (FMIconContainerClass *klass)
     ic_class->start_monitor_top_left = fm_icon_container_start_monitor_top_left;
     ic_class->stop_monitor_top_left = fm_icon_container_stop_monitor_top_left;
     ic_class->prioritize_thumbnailing = fm_icon_container_prioritize_thumbnailing;
+    ic_class->deprioritize_thumbnailing = fm_icon_container_deprioritize_thumbnailing;
 
     ic_class->compare_icons = fm_icon_container_compare_icons;
     ic_class->compare_icons_by_name = fm_icon_container_compare_icons_by_name;
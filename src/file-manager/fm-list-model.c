@@ -29,10 +29,12 @@
 #include <libegg/eggtreemultidnd.h>
 
 #include <string.h>
+#include <time.h>
 #include <eel/eel-gdk-pixbuf-extensions.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <libcaja-private/caja-dnd.h>
+#include <libcaja-private/caja-global-preferences.h>
 #include <glib.h>
 
 #include <src/glibcompat.h> /* for g_list_free_full */
@@ -50,6 +52,16 @@ static GQuark attribute_name_q,
 /* msec delay after Loading... dummy row turns into (empty) */
 #define LOADING_TO_EMPTY_DELAY 100
 
+/* Number of tree levels that remember their last looked up row */
+#define MAX_CURSOR_DEPTH 8
+
+/* Rows stepped over when merging a batch before searching instead */
+#define MAX_MERGE_STEPS 8
+
+/* Bumped to drop every cached column string, see file_entry_get_column_string() */
+static guint column_strings_generation = 1;
+static time_t column_strings_expiry;
+
 static guint list_model_signals[LAST_SIGNAL] = { 0 };
 
 static int fm_list_model_file_entry_compare_func (gconstpointer a,
@@ -59,6 +71,14 @@ static void fm_list_model_tree_model_init (GtkTreeModelIface *iface);
 static void fm_list_model_sortable_init (GtkTreeSortableIface *iface);
 static void fm_list_model_multi_drag_source_init (EggTreeMultiDragSourceIface *iface);
 
+typedef struct
+{
+    GSequence *files;
+    GSequenceIter *ptr;
+    int position;
+    guint serial;
+} LevelCursor;
+
 struct FMListModelDetails
 {
     GSequence *files;
@@ -77,8 +97,16 @@ struct FMListModelDetails
     int drag_begin_y;
 
     GPtrArray *columns;
+    GArray *column_attributes; /* GQuark of each entry in columns */
 
     GList *highlight_files;
+
+    /* Bumped whenever rows are inserted, removed or reordered. Row
+     * positions and level cursors are only trusted while their serial
+     * matches this one.
+     */
+    guint layout_serial;
+    LevelCursor cursors[MAX_CURSOR_DEPTH];
 };
 
 typedef struct
@@ -98,6 +126,11 @@ struct FileEntry
     FileEntry *parent;
     GSequence *files;
     GSequenceIter *ptr;
+    int position;		/* cached index of ptr, see position_serial */
+    guint position_serial;
+    char **column_strings;	/* formatted attributes, one per column */
+    guint n_column_strings;
+    guint column_strings_generation;
     guint loaded : 1;
 };
 
@@ -117,9 +150,23 @@ static const GtkTargetEntry drag_types [] =
 
 static GtkTargetList *drag_target_list = NULL;
 
+static void
+file_entry_clear_column_strings (FileEntry *file_entry)
+{
+    guint i;
+
+    for (i = 0; i < file_entry->n_column_strings; i++)
+    {
+        g_free (file_entry->column_strings[i]);
+        file_entry->column_strings[i] = NULL;
+    }
+}
+
 static void
 file_entry_free (FileEntry *file_entry)
 {
+    file_entry_clear_column_strings (file_entry);
+    g_free (file_entry->column_strings);
     caja_file_unref (file_entry->file);
     if (file_entry->reverse_map)
     {
@@ -191,6 +238,100 @@ fm_list_model_ptr_to_iter (FMListModel *model, GSequenceIter *ptr, GtkTreeIter *
     }
 }
 
+static void
+fm_list_model_layout_changed (FMListModel *model)
+{
+    model->details->layout_serial++;
+}
+
+static int
+file_entry_get_position (FMListModel *model, FileEntry *file_entry)
+{
+    if (file_entry->position_serial != model->details->layout_serial)
+    {
+        file_entry->position = g_sequence_iter_get_position (file_entry->ptr);
+        file_entry->position_serial = model->details->layout_serial;
+    }
+
+    return file_entry->position;
+}
+
+static int
+file_entry_get_depth (FileEntry *file_entry)
+{
+    int depth;
+
+    depth = 0;
+    for (file_entry = file_entry->parent; file_entry != NULL; file_entry = file_entry->parent)
+    {
+        depth++;
+    }
+
+    return depth;
+}
+
+/* Returns the row at position in files, or the end iter if there is no
+ * such row. GtkTreeView mostly asks for the same row or a neighbour of
+ * the one it asked for last, so each level remembers its last answer
+ * and steps from there instead of searching the sequence again.
+ */
+static GSequenceIter *
+fm_list_model_get_ptr_at_position (FMListModel *model, GSequence *files,
+                                   int depth, int position)
+{
+    LevelCursor *cursor;
+    GSequenceIter *ptr;
+    FileEntry *file_entry;
+
+    cursor = NULL;
+    ptr = NULL;
+
+    if (depth < MAX_CURSOR_DEPTH)
+    {
+        cursor = &model->details->cursors[depth];
+        if (cursor->files == files &&
+                cursor->serial == model->details->layout_serial)
+        {
+            if (position == cursor->position)
+            {
+                ptr = cursor->ptr;
+            }
+            else if (position == cursor->position + 1)
+            {
+                ptr = g_sequence_iter_next (cursor->ptr);
+            }
+            else if (position == cursor->position - 1 && position >= 0)
+            {
+                ptr = g_sequence_iter_prev (cursor->ptr);
+            }
+        }
+    }
+
+    if (ptr == NULL)
+    {
+        ptr = g_sequence_get_iter_at_pos (files, position);
+    }
+
+    if (g_sequence_iter_is_end (ptr))
+    {
+        return ptr;
+    }
+
+    file_entry = g_sequence_get (ptr);
+    file_entry->position = position;
+    file_entry->position_serial = model->details->layout_serial;
+
+    if (cursor != NULL)
+    {
+        cursor->files = files;
+        cursor->ptr = ptr;
+        cursor->position = position;
+        cursor->serial = model->details->layout_serial;
+    }
+
+    return ptr;
+}
+
 static gboolean
 fm_list_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
 {
@@ -198,22 +339,28 @@ fm_list_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath
     GSequence *files;
     GSequenceIter *ptr;
     FileEntry *file_entry;
-    int i, d;
+    int *indices;
+    int depth, d;
 
     model = (FMListModel *)tree_model;
     ptr = NULL;
 
     files = model->details->files;
-    for (d = 0; d < gtk_tree_path_get_depth (path); d++)
+    indices = gtk_tree_path_get_indices (path);
+    depth = gtk_tree_path_get_depth (path);
+    for (d = 0; d < depth; d++)
     {
-        i = gtk_tree_path_get_indices (path)[d];
+        if (files == NULL || indices[d] < 0)
+        {
+            return FALSE;
+        }
 
-        if (files == NULL || i >= g_sequence_get_length (files))
+        ptr = fm_list_model_get_ptr_at_position (model, files, d, indices[d]);
+        if (g_sequence_iter_is_end (ptr))
         {
             return FALSE;
         }
 
-        ptr = g_sequence_get_iter_at_pos (files, i);
         file_entry = g_sequence_get (ptr);
         files = file_entry->files;
     }
@@ -228,7 +375,6 @@ fm_list_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
 {
     GtkTreePath *path;
     FMListModel *model;
-    GSequenceIter *ptr;
     FileEntry *file_entry;
 
 
@@ -243,31 +389,103 @@ fm_list_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
     }
 
     path = gtk_tree_path_new ();
-    ptr = iter->user_data;
-    while (ptr != NULL)
+    file_entry = g_sequence_get (iter->user_data);
+    while (file_entry != NULL)
     {
-        gtk_tree_path_prepend_index (path, g_sequence_iter_get_position (ptr));
-        file_entry = g_sequence_get (ptr);
-        if (file_entry->parent != NULL)
-        {
-            ptr = file_entry->parent->ptr;
-        }
-        else
-        {
-            ptr = NULL;
-        }
+        gtk_tree_path_prepend_index (path, file_entry_get_position (model, file_entry));
+        file_entry = file_entry->parent;
     }
 
     return path;
 }
 
+/* Relative dates ("today at ...") change at midnight without the file
+ * changing, so all cached strings expire then.
+ */
+static void
+check_column_strings_expiry (void)
+{
+    time_t now;
+    struct tm midnight;
+
+    now = time (NULL);
+    if (now < column_strings_expiry)
+    {
+        return;
+    }
+
+    column_strings_generation++;
+
+    localtime_r (&now, &midnight);
+    midnight.tm_sec = 0;
+    midnight.tm_min = 0;
+    midnight.tm_hour = 0;
+    midnight.tm_mday++;
+    midnight.tm_isdst = -1;
+    column_strings_expiry = mktime (&midnight);
+}
+
+static gboolean
+emit_row_changed (GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
+{
+    gtk_tree_model_row_changed (model, path, iter);
+
+    return FALSE;
+}
+
+/* Every date string is different in another format, and no file
+ * changed for the cached ones to be dropped with it.
+ */
+static void
+date_format_changed_callback (FMListModel *model)
+{
+    column_strings_generation++;
+
+    gtk_tree_model_foreach (GTK_TREE_MODEL (model), emit_row_changed, NULL);
+}
+
+/* Formatting sizes, dates and permissions for every cell on every expose
+ * is what dominates scrolling, so the strings are kept per row until
+ * fm_list_model_file_changed() reports a change to the file.
+ */
+static const char *
+file_entry_get_column_string (FMListModel *model, FileEntry *file_entry, guint index)
+{
+    guint n_columns;
+
+    check_column_strings_expiry ();
+
+    if (file_entry->column_strings_generation != column_strings_generation)
+    {
+        file_entry_clear_column_strings (file_entry);
+        file_entry->column_strings_generation = column_strings_generation;
+    }
+
+    n_columns = model->details->columns->len;
+    if (file_entry->n_column_strings < n_columns)
+    {
+        file_entry->column_strings = g_renew (char *, file_entry->column_strings, n_columns);
+        memset (file_entry->column_strings + file_entry->n_column_strings, 0,
+                (n_columns - file_entry->n_column_strings) * sizeof (char *));
+        file_entry->n_column_strings = n_columns;
+    }
+
+    if (file_entry->column_strings[index] == NULL)
+    {
+        file_entry->column_strings[index] =
+            caja_file_get_string_attribute_with_default_q (file_entry->file,
+                    g_array_index (model->details->column_attributes, GQuark, index));
+    }
+
+    return file_entry->column_strings[index];
+}
+
 static void
 fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
 {
     FMListModel *model;
     FileEntry *file_entry;
     CajaFile *file;
-    char *str;
     GdkPixbuf *icon, *rendered_icon;
     GIcon *gicon, *emblemed_icon, *emblem_icon;
     CajaIconInfo *icon_info;
@@ -388,7 +606,7 @@ fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column
                     g_list_find_custom (model->details->highlight_files,
                                         file, (GCompareFunc) caja_file_compare_location))
             {
-                rendered_icon = eel_gdk_pixbuf_render (icon, 1, 255, 255, 0, 0);
+                rendered_icon = eel_gdk_pixbuf_render_shared (icon, 1, 255, 255, 0, 0);
 
                 if (rendered_icon != NULL)
                 {
@@ -409,19 +627,17 @@ fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column
     default:
         if (column >= FM_LIST_MODEL_NUM_COLUMNS || column < FM_LIST_MODEL_NUM_COLUMNS + model->details->columns->len)
         {
-            CajaColumn *caja_column;
             GQuark attribute;
-            caja_column = model->details->columns->pdata[column - FM_LIST_MODEL_NUM_COLUMNS];
+            guint index;
+
+            index = column - FM_LIST_MODEL_NUM_COLUMNS;
+            attribute = g_array_index (model->details->column_attributes, GQuark, index);
 
             g_value_init (value, G_TYPE_STRING);
-            g_object_get (caja_column,
-                          "attribute_q", &attribute,
-                          NULL);
             if (file != NULL)
             {
-                str = caja_file_get_string_attribute_with_default_q (file,
-                        attribute);
-                g_value_take_string (value, str);
+                g_value_set_string (value,
+                                    file_entry_get_column_string (model, file_entry, index));
             }
             else if (attribute == attribute_name_q)
             {
@@ -530,6 +746,7 @@ fm_list_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTr
     GSequenceIter *child;
     GSequence *files;
     FileEntry *file_entry;
+    int depth;
 
     model = (FMListModel *)tree_model;
 
@@ -537,13 +754,20 @@ fm_list_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTr
     {
         file_entry = g_sequence_get (parent->user_data);
         files = file_entry->files;
+        depth = file_entry_get_depth (file_entry) + 1;
     }
     else
     {
         files = model->details->files;
+        depth = 0;
     }
 
-    child = g_sequence_get_iter_at_pos (files, n);
+    if (files == NULL || n < 0)
+    {
+        return FALSE;
+    }
+
+    child = fm_list_model_get_ptr_at_position (model, files, depth, n);
 
     if (g_sequence_iter_is_end (child))
     {
@@ -755,6 +979,7 @@ static void
 fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePath *path)
 {
     GSequenceIter **old_order;
+    GSequenceIter *ptr;
     GtkTreeIter iter;
     int *new_order;
     int length;
@@ -771,10 +996,9 @@ fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePa
 
     /* generate old order of GSequenceIter's */
     old_order = g_new (GSequenceIter *, length);
-    for (i = 0; i < length; ++i)
+    ptr = g_sequence_get_begin_iter (files);
+    for (i = 0; i < length; ++i, ptr = g_sequence_iter_next (ptr))
     {
-        GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
-
         file_entry = g_sequence_get (ptr);
         if (file_entry->files != NULL)
         {
@@ -788,6 +1012,7 @@ fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePa
 
     /* sort */
     g_sequence_sort (files, fm_list_model_file_entry_compare_func, model);
+    fm_list_model_layout_changed (model);
 
     /* generate new order */
     new_order = g_new (int, length);
@@ -993,6 +1218,7 @@ add_dummy_row (FMListModel *model, FileEntry *parent_entry)
     dummy_file_entry->parent = parent_entry;
     dummy_file_entry->ptr = g_sequence_insert_sorted (parent_entry->files, dummy_file_entry,
                             fm_list_model_file_entry_compare_func, model);
+    fm_list_model_layout_changed (model);
     iter.stamp = model->details->stamp;
     iter.user_data = dummy_file_entry->ptr;
 
@@ -1062,6 +1288,7 @@ fm_list_model_add_file (FMListModel *model, CajaFile *file,
                 /* replace the dummy loading entry */
                 model->details->stamp++;
                 g_sequence_remove (dummy_ptr);
+                fm_list_model_layout_changed (model);
 
                 replace_dummy = TRUE;
             }
@@ -1071,6 +1298,7 @@ fm_list_model_add_file (FMListModel *model, CajaFile *file,
 
     file_entry->ptr = g_sequence_insert_sorted (files, file_entry,
                       fm_list_model_file_entry_compare_func, model);
+    fm_list_model_layout_changed (model);
 
     g_hash_table_insert (parent_hash, file, file_entry->ptr);
 
@@ -1101,6 +1329,177 @@ fm_list_model_add_file (FMListModel *model, CajaFile *file,
     return TRUE;
 }
 
+static int
+fm_list_model_file_entry_ptr_compare_func (gconstpointer a,
+        gconstpointer b,
+        gpointer      user_data)
+{
+    return fm_list_model_file_entry_compare_func (*(FileEntry **)a,
+            *(FileEntry **)b,
+            user_data);
+}
+
+/* Adds a batch of files living in the same directory. The batch is sorted
+ * once and merged into the existing rows, stepping forward from the last
+ * insertion point and searching when the next one is further on, with
+ * row_inserted emitted for each row as soon as it is in, so the model
+ * never has a row the view hasn't been told about.
+ */
+int
+fm_list_model_add_files (FMListModel *model, GList *files,
+                         CajaDirectory *directory)
+{
+    GtkTreeIter iter;
+    GtkTreePath *path;
+    FileEntry *file_entry, *parent_entry, *existing_entry;
+    GSequenceIter *ptr, *parent_ptr;
+    GSequence *sequence;
+    GHashTable *parent_hash, *batch;
+    GPtrArray *entries;
+    GList *l;
+    gboolean replace_dummy;
+    guint i;
+    int added, steps;
+
+    parent_ptr = NULL;
+    if (directory != NULL)
+    {
+        parent_ptr = g_hash_table_lookup (model->details->directory_reverse_map,
+                                          directory);
+    }
+
+    if (parent_ptr != NULL)
+    {
+        parent_entry = g_sequence_get (parent_ptr);
+        parent_hash = parent_entry->reverse_map;
+        sequence = parent_entry->files;
+    }
+    else
+    {
+        parent_entry = NULL;
+        parent_hash = model->details->top_reverse_map;
+        sequence = model->details->files;
+    }
+
+    /* The reverse map only gets a file once its row is in, as the
+     * handlers of row_inserted may look up any file; duplicates within
+     * the batch are caught here instead. */
+    entries = g_ptr_array_new ();
+    batch = g_hash_table_new (NULL, NULL);
+    for (l = files; l != NULL; l = l->next)
+    {
+        if (g_hash_table_lookup (parent_hash, l->data) != NULL ||
+                g_hash_table_lookup (batch, l->data) != NULL)
+        {
+            g_warning ("file already in tree (parent_ptr: %p)!!!\n", parent_ptr);
+            continue;
+        }
+
+        file_entry = g_new0 (FileEntry, 1);
+        file_entry->file = caja_file_ref (l->data);
+        file_entry->parent = parent_entry;
+        g_hash_table_insert (batch, file_entry->file, file_entry);
+        g_ptr_array_add (entries, file_entry);
+    }
+    g_hash_table_destroy (batch);
+
+    if (entries->len == 0)
+    {
+        g_ptr_array_free (entries, TRUE);
+        return 0;
+    }
+
+    g_ptr_array_sort_with_data (entries,
+                                fm_list_model_file_entry_ptr_compare_func,
+                                model);
+
+    replace_dummy = FALSE;
+    if (parent_entry != NULL)
+    {
+        /* See fm_list_model_add_file() */
+        parent_entry->loaded = 1;
+        if (g_sequence_get_length (sequence) == 1)
+        {
+            ptr = g_sequence_get_begin_iter (sequence);
+            existing_entry = g_sequence_get (ptr);
+            if (existing_entry->file == NULL)
+            {
+                /* replace the dummy loading entry */
+                model->details->stamp++;
+                g_sequence_remove (ptr);
+                replace_dummy = TRUE;
+            }
+        }
+    }
+
+    /* Merge the sorted batch into the sorted sequence. New entries go
+     * after existing entries that compare equal, like
+     * g_sequence_insert_sorted() does. Entries of a batch often go in
+     * next to each other, so step on from the last one, but search
+     * rather than walk over many rows.
+     */
+    ptr = NULL;
+    for (i = 0; i < entries->len; i++)
+    {
+        file_entry = g_ptr_array_index (entries, i);
+
+        steps = 0;
+        while (ptr != NULL && !g_sequence_iter_is_end (ptr))
+        {
+            existing_entry = g_sequence_get (ptr);
+            if (fm_list_model_file_entry_compare_func (existing_entry, file_entry, model) > 0)
+            {
+                break;
+            }
+            if (++steps > MAX_MERGE_STEPS)
+            {
+                ptr = NULL;
+                break;
+            }
+            ptr = g_sequence_iter_next (ptr);
+        }
+        if (ptr == NULL)
+        {
+            ptr = g_sequence_search (sequence, file_entry,
+                                     fm_list_model_file_entry_compare_func,
+                                     model);
+        }
+
+        file_entry->ptr = g_sequence_insert_before (ptr, file_entry);
+        g_hash_table_insert (parent_hash, file_entry->file, file_entry->ptr);
+        fm_list_model_layout_changed (model);
+
+        iter.stamp = model->details->stamp;
+        iter.user_data = file_entry->ptr;
+
+        path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
+        if (replace_dummy && i == 0)
+        {
+            gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+        }
+        else
+        {
+            gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+        }
+
+        if (caja_file_is_directory (file_entry->file))
+        {
+            file_entry->files = g_sequence_new ((GDestroyNotify)file_entry_free);
+
+            add_dummy_row (model, file_entry);
+
+            gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
+                                                  path, &iter);
+        }
+        gtk_tree_path_free (path);
+    }
+
+    added = entries->len;
+    g_ptr_array_free (entries, TRUE);
+
+    return added;
+}
+
 void
 fm_list_model_file_changed (FMListModel *model, CajaFile *file,
                             CajaDirectory *directory)
@@ -1120,8 +1519,9 @@ fm_list_model_file_changed (FMListModel *model, CajaFile *file,
         return;
     }
 
+    file_entry_clear_column_strings (g_sequence_get (ptr));
 
-    pos_before = g_sequence_iter_get_position (ptr);
+    pos_before = file_entry_get_position (model, g_sequence_get (ptr));
 
     g_sequence_sort_changed (ptr, fm_list_model_file_entry_compare_func, model);
 
@@ -1130,6 +1530,7 @@ fm_list_model_file_changed (FMListModel *model, CajaFile *file,
     if (pos_before != pos_after)
     {
         /* The file moved, we need to send rows_reordered */
+        fm_list_model_layout_changed (model);
 
         parent_file_entry = ((FileEntry *)g_sequence_get (ptr))->parent;
 
@@ -1218,6 +1619,7 @@ fm_list_model_remove (FMListModel *model, GtkTreeIter *iter)
                 gtk_tree_path_append_index (path, 0);
                 model->details->stamp++;
                 g_sequence_remove (child_ptr);
+                fm_list_model_layout_changed (model);
                 gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
                 gtk_tree_path_free (path);
             }
@@ -1264,6 +1666,7 @@ fm_list_model_remove (FMListModel *model, GtkTreeIter *iter)
 
     g_sequence_remove (ptr);
     model->details->stamp++;
+    fm_list_model_layout_changed (model);
     gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
 
     gtk_tree_path_free (path);
@@ -1581,9 +1984,14 @@ int
 fm_list_model_add_column (FMListModel *model,
                           CajaColumn *column)
 {
+    GQuark attribute;
+
     g_ptr_array_add (model->details->columns, column);
     g_object_ref (column);
 
+    g_object_get (column, "attribute_q", &attribute, NULL);
+    g_array_append_val (model->details->column_attributes, attribute);
+
     return FM_LIST_MODEL_NUM_COLUMNS + (model->details->columns->len - 1);
 }
 
@@ -1621,6 +2029,10 @@ fm_list_model_dispose (GObject *object)
 
     model = FM_LIST_MODEL (object);
 
+    g_signal_handlers_disconnect_by_func (caja_preferences,
+                                          date_format_changed_callback,
+                                          model);
+
     if (model->details->columns)
     {
         for (i = 0; i < model->details->columns->len; i++)
@@ -1629,6 +2041,8 @@ fm_list_model_dispose (GObject *object)
         }
         g_ptr_array_free (model->details->columns, TRUE);
         model->details->columns = NULL;
+        g_array_free (model->details->column_attributes, TRUE);
+        model->details->column_attributes = NULL;
     }
 
     if (model->details->files)
@@ -1677,8 +2091,16 @@ fm_list_model_init (FMListModel *model)
     model->details->top_reverse_map = g_hash_table_new (g_direct_hash, g_direct_equal);
     model->details->directory_reverse_map = g_hash_table_new (g_direct_hash, g_direct_equal);
     model->details->stamp = g_random_int ();
+    /* New file entries start out with a position_serial of 0 */
+    model->details->layout_serial = 1;
     model->details->sort_attribute = 0;
     model->details->columns = g_ptr_array_new ();
+    model->details->column_attributes = g_array_new (FALSE, FALSE, sizeof (GQuark));
+
+    g_signal_connect_swapped (caja_preferences,
+                              "changed::" CAJA_PREFERENCES_DATE_FORMAT,
+                              G_CALLBACK (date_format_changed_callback),
+                              model);
 }
 
 static void
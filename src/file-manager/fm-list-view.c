@@ -60,6 +60,7 @@
 #include <libcaja-private/caja-view-factory.h>
 #include <libcaja-private/caja-clipboard.h>
 #include <libcaja-private/caja-cell-renderer-text-ellipsized.h>
+#include <libcaja-private/caja-thumbnails.h>
 
 #include <src/glibcompat.h> /* for g_list_free_full */
 
@@ -112,8 +113,28 @@ struct FMListViewDetails
     gulong clipboard_handler_id;
 
     GQuark last_sort_attr;
+
+    /* Files added since the last flush, most recent first. They are
+     * handed to the model in per-directory batches. */
+    GList *pending_added_files;
+
+    guint prioritize_thumbnailing_id;
+    /* The files whose thumbnails were last moved to the front. */
+    GList *prioritized_files;
 };
 
+typedef struct
+{
+    CajaFile *file;
+    CajaDirectory *directory;
+} PendingAddedFile;
+
+/* Batches at least this big that fill an empty model are added with the
+ * model detached from the tree view, which then picks up all rows at once
+ * instead of handling one row_inserted per file.
+ */
+#define DETACH_MODEL_BATCH_SIZE 1000
+
 struct SelectionForeachData
 {
     GList *list;
@@ -127,6 +148,9 @@ struct SelectionForeachData
  */
 #define LIST_VIEW_MINIMUM_ROW_HEIGHT	28
 
+/* Never prioritize thumbnails for more rows than this at once */
+#define MAX_PRIORITIZED_ROWS 200
+
 /* We wait two seconds after row is collapsed to unload the subdirectory */
 #define COLLAPSE_TO_UNLOAD_DELAY 2
 
@@ -153,6 +177,7 @@ static void   fm_list_view_scale_font_size                 (FMListView        *v
 static void   fm_list_view_scroll_to_file                  (FMListView        *view,
         CajaFile      *file);
 static void   fm_list_view_iface_init                      (CajaViewIface *iface);
+static void   flush_pending_added_files                    (FMListView        *list_view);
 static void   fm_list_view_rename_callback                 (CajaFile      *file,
         GFile             *result_location,
         GError            *error,
@@ -1186,6 +1211,8 @@ fm_list_view_reveal_selection (FMDirectoryView *view)
 
     g_return_if_fail (FM_IS_LIST_VIEW (view));
 
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     selection = fm_directory_view_get_selection (view);
 
     /* Make sure at least one of the selected items is scrolled into view */
@@ -1617,6 +1644,160 @@ focus_in_event_callback (GtkWidget *widget, GdkEventFocus *event, gpointer user_
     return FALSE;
 }
 
+static gboolean
+get_next_visible_iter (GtkTreeView *tree_view,
+                       GtkTreeModel *model,
+                       GtkTreeIter *iter)
+{
+    GtkTreePath *path;
+    GtkTreeIter child, parent;
+    gboolean expanded;
+
+    path = gtk_tree_model_get_path (model, iter);
+    expanded = gtk_tree_view_row_expanded (tree_view, path);
+    gtk_tree_path_free (path);
+
+    if (expanded && gtk_tree_model_iter_children (model, &child, iter))
+    {
+        *iter = child;
+        return TRUE;
+    }
+
+    /* No children to descend into, so take the next sibling of the row
+     * or of the closest ancestor that has one. */
+    for (;;)
+    {
+        child = *iter;
+        if (gtk_tree_model_iter_next (model, iter))
+        {
+            return TRUE;
+        }
+        if (!gtk_tree_model_iter_parent (model, &parent, &child))
+        {
+            return FALSE;
+        }
+        *iter = parent;
+    }
+}
+
+/* Sends the thumbnails prioritized before, other than those of the
+ * files in visible, back to the end of the thumbnail queue, and
+ * remembers visible as the ones prioritized now.
+ */
+static void
+deprioritize_thumbnailing (FMListView *view, GList *visible)
+{
+    GList *l;
+    CajaFile *file;
+    char *uri;
+
+    for (l = view->details->prioritized_files; l != NULL; l = l->next)
+    {
+        file = l->data;
+        if (g_list_find (visible, file) == NULL &&
+                caja_file_is_thumbnailing (file))
+        {
+            uri = caja_file_get_uri (file);
+            caja_thumbnail_deprioritize (uri);
+            g_free (uri);
+        }
+    }
+
+    caja_file_list_free (view->details->prioritized_files);
+    view->details->prioritized_files = caja_file_list_copy (visible);
+}
+
+/* Moves the thumbnails of the rows in view to the front of the
+ * thumbnail queue, the topmost row first, and those of rows that
+ * scrolled away back.
+ */
+static gboolean
+prioritize_thumbnailing_callback (gpointer callback_data)
+{
+    FMListView *view;
+    GtkTreeModel *model;
+    GtkTreePath *start, *end, *path;
+    GtkTreeIter iter;
+    GList *files, *l;
+    CajaFile *file;
+    char *uri;
+    int rows;
+
+    view = FM_LIST_VIEW (callback_data);
+    view->details->prioritize_thumbnailing_id = 0;
+
+    if (!gtk_tree_view_get_visible_range (view->details->tree_view, &start, &end))
+    {
+        deprioritize_thumbnailing (view, NULL);
+        return FALSE;
+    }
+
+    model = GTK_TREE_MODEL (view->details->model);
+    files = NULL;
+    rows = 0;
+    if (gtk_tree_model_get_iter (model, &iter, start))
+    {
+        do
+        {
+            gtk_tree_model_get (model, &iter,
+                                FM_LIST_MODEL_FILE_COLUMN, &file,
+                                -1);
+            if (file != NULL && caja_file_is_thumbnailing (file))
+            {
+                files = g_list_prepend (files, file);
+            }
+            else if (file != NULL)
+            {
+                caja_file_unref (file);
+            }
+
+            path = gtk_tree_model_get_path (model, &iter);
+            if (gtk_tree_path_compare (path, end) >= 0)
+            {
+                gtk_tree_path_free (path);
+                break;
+            }
+            gtk_tree_path_free (path);
+        }
+        while (++rows < MAX_PRIORITIZED_ROWS &&
+                get_next_visible_iter (view->details->tree_view, model, &iter));
+    }
+
+    deprioritize_thumbnailing (view, files);
+
+    /* Prioritizing puts a file at the head of the queue, so go from
+     * the bottom row up. */
+    for (l = files; l != NULL; l = l->next)
+    {
+        uri = caja_file_get_uri (l->data);
+        caja_thumbnail_prioritize (uri);
+        g_free (uri);
+    }
+
+    caja_file_list_free (files);
+    gtk_tree_path_free (start);
+    gtk_tree_path_free (end);
+
+    return FALSE;
+}
+
+static void
+schedule_prioritize_thumbnailing (FMListView *view)
+{
+    if (view->details->prioritize_thumbnailing_id == 0)
+    {
+        view->details->prioritize_thumbnailing_id =
+            g_idle_add (prioritize_thumbnailing_callback, view);
+    }
+}
+
+static void
+vadjustment_value_changed_callback (GtkAdjustment *adjustment,
+                                    FMListView *view)
+{
+    schedule_prioritize_thumbnailing (view);
+}
+
 static void
 create_and_set_up_tree_view (FMListView *view)
 {
@@ -1809,18 +1990,110 @@ create_and_set_up_tree_view (FMListView *view)
     gtk_widget_show (GTK_WIDGET (view->details->tree_view));
     gtk_container_add (GTK_CONTAINER (view), GTK_WIDGET (view->details->tree_view));
 
+    g_signal_connect_object (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (view)),
+                             "value-changed",
+                             G_CALLBACK (vadjustment_value_changed_callback),
+                             view, 0);
 
     atk_obj = gtk_widget_get_accessible (GTK_WIDGET (view->details->tree_view));
     atk_object_set_name (atk_obj, _("List View"));
 }
 
 static void
-fm_list_view_add_file (FMDirectoryView *view, CajaFile *file, CajaDirectory *directory)
+pending_added_file_free (PendingAddedFile *pending)
+{
+    caja_file_unref (pending->file);
+    if (pending->directory != NULL)
+    {
+        caja_directory_unref (pending->directory);
+    }
+    g_free (pending);
+}
+
+static void
+discard_pending_added_files (FMListView *list_view)
+{
+    g_list_free_full (list_view->details->pending_added_files,
+                      (GDestroyNotify) pending_added_file_free);
+    list_view->details->pending_added_files = NULL;
+}
+
+static void
+flush_pending_added_files (FMListView *list_view)
 {
     FMListModel *model;
+    GHashTable *batches;
+    GList *pending_files, *directories, *files, *l;
+    PendingAddedFile *pending;
+    gboolean detach;
+
+    if (list_view->details->pending_added_files == NULL)
+    {
+        return;
+    }
+
+    model = list_view->details->model;
+    pending_files = g_list_reverse (list_view->details->pending_added_files);
+    list_view->details->pending_added_files = NULL;
+
+    /* Group by directory, keeping the order the files arrived in */
+    batches = g_hash_table_new (g_direct_hash, g_direct_equal);
+    directories = NULL;
+    for (l = pending_files; l != NULL; l = l->next)
+    {
+        pending = l->data;
+        if (!g_hash_table_lookup_extended (batches, pending->directory,
+                                           NULL, (gpointer *) &files))
+        {
+            directories = g_list_prepend (directories, pending->directory);
+            files = NULL;
+        }
+        g_hash_table_insert (batches, pending->directory,
+                             g_list_prepend (files, pending->file));
+    }
+    directories = g_list_reverse (directories);
+
+    detach = fm_list_model_is_empty (model) &&
+             g_list_length (pending_files) >= DETACH_MODEL_BATCH_SIZE;
+    if (detach)
+    {
+        gtk_tree_view_set_model (list_view->details->tree_view, NULL);
+    }
 
-    model = FM_LIST_VIEW (view)->details->model;
-    fm_list_model_add_file (model, file, directory);
+    for (l = directories; l != NULL; l = l->next)
+    {
+        files = g_list_reverse (g_hash_table_lookup (batches, l->data));
+        fm_list_model_add_files (model, files, l->data);
+        g_list_free (files);
+    }
+
+    if (detach)
+    {
+        gtk_tree_view_set_model (list_view->details->tree_view,
+                                 GTK_TREE_MODEL (model));
+    }
+
+    g_list_free (directories);
+    g_hash_table_destroy (batches);
+    g_list_free_full (pending_files, (GDestroyNotify) pending_added_file_free);
+}
+
+static void
+fm_list_view_add_file (FMDirectoryView *view, CajaFile *file, CajaDirectory *directory)
+{
+    FMListView *list_view;
+    PendingAddedFile *pending;
+
+    list_view = FM_LIST_VIEW (view);
+
+    /* Added files come in between begin_file_changes and
+     * end_file_changes, collect them and add them in one go. Anything
+     * that looks up rows by file flushes them first. */
+    pending = g_new (PendingAddedFile, 1);
+    pending->file = caja_file_ref (file);
+    pending->directory = directory != NULL ? caja_directory_ref (directory) : NULL;
+    list_view->details->pending_added_files =
+        g_list_prepend (list_view->details->pending_added_files, pending);
 }
 
 static char **
@@ -2037,6 +2310,9 @@ fm_list_view_clear (FMDirectoryView *view)
 
     list_view = FM_LIST_VIEW (view);
 
+    discard_pending_added_files (list_view);
+    deprioritize_thumbnailing (list_view, NULL);
+
     if (list_view->details->model != NULL)
     {
         stop_cell_editing (list_view);
@@ -2082,6 +2358,7 @@ fm_list_view_file_changed (FMDirectoryView *view, CajaFile *file, CajaDirectory
 
     listview = FM_LIST_VIEW (view);
 
+    flush_pending_added_files (listview);
     fm_list_model_file_changed (listview->details->model, file, directory);
 
     if (listview->details->renaming_file != NULL &&
@@ -2135,6 +2412,8 @@ fm_list_view_get_selection (FMDirectoryView *view)
 {
     GList *list;
 
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     list = NULL;
 
     gtk_tree_selection_selected_foreach (gtk_tree_view_get_selection (FM_LIST_VIEW (view)->details->tree_view),
@@ -2184,6 +2463,8 @@ fm_list_view_get_selection_for_file_transfer (FMDirectoryView *view)
 {
     struct SelectionForeachData selection_data;
 
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     selection_data.list = NULL;
     selection_data.selection = gtk_tree_view_get_selection (FM_LIST_VIEW (view)->details->tree_view);
 
@@ -2201,12 +2482,16 @@ fm_list_view_get_item_count (FMDirectoryView *view)
 {
     g_return_val_if_fail (FM_IS_LIST_VIEW (view), 0);
 
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     return fm_list_model_get_length (FM_LIST_VIEW (view)->details->model);
 }
 
 static gboolean
 fm_list_view_is_empty (FMDirectoryView *view)
 {
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     return fm_list_model_is_empty (FM_LIST_VIEW (view)->details->model);
 }
 
@@ -2217,6 +2502,8 @@ fm_list_view_end_file_changes (FMDirectoryView *view)
 
     list_view = FM_LIST_VIEW (view);
 
+    flush_pending_added_files (list_view);
+
     if (list_view->details->new_selection_path)
     {
         gtk_tree_view_set_cursor (list_view->details->tree_view,
@@ -2244,6 +2531,8 @@ fm_list_view_remove_file (FMDirectoryView *view, CajaFile *file, CajaDirectory *
     list_view = FM_LIST_VIEW (view);
     tree_model = GTK_TREE_MODEL(list_view->details->model);
 
+    flush_pending_added_files (list_view);
+
     if (fm_list_model_get_tree_iter_from_file (list_view->details->model, file, directory, &iter))
     {
         selection = gtk_tree_view_get_selection (list_view->details->tree_view);
@@ -2305,6 +2594,7 @@ fm_list_view_set_selection (FMDirectoryView *view, GList *selection)
     CajaFile *file;
 
     list_view = FM_LIST_VIEW (view);
+    flush_pending_added_files (list_view);
     tree_selection = gtk_tree_view_get_selection (list_view->details->tree_view);
 
     g_signal_handlers_block_by_func (tree_selection, list_selection_changed_callback, view);
@@ -2338,6 +2628,7 @@ fm_list_view_invert_selection (FMDirectoryView *view)
     GList *selection = NULL;
 
     list_view = FM_LIST_VIEW (view);
+    flush_pending_added_files (list_view);
     tree_selection = gtk_tree_view_get_selection (list_view->details->tree_view);
 
     g_signal_handlers_block_by_func (tree_selection, list_selection_changed_callback, view);
@@ -2369,6 +2660,8 @@ fm_list_view_invert_selection (FMDirectoryView *view)
 static void
 fm_list_view_select_all (FMDirectoryView *view)
 {
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     gtk_tree_selection_select_all (gtk_tree_view_get_selection (FM_LIST_VIEW (view)->details->tree_view));
 }
 
@@ -2852,6 +3145,8 @@ fm_list_view_start_renaming_file (FMDirectoryView *view,
 
     list_view = FM_LIST_VIEW (view);
 
+    flush_pending_added_files (list_view);
+
     /* Select all if we are in renaming mode already */
     if (list_view->details->file_name_column && list_view->details->editable_widget)
     {
@@ -3028,6 +3323,15 @@ fm_list_view_dispose (GObject *object)
 
     list_view = FM_LIST_VIEW (object);
 
+    discard_pending_added_files (list_view);
+
+    if (list_view->details->prioritize_thumbnailing_id != 0)
+    {
+        g_source_remove (list_view->details->prioritize_thumbnailing_id);
+        list_view->details->prioritize_thumbnailing_id = 0;
+    }
+    deprioritize_thumbnailing (list_view, NULL);
+
     if (list_view->details->model)
     {
         stop_cell_editing (list_view);
@@ -3131,6 +3435,8 @@ fm_list_view_get_first_visible_file (CajaView *view)
 
     list_view = FM_LIST_VIEW (view);
 
+    flush_pending_added_files (list_view);
+
     if (gtk_tree_view_get_path_at_pos (list_view->details->tree_view,
                                        0, 0,
                                        &path, NULL, NULL, NULL))
@@ -3166,6 +3472,8 @@ fm_list_view_scroll_to_file (FMListView *view,
     GtkTreePath *path;
     GtkTreeIter iter;
 
+    flush_pending_added_files (view);
+
     if (!fm_list_model_get_first_iter_for_file (view->details->model, file, &iter))
     {
         return;
@@ -3229,10 +3537,14 @@ fm_list_view_end_loading (FMDirectoryView *view,
     CajaClipboardMonitor *monitor;
     CajaClipboardInfo *info;
 
+    flush_pending_added_files (FM_LIST_VIEW (view));
+
     monitor = caja_clipboard_monitor_get ();
     info = caja_clipboard_monitor_get_clipboard_info (monitor);
 
     list_view_notify_clipboard_info (monitor, info, FM_LIST_VIEW (view));
+
+    schedule_prioritize_thumbnailing (FM_LIST_VIEW (view));
 }
 
 static void
@@ -334,7 +334,7 @@ get_menu_icon_for_file (TreeNode *node,
 
     if (highlight)
     {
-        pixbuf = eel_gdk_pixbuf_render (retval, 1, 255, 255, 0, 0);
+        pixbuf = eel_gdk_pixbuf_render_shared (retval, 1, 255, 255, 0, 0);
 
         if (pixbuf != NULL)
         {
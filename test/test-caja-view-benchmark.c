@@ -0,0 +1,683 @@
+/* test-caja-view-benchmark.c: Scroll and redraw benchmark for the icon
+ * and list views.
+ *
+ * Populates a CajaIconContainer or an FMListModel backed tree view with
+ * synthetic CajaFiles, runs a fixed script of zoom changes, scrolling,
+ * rubberband style selection sweeps, select all and resorting, and
+ * prints frame times, layout time and peak RSS.
+ *
+ * The views are packed into a GtkOffscreenWindow, so the benchmark runs
+ * without a visible window (a display is still needed, Xvfb will do):
+ *
+ *   xvfb-run ./test-caja-view-benchmark --view=list --files=100000
+ */
+
+#include "test.h"
+
+#include <libcaja-private/caja-column-utilities.h>
+#include <libcaja-private/caja-file.h>
+#include <libcaja-private/caja-file-private.h>
+#include <libcaja-private/caja-global-preferences.h>
+#include <libcaja-private/caja-icon-container.h>
+#include <src/file-manager/fm-list-model.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define WINDOW_WIDTH 1024
+#define WINDOW_HEIGHT 768
+
+#define MIN_FILES 1000
+#define MAX_FILES 500000
+
+/* Number of frames used to scroll through the whole view, and to sweep
+ * a rubberband selection across the first page of it.
+ */
+#define SCROLL_FRAMES 200
+#define RUBBERBAND_FRAMES 50
+
+static const char *extensions[] = {
+	"txt", "png", "jpg", "pdf", "c", "h", "ogg", "tar.gz", "html", "odt"
+};
+
+static char *view_option = NULL;
+static int files_option = 10000;
+static int repeat_option = 1;
+
+static GOptionEntry options[] = {
+	{ "view", 0, 0, G_OPTION_ARG_STRING, &view_option,
+	  "View to benchmark: icon, list or both (default both)", "VIEW" },
+	{ "files", 0, 0, G_OPTION_ARG_INT, &files_option,
+	  "Number of synthetic files, 1000 to 500000 (default 10000)", "N" },
+	{ "repeat", 0, 0, G_OPTION_ARG_INT, &repeat_option,
+	  "Number of times to run the script (default 1)", "N" },
+	{ NULL }
+};
+
+typedef struct {
+	GArray *samples;
+	GTimer *timer;
+} FrameStats;
+
+/* Minimal icon container subclass, standing in for FMIconContainer
+ * without pulling in the whole directory view.
+ */
+typedef CajaIconContainer BenchmarkIconContainer;
+typedef CajaIconContainerClass BenchmarkIconContainerClass;
+
+static GType benchmark_icon_container_get_type (void);
+
+G_DEFINE_TYPE (BenchmarkIconContainer, benchmark_icon_container, CAJA_TYPE_ICON_CONTAINER)
+
+static CajaIconInfo *
+benchmark_icon_container_get_icon_images (CajaIconContainer *container,
+					  CajaIconData *data,
+					  int size,
+					  GList **emblem_pixbufs,
+					  char **embedded_text,
+					  gboolean for_drag_accept,
+					  gboolean need_large_embeddded_text,
+					  gboolean *embedded_text_needs_loading,
+					  gboolean *has_window_open)
+{
+	*has_window_open = FALSE;
+
+	return caja_file_get_icon (CAJA_FILE (data), size,
+				   CAJA_FILE_ICON_FLAGS_USE_THUMBNAILS);
+}
+
+static void
+benchmark_icon_container_get_icon_text (CajaIconContainer *container,
+					CajaIconData *data,
+					char **editable_text,
+					char **additional_text,
+					gboolean include_invisible)
+{
+	*editable_text = caja_file_get_display_name (CAJA_FILE (data));
+	if (additional_text != NULL) {
+		*additional_text = NULL;
+	}
+}
+
+static char *
+benchmark_icon_container_get_icon_description (CajaIconContainer *container,
+					       CajaIconData *data)
+{
+	return NULL;
+}
+
+static char *
+benchmark_icon_container_get_icon_uri (CajaIconContainer *container,
+				       CajaIconData *data)
+{
+	return caja_file_get_uri (CAJA_FILE (data));
+}
+
+static int
+benchmark_icon_container_compare_icons (CajaIconContainer *container,
+					CajaIconData *icon_a,
+					CajaIconData *icon_b)
+{
+	return caja_file_compare_for_sort (CAJA_FILE (icon_a),
+					   CAJA_FILE (icon_b),
+					   CAJA_FILE_SORT_BY_DISPLAY_NAME,
+					   FALSE, FALSE);
+}
+
+static void
+benchmark_icon_container_do_nothing (CajaIconContainer *container)
+{
+}
+
+static void
+benchmark_icon_container_start_monitor_top_left (CajaIconContainer *container,
+						 CajaIconData *data,
+						 gconstpointer client,
+						 gboolean large_text)
+{
+}
+
+static void
+benchmark_icon_container_stop_monitor_top_left (CajaIconContainer *container,
+						CajaIconData *data,
+						gconstpointer client)
+{
+}
+
+static void
+benchmark_icon_container_prioritize_thumbnailing (CajaIconContainer *container,
+						  CajaIconData *data)
+{
+}
+
+static void
+benchmark_icon_container_class_init (BenchmarkIconContainerClass *class)
+{
+	class->get_icon_images = benchmark_icon_container_get_icon_images;
+	class->get_icon_text = benchmark_icon_container_get_icon_text;
+	class->get_icon_description = benchmark_icon_container_get_icon_description;
+	class->get_icon_uri = benchmark_icon_container_get_icon_uri;
+	class->compare_icons = benchmark_icon_container_compare_icons;
+	class->compare_icons_by_name = benchmark_icon_container_compare_icons;
+	class->freeze_updates = benchmark_icon_container_do_nothing;
+	class->unfreeze_updates = benchmark_icon_container_do_nothing;
+	class->start_monitor_top_left = benchmark_icon_container_start_monitor_top_left;
+	class->stop_monitor_top_left = benchmark_icon_container_stop_monitor_top_left;
+	class->prioritize_thumbnailing = benchmark_icon_container_prioritize_thumbnailing;
+}
+
+static void
+benchmark_icon_container_init (BenchmarkIconContainer *container)
+{
+}
+
+/* Content types matching the extensions above, index for index. */
+static const char *content_types[] = {
+	"text/plain", "image/png", "image/jpeg", "application/pdf",
+	"text/x-csrc", "text/x-chdr", "audio/x-vorbis+ogg",
+	"application/x-compressed-tar", "text/html",
+	"application/vnd.oasis.opendocument.text"
+};
+
+static GFileInfo *
+create_synthetic_info (const char *name, int index, guint64 now)
+{
+	GFileInfo *info;
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+	g_file_info_set_display_name (info, name);
+	g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+	g_file_info_set_content_type (info, content_types[index % G_N_ELEMENTS (content_types)]);
+	/* Spread sizes and dates out so that sorting by either does
+	 * real work instead of hitting ties.
+	 */
+	g_file_info_set_size (info, ((goffset) index * 7919) % (64 * 1024 * 1024));
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					  now - ((guint64) index * 97) % (5 * 365 * 24 * 60 * 60));
+
+	return info;
+}
+
+static GList *
+create_synthetic_files (int count)
+{
+	GList *files;
+	CajaFile *file;
+	GFileInfo *info;
+	char *name, *uri;
+	guint64 now;
+	int i;
+
+	/* Nothing is ever read from disk for these, so the directory
+	 * does not need to exist. Each file gets its info up front, as
+	 * it would from a directory load, so the views sort and draw
+	 * real names, sizes, dates and types. Prepend in reverse to keep
+	 * the list in creation order without an O(n^2) append.
+	 */
+	now = time (NULL);
+	files = NULL;
+	for (i = count - 1; i >= 0; i--) {
+		name = g_strdup_printf ("file-%06d.%s",
+					i, extensions[i % G_N_ELEMENTS (extensions)]);
+		uri = g_strconcat ("file:///caja-view-benchmark/", name, NULL);
+		file = caja_file_get_by_uri (uri);
+
+		info = create_synthetic_info (name, i, now);
+		caja_file_update_info (file, info);
+		g_object_unref (info);
+
+		files = g_list_prepend (files, file);
+		g_free (uri);
+		g_free (name);
+	}
+
+	return files;
+}
+
+static void
+flush_display (void)
+{
+	while (gtk_events_pending ()) {
+		gtk_main_iteration ();
+	}
+	gdk_window_process_all_updates ();
+	gdk_flush ();
+}
+
+static FrameStats *
+frame_stats_new (void)
+{
+	FrameStats *stats;
+
+	stats = g_new0 (FrameStats, 1);
+	stats->samples = g_array_new (FALSE, FALSE, sizeof (double));
+	stats->timer = g_timer_new ();
+
+	return stats;
+}
+
+static void
+frame_stats_free (FrameStats *stats)
+{
+	g_array_free (stats->samples, TRUE);
+	g_timer_destroy (stats->timer);
+	g_free (stats);
+}
+
+static void
+frame_begin (FrameStats *stats)
+{
+	g_timer_start (stats->timer);
+}
+
+static void
+frame_end (FrameStats *stats)
+{
+	double msec;
+
+	flush_display ();
+	msec = g_timer_elapsed (stats->timer, NULL) * 1000.0;
+	g_array_append_val (stats->samples, msec);
+}
+
+static int
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	double x, y;
+
+	x = *(const double *) a;
+	y = *(const double *) b;
+
+	return x < y ? -1 : x > y ? +1 : 0;
+}
+
+static void
+frame_stats_report (FrameStats *stats, const char *label)
+{
+	double *samples;
+	double total;
+	guint n, i;
+
+	n = stats->samples->len;
+	if (n == 0) {
+		return;
+	}
+
+	g_array_sort (stats->samples, compare_doubles);
+	samples = (double *) stats->samples->data;
+
+	total = 0;
+	for (i = 0; i < n; i++) {
+		total += samples[i];
+	}
+
+	g_print ("  %-22s frames %4u  min %8.2f  median %8.2f  p95 %8.2f  max %8.2f  total %9.1f ms\n",
+		 label, n,
+		 samples[0],
+		 samples[n / 2],
+		 samples[MIN (n - 1, (n * 95) / 100)],
+		 samples[n - 1],
+		 total);
+}
+
+static void
+report_single (const char *label, double seconds)
+{
+	g_print ("  %-22s %9.1f ms\n", label, seconds * 1000.0);
+}
+
+static void
+report_peak_rss (void)
+{
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0) {
+		/* ru_maxrss is in kilobytes on Linux. */
+		g_print ("  %-22s %9ld kB\n", "peak RSS", usage.ru_maxrss);
+	}
+}
+
+static void
+benchmark_scroll (GtkAdjustment *vadjustment, const char *label)
+{
+	FrameStats *stats;
+	double lower, upper, page, value;
+	int i;
+
+	stats = frame_stats_new ();
+
+	lower = gtk_adjustment_get_lower (vadjustment);
+	upper = gtk_adjustment_get_upper (vadjustment);
+	page = gtk_adjustment_get_page_size (vadjustment);
+
+	/* Down in even steps, then jump back to the top. */
+	for (i = 0; i <= SCROLL_FRAMES; i++) {
+		value = lower + (upper - page - lower) * i / SCROLL_FRAMES;
+		frame_begin (stats);
+		gtk_adjustment_set_value (vadjustment, MAX (lower, value));
+		frame_end (stats);
+	}
+	frame_begin (stats);
+	gtk_adjustment_set_value (vadjustment, lower);
+	frame_end (stats);
+
+	frame_stats_report (stats, label);
+	frame_stats_free (stats);
+}
+
+static GtkWidget *
+create_window (GtkWidget *view, GtkAdjustment **vadjustment)
+{
+	GtkWidget *window, *scrolled_window;
+
+	window = gtk_offscreen_window_new ();
+	gtk_window_set_default_size (GTK_WINDOW (window), WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+					GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add (GTK_CONTAINER (scrolled_window), view);
+	gtk_container_add (GTK_CONTAINER (window), scrolled_window);
+
+	gtk_widget_show_all (window);
+	flush_display ();
+
+	*vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled_window));
+
+	return window;
+}
+
+static void
+benchmark_icon_view (GList *files)
+{
+	CajaIconContainer *container;
+	GtkWidget *window;
+	GtkAdjustment *vadjustment;
+	FrameStats *stats;
+	GList *l, *selection;
+	GTimer *timer;
+	char *label;
+	int zoom_level, i, n, count, step;
+
+	g_print ("icon view, %u files\n", g_list_length (files));
+
+	container = g_object_new (benchmark_icon_container_get_type (), NULL);
+	caja_icon_container_set_auto_layout (container, TRUE);
+	window = create_window (GTK_WIDGET (container), &vadjustment);
+
+	timer = g_timer_new ();
+
+	caja_icon_container_begin_loading (container);
+	for (l = files; l != NULL; l = l->next) {
+		caja_icon_container_add (container, l->data);
+	}
+	caja_icon_container_end_loading (container, TRUE);
+	caja_icon_container_layout_now (container);
+	report_single ("add and layout", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	flush_display ();
+	report_single ("first redraw", g_timer_elapsed (timer, NULL));
+
+	benchmark_scroll (vadjustment, "scroll");
+
+	stats = frame_stats_new ();
+	for (zoom_level = CAJA_ZOOM_LEVEL_SMALLEST; zoom_level <= CAJA_ZOOM_LEVEL_LARGEST; zoom_level++) {
+		g_timer_start (timer);
+		frame_begin (stats);
+		caja_icon_container_set_zoom_level (container, zoom_level);
+		caja_icon_container_layout_now (container);
+		frame_end (stats);
+
+		label = g_strdup_printf ("zoom %d layout", zoom_level);
+		report_single (label, g_timer_elapsed (timer, NULL));
+		g_free (label);
+	}
+	frame_stats_report (stats, "zoom");
+	frame_stats_free (stats);
+
+	caja_icon_container_set_zoom_level (container, CAJA_ZOOM_LEVEL_STANDARD);
+	caja_icon_container_layout_now (container);
+	flush_display ();
+	benchmark_scroll (vadjustment, "scroll (standard)");
+
+	/* Grow the selection the way a rubberband drag over the top of
+	 * the view does. Real pointer grabs cannot be scripted reliably
+	 * offscreen, so the selection is set directly.
+	 */
+	stats = frame_stats_new ();
+	count = MIN ((int) g_list_length (files), 1000);
+	step = MAX (1, count / RUBBERBAND_FRAMES);
+	for (i = step; i <= count; i += step) {
+		selection = NULL;
+		for (l = files, n = 0; l != NULL && n < i; l = l->next, n++) {
+			selection = g_list_prepend (selection, l->data);
+		}
+		frame_begin (stats);
+		caja_icon_container_set_selection (container, selection);
+		frame_end (stats);
+		g_list_free (selection);
+	}
+	frame_stats_report (stats, "rubberband");
+	frame_stats_free (stats);
+
+	g_timer_start (timer);
+	caja_icon_container_select_all (container);
+	flush_display ();
+	report_single ("select all", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	caja_icon_container_unselect_all (container);
+	flush_display ();
+	report_single ("unselect all", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	caja_icon_container_sort (container);
+	caja_icon_container_layout_now (container);
+	flush_display ();
+	report_single ("resort", g_timer_elapsed (timer, NULL));
+
+	report_peak_rss ();
+
+	g_timer_destroy (timer);
+	gtk_widget_destroy (window);
+}
+
+static void
+benchmark_list_view (GList *files)
+{
+	FMListModel *model;
+	GtkTreeView *tree_view;
+	GtkTreeViewColumn *column;
+	GtkTreeSelection *selection;
+	GtkTreePath *start, *end;
+	GtkCellRenderer *cell;
+	GtkWidget *window;
+	GtkAdjustment *vadjustment;
+	FrameStats *stats;
+	GList *columns, *l;
+	GTimer *timer;
+	char *name;
+	int column_num, sort_column_id, zoom_level, i, count, step;
+
+	g_print ("list view, %u files\n", g_list_length (files));
+
+	model = g_object_new (FM_TYPE_LIST_MODEL, NULL);
+	tree_view = GTK_TREE_VIEW (gtk_tree_view_new ());
+	selection = gtk_tree_view_get_selection (tree_view);
+	gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
+	gtk_tree_view_set_rules_hint (tree_view, TRUE);
+
+	/* Same columns as FMListView, with the icon packed into the
+	 * name column.
+	 */
+	columns = caja_get_all_columns ();
+	for (l = columns; l != NULL; l = l->next) {
+		g_object_get (l->data, "name", &name, NULL);
+		column_num = fm_list_model_add_column (model, l->data);
+
+		column = gtk_tree_view_column_new ();
+		gtk_tree_view_column_set_title (column, name);
+		if (strcmp (name, "name") == 0) {
+			cell = gtk_cell_renderer_pixbuf_new ();
+			gtk_tree_view_column_pack_start (column, cell, FALSE);
+			gtk_tree_view_column_set_attributes (column, cell,
+							     "pixbuf", FM_LIST_MODEL_SMALL_ICON_COLUMN,
+							     NULL);
+		}
+		cell = gtk_cell_renderer_text_new ();
+		gtk_tree_view_column_pack_start (column, cell, TRUE);
+		gtk_tree_view_column_set_attributes (column, cell,
+						     "text", column_num,
+						     NULL);
+		gtk_tree_view_append_column (tree_view, column);
+		g_free (name);
+	}
+	caja_column_list_free (columns);
+
+	window = create_window (GTK_WIDGET (tree_view), &vadjustment);
+
+	timer = g_timer_new ();
+
+	fm_list_model_add_files (model, files, NULL);
+	gtk_tree_view_set_model (tree_view, GTK_TREE_MODEL (model));
+	report_single ("add and attach", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	flush_display ();
+	report_single ("first redraw", g_timer_elapsed (timer, NULL));
+
+	benchmark_scroll (vadjustment, "scroll");
+
+	/* The list view changes zoom by switching the icon column. */
+	stats = frame_stats_new ();
+	column = gtk_tree_view_get_column (tree_view, 0);
+	cell = NULL;
+	{
+		GList *cells;
+
+		cells = gtk_cell_layout_get_cells (GTK_CELL_LAYOUT (column));
+		if (cells != NULL && GTK_IS_CELL_RENDERER_PIXBUF (cells->data)) {
+			cell = cells->data;
+		}
+		g_list_free (cells);
+	}
+	for (zoom_level = CAJA_ZOOM_LEVEL_SMALLEST; cell != NULL && zoom_level <= CAJA_ZOOM_LEVEL_LARGEST; zoom_level++) {
+		frame_begin (stats);
+		gtk_tree_view_column_set_attributes (column, cell,
+						     "pixbuf", fm_list_model_get_column_id_from_zoom_level (zoom_level),
+						     NULL);
+		gtk_tree_view_columns_autosize (tree_view);
+		frame_end (stats);
+	}
+	if (cell != NULL) {
+		gtk_tree_view_column_set_attributes (column, cell,
+						     "pixbuf", FM_LIST_MODEL_SMALL_ICON_COLUMN,
+						     NULL);
+	}
+	frame_stats_report (stats, "zoom");
+	frame_stats_free (stats);
+
+	stats = frame_stats_new ();
+	count = MIN ((int) g_list_length (files), 1000);
+	step = MAX (1, count / RUBBERBAND_FRAMES);
+	start = gtk_tree_path_new_first ();
+	for (i = step; i <= count; i += step) {
+		end = gtk_tree_path_new_from_indices (i - 1, -1);
+		frame_begin (stats);
+		gtk_tree_selection_unselect_all (selection);
+		gtk_tree_selection_select_range (selection, start, end);
+		frame_end (stats);
+		gtk_tree_path_free (end);
+	}
+	gtk_tree_path_free (start);
+	frame_stats_report (stats, "rubberband");
+	frame_stats_free (stats);
+
+	g_timer_start (timer);
+	gtk_tree_selection_select_all (selection);
+	flush_display ();
+	report_single ("select all", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	gtk_tree_selection_unselect_all (selection);
+	flush_display ();
+	report_single ("unselect all", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	sort_column_id = fm_list_model_get_sort_column_id_from_attribute
+		(model, g_quark_from_static_string ("size"));
+	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model),
+					      sort_column_id,
+					      GTK_SORT_DESCENDING);
+	flush_display ();
+	report_single ("resort by size", g_timer_elapsed (timer, NULL));
+
+	g_timer_start (timer);
+	sort_column_id = fm_list_model_get_sort_column_id_from_attribute
+		(model, g_quark_from_static_string ("name"));
+	gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model),
+					      sort_column_id,
+					      GTK_SORT_ASCENDING);
+	flush_display ();
+	report_single ("resort by name", g_timer_elapsed (timer, NULL));
+
+	report_peak_rss ();
+
+	g_timer_destroy (timer);
+	gtk_widget_destroy (window);
+	g_object_unref (model);
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error;
+	GList *files;
+	gboolean icon, list;
+	int i;
+
+	test_init (&argc, &argv);
+
+	context = g_option_context_new ("- benchmark the icon and list views");
+	g_option_context_add_main_entries (context, options, NULL);
+
+	error = NULL;
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	icon = view_option == NULL || strcmp (view_option, "both") == 0 || strcmp (view_option, "icon") == 0;
+	list = view_option == NULL || strcmp (view_option, "both") == 0 || strcmp (view_option, "list") == 0;
+	if (!icon && !list) {
+		g_printerr ("Unknown view \"%s\"\n", view_option);
+		return EXIT_FAILURE;
+	}
+
+	files_option = CLAMP (files_option, MIN_FILES, MAX_FILES);
+
+	caja_global_preferences_init ();
+
+	files = create_synthetic_files (files_option);
+
+	for (i = 0; i < MAX (1, repeat_option); i++) {
+		if (icon) {
+			benchmark_icon_view (files);
+		}
+		if (list) {
+			benchmark_list_view (files);
+		}
+	}
+
+	caja_file_list_free (files);
+
+	return test_quit (EXIT_SUCCESS);
+}